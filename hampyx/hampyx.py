@@ -12,6 +12,8 @@ In []: object = hpx.Hampyx (xml_path=<xml file path>, exe_path=<executable path>
 # hammurabiX executable path,
 # by default,
 # is searched from the environment varialbe PATH,
+# unless the compiled module _hamx (built with ENABLE_PYTHON) is importable,
+# in which case hammurabiX runs in process, without temporary files,
 # while xml file path,
 # by default,
 # is searched in the current working directory './'.
@@ -66,6 +68,11 @@ import subprocess
 import xml.etree.ElementTree as et
 import numpy as np
 
+try:
+    import _hamx
+except ImportError:
+    _hamx = None
+
 
 from functools import wraps
 def icy(cls):
@@ -108,10 +115,13 @@ class Hampyx(object):
             XML parameter file path
             
         exe_path : string
-            hammurabi C executable path
+            hammurabi C executable path,
+            if None and module _hamx is available, run in process
         """
         # current working directory
         self.wk_dir = None
+        # in-process pipeline, kept across runs
+        self._pipeline = None
         # encapsulated below
         self.exe_path = exe_path
         self.xml_path = xml_path
@@ -138,8 +148,13 @@ class Hampyx(object):
     @exe_path.setter
     def exe_path(self, exe_path):
         """
-        by default hammurabiX executable "hamx" should be available in PATH
+        by default hammurabiX executable "hamx" should be available in PATH,
+        or module _hamx in PYTHONPATH
         """
+        if exe_path is None and _hamx is not None:  # run in process
+            self._exe_path = None
+            self._executable = None
+            return
         if exe_path is None:  # search sys environ
             self._exe_path = None
             env = os.environ.get('PATH').split(os.pathsep)
@@ -237,8 +252,12 @@ class Hampyx(object):
         ----------
         
         verbose : bool
-            record hammurabi executable std output/error, or not
+            record hammurabi executable std output/error, or not,
+            ignored when running in process
         """
+        if self._executable is None:
+            self._run_module()
+            return
         # create new temp parameter file
         if self.temp_file is self._base_file:
             self._new_xml_copy()
@@ -266,6 +285,30 @@ class Hampyx(object):
         self._get_sims()
         self._del_xml_copy()
 
+    def _run_module(self):
+        """
+        run in process with module _hamx,
+        only stages whose parameters changed since last run are assembled,
+        maps are copied out of the pipeline
+        """
+        root = self.tree.getroot()
+        text = et.tostring(root, encoding='unicode')
+        if self._pipeline is None:
+            self._pipeline = _hamx.Pipeline(text)
+        self._pipeline.run(text)
+        maps = self._pipeline.maps()
+        for sync in root.findall("./observable/sync[@cue='1']"):
+            freq = str(sync.get('freq'))
+            nside = str(sync.get('nside'))
+            name = sync.get('filename')[:-4]
+            for stokes in ('I', 'Q', 'U'):
+                self.sim_map[('sync', freq, nside, stokes)] = np.array(maps[name+'_'+stokes+'.bin'])
+        for tag, obs in (('fd', 'faraday'), ('dm', 'dm')):
+            target = root.find("./observable/"+obs+"[@cue='1']")
+            if target is not None:
+                nside = str(target.get('nside'))
+                self.sim_map[(tag, 'nan', nside, 'nan')] = np.array(maps[target.get('filename')])
+
     def _new_xml_copy(self):
         """
         make a temporary parameter file copy and rename output file with random mark
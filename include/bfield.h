@@ -73,6 +73,29 @@ public:
   // 1st argument: parameter class object
   // 2nd argument: magnetic field grid class object
   virtual void write_grid(const Param *, Grid_breg *) const;
+  // get regular magnetic field at a batch of positions
+  // read/build permission is checked once per batch
+  // 1st-3rd arguments: galactic centric Cartesian frame x, y, z arrays
+  // 4th argument: number of positions
+  // 5th argument: parameter class object
+  // 6th argument: magnetic grid class object
+  // 7th-9th arguments: output field x, y, z component arrays
+  virtual void read_field_batch(const ham_float *, const ham_float *,
+                                const ham_float *, const ham_uint &,
+                                const Param *, const Grid_breg *, ham_float *,
+                                ham_float *, ham_float *) const;
+  // assemble analytic magnetic field at a batch of positions
+  // arguments as ``read_field_batch``, without grid object
+  virtual void write_field_batch(const ham_float *, const ham_float *,
+                                 const ham_float *, const ham_uint &,
+                                 const Param *, ham_float *, ham_float *,
+                                 ham_float *) const;
+  // read from field grid with linear interpolation at a batch of positions
+  // arguments as ``read_field_batch``
+  virtual void read_grid_batch(const ham_float *, const ham_float *,
+                               const ham_float *, const ham_uint &,
+                               const Param *, const Grid_breg *, ham_float *,
+                               ham_float *, ham_float *) const;
 };
 
 // random magnetic field
@@ -95,6 +118,17 @@ public:
   // write random field to grid (model dependent)
   virtual void write_grid(const Param *, const Breg *, const Grid_breg *,
                           Grid_brnd *) const;
+  // get random magnetic field at a batch of positions
+  // arguments as ``Breg::read_field_batch``
+  virtual void read_field_batch(const ham_float *, const ham_float *,
+                                const ham_float *, const ham_uint &,
+                                const Param *, const Grid_brnd *, ham_float *,
+                                ham_float *, ham_float *) const;
+  // read from field grid with linear interpolation at a batch of positions
+  virtual void read_grid_batch(const ham_float *, const ham_float *,
+                               const ham_float *, const ham_uint &,
+                               const Param *, const Grid_brnd *, ham_float *,
+                               ham_float *, ham_float *) const;
 };
 
 //------------------------------ Breg DERIVED --------------------------------//
@@ -82,6 +82,29 @@ public:
   // 2nd argument: parameter class object
   virtual ham_float spatial_profile(const Hamvec<3, ham_float> &,
                                     const Param *) const;
+  // read CRE flux from grid at all energy indices for a batch of positions
+  // 1st-3rd arguments: galactic centric Cartesian frame x, y, z arrays
+  // 4th argument: number of positions
+  // 5th argument: parameter class object
+  // 6th argument: CRE grid class object
+  // 7th argument: output flux array, energy index runs fastest
+  virtual void read_grid_num_batch(const ham_float *, const ham_float *,
+                                   const ham_float *, const ham_uint &,
+                                   const Param *, const Grid_cre *,
+                                   ham_float *) const;
+  // flux normalization at a batch of positions
+  // 1st-3rd arguments: galactic centric Cartesian frame x, y, z arrays
+  // 4th argument: number of positions
+  // 5th argument: parameter class object
+  // 6th argument: output array
+  virtual void flux_norm_batch(const ham_float *, const ham_float *,
+                               const ham_float *, const ham_uint &,
+                               const Param *, ham_float *) const;
+  // flux index at a batch of positions
+  // arguments as ``flux_norm_batch``
+  virtual void flux_idx_batch(const ham_float *, const ham_float *,
+                              const ham_float *, const ham_uint &,
+                              const Param *, ham_float *) const;
 };
 
 // uniform CRE flux
@@ -104,6 +127,13 @@ public:
   // spatial CRE flux reprofiling
   ham_float spatial_profile(const Hamvec<3, ham_float> &,
                             const Param *) const override;
+  // position independent factors are evaluated once per batch
+  void flux_norm_batch(const ham_float *, const ham_float *, const ham_float *,
+                       const ham_uint &, const Param *,
+                       ham_float *) const override;
+  void flux_idx_batch(const ham_float *, const ham_float *, const ham_float *,
+                      const ham_uint &, const Param *,
+                      ham_float *) const override;
 };
 
 // analytic CRE flux
@@ -126,6 +156,10 @@ public:
   // spatial CRE flux reprofiling
   ham_float spatial_profile(const Hamvec<3, ham_float> &,
                             const Param *) const override;
+  // position independent factor is evaluated once per batch
+  void flux_norm_batch(const ham_float *, const ham_float *, const ham_float *,
+                       const ham_uint &, const Param *,
+                       ham_float *) const override;
 };
 
 // use numerical CRE flux
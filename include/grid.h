@@ -13,6 +13,10 @@
 // There are three major functions in Grid class
 // ``build_grid`` is in charge of preparing data structure and memory allocation
 // ``import_grid`` and ``export_grid`` interface with external data sotrage
+// ``export_data`` packs files of ``export_grid``, which are written
+// either directly or by Hamwriter in background
+// ``prefilter_grid`` of field grids prepares filled grids for
+// interpolation, grids are exported before
 
 #ifndef HAMMURABI_GRID_H
 #define HAMMURABI_GRID_H
@@ -21,9 +25,14 @@
 #include <cassert>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <fftw3.h>
+#include <hamarray.h>
+#include <hamgrid.h>
+#include <haminterp.h>
+#include <hamlayout.h>
 #include <hamdis.h>
 #include <hamsk.h>
 #include <hamtype.h>
@@ -38,12 +47,33 @@ public:
   Grid &operator=(const Grid &) = delete;
   Grid &operator=(Grid &&) = delete;
   virtual ~Grid() = default;
+  // file names with file content
+  typedef std::vector<std::pair<std::string, std::vector<char>>> file_list;
   // build up grid and allocate memory
   virtual void build_grid(const Param *);
   // export grid to file
   virtual void export_grid(const Param *);
+  // pack grid into files of export
+  virtual file_list export_data(const Param *);
   // import file to grid
   virtual void import_grid(const Param *);
+  // import grid file, see hamgrid, either by bulk reads into own
+  // arrays ("stream") or as views into a file mapping ("mmap",
+  // "populate"), which falls back to conversion from the mapping if
+  // file dtype differs from ham_store, checksum is verified unless
+  // pages are read upon access ("mmap"),
+  // bricks of mapped files are decoded upon access into a cache
+  // 1st argument: file name
+  // 2nd argument: import mode
+  // 3rd argument: header of grid as given by parameters
+  // 4th argument: component arrays, in order of interleaving
+  // 5th argument: memory order of arrays, files of other than row-major
+  // order are imported into own arrays in any mode
+  // 6th argument: budget of decoded bricks in bytes
+  static void import_file(const std::string &, const std::string &,
+                          const hamgrid::header &,
+                          const std::vector<Hamarray<ham_store> *> &,
+                          const Hamlayout &, const std::size_t &);
 };
 
 // regular magnetic vector field grid
@@ -57,10 +87,16 @@ public:
   Grid_breg &operator=(Grid_breg &&) = delete;
   virtual ~Grid_breg() = default;
   void build_grid(const Param *) override;
-  void export_grid(const Param *) override;
+  file_list export_data(const Param *) override;
   void import_grid(const Param *) override;
+  // turn values into coefficients of interpolation, see Haminterp
+  void prefilter_grid();
   // spatial domain magnetic field
-  std::unique_ptr<ham_float[]> bx, by, bz;
+  Hamarray<ham_store> bx, by, bz;
+  // memory order of values
+  Hamlayout layout;
+  // interpolation at positions within grid box
+  Haminterp interp;
 };
 
 // random magnetic vector field grid
@@ -88,10 +124,16 @@ public:
     }
   };
   void build_grid(const Param *) override;
-  void export_grid(const Param *) override;
+  file_list export_data(const Param *) override;
   void import_grid(const Param *) override;
+  // turn values into coefficients of interpolation, see Haminterp
+  void prefilter_grid();
   // spatial domain magnetic field
-  std::unique_ptr<ham_float[]> bx, by, bz;
+  Hamarray<ham_store> bx, by, bz;
+  // memory order of values
+  Hamlayout layout;
+  // interpolation at positions within grid box
+  Haminterp interp;
   // Fourier domain magnetic field
   fftw_complex *c0, *c1;
   // for/backward FFT plans
@@ -111,10 +153,16 @@ public:
   Grid_tereg &operator=(Grid_tereg &&) = delete;
   virtual ~Grid_tereg() = default;
   void build_grid(const Param *) override;
-  void export_grid(const Param *) override;
+  file_list export_data(const Param *) override;
   void import_grid(const Param *) override;
+  // turn values into coefficients of interpolation, see Haminterp
+  void prefilter_grid();
   // spatial domain thermal electron field
-  std::unique_ptr<ham_float[]> te;
+  Hamarray<ham_store> te;
+  // memory order of values
+  Hamlayout layout;
+  // interpolation at positions within grid box
+  Haminterp interp;
 };
 
 // random thermal electron density field grid
@@ -138,10 +186,16 @@ public:
     }
   };
   void build_grid(const Param *) override;
-  void export_grid(const Param *) override;
+  file_list export_data(const Param *) override;
   void import_grid(const Param *) override;
+  // turn values into coefficients of interpolation, see Haminterp
+  void prefilter_grid();
   // spatial domain thermal electron field
-  std::unique_ptr<ham_float[]> te;
+  Hamarray<ham_store> te;
+  // memory order of values
+  Hamlayout layout;
+  // interpolation at positions within grid box
+  Haminterp interp;
   // Fourier domain thermal electron field
   fftw_complex *te_k;
   // backward FFT plan
@@ -161,10 +215,14 @@ public:
   Grid_cre &operator=(Grid_cre &&) = delete;
   virtual ~Grid_cre() = default;
   void build_grid(const Param *) override;
-  void export_grid(const Param *) override;
+  file_list export_data(const Param *) override;
   void import_grid(const Param *) override;
   // phase-space domain CRE flux field
-  std::unique_ptr<ham_float[]> cre_flux;
+  Hamarray<ham_store> cre_flux;
+  // memory order of values, row-major with energy running fastest
+  Hamlayout layout;
+  // interpolation at positions within grid box, of all energies
+  Haminterp interp;
 };
 
 // observable field grid
@@ -178,17 +236,22 @@ public:
   Grid_obs &operator=(Grid_obs &&) = delete;
   virtual ~Grid_obs() = default;
   void build_grid(const Param *) override;
-  void export_grid(const Param *) override;
+  file_list export_data(const Param *) override;
+  // rescale maps into conventional units and list them with export
+  // file names, maps are rescaled in place, once per integration
+  // 1st argument: parameter class object
+  std::vector<std::pair<std::string, Hampix<ham_float> *>>
+  export_list(const Param *);
+  // zero observable maps, keeping allocation and mask
+  void clear_grid();
   // HEALPix map for observables
   // dm_map: dispersion measure
-  // is_map: synchrotron Stokes I
-  // qs_map: synchrotron Stokes Q
-  // us_map: synchrotron Stokes U
+  // is_map: synchrotron Stokes I, one map per synchrotron channel
+  // qs_map: synchrotron Stokes Q, one map per synchrotron channel
+  // us_map: synchrotron Stokes U, one map per synchrotron channel
   // fd_map: Faraday depth
-  std::unique_ptr<Hampix<ham_float>> dm_map, is_map, qs_map, us_map, fd_map;
-  // temporary HEALPix map for each shell
-  std::unique_ptr<Hampix<ham_float>> tmp_dm_map, tmp_is_map, tmp_qs_map,
-      tmp_us_map, tmp_fd_map;
+  std::unique_ptr<Hampix<ham_float>> dm_map, fd_map;
+  std::vector<std::unique_ptr<Hampix<ham_float>>> is_map, qs_map, us_map;
   // mask map
   std::unique_ptr<Hampisk<ham_float>> mask_map;
 };
@@ -0,0 +1,254 @@
+// storage of field grids
+//
+// Hamarray holds the values of one grid component, either in its own
+// allocation or as a read-only view into a memory-mapped grid file,
+// where components of a cell are interleaved and a component is read
+// with a stride, components may share one own allocation interleaved
+// in the same way
+//
+// Hammap maps a whole file read-only, the mapping is shared by views of
+// all components and released with the last of them
+//
+// Hambricks decodes values of compressed grid files on demand, brick by
+// brick, and is shared by the arrays of all components
+
+#ifndef HAMMURABI_ARRAY_H
+#define HAMMURABI_ARRAY_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <hamtype.h>
+
+class Hammap {
+public:
+  // map whole file read-only
+  // 1st argument: file name
+  // 2nd argument: if all pages are read in before first access,
+  // otherwise pages are read in upon access
+  Hammap(const std::string &, const bool &);
+  Hammap() = delete;
+  Hammap(const Hammap &) = delete;
+  Hammap(Hammap &&) = delete;
+  Hammap &operator=(const Hammap &) = delete;
+  Hammap &operator=(Hammap &&) = delete;
+  virtual ~Hammap();
+  // first byte of mapping
+  const char *data() const { return this->ptr; }
+  // mapping size in bytes
+  std::size_t size() const { return this->bytes; }
+
+protected:
+  const char *ptr{nullptr};
+  std::size_t bytes{0};
+};
+
+// a brick covers edge^3 cells, or less at upper grid boundaries,
+// with all values of all components of its cells
+//
+// decoded bricks are cached for all threads and evicted in least recently
+// used order beyond the budget, each thread pins the last bricks it read,
+// so that reads within them take no lock, and pinned bricks outlive
+// their eviction until the thread reads other bricks
+template <typename T> class Hambricks {
+public:
+  // decoder of brick values, in order component, x, y, z and value per
+  // cell within brick
+  // 1st argument: brick index
+  // 2nd argument: values of brick
+  typedef std::function<void(const ham_uint &, T *)> decoder;
+  // 1st argument: number of cells in x, y and z direction
+  // 2nd argument: number of values per cell, running fastest
+  // 3rd argument: number of components
+  // 4th argument: brick edge length in cells, a power of 2
+  // 5th argument: budget of cached bricks in bytes
+  // 6th argument: brick decoder
+  Hambricks(const ham_uint (&)[3], const ham_uint &, const ham_uint &,
+            const ham_uint &, const std::size_t &, decoder);
+  Hambricks() = delete;
+  Hambricks(const Hambricks &) = delete;
+  Hambricks(Hambricks &&) = delete;
+  Hambricks &operator=(const Hambricks &) = delete;
+  Hambricks &operator=(Hambricks &&) = delete;
+  virtual ~Hambricks() = default;
+  // value of component
+  // 1st argument: index of value in component, as in toolkit::index3d
+  // or toolkit::index4d
+  // 2nd argument: component
+  inline T at(const ham_uint &i, const ham_uint &c) const {
+    assert(i < this->length and c < this->ncomp);
+    const ham_uint cell{i / this->nw};
+    const ham_uint z{cell % this->n[2]};
+    const ham_uint y{cell / this->n[2] % this->n[1]};
+    const ham_uint x{cell / this->n[2] / this->n[1]};
+    const brick &b{this->fetch(
+        ((x >> this->shift) * this->nb[1] + (y >> this->shift)) * this->nb[2] +
+        (z >> this->shift))};
+    const ham_uint mask{(ham_uint(1) << this->shift) - 1};
+    return b.values[(((c * b.n[0] + (x & mask)) * b.n[1] + (y & mask)) *
+                         b.n[2] +
+                     (z & mask)) *
+                        this->nw +
+                    i % this->nw];
+  }
+  // number of values per component
+  ham_uint size() const { return this->length; }
+  // number of bricks decoded so far, including repeated decoding
+  ham_uint decoded() const;
+  // bytes of bricks in cache
+  std::size_t resident() const;
+
+protected:
+  struct brick {
+    std::unique_ptr<T[]> values;
+    // number of cells in x, y and z direction
+    ham_uint n[3];
+    std::size_t bytes;
+  };
+  // last bricks read by a thread, of any Hambricks object
+  struct pin {
+    std::uint64_t owner{0};
+    ham_uint id{0};
+    std::shared_ptr<const brick> ptr;
+  };
+  static constexpr unsigned npin{8};
+  static thread_local pin pins[npin];
+  static thread_local unsigned next;
+  // number of cells, bricks, values per cell and components
+  ham_uint n[3], nb[3], nw, ncomp, length;
+  // brick edge length is 1 << shift
+  ham_uint shift;
+  std::size_t budget;
+  decoder decode;
+  // unique among all objects ever created, pins refer to it
+  std::uint64_t serial;
+  mutable std::mutex lock;
+  // cached bricks, most recently used first
+  mutable std::list<ham_uint> order;
+  mutable std::unordered_map<
+      ham_uint,
+      std::pair<std::shared_ptr<const brick>, std::list<ham_uint>::iterator>>
+      cache;
+  mutable std::size_t bytes{0};
+  mutable ham_uint count{0};
+  // brick by index, from pins of calling thread or else from cache
+  inline const brick &fetch(const ham_uint &id) const {
+    for (const pin &p : pins) {
+      if (p.id == id and p.owner == this->serial) {
+        return *p.ptr;
+      }
+    }
+    return this->load(id);
+  }
+  // brick from cache or decoder, pinned for calling thread
+  const brick &load(const ham_uint &) const;
+};
+
+template <typename T>
+thread_local typename Hambricks<T>::pin Hambricks<T>::pins[Hambricks<T>::npin];
+template <typename T> thread_local unsigned Hambricks<T>::next{0};
+
+template <typename T> class Hamarray {
+public:
+  Hamarray() = default;
+  // own allocation, zero initialized
+  // 1st argument: number of values
+  Hamarray(const ham_uint &n)
+      : own{new T[n](), std::default_delete<T[]>()}, ptr{own.get()},
+        length{n} {}
+  // read-only view into mapping
+  // 1st argument: mapping
+  // 2nd argument: address of first value in mapping
+  // 3rd argument: number of values
+  // 4th argument: distance between values, in number of values
+  Hamarray(const std::shared_ptr<const Hammap> &m, const T *p,
+           const ham_uint &n, const ham_uint &s)
+      : map{m}, ptr{const_cast<T *>(p)}, length{n}, step{s} {}
+  // read-only values decoded on demand
+  // 1st argument: bricks of all components
+  // 2nd argument: component
+  Hamarray(const std::shared_ptr<const Hambricks<T>> &b, const ham_uint &c)
+      : bricks{b}, length{b->size()}, comp{c} {}
+  Hamarray(const Hamarray &) = delete;
+  Hamarray(Hamarray &&) = default;
+  Hamarray &operator=(const Hamarray &) = delete;
+  Hamarray &operator=(Hamarray &&) = default;
+  ~Hamarray() = default;
+  // values of a view are read-only, writing into a view is an error
+  inline T &operator[](const ham_uint &i) {
+    assert(i < this->length and not this->bricks);
+    return this->ptr[i * this->step];
+  }
+  inline T operator[](const ham_uint &i) const {
+    assert(i < this->length);
+    if (this->bricks) {
+      return this->bricks->at(i, this->comp);
+    }
+    return this->ptr[i * this->step];
+  }
+  // first value, for contiguous access of own allocation
+  T *data() {
+    assert(this->own and this->step == 1);
+    return this->ptr;
+  }
+  // null if values are decoded on demand
+  const T *data() const { return this->ptr; }
+  // number of values
+  ham_uint size() const { return this->length; }
+  // distance between values, in number of values
+  ham_uint stride() const { return this->step; }
+  // if values are a view into a mapping or decoded on demand
+  bool mapped() const { return this->map != nullptr or this->bricks; }
+  // if values are decoded on demand
+  bool chunked() const { return this->bricks != nullptr; }
+  explicit operator bool() const {
+    return this->ptr != nullptr or this->bricks;
+  }
+  // components interleaved in one own allocation, zero initialized,
+  // value i of component c is at i * stride + c
+  // 1st argument: components, in order of interleaving
+  // 2nd argument: number of values per component
+  // 3rd argument: distance between values, in number of values,
+  // at least number of components
+  static void interleave(const std::vector<Hamarray *> &list,
+                         const ham_uint &n, const ham_uint &s) {
+    assert(s >= list.size());
+    // first value at cache line boundary, so that cells of a power of 2
+    // values do not straddle cache lines
+    constexpr std::size_t line{64};
+    const std::size_t size{n * s + line / sizeof(T)};
+    std::shared_ptr<T> block(new T[size](), std::default_delete<T[]>());
+    void *first{block.get()};
+    std::size_t space{size * sizeof(T)};
+    std::align(line, n * s * sizeof(T), first, space);
+    for (ham_uint c = 0; c != list.size(); ++c) {
+      Hamarray &a{*list[c]};
+      a = Hamarray();
+      a.own = block;
+      a.ptr = static_cast<T *>(first) + c;
+      a.length = n;
+      a.step = s;
+    }
+  }
+
+protected:
+  // shared among interleaved components
+  std::shared_ptr<T> own;
+  std::shared_ptr<const Hammap> map;
+  std::shared_ptr<const Hambricks<T>> bricks;
+  T *ptr{nullptr};
+  ham_uint length{0};
+  ham_uint step{1};
+  // component of bricks
+  ham_uint comp{0};
+};
+
+#endif
@@ -80,6 +80,8 @@ public:
   virtual void data(const T &new_data) { this->Data = new_data; }
   // update ksy index
   virtual void index(const ham_uint &new_idx) { this->Index = new_idx; }
+  // address of sky information, for strided views of node arrays
+  const T *data_address() const { return &this->Data; }
 };
 
 // data type T
@@ -157,6 +159,9 @@ public:
   }
   // extract map size
   virtual ham_uint npix() const { return this->Map->size(); }
+  // address of first node data, node data are sizeof(Node<T>) apart,
+  // valid until map is resized
+  const T *data_address() const { return this->Map->front().data_address(); }
   // print to content of each pix to screen
   virtual void print() const {
     std::cout << "... printing Hamdis map information ..." << std::endl;
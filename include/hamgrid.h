@@ -0,0 +1,176 @@
+// container format of field grid files
+//
+// a grid file starts with one page of header, padded with zeros,
+// followed by the payload of values from the first page boundary on,
+// so that a mapped file is a valid array of values
+//
+// payload of interleaved layout holds grid components interleaved per
+// value index, e.g. bx,by,bz of a cell in turn, value index runs as in
+// toolkit::index3d, and toolkit::index4d for CRE, whatever the memory
+// order of grids, see Hamlayout, values are stored as ham_store of the
+// writing build, given by dtype, in byte order of the writing machine,
+// and zero padded to a multiple of 8 bytes, the checksum is 64-bit
+// FNV-1a over padded payload taken as native 64-bit words
+//
+// payload of brick layout splits the spatial grid into bricks of edge^3
+// cells, or less at upper boundaries, bricks are indexed as cells are,
+// the payload starts with byte offsets of all bricks relative to payload
+// and the end offset, followed by compressed bricks, each brick holds
+// all values of its cells in order component, x, y, z and CRE energy,
+// compressed by codec
+// "lossless" XOR of neighbouring values, byte planes, zero runs
+// "lossy" values rounded to multiples of 2*tolerance, differences of
+// neighbouring multiples as zigzag variable length integers,
+// which keeps absolute errors within tolerance
+//
+// files of other byte order are rejected, raw files of former releases
+// are converted by hamx_convert
+
+#ifndef HAMMURABI_GRIDFILE_H
+#define HAMMURABI_GRIDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <hamarray.h>
+#include <hamlayout.h>
+#include <hamtype.h>
+#include <param.h>
+
+namespace hamgrid {
+
+// format version of header
+constexpr std::uint64_t version{1};
+// byte order mark, as written by writing machine
+constexpr std::uint64_t endian{0x0102030405060708ull};
+// header and payload alignment in bytes
+constexpr std::size_t page{4096};
+
+// fields of 8 bytes each, without padding
+struct header {
+  // "HAMGRID"
+  char magic[8];
+  std::uint64_t version;
+  std::uint64_t endian;
+  // "breg", "brnd", "tereg", "ternd" or "cre"
+  char kind[8];
+  // "f8" or "f4"
+  char dtype[8];
+  // "interleaved" or "brick"
+  char layout[16];
+  // number of components per value index
+  std::uint64_t ncomp;
+  // number of grid support points, nE is 1 except for CRE
+  std::uint64_t nx, ny, nz, nE;
+  // galactic centric Cartesian limits, in cgs units
+  double x_min, x_max, y_min, y_max, z_min, z_max;
+  // CRE energy limits, in cgs units
+  double E_min, E_max;
+  // random seed of generated grid, zero if unknown or not random
+  std::uint64_t seed;
+  // fingerprint of field parameters, see Param::param_stage
+  std::uint64_t param_hash;
+  // payload position and size in bytes, without padding
+  std::uint64_t offset, bytes;
+  std::uint64_t checksum;
+  // brick edge length in cells, zero for interleaved layout
+  std::uint64_t brick;
+  // brick codec "lossless" or "lossy", "none" for interleaved layout
+  char codec[16];
+  // absolute error bound of lossy codec, zero otherwise
+  double tolerance;
+};
+
+// header of grid kind as given by parameters, without checksum,
+// and without payload size of brick layout
+// 1st argument: grid kind
+// 2nd argument: parameter class object
+header describe(const std::string &, const Param *);
+
+// header of file, throws if file is not a grid file of this machine
+// 1st argument: first bytes of file
+// 2nd argument: number of given bytes
+// 3rd argument: file name, for messages
+header parse(const char *, const std::size_t &, const std::string &);
+
+// throw if grid in file does not fit grid of parameters
+// 1st argument: header of file
+// 2nd argument: header of parameters
+// 3rd argument: file name, for messages
+void check(const header &, const header &, const std::string &);
+
+// number of values per component
+inline std::uint64_t count(const header &h) {
+  return h.nx * h.ny * h.nz * h.nE;
+}
+
+// size of value in payload in bytes
+inline std::size_t itemsize(const header &h) {
+  return h.dtype[1] == '4' ? sizeof(float) : sizeof(double);
+}
+
+// payload size in bytes with padding
+inline std::uint64_t padded(const std::uint64_t &bytes) {
+  return (bytes + 7) / 8 * 8;
+}
+
+// if payload is split into bricks
+inline bool bricked(const header &h) { return h.brick != 0; }
+
+// number of bricks
+inline std::uint64_t bricks(const header &h) {
+  return ((h.nx + h.brick - 1) / h.brick) * ((h.ny + h.brick - 1) / h.brick) *
+         ((h.nz + h.brick - 1) / h.brick);
+}
+
+// throw if brick offsets exceed payload
+// 1st argument: header of file
+// 2nd argument: payload
+// 3rd argument: file name, for messages
+void check_bricks(const header &, const char *, const std::string &);
+
+// decode brick, in order component, x, y, z and CRE energy
+// 1st argument: header of file
+// 2nd argument: payload
+// 3rd argument: brick index
+// 4th argument: values of brick
+void unpack(const header &, const char *, const std::uint64_t &,
+            ham_store *);
+
+// decode all bricks into components
+// 1st argument: header of file
+// 2nd argument: payload
+// 3rd argument: components, own arrays
+// 4th argument: memory order of components
+void unpack(const header &, const char *,
+            const std::vector<Hamarray<ham_store> *> &, const Hamlayout &);
+
+// continue 64-bit FNV-1a checksum over words
+// 1st argument: checksum so far
+// 2nd argument: first byte
+// 3rd argument: number of bytes, a multiple of 8
+std::uint64_t checksum(std::uint64_t, const char *, const std::size_t &);
+
+// initial value of checksum
+constexpr std::uint64_t checksum_basis{14695981039346656037ull};
+
+// file image of grid with header and checksum
+// 1st argument: header of grid, checksum and size are filled in
+// 2nd argument: components, in order of interleaving or within bricks
+// 3rd argument: memory order of components, files are row-major
+std::vector<char> pack(header,
+                       const std::vector<const Hamarray<ham_store> *> &,
+                       const Hamlayout &);
+
+// write raw file of interleaved ham_float values as grid file,
+// values of interleaved layout are kept as ham_float
+// 1st argument: raw file name
+// 2nd argument: grid file name
+// 3rd argument: header of grid, layout and codec are kept
+void convert(const std::string &, const std::string &, header);
+
+} // namespace hamgrid
+
+#endif
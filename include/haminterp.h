@@ -0,0 +1,261 @@
+// trilinear and tricubic interpolation of field grids
+//
+// Haminterp locates positions in the box of a grid with precomputed
+// reciprocal vertex spacings, and interpolates scalar, vector and
+// spectral grids from the eight vertices around a position, positions
+// outside the box, surface excluded, give zero
+//
+// tricubic interpolation reads the 64 vertices around a position, with
+// vertices beyond the box mirrored at its surface, Catmull-Rom splines
+// pass through grid values, cubic B-splines are smoother and more
+// accurate, but pass through values only after grid values are turned
+// into spline coefficients by prefilter, see Unser, IEEE Signal
+// Processing Magazine 16 (1999) 22, so that a grid of given accuracy
+// can be coarser than with trilinear interpolation
+//
+// values are read through a pointer and stride wherever possible,
+// components interleaved per vertex, in own allocation or in a mapped
+// grid file, are interpolated together from the same cache lines,
+// values decoded on demand are read through their arrays
+//
+// vertices are found through the memory order of the grid, see
+// Hamlayout
+//
+// batch kernels locate a block of positions at once and then gather
+// vertex values, both loops are free of branches and dependencies
+// among positions, so that compilers vectorize them, with gather
+// instructions where the target supports them, tricubic batch kernels
+// take one position at a time
+
+#ifndef HAMMURABI_INTERP_H
+#define HAMMURABI_INTERP_H
+
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <hamarray.h>
+#include <hamlayout.h>
+#include <hamtype.h>
+#include <hamvec.h>
+
+class Haminterp {
+public:
+  // number of positions located at once by batch kernels
+  static constexpr ham_uint block{64};
+  // empty grid, all positions are outside
+  Haminterp() = default;
+  // 1st argument: grid parameters, with number of vertices and limits
+  // of box in x, y and z direction, e.g. Param::grid_breg
+  // 2nd argument: memory order of grid values
+  // 3rd argument: interpolation "linear", "catmull-rom" or "bspline"
+  template <typename G>
+  Haminterp(const G &grid, const Hamlayout &layout,
+            const std::string &method = "linear")
+      : n{grid.nx, grid.ny, grid.nz},
+        lo{grid.x_min, grid.y_min, grid.z_min},
+        r{(grid.nx - 1) / (grid.x_max - grid.x_min),
+          (grid.ny - 1) / (grid.y_max - grid.y_min),
+          (grid.nz - 1) / (grid.z_max - grid.z_min)},
+        nw{layout.width()}, layout{layout}, cubic{method != "linear"},
+        spline{method == "bspline"} {
+    if (method != "linear" and method != "catmull-rom" and
+        method != "bspline") {
+      throw std::runtime_error("unsupported grid interpolation " + method);
+    }
+  }
+  // row-major grid
+  // 1st argument: grid parameters, as above
+  // 2nd argument: number of values per vertex, running fastest
+  template <typename G>
+  Haminterp(const G &grid, const ham_uint &nw = 1)
+      : Haminterp(grid, Hamlayout({grid.nx, grid.ny, grid.nz}, "row", nw)) {}
+  Haminterp(const Haminterp &) = default;
+  Haminterp(Haminterp &&) = default;
+  Haminterp &operator=(const Haminterp &) = default;
+  Haminterp &operator=(Haminterp &&) = default;
+  ~Haminterp() = default;
+  // cell around a position, as offsets of its lower and upper vertices
+  // per direction, see Hamlayout, and distances to its lower vertex in
+  // units of vertex spacing
+  struct cell {
+    ham_uint x[2], y[2], z[2];
+    ham_float xd, yd, zd;
+  };
+  // vertices around a position for tricubic interpolation, as offsets
+  // of four vertices per direction, see Hamlayout, and their weights
+  struct stencil {
+    ham_uint x[4], y[4], z[4];
+    ham_float wx[4], wy[4], wz[4];
+  };
+  // locate position, false outside box, surface excluded
+  // 1st argument: galactic centric Cartesian position
+  // 2nd argument: cell of position, left as is outside box
+  inline bool locate(const Hamvec<3, ham_float> &pos, cell &c) const {
+    const ham_float tx{(pos[0] - this->lo[0]) * this->r[0]};
+    const ham_float ty{(pos[1] - this->lo[1]) * this->r[1]};
+    const ham_float tz{(pos[2] - this->lo[2]) * this->r[2]};
+    if (tx <= 0 or tx >= this->n[0] - 1 or ty <= 0 or
+        ty >= this->n[1] - 1 or tz <= 0 or tz >= this->n[2] - 1) {
+      return false;
+    }
+    const ham_uint xl{(ham_uint)std::floor(tx)};
+    const ham_uint yl{(ham_uint)std::floor(ty)};
+    const ham_uint zl{(ham_uint)std::floor(tz)};
+    const ham_uint *ox{this->layout.offsets(0)};
+    const ham_uint *oy{this->layout.offsets(1)};
+    const ham_uint *oz{this->layout.offsets(2)};
+    c.x[0] = ox[xl];
+    c.x[1] = ox[xl + 1];
+    c.y[0] = oy[yl];
+    c.y[1] = oy[yl + 1];
+    c.z[0] = oz[zl];
+    c.z[1] = oz[zl + 1];
+    c.xd = tx - xl;
+    c.yd = ty - yl;
+    c.zd = tz - zl;
+    assert(c.xd >= 0 and c.yd >= 0 and c.zd >= 0 and c.xd < 1 and
+           c.yd < 1 and c.zd < 1);
+    return true;
+  }
+  // locate position for tricubic interpolation, false outside box,
+  // surface excluded
+  // 1st argument: galactic centric Cartesian position
+  // 2nd argument: stencil of position, left as is outside box
+  bool locate(const Hamvec<3, ham_float> &, stencil &) const;
+  // scalar grid at position
+  // 1st argument: galactic centric Cartesian position
+  // 2nd argument: grid values
+  // 3rd argument: value index within vertex, e.g. CRE energy index
+  ham_float scalar(const Hamvec<3, ham_float> &,
+                   const Hamarray<ham_store> &, const ham_uint &w = 0) const;
+  // vector grid at position
+  // 1st argument: galactic centric Cartesian position
+  // 2nd-4th argument: grid values of x, y and z component
+  Hamvec<3, ham_float> vector(const Hamvec<3, ham_float> &,
+                              const Hamarray<ham_store> &,
+                              const Hamarray<ham_store> &,
+                              const Hamarray<ham_store> &) const;
+  // scalar grid at a batch of positions
+  // 1st-3rd argument: galactic centric Cartesian x, y, z arrays
+  // 4th argument: number of positions
+  // 5th argument: grid values
+  // 6th argument: output array
+  void scalar(const ham_float *, const ham_float *, const ham_float *,
+              const ham_uint &, const Hamarray<ham_store> &,
+              ham_float *) const;
+  // vector grid at a batch of positions
+  // 1st-3rd argument: galactic centric Cartesian x, y, z arrays
+  // 4th argument: number of positions
+  // 5th-7th argument: grid values of x, y and z component
+  // 8th-10th argument: output arrays of x, y and z component
+  void vector(const ham_float *, const ham_float *, const ham_float *,
+              const ham_uint &, const Hamarray<ham_store> &,
+              const Hamarray<ham_store> &, const Hamarray<ham_store> &,
+              ham_float *, ham_float *, ham_float *) const;
+  // all values per vertex, e.g. CRE spectrum, at a batch of positions
+  // 1st-3rd argument: galactic centric Cartesian x, y, z arrays
+  // 4th argument: number of positions
+  // 5th argument: grid values
+  // 6th argument: output array, value index within vertex runs fastest
+  void spectral(const ham_float *, const ham_float *, const ham_float *,
+                const ham_uint &, const Hamarray<ham_store> &,
+                ham_float *) const;
+  // if components are interleaved per vertex in one stretch of memory,
+  // in order x, y and z
+  static bool interleaved(const Hamarray<ham_store> &,
+                          const Hamarray<ham_store> &,
+                          const Hamarray<ham_store> &);
+  // turn grid values into B-spline coefficients in place, once the grid
+  // is filled, nothing to do for other interpolations, views are
+  // read-only and replaced by own arrays first
+  // 1st argument: component arrays of grid
+  void prefilter(const std::vector<Hamarray<ham_store> *> &) const;
+  // if grid holds B-spline coefficients rather than values after
+  // prefilter
+  bool prefiltered() const { return this->spline; }
+
+protected:
+  // number of vertices in x, y and z direction
+  ham_uint n[3]{0, 0, 0};
+  // lower box limits, and reciprocal vertex spacings
+  ham_float lo[3]{0., 0., 0.}, r[3]{0., 0., 0.};
+  // values per vertex
+  ham_uint nw{1};
+  // memory order of grid values
+  Hamlayout layout;
+  // if interpolated from 64 vertices, by B-splines
+  bool cubic{false}, spline{false};
+  // cells of a block of positions, see cell
+  struct cells {
+    ham_uint x0[block], x1[block], y0[block], y1[block], z0[block],
+        z1[block];
+    ham_float xd[block], yd[block], zd[block];
+    // 0 outside box, flags are as wide as offsets, narrower ones do not
+    // vectorize
+    ham_uint in[block];
+  };
+  // linear interpolation, along z, y and x direction in turn
+  // 1st argument: values, value of position i is f[i * st]
+  // 2nd argument: distance between values
+  // 3rd-8th argument: offsets of lower and upper vertices in x, y and z
+  // direction, a value index within vertex is added to x offsets
+  // 9th-11th argument: distances to lower vertex
+  template <typename A>
+  inline ham_float trilinear(const A &f, const ham_uint &st,
+                             const ham_uint &x0, const ham_uint &x1,
+                             const ham_uint &y0, const ham_uint &y1,
+                             const ham_uint &z0, const ham_uint &z1,
+                             const ham_float &xd, const ham_float &yd,
+                             const ham_float &zd) const {
+    const ham_uint c00{x0 + y0};
+    const ham_uint c01{x0 + y1};
+    const ham_uint c10{x1 + y0};
+    const ham_uint c11{x1 + y1};
+    const ham_float i1{f[(c00 + z0) * st] * (1. - zd) +
+                       f[(c00 + z1) * st] * zd};
+    const ham_float i2{f[(c01 + z0) * st] * (1. - zd) +
+                       f[(c01 + z1) * st] * zd};
+    const ham_float j1{f[(c10 + z0) * st] * (1. - zd) +
+                       f[(c10 + z1) * st] * zd};
+    const ham_float j2{f[(c11 + z0) * st] * (1. - zd) +
+                       f[(c11 + z1) * st] * zd};
+    const ham_float w1{i1 * (1. - yd) + i2 * yd};
+    const ham_float w2{j1 * (1. - yd) + j2 * yd};
+    return w1 * (1. - xd) + w2 * xd;
+  }
+  // cubic interpolation, along z, y and x direction in turn
+  // 1st argument: values, value of position i is f[i * st]
+  // 2nd argument: distance between values
+  // 3rd argument: stencil of position
+  // 4th argument: value index within vertex
+  template <typename A>
+  inline ham_float tricubic(const A &f, const ham_uint &st, const stencil &s,
+                            const ham_uint &w) const {
+    ham_float result{0.};
+    for (unsigned a = 0; a != 4; ++a) {
+      ham_float plane{0.};
+      for (unsigned b = 0; b != 4; ++b) {
+        const ham_uint c{s.x[a] + s.y[b] + w};
+        const ham_float line{f[(c + s.z[0]) * st] * s.wz[0] +
+                             f[(c + s.z[1]) * st] * s.wz[1] +
+                             f[(c + s.z[2]) * st] * s.wz[2] +
+                             f[(c + s.z[3]) * st] * s.wz[3]};
+        plane += line * s.wy[b];
+      }
+      result += plane * s.wx[a];
+    }
+    return result;
+  }
+  // cells of a block of positions, positions outside box are flagged
+  // and given a cell nearby, so that their vertices are valid
+  // 1st-3rd argument: galactic centric Cartesian x, y, z arrays
+  // 4th argument: number of positions, at most block
+  // 5th argument: cells of positions
+  void locate(const ham_float *, const ham_float *, const ham_float *,
+              const ham_uint &, cells &) const;
+};
+
+#endif
@@ -2,11 +2,13 @@
 #define HAMMURABI_IO_H
 
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <memory>
 #include <omp.h>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <hamdis.h>
 #include <hamp.h>
@@ -35,23 +37,19 @@ public:
     std::fstream outfile(this->Filename.c_str(),
                          std::ios::out | std::ios::binary);
     if (outfile.is_open()) {
-      ham_float tmpfloat;
-      ham_uint tmpuint;
-      // unable to multithread
+      // records of index, theta, phi and data, written at once
+      const std::size_t record{sizeof(ham_uint) + 3 * sizeof(ham_float)};
+      std::vector<char> buffer(m.npix() * record);
+      char *ptr{buffer.data()};
       for (ham_uint i = 0; i < m.npix(); ++i) {
-        // idx
-        tmpuint = m.index(i);
-        outfile.write(reinterpret_cast<char *>(&tmpuint), sizeof(ham_uint));
-        // theta
-        tmpfloat = m.pointing(i).theta();
-        outfile.write(reinterpret_cast<char *>(&tmpfloat), sizeof(ham_float));
-        // phi
-        tmpfloat = m.pointing(i).phi();
-        outfile.write(reinterpret_cast<char *>(&tmpfloat), sizeof(ham_float));
-        // data
-        tmpfloat = m.data(i);
-        outfile.write(reinterpret_cast<char *>(&tmpfloat), sizeof(ham_float));
+        const ham_uint tmpuint{m.index(i)};
+        const ham_float tmpfloat[3]{m.pointing(i).theta(),
+                                    m.pointing(i).phi(), m.data(i)};
+        std::memcpy(ptr, &tmpuint, sizeof(ham_uint));
+        std::memcpy(ptr + sizeof(ham_uint), tmpfloat, sizeof(tmpfloat));
+        ptr += record;
       }
+      outfile.write(buffer.data(), buffer.size());
       outfile.close();
     } else
       throw std::runtime_error("unable to open file");
@@ -61,13 +59,13 @@ public:
     std::fstream outfile(this->Filename.c_str(),
                          std::ios::out | std::ios::binary);
     if (outfile.is_open()) {
-      ham_float tmpfloat;
-      // unable to multithread
+      // data written at once
+      std::vector<ham_float> buffer(m.npix());
       for (ham_uint i = 0; i < m.npix(); ++i) {
-        // data
-        tmpfloat = m.data(i);
-        outfile.write(reinterpret_cast<char *>(&tmpfloat), sizeof(ham_float));
+        buffer[i] = m.data(i);
       }
+      outfile.write(reinterpret_cast<const char *>(buffer.data()),
+                    buffer.size() * sizeof(ham_float));
       outfile.close();
     } else
       throw std::runtime_error("unable to open file");
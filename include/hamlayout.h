@@ -0,0 +1,81 @@
+// memory order of field grid values
+//
+// Hamlayout maps vertex indices to positions of values in memory,
+// the position is a sum of offsets per direction, looked up in one
+// table per direction, so that any order whose positions separate by
+// direction costs the same
+//
+// "row" is row-major order as in toolkit::index3d, "brick" tiles the
+// grid into bricks of edge^3 vertices in row-major order, with vertices
+// of a brick in row-major order, "morton" orders vertices of a brick
+// along the Z-order curve, bricks are padded at upper grid boundaries,
+// so that tiled orders take slightly more memory than vertices
+//
+// Fourier transforms and grid files keep row-major order, values are
+// reordered when copied from transforms and at import and export
+
+#ifndef HAMMURABI_LAYOUT_H
+#define HAMMURABI_LAYOUT_H
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include <hamtype.h>
+
+class Hamlayout {
+public:
+  // brick edge length in vertices of tiled orders
+  static constexpr ham_uint edge{8};
+  // empty grid
+  Hamlayout() = default;
+  // 1st argument: number of vertices in x, y and z direction
+  // 2nd argument: order "row", "brick" or "morton"
+  // 3rd argument: number of values per vertex, running fastest
+  Hamlayout(const ham_uint (&)[3], const std::string &order = "row",
+            const ham_uint &nw = 1);
+  Hamlayout(const Hamlayout &) = default;
+  Hamlayout(Hamlayout &&) = default;
+  Hamlayout &operator=(const Hamlayout &) = default;
+  Hamlayout &operator=(Hamlayout &&) = default;
+  ~Hamlayout() = default;
+  // position of first value of vertex, in place of toolkit::index3d
+  inline ham_uint index(const ham_uint &i, const ham_uint &j,
+                        const ham_uint &l) const {
+    assert(i < this->n[0] and j < this->n[1] and l < this->n[2]);
+    return this->t[0][i] + this->t[1][j] + this->t[2][l];
+  }
+  // position of value given by its row-major index, as in
+  // toolkit::index3d, or toolkit::index4d with energy running fastest
+  inline ham_uint at(const ham_uint &k) const {
+    if (this->linear) {
+      return k;
+    }
+    const ham_uint cell{k / this->nw};
+    return this->index(cell / this->n[2] / this->n[1],
+                       cell / this->n[2] % this->n[1], cell % this->n[2]) +
+           k % this->nw;
+  }
+  // offsets of vertices in a direction, sums give positions
+  // 1st argument: direction, 0, 1 or 2 for x, y and z
+  const ham_uint *offsets(const unsigned &d) const {
+    assert(d < 3);
+    return this->t[d].data();
+  }
+  // number of values in memory, with padding of bricks
+  ham_uint size() const { return this->length; }
+  // number of values per vertex
+  ham_uint width() const { return this->nw; }
+  // if positions are row-major indices
+  bool row() const { return this->linear; }
+
+protected:
+  // number of vertices in x, y and z direction, values per vertex
+  ham_uint n[3]{0, 0, 0}, nw{1};
+  ham_uint length{0};
+  bool linear{true};
+  // offsets per direction
+  std::vector<ham_uint> t[3];
+};
+
+#endif
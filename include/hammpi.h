@@ -0,0 +1,134 @@
+// MPI distribution utilities
+//
+// with HAMMURABI_MPI undefined, or MPI not initialized,
+// there is a single rank and all collective calls are no-ops,
+// so the same library serves both serial and MPI executables
+//
+// large arrays are communicated in pieces,
+// as MPI counts are limited to int
+
+#ifndef HAMMURABI_MPI_H
+#define HAMMURABI_MPI_H
+
+#ifdef HAMMURABI_MPI
+#include <mpi.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+
+#include <hamtype.h>
+
+namespace hammpi {
+
+#ifdef HAMMURABI_MPI
+// communicator used by all distributed work
+inline MPI_Comm &communicator() {
+  static MPI_Comm comm{MPI_COMM_WORLD};
+  return comm;
+}
+
+template <typename T> inline MPI_Datatype datatype();
+template <> inline MPI_Datatype datatype<double>() { return MPI_DOUBLE; }
+template <> inline MPI_Datatype datatype<float>() { return MPI_FLOAT; }
+template <> inline MPI_Datatype datatype<char>() { return MPI_SIGNED_CHAR; }
+
+// largest count in one MPI call
+constexpr ham_uint piece{
+    static_cast<ham_uint>(std::numeric_limits<int>::max())};
+#endif
+
+// if MPI is initialized and not yet finalized
+inline bool active() {
+#ifdef HAMMURABI_MPI
+  int init, fin;
+  MPI_Initialized(&init);
+  MPI_Finalized(&fin);
+  return init and not fin;
+#else
+  return false;
+#endif
+}
+
+// rank index in communicator
+inline ham_uint rank() {
+#ifdef HAMMURABI_MPI
+  if (active()) {
+    int r;
+    MPI_Comm_rank(communicator(), &r);
+    return static_cast<ham_uint>(r);
+  }
+#endif
+  return 0;
+}
+
+// number of ranks in communicator
+inline ham_uint size() {
+#ifdef HAMMURABI_MPI
+  if (active()) {
+    int s;
+    MPI_Comm_size(communicator(), &s);
+    return static_cast<ham_uint>(s);
+  }
+#endif
+  return 1;
+}
+
+// element-wise sum over ranks, result on all ranks
+// 1st argument: array
+// 2nd argument: array size
+template <typename T>
+inline void allreduce_sum(T *data, const ham_uint &n) {
+#ifdef HAMMURABI_MPI
+  if (size() > 1) {
+    for (ham_uint i = 0; i < n; i += piece) {
+      MPI_Allreduce(MPI_IN_PLACE, data + i,
+                    static_cast<int>(std::min(piece, n - i)), datatype<T>(),
+                    MPI_SUM, communicator());
+    }
+  }
+#else
+  (void)data;
+  (void)n;
+#endif
+}
+
+// element-wise maximum over ranks, result on all ranks
+// 1st argument: array
+// 2nd argument: array size
+template <typename T>
+inline void allreduce_max(T *data, const ham_uint &n) {
+#ifdef HAMMURABI_MPI
+  if (size() > 1) {
+    for (ham_uint i = 0; i < n; i += piece) {
+      MPI_Allreduce(MPI_IN_PLACE, data + i,
+                    static_cast<int>(std::min(piece, n - i)), datatype<T>(),
+                    MPI_MAX, communicator());
+    }
+  }
+#else
+  (void)data;
+  (void)n;
+#endif
+}
+
+// copy array from rank 0 to all ranks
+// 1st argument: array
+// 2nd argument: array size
+template <typename T> inline void broadcast(T *data, const ham_uint &n) {
+#ifdef HAMMURABI_MPI
+  if (size() > 1) {
+    for (ham_uint i = 0; i < n; i += piece) {
+      MPI_Bcast(data + i, static_cast<int>(std::min(piece, n - i)),
+                datatype<T>(), 0, communicator());
+    }
+  }
+#else
+  (void)data;
+  (void)n;
+#endif
+}
+
+} // namespace hammpi
+
+#endif
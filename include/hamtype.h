@@ -21,4 +21,21 @@ typedef std::int_fast32_t ham_int;   // singed int
 typedef std::int_fast8_t ham_sint;   // short int
 typedef double ham_float;            // floating piont
 
+// precision policy
+// field grids are stored in storage type,
+// while arithmetic and LoS accumulation are carried in compute type
+template <typename S, typename C> struct ham_precision {
+  typedef S storage;
+  typedef C compute;
+};
+
+// single precision storage is switched on by CMake option ENABLE_SINGLE_GRID
+// which halves memory and bandwidth of field grids
+#ifdef HAMMURABI_SINGLE_GRID
+typedef ham_precision<float, ham_float> ham_policy;
+#else
+typedef ham_precision<double, ham_float> ham_policy;
+#endif
+typedef ham_policy::storage ham_store; // grid storage
+
 #endif
@@ -0,0 +1,69 @@
+// writer of binary output files
+//
+// Hamwriter takes over finished file images and writes each into its file
+// with bulk writes in a background thread, in order of submission,
+// so that the pipeline continues while files are written
+//
+// wait is the completion barrier, it returns when all submitted files
+// are written and throws if any of them failed,
+// destruction waits as well, but can only report failures
+
+#ifndef HAMMURABI_WRITER_H
+#define HAMMURABI_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Hamwriter {
+public:
+  // 1st argument: limit of bytes waiting in queue, submission blocks
+  // beyond it, a single larger file is accepted by empty queue
+  Hamwriter(const std::size_t &limit = std::size_t(1) << 31);
+  Hamwriter(const Hamwriter &) = delete;
+  Hamwriter(Hamwriter &&) = delete;
+  Hamwriter &operator=(const Hamwriter &) = delete;
+  Hamwriter &operator=(Hamwriter &&) = delete;
+  virtual ~Hamwriter();
+  // queue file image for writing
+  // 1st argument: file name
+  // 2nd argument: file content, taken over
+  // 3rd argument: if file is flushed to storage before closing
+  void write(const std::string &, std::vector<char> &&, const bool &);
+  // block until all queued files are written,
+  // throw first failure since last call
+  void wait();
+  // write bytes into file in calling thread
+  // 1st argument: file name
+  // 2nd argument: address of first byte
+  // 3rd argument: number of bytes
+  // 4th argument: if file is flushed to storage before closing
+  static void dump(const std::string &, const void *, const std::size_t &,
+                   const bool &);
+
+protected:
+  struct job {
+    std::string name;
+    std::vector<char> data;
+    bool sync;
+  };
+  std::deque<job> queue;
+  // bytes in queue and its limit
+  std::size_t queued{0}, limit;
+  // if worker is writing a file, if worker is asked to stop
+  bool busy{false}, stop{false};
+  // first failure message since last wait
+  std::string failure;
+  std::mutex lock;
+  // signals queued jobs to worker and finished jobs to submitters
+  std::condition_variable todo, done;
+  std::thread worker;
+  // worker loop
+  void run();
+};
+
+#endif
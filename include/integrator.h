@@ -3,6 +3,9 @@
 #ifndef HAMMURABI_INT_H
 #define HAMMURABI_INT_H
 
+#include <cmath>
+#include <limits>
+#include <memory>
 #include <vector>
 
 #include <bfield.h>
@@ -11,24 +14,135 @@
 #include <hamp.h>
 #include <hamtype.h>
 #include <param.h>
+#include <raycache.h>
+#include <synckernel.h>
 #include <tefield.h>
 
 class Integrator {
 public:
   Integrator() = default;
+  // 1st argument: LoS field sample cache, nullptr for none
+  Integrator(Ray_cache *c) : cache{c} {}
   Integrator(const Integrator &) = delete;
   Integrator(Integrator &&) = delete;
   Integrator &operator=(const Integrator &) = delete;
   Integrator &operator=(Integrator &&) = delete;
   virtual ~Integrator() = default;
   // assmebling pixels/shells into sky map
+  // pixels of all shells are integrated concurrently, without Faraday
+  // rotation from inner shells, which is applied as shells are composed
   void write_grid(const Breg *, const Brnd *, const TEreg *, const TErnd *,
                   const CREfield *, const Grid_breg *, const Grid_brnd *,
                   const Grid_tereg *, const Grid_ternd *, const Grid_cre *,
                   Grid_obs *, const Param *) const;
+  // assmebling sky maps of base and shifted parameters in one pass
+  // fields are sampled along LoS with the first parameters,
+  // the others re-read regular fields and CRE at the same samples
+  // 11th argument: observable grids, one per parameter class object
+  // 12th argument: parameter class objects, base first
+  void write_grid(const Breg *, const Brnd *, const TEreg *, const TErnd *,
+                  const CREfield *, const Grid_breg *, const Grid_brnd *,
+                  const Grid_tereg *, const Grid_ternd *, const Grid_cre *,
+                  const std::vector<Grid_obs *> &,
+                  const std::vector<const Param *> &) const;
 #ifdef NDEBUG
 protected:
 #endif
+  // to hold temporary information of observables
+  // synchrotron Stokes parameters are held per channel
+  struct struct_observables {
+    std::vector<ham_float> is, qs, us;
+    ham_float fd;
+    ham_float dm;
+    ham_float ff;
+    // rounding error compensation of LoS sums above
+    std::vector<ham_float> is_c, qs_c, us_c;
+    ham_float fd_c, dm_c;
+  };
+  // to hold temporary information of spherical shells
+  struct struct_shell {
+    ham_uint shell_num;
+    ham_float d_start;
+    ham_float d_stop;
+    ham_float delta_d;
+    ham_uint step;
+    std::vector<ham_float> dist;
+    // adaptive integration relative tolerance and largest step
+    ham_float tol;
+    ham_float delta_max;
+    // if field samples of shell pixels are cached
+    bool cached;
+  };
+  // to hold maps of one shell until shells are composed
+  // Q/U are without Faraday rotation from inner shells,
+  // Faraday depth is of the shell alone
+  struct struct_shell_maps {
+    std::unique_ptr<Hampix<ham_float>> dm, fd;
+    // one map per synchrotron channel
+    std::vector<std::unique_ptr<Hampix<ham_float>>> is, qs, us;
+    // any allocated map, for shell resolution and pixel pointing
+    inline const Hampix<ham_float> &grid() const { return dm ? *dm : *fd; }
+    // list all allocated maps
+    // 1st argument: map list, output
+    inline void collect(std::vector<Hampix<ham_float> *> *list) const {
+      if (dm)
+        list->push_back(dm.get());
+      for (decltype(is.size()) c = 0; c != is.size(); ++c) {
+        list->push_back(is[c].get());
+        list->push_back(qs[c].get());
+        list->push_back(us[c].get());
+      }
+      if (fd)
+        list->push_back(fd.get());
+    }
+  };
+  // to hold per-run constants of synchrotron channels and CRE spectrum
+  struct struct_sync {
+    ham_uint channels;
+    std::vector<ham_float> freq;
+    // observational wavelength squared
+    std::vector<ham_float> lambda_square;
+    // intensity to brightness temperature conversion factor
+    std::vector<ham_float> i2bt;
+    // CRE spectral table, used with CRE grid
+    // kinetic energy and 1/beta at energy nodes
+    std::vector<ham_float> KE, inv_beta;
+    // energy bin width and bin-averaged KE^-2,
+    // the B_per and frequency independent part of x in F(x)/G(x)
+    std::vector<ham_float> dE, x_mid;
+    // tabulated F(x)/G(x), used with CRE grid
+    std::unique_ptr<Sync_kernel> kernel;
+  };
+  // to hold field samples along one LoS in a shell, filled by batch readers
+  // only steps within simulation limits are kept
+  struct struct_ray {
+    ham_uint size;
+    // galactic centric Cartesian positions
+    std::vector<ham_float> x, y, z;
+    // regular and random magnetic field components
+    std::vector<ham_float> breg_x, breg_y, breg_z, brnd_x, brnd_y, brnd_z;
+    // regular and random thermal electron density
+    std::vector<ham_float> tereg, ternd;
+    // total magnetic field and thermal electron density,
+    // as kept by LoS field sample cache
+    std::vector<ham_float> btot_x, btot_y, btot_z, tetot;
+    // CRE flux at energy nodes with CRE grid, energy index runs fastest
+    std::vector<ham_float> cre_flux;
+    // CRE spectral index and norm without CRE grid
+    std::vector<ham_float> cre_idx, cre_norm;
+    // scratch for batch evaluation of F(x)/G(x) over energy bins
+    std::vector<ham_float> kernel_x, kernel_val;
+    // integrands evaluated once per sample, thermal electron density,
+    // parallel magnetic field, intrinsic polarization angle and
+    // synchrotron emissivities with channel index running fastest
+    std::vector<ham_float> te, b_par, ipa, j_tot, j_pol;
+  };
+  // to memoize Gamma function products in analytic CRE synchrotron
+  // emissivity, valid for the spectral index they were computed with
+  struct struct_gamma_memo {
+    ham_float index{std::numeric_limits<ham_float>::quiet_NaN()};
+    ham_float gamma_t, gamma_p;
+  };
   // Carteisan unit vector of given LoS direction
   // 1st argument: polar angle (in rad)
   // 2nd argument: azimuthal angle (in rad)
@@ -56,54 +170,220 @@ protected:
   ham_float sync_ipa(const Hamvec<3, ham_float> &, const ham_float &,
                      const ham_float &) const;
   // synchrotron total emissivity calculator
-  // 1st argument: galactic centric Cartesian frame position
-  // 2nd argument: parameter class object
-  // 3rd argument: CRE object
-  // 4th argument: CRE grid object
-  // 5th argument: perpendicular component of magnetic field wrt LoS direction
-  ham_float sync_emissivity_t(const Hamvec<3, ham_float> &, const Param *,
-                              const CREfield *, const Grid_cre *,
-                              const ham_float &) const;
+  // 1st argument: field samples along LoS
+  // 2nd argument: step index in field samples
+  // 3rd argument: parameter class object
+  // 4th argument: synchrotron constants with CRE spectral table
+  // 5th argument: Gamma function memo for analytic CRE
+  // 6th argument: perpendicular component of magnetic field wrt LoS direction
+  // 7th argument: observational frequency
+  ham_float sync_emissivity_t(struct_ray *, const ham_uint &, const Param *,
+                              const struct_sync *, struct_gamma_memo *,
+                              const ham_float &, const ham_float &) const;
   // synchrotron polarized emissivity calculator
-  // 1st argument: galactic centric Cartesian frame position
-  // 2nd argument: parameter class object
-  // 3rd argument: CRE object
-  // 4th argument: CRE grid object
-  // 5th argument: perpendicular component of magnetic field wrt LoS direction
-  ham_float sync_emissivity_p(const Hamvec<3, ham_float> &, const Param *,
-                              const CREfield *, const Grid_cre *,
-                              const ham_float &) const;
+  // 1st argument: field samples along LoS
+  // 2nd argument: step index in field samples
+  // 3rd argument: parameter class object
+  // 4th argument: synchrotron constants with CRE spectral table
+  // 5th argument: Gamma function memo for analytic CRE
+  // 6th argument: perpendicular component of magnetic field wrt LoS direction
+  // 7th argument: observational frequency
+  ham_float sync_emissivity_p(struct_ray *, const ham_uint &, const Param *,
+                              const struct_sync *, struct_gamma_memo *,
+                              const ham_float &, const ham_float &) const;
   // converting brightness temp into thermal temp with T_0 = 2.725K,
   // Prog.Theor.Exp.Phys. (2014) 2014 (6): 06B109.
   // 1st argument: brightness temperature
   // 2nd argument: observational frequency
   ham_float temp_convert(const ham_float &, const ham_float &) const;
+  // LoS field sample cache
+  Ray_cache *cache{nullptr};
 #ifdef NDEBUG
 private:
 #endif
-  // to hold temporary information of observables
-  struct struct_observables {
-    ham_float is, qs, us;
-    ham_float fd;
-    ham_float dm;
-    ham_float ff;
-  };
-  // to hold temporary information of spherical shells
-  struct struct_shell {
-    ham_uint shell_num;
-    ham_float d_start;
-    ham_float d_stop;
-    ham_float delta_d;
-    ham_uint step;
-    std::vector<ham_float> dist;
-  };
   // conduct LOS integration in one pixel at given shell
-  void radial_integration(const struct_shell *, const Hamp &,
-                          struct_observables *, const Breg *, const Brnd *,
-                          const TEreg *, const TErnd *, const CREfield *,
-                          const Grid_breg *, const Grid_brnd *,
-                          const Grid_tereg *, const Grid_ternd *,
-                          const Grid_cre *, const Param *) const;
+  // fields are read in batch once per LoS and shared by all
+  // synchrotron channels, or replayed from cache
+  // 3rd argument: LoS pointing
+  // 4th argument: pixel index, for cache
+  void radial_integration(const struct_shell *, const struct_sync *,
+                          const Hamp &, const ham_uint &,
+                          struct_observables *, struct_ray *,
+                          const Breg *, const Brnd *, const TEreg *,
+                          const TErnd *, const CREfield *, const Grid_breg *,
+                          const Grid_brnd *, const Grid_tereg *,
+                          const Grid_ternd *, const Grid_cre *,
+                          const Param *) const;
+  // conduct LOS integration in one pixel with shifted parameters
+  // positions and random fields are taken from the integrated base ray,
+  // regular fields and CRE are read again
+  // 3rd argument: LoS pointing
+  // 4th argument: field samples of base parameters
+  // 5th argument: pixel observables, output
+  // 6th argument: field samples of shifted parameters
+  // the rest are regular field, CRE, grid and
+  // shifted parameter class objects
+  void shifted_integration(const struct_shell *, const struct_sync *,
+                           const Hamp &, const struct_ray *,
+                           struct_observables *, struct_ray *, const Breg *,
+                           const TEreg *, const CREfield *, const Grid_breg *,
+                           const Grid_tereg *, const Grid_cre *,
+                           const Param *) const;
+  // integrate one shell with hierarchical angular refinement
+  // all pixels are integrated at the coarsest level, children are
+  // integrated only where parent level fails to predict them,
+  // elsewhere parent level is interpolated up to shell resolution
+  // 1st argument: shell resolution
+  // 2nd argument: shell information
+  // 3rd argument: synchrotron channel information
+  // the rest are field, grid (mask from observable grid),
+  // shell maps (output) and parameter class objects
+  void refine_shell(const ham_uint &, const struct_shell *,
+                    const struct_sync *, const Breg *, const Brnd *,
+                    const TEreg *, const TErnd *, const CREfield *,
+                    const Grid_breg *, const Grid_brnd *, const Grid_tereg *,
+                    const Grid_ternd *, const Grid_cre *, const Grid_obs *,
+                    struct_shell_maps *, const Param *) const;
+  // allocate shell maps of observables in use
+  // 1st argument: shell maps, output
+  // 2nd argument: shell resolution
+  // 3rd argument: synchrotron channel information
+  // 4th argument: parameter class object
+  void assemble_shell_maps(struct_shell_maps *, const ham_uint &,
+                           const struct_sync *, const Param *) const;
+  // accumulate shell maps into sky maps from inner to outer shell,
+  // Q/U of each shell are first rotated by Faraday depth of inner shells
+  // shell maps are released as they are composed
+  // 1st argument: shell maps in shell order
+  // 2nd argument: synchrotron channel information
+  // 3rd argument: observable grid
+  // 4th argument: parameter class object
+  void compose_shells(std::vector<std::unique_ptr<struct_shell_maps>> *,
+                      const struct_sync *, Grid_obs *, const Param *) const;
+  // store pixel observables into shell maps
+  // synchrotron intensities are converted into temperature
+  // 1st argument: pixel index
+  // 2nd argument: pixel observables
+  // 3rd argument: synchrotron channel information
+  // 4th argument: shell maps
+  // 5th argument: parameter class object
+  void store_observables(const ham_uint &, const struct_observables *,
+                         const struct_sync *, struct_shell_maps *,
+                         const Param *) const;
+  // conduct adaptive LOS integration in one pixel at given shell
+  // steps grow in smooth regions and shrink at sharp structures,
+  // between shell resolution and its upper limit
+  void adaptive_integration(const struct_shell *, const struct_sync *,
+                            const Hamp &, const Hamvec<3, ham_float> &,
+                            const ham_float &, struct_gamma_memo *,
+                            struct_observables *, struct_ray *, const Breg *,
+                            const Brnd *, const TEreg *, const TErnd *,
+                            const CREfield *, const Grid_breg *,
+                            const Grid_brnd *, const Grid_tereg *,
+                            const Grid_ternd *, const Grid_cre *,
+                            const Param *) const;
+  // check embedded error estimate of adaptive integration
+  // return true if within tolerance
+  // 1st argument: observables before current cell
+  // 2nd argument: observables with low order sum of current cell
+  // 3rd argument: observables with high order sum of current cell
+  // 4th argument: relative tolerance
+  // 5th argument: parameter class object
+  bool check_adaptive_tolerance(const struct_observables *,
+                                const struct_observables *,
+                                const struct_observables *, const ham_float &,
+                                const Param *) const;
+  // evaluate integrands of field samples from given index to the end
+  // 1st argument: field samples along LoS
+  // 2nd argument: index of first sample to evaluate
+  // 3rd argument: synchrotron constants with CRE spectral table
+  // 4th argument: LoS pointing
+  // 5th argument: LoS versor
+  // 6th argument: Gamma function memo for analytic CRE
+  // 7th argument: parameter class object
+  void evaluate_ray(struct_ray *, const ham_uint &, const struct_sync *,
+                    const Hamp &, const Hamvec<3, ham_float> &,
+                    struct_gamma_memo *, const Param *) const;
+  // accumulate one evaluated sample into observables
+  // 1st argument: field samples along LoS
+  // 2nd argument: sample index in field samples
+  // 3rd argument: integration weight (path length) of the sample
+  // 4th argument: synchrotron constants
+  // 5th argument: Faraday depth from inner shells
+  // 6th argument: observables, accumulated in place
+  // 7th argument: parameter class object
+  void accumulate_sample(const struct_ray *, const ham_uint &,
+                         const ham_float &, const struct_sync *,
+                         const ham_float &, struct_observables *,
+                         const Param *) const;
+  // compensated (Neumaier) summation
+  // 1st argument: running sum
+  // 2nd argument: running compensation
+  // 3rd argument: increment
+  inline void compensated_add(ham_float *sum, ham_float *comp,
+                              const ham_float &inc) const {
+    const ham_float t{*sum + inc};
+    if (std::fabs(*sum) >= std::fabs(inc))
+      *comp += (*sum - t) + inc;
+    else
+      *comp += (inc - t) + *sum;
+    *sum = t;
+  }
+  // zero LoS sums and their compensation
+  // 1st argument: observables
+  void reset_observables(struct_observables *) const;
+  // add compensation to LoS sums, and zero it
+  // 1st argument: observables
+  void compensate_observables(struct_observables *) const;
+  // fill ``struct_ray`` with field samples along LoS in given shell
+  void assemble_ray(struct_ray *, const struct_shell *,
+                    const Hamvec<3, ham_float> &, const Breg *, const Brnd *,
+                    const TEreg *, const TErnd *, const CREfield *,
+                    const Grid_breg *, const Grid_brnd *, const Grid_tereg *,
+                    const Grid_ternd *, const Grid_cre *, const Param *) const;
+  // fill ``struct_ray`` with cached field samples along LoS in given shell
+  // CRE is read at recomputed positions
+  // 4th argument: pixel index
+  void replay_ray(struct_ray *, const struct_shell *,
+                  const Hamvec<3, ham_float> &, const ham_uint &,
+                  const CREfield *, const Grid_cre *, const Param *) const;
+  // append field samples at given LoS distances to ``struct_ray``
+  // return index of first appended sample
+  // 1st argument: field samples along LoS
+  // 2nd argument: array of LoS distances
+  // 3rd argument: array size
+  ham_uint sample_ray(struct_ray *, const ham_float *, const ham_uint &,
+                      const Hamvec<3, ham_float> &, const Breg *,
+                      const Brnd *, const TEreg *, const TErnd *,
+                      const CREfield *, const Grid_breg *, const Grid_brnd *,
+                      const Grid_tereg *, const Grid_ternd *, const Grid_cre *,
+                      const Param *) const;
+  // append positions at given LoS distances to ``struct_ray``
+  // return index of first appended sample
+  // 1st argument: field samples along LoS
+  // 2nd argument: array of LoS distances
+  // 3rd argument: array size
+  // 4th argument: LoS versor
+  // 5th argument: parameter class object
+  ham_uint sample_position(struct_ray *, const ham_float *, const ham_uint &,
+                           const Hamvec<3, ham_float> &, const Param *) const;
+  // read CRE at positions of ``struct_ray`` samples
+  // 1st argument: field samples along LoS
+  // 2nd argument: index of first sample
+  // 3rd argument: sample number
+  void sample_cre(struct_ray *, const ham_uint &, const ham_uint &,
+                  const CREfield *, const Grid_cre *, const Param *) const;
+  // sample numbers of shell pixels, as reserved in cache
+  // pixels of other MPI ranks get zero
+  // 1st argument: shell information
+  // 2nd argument: shell map in RING ordering
+  // 3rd argument: pixel traversal order, empty for RING order
+  // 4th argument: pixels per chunk of work
+  // 5th argument: parameter class object
+  // 6th argument: sample numbers, output
+  void cache_counts(const struct_shell *, const Hampix<ham_float> &,
+                    const std::vector<ham_uint> &, const ham_uint &,
+                    const Param *, std::vector<ham_uint> *) const;
   // general upper boundary check
   // return false if 1st argument is larger than 2nd
   inline bool check_simulation_upper_limit(const ham_float &value,
@@ -116,10 +396,55 @@ private:
                                            const ham_float &limit) const {
     return (value < limit);
   }
+  // check if position is within simulation limits
+  // with the same comparisons as boundary checks above
+  // 1st argument: galactic centric position
+  // 2nd argument: parameter class object
+  inline bool check_simulation_volume(const Hamvec<3, ham_float> &pos,
+                                      const Param *par) const {
+    const ham_float r{pos.length()};
+    return not(check_simulation_lower_limit(r, par->grid_obs.gc_r_min) or
+               check_simulation_upper_limit(r, par->grid_obs.gc_r_max) or
+               check_simulation_lower_limit(pos[2], par->grid_obs.gc_z_min) or
+               check_simulation_upper_limit(pos[2], par->grid_obs.gc_z_max));
+  }
+  // clip LoS in given shell against gc_r sphere and gc_z slab
+  // return number of valid distance intervals, at most two
+  // as the gc_r_min sphere may split LoS
+  // 1st argument: shell information
+  // 2nd argument: LoS versor
+  // 3rd argument: parameter class object
+  // 4th argument: array of interval lower ends, output
+  // 5th argument: array of interval upper ends, output
+  ham_uint clip_los(const struct_shell *, const Hamvec<3, ham_float> &,
+                    const Param *, ham_float *, ham_float *) const;
+  // clip LoS in given shell against gc_r sphere and gc_z slab
+  // return number of valid step ranges, at most two
+  // as the gc_r_min sphere may split LoS
+  // 1st argument: shell information
+  // 2nd argument: LoS versor
+  // 3rd argument: parameter class object
+  // 4th argument: array of first valid step index, output
+  // 5th argument: array of past-the-last valid step index, output
+  ham_uint clip_ray(const struct_shell *, const Hamvec<3, ham_float> &,
+                    const Param *, ham_uint *, ham_uint *) const;
+  // sum maps of equal resolution over MPI ranks
+  // 1st argument: maps, result on all ranks
+  void reduce_maps(const std::vector<Hampix<ham_float> *> &) const;
+  // pixel traversal order of a shell map
+  // NESTED-order index to RING-order index, one tile after another
+  // 1st argument: traversal order, output
+  // 2nd argument: shell map in RING ordering
+  void traversal_order(std::vector<ham_uint> *,
+                       const Hampix<ham_float> &) const;
   // assembling ``struct_shell``
   // this part may introduce precision loss
   void assemble_shell_ref(struct_shell *, const Param *,
                           const ham_uint &) const;
+  // assembling ``struct_sync``, including CRE spectral table
+  void assemble_sync_ref(struct_sync *, const Param *) const;
+  // refresh ``struct_gamma_memo`` if spectral index differs
+  void update_gamma_memo(struct_gamma_memo *, const ham_float &) const;
 };
 
 #endif
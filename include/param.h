@@ -3,6 +3,7 @@
 #ifndef HAMMURABI_PARAM_H
 #define HAMMURABI_PARAM_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -13,6 +14,8 @@
 class Param {
 public:
   Param(const std::string);
+  // 1st argument: parsed XML parameter document
+  Param(tinyxml2::XMLDocument *);
   Param() = default;
   Param(const Param &) = delete;
   Param(Param &&) = delete;
@@ -21,6 +24,29 @@ public:
   virtual ~Param() = default;
   // galactic centric Cartesian position of the observer
   Hamvec<3, ham_float> observer;
+  // profiling output
+  struct param_profile {
+    bool do_profile = false;
+    std::string filename;
+    // "json" or "chrome"
+    std::string format;
+  } profile;
+  // output files
+  struct param_output {
+    // write grid and map files in background
+    bool async = false;
+    // flush each written file to storage
+    bool fsync = false;
+  } output;
+  // parameter gradient maps
+  struct param_gradient {
+    bool do_gradient = false;
+    // map file name suffix and XML key chain below root of each parameter
+    std::vector<std::string> name;
+    std::vector<std::vector<std::string>> keychain;
+    // central difference half step of each parameter, in XML units
+    std::vector<ham_float> shift;
+  } gradient;
   // regular magnetic field grid
   struct param_breg_grid {
     // in/output file name
@@ -28,10 +54,24 @@ public:
     // grid build/read/write controller
     bool build_permission = false, read_permission = false,
          write_permission = false;
+    // import through "stream", "mmap" or "populate"
+    std::string import_mode = "stream";
+    // export codec, "none" for interleaved layout, "lossless" or "lossy"
+    // for bricks, tolerance is the absolute error bound of "lossy"
+    std::string codec = "none";
+    ham_float tolerance = 0;
+    // brick edge length of export, budget of decoded bricks in MiB
+    ham_uint brick = 32, cache = 1024;
     // galactic centric Cartesian limit
     ham_float x_max, x_min, y_max, y_min, z_max, z_min;
     // number Cartesian grid support points
     ham_uint nx, ny, nz, full_size;
+    // memory order "row", "brick" or "morton", see Hamlayout
+    std::string order = "row";
+    // interpolation "linear", "catmull-rom" or "bspline", see Haminterp
+    std::string interp = "linear";
+    // if components are interleaved per vertex in memory
+    bool interleave = false;
   } grid_breg;
   // random magnetic field grid
   struct param_brnd_grid {
@@ -40,10 +80,24 @@ public:
     // grid build/read/write controller
     bool read_permission = false, write_permission = false,
          build_permission = false;
+    // import through "stream", "mmap" or "populate"
+    std::string import_mode = "stream";
+    // export codec, "none" for interleaved layout, "lossless" or "lossy"
+    // for bricks, tolerance is the absolute error bound of "lossy"
+    std::string codec = "none";
+    ham_float tolerance = 0;
+    // brick edge length of export, budget of decoded bricks in MiB
+    ham_uint brick = 32, cache = 1024;
     // galactic centric Cartesian limit
     ham_float x_max, x_min, y_max, y_min, z_max, z_min;
     // number Cartesian grid support points
     ham_uint nx, ny, nz, full_size;
+    // memory order "row", "brick" or "morton", see Hamlayout
+    std::string order = "row";
+    // interpolation "linear", "catmull-rom" or "bspline", see Haminterp
+    std::string interp = "linear";
+    // if components are interleaved per vertex in memory
+    bool interleave = false;
   } grid_brnd;
   // regular thermal electron grid
   struct param_tereg_grid {
@@ -51,10 +105,22 @@ public:
     // grid build/read/write controller
     bool build_permission = false, read_permission = false,
          write_permission = false;
+    // import through "stream", "mmap" or "populate"
+    std::string import_mode = "stream";
+    // export codec, "none" for interleaved layout, "lossless" or "lossy"
+    // for bricks, tolerance is the absolute error bound of "lossy"
+    std::string codec = "none";
+    ham_float tolerance = 0;
+    // brick edge length of export, budget of decoded bricks in MiB
+    ham_uint brick = 32, cache = 1024;
     // galactic centric Cartesian limit
     ham_float x_max, x_min, y_max, y_min, z_max, z_min;
     // number Cartesian grid support points
     ham_uint nx, ny, nz, full_size;
+    // memory order "row", "brick" or "morton", see Hamlayout
+    std::string order = "row";
+    // interpolation "linear", "catmull-rom" or "bspline", see Haminterp
+    std::string interp = "linear";
   } grid_tereg;
   // random thermal electron grid
   struct param_ternd_grid {
@@ -63,10 +129,22 @@ public:
     // grid build/read/write controller
     bool read_permission = false, write_permission = false,
          build_permission = false;
+    // import through "stream", "mmap" or "populate"
+    std::string import_mode = "stream";
+    // export codec, "none" for interleaved layout, "lossless" or "lossy"
+    // for bricks, tolerance is the absolute error bound of "lossy"
+    std::string codec = "none";
+    ham_float tolerance = 0;
+    // brick edge length of export, budget of decoded bricks in MiB
+    ham_uint brick = 32, cache = 1024;
     // galactic centric Cartesian limit
     ham_float x_max, x_min, y_max, y_min, z_max, z_min;
     // number Cartesian grid support points
     ham_uint nx, ny, nz, full_size;
+    // memory order "row", "brick" or "morton", see Hamlayout
+    std::string order = "row";
+    // interpolation "linear", "catmull-rom" or "bspline", see Haminterp
+    std::string interp = "linear";
   } grid_ternd;
   // cosmic ray electron grid
   struct param_cre_grid {
@@ -75,6 +153,14 @@ public:
     // grid build/read/write controller
     bool build_permission = false, read_permission = false,
          write_permission = false;
+    // import through "stream", "mmap" or "populate"
+    std::string import_mode = "stream";
+    // export codec, "none" for interleaved layout, "lossless" or "lossy"
+    // for bricks, tolerance is the absolute error bound of "lossy"
+    std::string codec = "none";
+    ham_float tolerance = 0;
+    // brick edge length of export, budget of decoded bricks in MiB
+    ham_uint brick = 32, cache = 1024;
     // number Cartesian grid support points
     ham_uint nE, nz, nx, ny, cre_size;
     // galactic centric Cartesian limit
@@ -82,6 +168,8 @@ public:
     // cosmic ray electron logarithmic space energy limit
     // E_fact is used for assigning energy bin length
     ham_float E_min, E_max, E_fact;
+    // relative accuracy of tabulated synchrotron kernels F(x), G(x)
+    ham_float kernel_tol = 1e-8;
   } grid_cre;
   // observable grid
   struct param_obs_grid {
@@ -103,9 +191,30 @@ public:
     ham_float oc_r_min, oc_r_max;
     // LoS integration radial resolution
     ham_float oc_r_res;
+    // adaptive LoS integration, largest radial step
+    // and relative tolerance per shell
+    bool do_adaptive = false;
+    ham_float oc_r_res_max;
+    std::vector<ham_float> tol_shell;
+    // hierarchical angular refinement, from given nside up to shell nside
+    // with relative tolerance of parent level prediction
+    bool do_refine = false;
+    ham_uint nside_refine;
+    ham_float tol_refine;
+    // pixel traversal in NESTED-order tiles of given nside
+    bool do_nested = false;
+    ham_uint nside_tile;
+    // LoS field sample cache, in memory and optionally in file,
+    // samples are kept in single precision upon request
+    bool do_cache = false, cache_single = false;
+    std::string cache_name;
+    // fingerprint of parameters that field samples depend on
+    std::uint64_t cache_key = 0;
+    // false if random fields are not reproducible
+    bool cache_stable = true;
     // simulation controllers
-    bool do_dm = false, do_fd = false;
-    std::vector<bool> do_sync;
+    // do_sync is true if any synchrotron channel is active
+    bool do_dm = false, do_fd = false, do_sync = false;
     // in/output file name
     std::string sim_fd_name, sim_dm_name;
     std::vector<std::string> sim_sync_name;
@@ -114,6 +223,12 @@ public:
     // mask controllers
     bool do_mask = false;
     std::string mask_name;
+    // galactic centric Cartesian positions of all observers,
+    // the first one is ``observer`` that field models refer to
+    std::vector<Hamvec<3, ham_float>> observer_list;
+    // LoS origin and map file name suffix of current observer
+    Hamvec<3, ham_float> origin;
+    std::string origin_tag;
   } grid_obs;
   // magnetic field parameters
   std::string breg_type, brnd_type, brnd_method;
@@ -209,8 +324,19 @@ public:
     ham_float r0;
     ham_float E0, j0;
   } cre_unif;
+  // fingerprints of XML parameters that pipeline stages depend on,
+  // of field grid allocation and of fields, for batch runs
+  struct param_stage {
+    std::uint64_t grid_tereg = 0, grid_breg = 0, grid_ternd = 0,
+                  grid_brnd = 0, grid_cre = 0, grid_obs = 0;
+    std::uint64_t tereg = 0, breg = 0, ternd = 0, brnd = 0, cre = 0;
+  } stage_key;
 
 protected:
+  // collect profiling output parameters
+  void profile_param(tinyxml2::XMLDocument *);
+  // collect file output parameters
+  void output_param(tinyxml2::XMLDocument *);
   // collect observable related parameters
   void obs_param(tinyxml2::XMLDocument *);
   // collect magnetic field related parameters
@@ -221,6 +347,30 @@ protected:
   void ternd_param(tinyxml2::XMLDocument *);
   // collect cosmic ray electron related parameters
   void cre_param(tinyxml2::XMLDocument *);
+  // optional import mode of field grid, "stream" by default
+  // 1st argument: ptr to fieldio element
+  // 2nd argument: field grid key
+  std::string import_param(tinyxml2::XMLElement *, const std::string &);
+  // optional memory order of field grid, "row" by default
+  // 1st argument: grid box element
+  std::string order_param(tinyxml2::XMLElement *);
+  // optional interpolation of field grid, "linear" by default
+  // 1st argument: grid box element
+  std::string interp_param(tinyxml2::XMLElement *);
+  // export codec and brick cache of grid file
+  // 1st argument: fieldio element
+  // 2nd argument: grid name
+  // 3rd argument: grid parameters
+  template <typename G>
+  void codec_param(tinyxml2::XMLElement *, const std::string &, G &);
+  // collect gradient parameters
+  // after field and observable parameters are collected
+  void gradient_param(tinyxml2::XMLDocument *);
+  // fingerprint parameters of pipeline stages
+  void stage_param(tinyxml2::XMLDocument *);
+  // fingerprint parameters for LoS field sample cache
+  // after all other parameters are collected
+  void cache_param(tinyxml2::XMLDocument *);
 };
 
 #endif
@@ -1,14 +1,19 @@
 #ifndef HAMMURABI_PIPELINE_H
 #define HAMMURABI_PIPELINE_H
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <bfield.h>
 #include <crefield.h>
 #include <grid.h>
+#include <hamwriter.h>
 #include <integrator.h>
 #include <param.h>
+#include <raycache.h>
 #include <tefield.h>
+#include <tinyxml2.h>
 #include <toolkit.h>
 
 class Pipeline {
@@ -27,8 +32,30 @@ public:
   virtual void assemble_brnd();
   virtual void assemble_cre();
   virtual void assemble_obs();
+  // write profiling records upon request
+  virtual void export_profile() const;
+  // block until grid and map files are written,
+  // throw if writing any of them failed
+  virtual void wait_export();
+  // batch mode, parameters of next run from given XML document,
+  // only stages whose parameters changed are assembled again,
+  // then observables are integrated
+  // 1st argument: XML parameter document of next run
+  // 2nd argument: map file name suffix of next run
+  virtual void rerun(tinyxml2::XMLDocument *, const std::string &);
+  // batch mode, one run per line of JSON-lines file, each line
+  // overrides parameters of XML file given at construction
+  // with dotted key paths, see toolkit::override_xml
+  // 1st argument: JSON-lines file name
+  virtual void assemble_batch(const std::string &);
 
 protected:
+  // XML parameter file given at construction
+  std::string xml_name;
+  // stage fingerprints of assembled stages, zero if not assembled
+  Param::param_stage built;
+  // map file name suffix of current run
+  std::string run_tag;
   std::unique_ptr<Param> par;
   std::unique_ptr<Grid_tereg> grid_tereg;
   std::unique_ptr<Grid_breg> grid_breg;
@@ -42,6 +69,32 @@ protected:
   std::unique_ptr<Brnd> brnd;
   std::unique_ptr<CREfield> cre;
   std::unique_ptr<Integrator> intobj;
+  // LoS field samples, kept across runs of the same pipeline
+  std::unique_ptr<Ray_cache> ray_cache;
+  // background writer of output files, created upon first use
+  std::unique_ptr<Hamwriter> writer;
+  // parameters with each gradient parameter shifted up and down,
+  // two per gradient parameter, with suffixed observable file names
+  std::vector<std::unique_ptr<Param>> par_shift;
+  // derivative maps, one observable grid per gradient parameter
+  std::vector<std::unique_ptr<Grid_obs>> grid_grad;
+  // parse shifted parameters of gradient from XML document
+  // 1st argument: XML parameter document
+  void assemble_shift(tinyxml2::XMLDocument *);
+  // deliver maps of one integration, written to files by default
+  // 1st argument: observable grid
+  // 2nd argument: parameters of observable grid
+  virtual void export_obs(Grid_obs *, const Param *);
+  // write files of grid, in background if requested
+  // 1st argument: field or observable grid
+  // 2nd argument: parameters of grid
+  void export_file(Grid *, const Param *);
+  // set LoS origin and map file name suffix of given observer
+  // 1st argument: observer index
+  void select_observer(const ham_uint &);
+  // LoS integration of base and shifted parameters in one pass,
+  // with central difference of shifted maps into derivative maps
+  void assemble_gradient();
 };
 
 #endif
@@ -0,0 +1,173 @@
+// Profiler class
+//
+// Profiler accumulates elapsed time and call numbers of named regions,
+// and values of named counters, separately in each thread
+// threads write only to their own records, without locks,
+// records are aggregated when reported
+//
+// regions registered as stages also keep every call as trace event,
+// which is meant for coarse pipeline stages, not for hot paths
+//
+// records are exported in JSON, or in Chrome trace event format
+// which can be viewed in chrome://tracing or Perfetto
+//
+// instrumentation is done with HAM_PROFILE* and HAM_COUNT macros,
+// which compile to nothing under NTIMING
+
+#ifndef HAMMURABI_PROFILER_H
+#define HAMMURABI_PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <hamtype.h>
+
+class Profiler {
+public:
+  typedef std::chrono::steady_clock clock;
+  typedef clock::time_point tick;
+  // maximal number of regions and counters
+  static constexpr ham_uint capacity = 128;
+  // one call of stage region
+  struct struct_event {
+    ham_uint id;
+    // microseconds since profiler construction
+    ham_float begin, duration;
+  };
+  // records of one thread
+  struct alignas(64) struct_thread {
+    std::array<ham_float, capacity> time;
+    std::array<ham_uint, capacity> calls;
+    std::array<ham_uint, capacity> count;
+    std::vector<struct_event> events;
+  };
+  Profiler(const Profiler &) = delete;
+  Profiler(Profiler &&) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+  Profiler &operator=(Profiler &&) = delete;
+  virtual ~Profiler() = default;
+  // the process-wide profiler
+  static Profiler &instance();
+  // register timing region, return its index
+  // registering existing name returns the same index
+  // 1st argument: region name
+  // 2nd argument: if calls are kept as trace events
+  ham_uint region(const std::string &, const bool &stage = false);
+  // register counter, return its index
+  // 1st argument: counter name
+  ham_uint counter(const std::string &);
+  // records of calling thread, created at its first call
+  struct_thread *local();
+  // record one call of region
+  // 1st argument: region index
+  // 2nd argument: begin of call
+  // 3rd argument: end of call
+  void add_time(const ham_uint &, const tick &, const tick &);
+  // add to counter
+  // 1st argument: counter index
+  // 2nd argument: increment
+  inline void add_count(const ham_uint &id, const ham_uint &n) {
+    local()->count[id] += n;
+  }
+  // zero all records, registered names are kept
+  // not to be called while threads are recording
+  void reset();
+  // totals over threads, zero for unknown names
+  // 1st argument: region or counter name
+  ham_float total_time(const std::string &) const;
+  ham_uint total_calls(const std::string &) const;
+  ham_uint total_count(const std::string &) const;
+  // number of threads with records
+  ham_uint threads() const;
+  // write aggregated and per-thread records
+  // 1st argument: file name
+  void export_json(const std::string &) const;
+  // write stage events and aggregated records in Chrome trace format
+  // 1st argument: file name
+  void export_trace(const std::string &) const;
+#ifdef NDEBUG
+protected:
+#endif
+  Profiler();
+  // construction time, origin of trace events
+  tick epoch;
+  // guards registration of names and threads
+  mutable std::mutex lock;
+  std::vector<std::string> region_name, counter_name;
+  // fixed size, as it is read by recording threads without lock
+  std::array<bool, capacity> region_stage{};
+  std::vector<std::unique_ptr<struct_thread>> records;
+  // index of name in list, capacity if absent
+  ham_uint find(const std::vector<std::string> &, const std::string &) const;
+  // JSON body of aggregated and per-thread records
+  std::string summary() const;
+};
+
+// records elapsed time of region from construction to stop or destruction
+class Profile_scope {
+public:
+  // 1st argument: region index
+  Profile_scope(const ham_uint &id)
+      : id{id}, begin{Profiler::clock::now()} {}
+  Profile_scope(const Profile_scope &) = delete;
+  Profile_scope(Profile_scope &&) = delete;
+  Profile_scope &operator=(const Profile_scope &) = delete;
+  Profile_scope &operator=(Profile_scope &&) = delete;
+  virtual ~Profile_scope() { stop(); }
+  // record call, later stops are ignored
+  inline void stop() {
+    if (active) {
+      Profiler::instance().add_time(id, begin, Profiler::clock::now());
+      active = false;
+    }
+  }
+
+protected:
+  ham_uint id;
+  Profiler::tick begin;
+  bool active = true;
+};
+
+#define HAM_PROFILE_CAT_(a, b) a##b
+#define HAM_PROFILE_CAT(a, b) HAM_PROFILE_CAT_(a, b)
+
+#ifndef NTIMING
+// time the rest of enclosing scope as region
+#define HAM_PROFILE(name)                                                      \
+  static const ham_uint HAM_PROFILE_CAT(ham_profile_id_, __LINE__){           \
+      Profiler::instance().region(name)};                                      \
+  Profile_scope HAM_PROFILE_CAT(ham_profile_scope_, __LINE__) {                \
+    HAM_PROFILE_CAT(ham_profile_id_, __LINE__)                                 \
+  }
+// time the rest of enclosing scope as stage, kept in trace
+#define HAM_PROFILE_STAGE(name)                                                \
+  static const ham_uint HAM_PROFILE_CAT(ham_profile_id_, __LINE__){           \
+      Profiler::instance().region(name, true)};                                \
+  Profile_scope HAM_PROFILE_CAT(ham_profile_scope_, __LINE__) {                \
+    HAM_PROFILE_CAT(ham_profile_id_, __LINE__)                                 \
+  }
+// time region between HAM_PROFILE_BEGIN and HAM_PROFILE_END with same tag
+#define HAM_PROFILE_BEGIN(tag, name)                                           \
+  static const ham_uint ham_profile_id_##tag{                                  \
+      Profiler::instance().region(name)};                                      \
+  Profile_scope ham_profile_scope_##tag { ham_profile_id_##tag }
+#define HAM_PROFILE_END(tag) ham_profile_scope_##tag.stop()
+// add to named counter
+#define HAM_COUNT(name, n)                                                     \
+  do {                                                                         \
+    static const ham_uint ham_count_id{Profiler::instance().counter(name)};    \
+    Profiler::instance().add_count(ham_count_id, n);                           \
+  } while (0)
+#else
+#define HAM_PROFILE(name)
+#define HAM_PROFILE_STAGE(name)
+#define HAM_PROFILE_BEGIN(tag, name)
+#define HAM_PROFILE_END(tag)
+#define HAM_COUNT(name, n)
+#endif
+
+#endif
@@ -0,0 +1,113 @@
+// LoS field sample cache
+//
+// Ray_cache keeps total magnetic field and thermal electron density
+// sampled along each LoS, per shell and pixel, so that a later run
+// with unchanged fields replays them through emissivity and
+// accumulation without reading the fields again
+//
+// positions along LoS are not kept, they follow from pixel pointing
+// and shell radial steps and are recomputed at replay
+//
+// cache content is tagged with a key of the parameters and imported
+// grid files it depends on, see Param::cache_param, a cache with
+// different key is discarded at opening
+//
+// pixel slices are laid out once per shell, so pixels are filled
+// concurrently without locks
+
+#ifndef HAMMURABI_RAYCACHE_H
+#define HAMMURABI_RAYCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <hamtype.h>
+
+class Ray_cache {
+public:
+  Ray_cache() = default;
+  Ray_cache(const Ray_cache &) = delete;
+  Ray_cache(Ray_cache &&) = delete;
+  Ray_cache &operator=(const Ray_cache &) = delete;
+  Ray_cache &operator=(Ray_cache &&) = delete;
+  virtual ~Ray_cache() = default;
+  // prepare cache for a run, discard content of other key
+  // or precision, then try file if cache is empty
+  // 1st argument: key of parameters that affect field samples
+  // 2nd argument: if samples are kept in single precision
+  // 3rd argument: file name, empty for memory only
+  void open(const std::uint64_t &, const bool &, const std::string &);
+  // drop all content
+  void clear();
+  // if shell is laid out for given pixel number
+  // 1st argument: shell index
+  // 2nd argument: pixel number
+  bool ready(const ham_uint &, const ham_uint &) const;
+  // lay out shell slices, previous content of shell is dropped
+  // 1st argument: shell index
+  // 2nd argument: sample number per pixel, zero for uncached pixels
+  void layout(const ham_uint &, const std::vector<ham_uint> &);
+  // sample number reserved for pixel
+  // 1st argument: shell index
+  // 2nd argument: pixel index
+  inline ham_uint samples(const ham_uint &shell, const ham_uint &ipix) const {
+    return this->shells[shell].offset[ipix + 1] -
+           this->shells[shell].offset[ipix];
+  }
+  // if pixel samples are cached
+  // 1st argument: shell index
+  // 2nd argument: pixel index
+  inline bool filled(const ham_uint &shell, const ham_uint &ipix) const {
+    return this->shells[shell].filled[ipix];
+  }
+  // store pixel samples, ignored unless sample number is as reserved
+  // 1st argument: shell index
+  // 2nd argument: pixel index
+  // 3rd argument: sample number
+  // 4th-6th arguments: arrays of magnetic field components
+  // 7th argument: array of thermal electron density
+  void store(const ham_uint &, const ham_uint &, const ham_uint &,
+             const ham_float *, const ham_float *, const ham_float *,
+             const ham_float *);
+  // load cached pixel samples
+  // 1st argument: shell index
+  // 2nd argument: pixel index
+  // 3rd-5th arguments: arrays of magnetic field components, output
+  // 6th argument: array of thermal electron density, output
+  void load(const ham_uint &, const ham_uint &, ham_float *, ham_float *,
+            ham_float *, ham_float *) const;
+  // number of cached pixels, over all shells
+  ham_uint pixels() const;
+  // write content to file
+  // 1st argument: file name
+  void save(const std::string &) const;
+  // read content from file, return false if file is absent
+  // or holds another key or precision
+  // 1st argument: file name
+  bool read(const std::string &);
+  // if pixels were stored since last open
+  inline bool modified() const { return this->dirty; }
+#ifdef NDEBUG
+protected:
+#endif
+  // cached values per sample, Bx, By, Bz and te
+  static constexpr ham_uint width = 4;
+  // samples of one shell, pixel slices are contiguous
+  struct struct_slices {
+    // first sample of each pixel, with total as last entry
+    std::vector<ham_uint> offset;
+    std::vector<char> filled;
+    // one of them is used, by precision
+    std::vector<double> data64;
+    std::vector<float> data32;
+  };
+  std::uint64_t key = 0;
+  bool single = false;
+  // set by concurrent stores
+  std::atomic<bool> dirty{false};
+  std::vector<struct_slices> shells;
+};
+
+#endif
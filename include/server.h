@@ -0,0 +1,67 @@
+// resident pipeline serving requests over a local UNIX-domain socket
+//
+// Server keeps grids, FFT plans, observable maps with mask and the LoS
+// sample cache of its pipeline in memory between requests, so that
+// repeated evaluation, e.g. in parameter fitting, pays neither process
+// startup nor grid allocation
+//
+// each request is one line of JSON object, with dotted key paths
+// overriding the XML parameter file given at construction, see
+// toolkit::override_xml, overrides do not accumulate across requests,
+// only stages whose parameters differ from the previous request are
+// assembled again, see Pipeline::rerun
+//
+// reply of a request is either
+//   "ok <map number>\n" followed by every map as
+//   "<map file name> <pixel number>\n" and raw ham_float pixel values,
+//   maps in conventional units, in order of file export
+// or
+//   "error <message>\n", which leaves server ready for next request
+//
+// request line "shutdown" is answered with "bye\n" and stops server,
+// a closed connection makes server wait for the next client
+
+#ifndef HAMMURABI_SERVER_H
+#define HAMMURABI_SERVER_H
+
+#include <memory>
+#include <string>
+
+#include <grid.h>
+#include <hamtype.h>
+#include <param.h>
+#include <pipeline.h>
+#include <tinyxml2.h>
+
+class Server : public Pipeline {
+public:
+  Server() = default;
+  Server(const std::string &);
+  Server(const Server &) = delete;
+  Server(Server &&) = delete;
+  Server &operator=(const Server &) = delete;
+  Server &operator=(Server &&) = delete;
+  virtual ~Server() = default;
+  // accept clients on UNIX-domain socket until shutdown request,
+  // socket file is created and removed by server, a file other than
+  // a socket at path is never removed and stops server
+  // 1st argument: socket file path
+  virtual void serve(const std::string &);
+  // reply to one request line
+  // 1st argument: request line
+  // 2nd argument: reply, overwritten
+  // return false for shutdown request
+  virtual bool respond(const std::string &, std::string &);
+
+protected:
+  // XML parameter document given at construction
+  std::unique_ptr<tinyxml2::XMLDocument> base;
+  // maps of current request, serialized into reply
+  std::string payload;
+  // map number in payload
+  ham_uint payload_count{0};
+  // append maps to payload instead of writing files
+  void export_obs(Grid_obs *, const Param *) override;
+};
+
+#endif
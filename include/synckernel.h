@@ -0,0 +1,90 @@
+// tabulated synchrotron kernel functions
+//
+// F(x) = x \int_x^\infty K_{5/3}(t) dt
+// G(x) = x K_{2/3}(x)
+// check Rybicki & Lightman Sec.6.2 'spectrum of synchrotron radiation'
+//
+// kernels are interpolated from tables uniformly spaced in ln(x),
+// with leading series below the table and asymptotic series above it;
+// table density is raised until the requested relative accuracy is met
+
+#ifndef HAMMURABI_SYNCKERNEL_H
+#define HAMMURABI_SYNCKERNEL_H
+
+#include <vector>
+
+#include <hamtype.h>
+
+class Sync_kernel {
+public:
+  // 1st argument: relative accuracy target of F(x) and G(x)
+  Sync_kernel(const ham_float &tol = 1e-8);
+  Sync_kernel(const Sync_kernel &) = delete;
+  Sync_kernel(Sync_kernel &&) = delete;
+  Sync_kernel &operator=(const Sync_kernel &) = delete;
+  Sync_kernel &operator=(Sync_kernel &&) = delete;
+  virtual ~Sync_kernel() = default;
+  // synchrotron kernel F(x), zero for non-positive x
+  // 1st argument: x
+  ham_float F(const ham_float &) const;
+  // synchrotron kernel G(x), zero for non-positive x
+  // 1st argument: x
+  ham_float G(const ham_float &) const;
+  // batch evaluation of F(x)
+  // 1st argument: array of x
+  // 2nd argument: array size
+  // 3rd argument: array of F(x), output
+  void F_batch(const ham_float *, const ham_uint &, ham_float *) const;
+  // batch evaluation of G(x)
+  // 1st argument: array of x
+  // 2nd argument: array size
+  // 3rd argument: array of G(x), output
+  void G_batch(const ham_float *, const ham_uint &, ham_float *) const;
+  // table nodes per decade of x, after meeting accuracy target
+  inline ham_uint nodes_per_decade() const { return this->npd; }
+  // maximal relative error of tabulated kernels at table mid-nodes
+  inline ham_float error() const { return this->err; }
+#ifdef NDEBUG
+protected:
+#endif
+  // table range, series expansions are used outside
+  ham_float x_lo{1e-5}, x_hi{40.};
+  // ln(x_lo), ln(x) spacing and its inverse
+  ham_float u_lo, du, inv_du;
+  ham_uint npd;
+  ham_float err;
+  // tabulated e^x F(x) and e^x G(x), one extra node at each end
+  std::vector<ham_float> tab_F, tab_G;
+  // coefficients of 1/x power series in asymptotic expansion
+  std::vector<ham_float> asym_F, asym_G;
+  // fill tables with given nodes per decade
+  void build(const ham_uint &);
+  // maximal relative error of current tables at table mid-nodes
+  ham_float max_error() const;
+  // e^x F(x) and e^x G(x) by quadrature, used for building tables
+  // F(x) = x \int_0^\infty e^{-x cosh(t)} cosh(5t/3)/cosh(t) dt
+  // G(x) = x \int_0^\infty e^{-x cosh(t)} cosh(2t/3) dt
+  // 1st argument: x
+  ham_float quad_F(const ham_float &) const;
+  ham_float quad_G(const ham_float &) const;
+  // 4-point Lagrange interpolation of table at ln(x)
+  // 1st argument: table
+  // 2nd argument: ln(x)
+  ham_float interp(const std::vector<ham_float> &, const ham_float &) const;
+  // batch evaluation of kernel, table lookup of all elements first,
+  // then scalar kernel for elements outside table range
+  // 1st argument: table
+  // 2nd argument: scalar kernel
+  // 3rd argument: array of x
+  // 4th argument: array size
+  // 5th argument: array of kernel values, output
+  void batch(const std::vector<ham_float> &,
+             ham_float (Sync_kernel::*)(const ham_float &) const,
+             const ham_float *, const ham_uint &, ham_float *) const;
+  // asymptotic expansion sqrt(pi x/2) e^{-x} \sum_n c_n x^{-n}
+  // 1st argument: coefficients c_n
+  // 2nd argument: x
+  ham_float asym(const std::vector<ham_float> &, const ham_float &) const;
+};
+
+#endif
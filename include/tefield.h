@@ -62,6 +62,28 @@ public:
   // 1st argument: parameter class object
   // 2nd argument: electron field grid class object
   virtual void write_grid(const Param *, Grid_tereg *) const;
+  // get thermal electron density at a batch of positions
+  // read/build permission is checked once per batch
+  // 1st-3rd arguments: galactic centric Cartesian frame x, y, z arrays
+  // 4th argument: number of positions
+  // 5th argument: parameter class object
+  // 6th argument: electron grid class object
+  // 7th argument: output density array
+  virtual void read_field_batch(const ham_float *, const ham_float *,
+                                const ham_float *, const ham_uint &,
+                                const Param *, const Grid_tereg *,
+                                ham_float *) const;
+  // assemble thermal electron density at a batch of positions
+  // arguments as ``read_field_batch``, without grid object
+  virtual void write_field_batch(const ham_float *, const ham_float *,
+                                 const ham_float *, const ham_uint &,
+                                 const Param *, ham_float *) const;
+  // read from grid with linear interpolation at a batch of positions
+  // arguments as ``read_field_batch``
+  virtual void read_grid_batch(const ham_float *, const ham_float *,
+                               const ham_float *, const ham_uint &,
+                               const Param *, const Grid_tereg *,
+                               ham_float *) const;
 };
 
 // base class with read_grid implemented
@@ -79,6 +101,17 @@ public:
                               const Grid_ternd *) const;
   virtual void write_grid(const Param *, const TEreg *, const Grid_tereg *,
                           Grid_ternd *) const;
+  // get random thermal electron density at a batch of positions
+  // arguments as ``TEreg::read_field_batch``
+  virtual void read_field_batch(const ham_float *, const ham_float *,
+                                const ham_float *, const ham_uint &,
+                                const Param *, const Grid_ternd *,
+                                ham_float *) const;
+  // read from grid with linear interpolation at a batch of positions
+  virtual void read_grid_batch(const ham_float *, const ham_float *,
+                               const ham_float *, const ham_uint &,
+                               const Param *, const Grid_ternd *,
+                               ham_float *) const;
 };
 
 //--------------------------- TEreg DERIVED ----------------------------------//
@@ -22,7 +22,6 @@ class Timer {
 public:
 #endif
   timecache record;
-  bool usato = false; // marker for multiple time recording
 public:
   Timer() = default;
   virtual ~Timer() = default;
@@ -41,12 +40,9 @@ public:
   inline void stop(std::string flag) {
     duration diff =
         (std::chrono::high_resolution_clock::now() - record[flag].first);
-    if (usato) { // multiple stop
-      record[flag].second += diff.count();
-    } else { // 1st stop
-      record[flag].second = diff.count();
-      usato = true;
-    }
+    // elapsed time accumulates over repeated start/stop of each record,
+    // new records start from zero
+    record[flag].second += diff.count();
   }
   // print to stdout the elapsed time in ms resolution
   // 1st argument: (optional) name of timing record
@@ -4,13 +4,17 @@
 #define HAMMURABI_TOOLKIT_H
 
 #include <cassert>
+#include <cctype>
 #include <cmath>
+#include <cstdint>
 #include <ctime>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <hamtype.h>
@@ -118,6 +122,16 @@ inline ham_float covariance(const std::vector<ham_float> &vect1,
   covar /= vect1.size();
   return covar;
 }
+// 64-bit FNV-1a hash of string
+// 1st argument: string
+inline std::uint64_t hash(const std::string &s) {
+  std::uint64_t h{14695981039346656037ull};
+  for (const unsigned char c : s) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
 // use given seed number or generate random seed according to thread and clock
 inline ham_uint random_seed(const ham_int &s) {
   assert(s >= 0);
@@ -269,6 +283,109 @@ inline ham_float fetchfloat(tinyxml2::XMLElement *el,
 #endif
   return el->DoubleAttribute(att_type.c_str());
 }
+// parse one JSON-lines record, a flat object of scalar values
+// return (key, value) pairs in order of appearance,
+// strings are unquoted and booleans are turned into "1" or "0"
+// 1st argument: one line of text
+inline std::vector<std::pair<std::string, std::string>>
+parse_record(const std::string &line) {
+  std::vector<std::pair<std::string, std::string>> result;
+  std::size_t i{0};
+  auto skip = [&]() {
+    while (i < line.size() and
+           std::isspace(static_cast<unsigned char>(line[i]))) {
+      ++i;
+    }
+  };
+  auto expect = [&](const char c) {
+    skip();
+    if (i >= line.size() or line[i] != c) {
+      throw std::runtime_error("invalid JSON record: " + line);
+    }
+    ++i;
+  };
+  // quoted string with basic escapes
+  auto text = [&]() {
+    expect('"');
+    std::string out;
+    while (i < line.size() and line[i] != '"') {
+      if (line[i] == '\\' and i + 1 < line.size()) {
+        ++i;
+      }
+      out.push_back(line[i++]);
+    }
+    expect('"');
+    return out;
+  };
+  expect('{');
+  skip();
+  if (i < line.size() and line[i] == '}') {
+    return result;
+  }
+  while (true) {
+    std::string key{text()};
+    expect(':');
+    skip();
+    std::string value;
+    if (i < line.size() and line[i] == '"') {
+      value = text();
+    } else {
+      while (i < line.size() and line[i] != ',' and line[i] != '}' and
+             not std::isspace(static_cast<unsigned char>(line[i]))) {
+        value.push_back(line[i++]);
+      }
+      if (value == "true") {
+        value = "1";
+      } else if (value == "false") {
+        value = "0";
+      } else if (value.empty() or value == "null" or
+                 value.find_first_of("{[") != std::string::npos) {
+        throw std::runtime_error("invalid JSON value of " + key);
+      }
+    }
+    result.emplace_back(key, value);
+    skip();
+    if (i < line.size() and line[i] == ',') {
+      ++i;
+      continue;
+    }
+    expect('}');
+    break;
+  }
+  return result;
+}
+// set XML attribute addressed by dotted key path below <root>,
+// as "magneticfield.regular.unif.bp" for its "value" attribute,
+// or "magneticfield.random@seed" for other attributes,
+// "sync[1]" addresses the 2nd of sibling elements of the same name
+// 1st argument: pointer to tinyxml2::XMLDocument
+// 2nd argument: key path
+// 3rd argument: attribute value
+inline void override_xml(tinyxml2::XMLDocument *doc, const std::string &key,
+                         const std::string &value) {
+  const std::size_t at{key.find('@')};
+  const std::string path{key.substr(0, at)};
+  const std::string attribute{at == std::string::npos ? "value"
+                                                      : key.substr(at + 1)};
+  tinyxml2::XMLElement *el{doc->FirstChildElement("root")};
+  std::stringstream ss(path);
+  for (std::string name; el != nullptr and std::getline(ss, name, '.');) {
+    ham_uint index{0};
+    const std::size_t bracket{name.find('[')};
+    if (bracket != std::string::npos) {
+      index = std::stoul(name.substr(bracket + 1));
+      name.erase(bracket);
+    }
+    el = el->FirstChildElement(name.c_str());
+    for (ham_uint n = 0; el != nullptr and n != index; ++n) {
+      el = el->NextSiblingElement(name.c_str());
+    }
+  }
+  if (el == nullptr or attribute.empty()) {
+    throw std::runtime_error("unknown parameter key: " + key);
+  }
+  el->SetAttribute(attribute.c_str(), value.c_str());
+}
 } // namespace toolkit
 
 #endif
@@ -12,6 +12,7 @@
 #include <hamunits.h>
 #include <hamvec.h>
 #include <param.h>
+#include <profiler.h>
 #include <toolkit.h>
 
 // global anisotropic turbulent field
@@ -77,6 +78,7 @@ void Brnd_es::write_grid(const Param *par, const Breg *breg,
                          const Grid_breg *gbreg, Grid_brnd *grid) const {
   // STEP I
   // GENERATE GAUSSIAN RANDOM FROM SPECTRUM
+  HAM_PROFILE_BEGIN(gaussian, "brnd_es/gaussian");
   // initialize random seed
 #ifdef _OPENMP
   gsl_rng **threadvec = new gsl_rng *[omp_get_max_threads()];
@@ -114,9 +116,14 @@ void Brnd_es::write_grid(const Param *par, const Breg *breg,
         ky -= cgs::kpc * par->grid_brnd.ny / ly;
       const ham_uint idx_lv2{idx_lv1 + j * par->grid_brnd.nz};
       for (decltype(par->grid_brnd.nz) l = 0; l < par->grid_brnd.nz; ++l) {
-        // 0th term is fixed to zero in allocation
-        if (i == 0 and j == 0 and l == 0)
+        // 0th term is zero, also after previous realization on same grid
+        if (i == 0 and j == 0 and l == 0) {
+          grid->c0[0][0] = 0;
+          grid->c0[0][1] = 0;
+          grid->c1[0][0] = 0;
+          grid->c1[0][1] = 0;
           continue;
+        }
         ham_float kz{cgs::kpc * l / lz};
         if (l >= (par->grid_brnd.nz + 1) / 2)
           kz -= cgs::kpc * par->grid_brnd.nz / lz;
@@ -149,8 +156,10 @@ void Brnd_es::write_grid(const Param *par, const Breg *breg,
   // free random memory
   gsl_rng_free(r);
 #endif
+  HAM_PROFILE_END(gaussian);
   // STEP II
   // RESCALING FIELD PROFILE IN REAL SPACE
+  HAM_PROFILE_BEGIN(rescale, "brnd_es/rescale");
   // 1./std::sqrt(3*bi_var)
   // after 1st Fourier transformation, c0_R = bx, c0_I = by, c1_I = bz
   const ham_float b_var_invsq{
@@ -204,9 +213,11 @@ void Brnd_es::write_grid(const Param *par, const Breg *breg,
   // execute DFT forward plan
   fftw_execute_dft(grid->plan_c0_fw, grid->c0, grid->c0);
   fftw_execute_dft(grid->plan_c1_fw, grid->c1, grid->c1);
+  HAM_PROFILE_END(rescale);
   // STEP III
   // RE-ORTHOGONALIZING IN FOURIER SPACE
   // Gram-Schmidt process
+  HAM_PROFILE("brnd_es/orthogonalize");
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static)
 #endif
@@ -306,11 +317,13 @@ void Brnd_es::write_grid(const Param *par, const Breg *breg,
         // c*0(-q) = bx(q) - i by(q)
         // c1(q) = by(q) + i bz(q)
         // c1*1(-q) = by(q) - i bz(q)
-        grid->bx[idx] =
+        // transforms are row-major, grid in its memory order
+        const ham_uint cell{grid->layout.index(i, j, l)};
+        grid->bx[cell] =
             0.5 * (grid->c0[idx][0] + grid->c0[idx_sym][0]) * inv_grid_size;
-        grid->by[idx] =
+        grid->by[cell] =
             0.5 * (grid->c1[idx][0] + grid->c1[idx_sym][0]) * inv_grid_size;
-        grid->bz[idx] =
+        grid->bz[cell] =
             0.5 * (grid->c1[idx_sym][1] + grid->c1[idx][1]) * inv_grid_size;
       }
     }
@@ -11,10 +11,12 @@
 #include <hamunits.h>
 #include <hamvec.h>
 #include <param.h>
+#include <profiler.h>
 #include <toolkit.h>
 
 void Brnd_mhd::write_grid(const Param *par, const Breg *breg,
                           const Grid_breg *gbreg, Grid_brnd *grid) const {
+  HAM_PROFILE_BEGIN(spectrum, "brnd_mhd/spectrum");
   // initialize random seed
 #ifdef _OPENMP
   gsl_rng **threadvec = new gsl_rng *[omp_get_max_threads()];
@@ -56,9 +58,14 @@ void Brnd_mhd::write_grid(const Param *par, const Breg *breg,
         k[1] -= cgs::kpc * par->grid_brnd.ny / ly;
       const ham_uint idx_lv2{idx_lv1 + j * par->grid_brnd.nz};
       for (decltype(par->grid_brnd.nz) l = 0; l < par->grid_brnd.nz; ++l) {
-        // the very 0th term is fixed to zero in allocation
-        if (i == 0 and j == 0 and l == 0)
+        // 0th term is zero, also after previous realization on same grid
+        if (i == 0 and j == 0 and l == 0) {
+          grid->c0[0][0] = 0;
+          grid->c0[0][1] = 0;
+          grid->c1[0][0] = 0;
+          grid->c1[0][1] = 0;
           continue;
+        }
         k[2] = cgs::kpc * l / lz;
         if (l >= (par->grid_brnd.nz + 1) / 2)
           k[2] -= cgs::kpc * par->grid_brnd.nz / lz;
@@ -133,7 +140,9 @@ void Brnd_mhd::write_grid(const Param *par, const Breg *breg,
   // execute DFT backward plan
   fftw_execute_dft(grid->plan_c0_bw, grid->c0, grid->c0);
   fftw_execute_dft(grid->plan_c1_bw, grid->c1, grid->c1);
+  HAM_PROFILE_END(spectrum);
   // now we need to get real parts manually
+  HAM_PROFILE("brnd_mhd/real part");
   // since we start in k-space real fields
   // the results in x-space are complex fields
 #ifdef _OPENMP
@@ -171,9 +180,11 @@ void Brnd_mhd::write_grid(const Param *par, const Breg *breg,
         // c*0(-q) = bx(q) - i by(q)
         // c1(q) = by(q) + i bz(q)
         // c1*1(-q) = by(q) - i bz(q)
-        grid->bx[idx] = 0.5 * (grid->c0[idx][0] + grid->c0[idx_sym][0]);
-        grid->by[idx] = 0.5 * (grid->c1[idx][0] + grid->c1[idx_sym][0]);
-        grid->bz[idx] = 0.5 * (grid->c1[idx_sym][1] + grid->c1[idx][1]);
+        // transforms are row-major, grid in its memory order
+        const ham_uint cell{grid->layout.index(i, j, l)};
+        grid->bx[cell] = 0.5 * (grid->c0[idx][0] + grid->c0[idx_sym][0]);
+        grid->by[cell] = 0.5 * (grid->c1[idx][0] + grid->c1[idx_sym][0]);
+        grid->bz[cell] = 0.5 * (grid->c1[idx_sym][1] + grid->c1[idx][1]);
       }
     }
   }
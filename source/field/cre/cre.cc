@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <stdexcept>
@@ -7,6 +8,7 @@
 #include <hamtype.h>
 #include <hamvec.h>
 #include <param.h>
+#include <profiler.h>
 #include <toolkit.h>
 
 ham_float CREfield::read_field(const Hamvec<3, ham_float> &pos,
@@ -48,158 +50,29 @@ ham_float CREfield::read_grid(const Hamvec<3, ham_float> &pos,
                               const ham_float &En, const Param *par,
                               const Grid_cre *grid) const {
   // linear interpolation in log(E)
-  ham_float tmp{std::log(En / par->grid_cre.E_min) /
-                std::log(par->grid_cre.E_max / par->grid_cre.E_min)};
+  const ham_float tmp{std::log(En / par->grid_cre.E_min) /
+                      par->grid_cre.E_fact};
   if (tmp <= 0 or tmp >= par->grid_cre.nE - 1) {
     return 0.;
   }
-  decltype(par->grid_cre.nE) El{(ham_uint)std::floor(tmp)};
+  const ham_uint El{(ham_uint)std::floor(tmp)};
   const ham_float Ed{tmp - El};
-  // linear interpolation in the spatial domain
-  tmp = (par->grid_cre.nx - 1) * (pos[0] - par->grid_cre.x_min) /
-        (par->grid_cre.x_max - par->grid_cre.x_min);
-  if (tmp <= 0 or tmp >= par->grid_cre.nx - 1) {
-    return 0.;
-  }
-  decltype(par->grid_cre.nx) xl{(ham_uint)std::floor(tmp)};
-  const ham_float xd{tmp - xl};
-  tmp = (par->grid_cre.ny - 1) * (pos[1] - par->grid_cre.y_min) /
-        (par->grid_cre.y_max - par->grid_cre.y_min);
-  if (tmp <= 0 or tmp >= par->grid_cre.ny - 1) {
-    return 0.;
-  }
-  decltype(par->grid_cre.nx) yl{(ham_uint)std::floor(tmp)};
-  const ham_float yd{tmp - yl};
-  tmp = (par->grid_cre.nz - 1) * (pos[2] - par->grid_cre.z_min) /
-        (par->grid_cre.z_max - par->grid_cre.z_min);
-  if (tmp <= 0 or tmp >= par->grid_cre.nz - 1) {
-    return 0.;
-  }
-  decltype(par->grid_cre.nx) zl{(ham_uint)std::floor(tmp)};
-  const ham_float zd{tmp - zl};
-  assert(Ed >= 0 and Ed < 1 and xd >= 0 and yd >= 0 and zd >= 0 and xd < 1 and
-         yd < 1 and zd < 1);
-  // @ El
-  ham_uint idx1{toolkit::index4d(par->grid_cre.nE, par->grid_cre.nx,
-                                 par->grid_cre.ny, par->grid_cre.nz, xl, yl, zl,
-                                 El)};
-  ham_uint idx2{toolkit::index4d(par->grid_cre.nE, par->grid_cre.nx,
-                                 par->grid_cre.ny, par->grid_cre.nz, xl, yl,
-                                 zl + 1, El)};
-  const ham_float i1{grid->cre_flux[idx1] * (1. - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl, yl + 1, zl, El);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl, yl + 1, zl + 1, El);
-  const ham_float i2{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl, zl, El);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl, zl + 1, El);
-  const ham_float j1{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl + 1, zl, El);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl + 1, zl + 1, El);
-  const ham_float j2{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  const ham_float w1{i1 * (1 - yd) + i2 * yd};
-  const ham_float w2{j1 * (1 - yd) + j2 * yd};
-  const ham_float q1{w1 * (1 - xd) + w2 * xd};
-  // @ El+1
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl, yl, zl, El + 1);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl, yl, zl + 1, El + 1);
-  const ham_float i3{grid->cre_flux[idx1] * (1. - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl, yl + 1, zl, El + 1);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl, yl + 1, zl + 1, El + 1);
-  const ham_float i4{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl, zl, El + 1);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl, zl + 1, El + 1);
-  const ham_float j3{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl + 1, zl, El + 1);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl + 1, zl + 1, El + 1);
-  const ham_float j4{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  const ham_float w3{i3 * (1 - yd) + i4 * yd};
-  const ham_float w4{j3 * (1 - yd) + j4 * yd};
-  const ham_float q2{w3 * (1 - xd) + w4 * xd};
-  // linear interpolate in log(E)
+  assert(Ed >= 0 and Ed < 1);
+  // linear interpolation in the spatial domain @ El and El+1
+  const ham_float q1{grid->interp.scalar(pos, grid->cre_flux, El)};
+  const ham_float q2{grid->interp.scalar(pos, grid->cre_flux, El + 1)};
   return q1 * (1 - Ed) + q2 * Ed;
 }
 
 ham_float CREfield::read_grid_num(const Hamvec<3, ham_float> &pos,
-                                  const ham_uint &Eidx, const Param *par,
+                                  const ham_uint &Eidx, const Param *,
                                   const Grid_cre *grid) const {
-  // linear interpolation
-  ham_float tmp{(par->grid_cre.nx - 1) * (pos[0] - par->grid_cre.x_min) /
-                (par->grid_cre.x_max - par->grid_cre.x_min)};
-  if (tmp <= 0 or tmp >= par->grid_cre.nx - 1) {
-    return 0.;
-  }
-  decltype(par->grid_cre.nx) xl{(ham_uint)std::floor(tmp)};
-  const ham_float xd{tmp - xl};
-  tmp = (par->grid_cre.ny - 1) * (pos[1] - par->grid_cre.y_min) /
-        (par->grid_cre.y_max - par->grid_cre.y_min);
-  if (tmp <= 0 or tmp >= par->grid_cre.ny - 1) {
-    return 0.;
-  }
-  decltype(par->grid_cre.ny) yl{(ham_uint)std::floor(tmp)};
-  const ham_float yd{tmp - yl};
-  tmp = (par->grid_cre.nz - 1) * (pos[2] - par->grid_cre.z_min) /
-        (par->grid_cre.z_max - par->grid_cre.z_min);
-  if (tmp <= 0 or tmp >= par->grid_cre.nz - 1) {
-    return 0.;
-  }
-  decltype(par->grid_cre.nz) zl{(ham_uint)std::floor(tmp)};
-  const ham_float zd{tmp - zl};
-  assert(xd >= 0 and yd >= 0 and zd >= 0 and xd < 1 and yd < 1 and zd < 1);
-  ham_uint idx1{toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny,
-                                 par->grid_cre.nz, par->grid_cre.nE, xl, yl, zl,
-                                 Eidx)};
-  ham_uint idx2{toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny,
-                                 par->grid_cre.nz, par->grid_cre.nE, xl, yl,
-                                 zl + 1, Eidx)};
-  const ham_float i1{grid->cre_flux[idx1] * (1. - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl, yl + 1, zl, Eidx);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl, yl + 1, zl + 1, Eidx);
-  const ham_float i2{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl, zl, Eidx);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl, zl + 1, Eidx);
-  const ham_float j1{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  idx1 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl + 1, zl, Eidx);
-  idx2 = toolkit::index4d(par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz,
-                          par->grid_cre.nE, xl + 1, yl + 1, zl + 1, Eidx);
-  const ham_float j2{grid->cre_flux[idx1] * (1 - zd) +
-                     grid->cre_flux[idx2] * zd};
-  const ham_float w1{i1 * (1 - yd) + i2 * yd};
-  const ham_float w2{j1 * (1 - yd) + j2 * yd};
-  return w1 * (1 - xd) + w2 * xd;
+  return grid->interp.scalar(pos, grid->cre_flux, Eidx);
 }
 
 // writing CRE DIFFERENTIAL density flux, in [GeV m^2 s sr]^-1
 void CREfield::write_grid(const Param *par, Grid_cre *grid) const {
+  HAM_PROFILE("cre/grid");
   assert(par->grid_cre.write_permission);
   Hamvec<3, ham_float> gc_pos;
   ham_float E;
@@ -225,3 +98,26 @@ void CREfield::write_grid(const Param *par, Grid_cre *grid) const {
     }
   }
 }
+
+void CREfield::read_grid_num_batch(const ham_float *x, const ham_float *y,
+                                   const ham_float *z, const ham_uint &n,
+                                   const Param *, const Grid_cre *grid,
+                                   ham_float *flux) const {
+  grid->interp.spectral(x, y, z, n, grid->cre_flux, flux);
+}
+
+void CREfield::flux_norm_batch(const ham_float *x, const ham_float *y,
+                               const ham_float *z, const ham_uint &n,
+                               const Param *par, ham_float *norm) const {
+  for (ham_uint i = 0; i != n; ++i) {
+    norm[i] = flux_norm(Hamvec<3, ham_float>{x[i], y[i], z[i]}, par);
+  }
+}
+
+void CREfield::flux_idx_batch(const ham_float *x, const ham_float *y,
+                              const ham_float *z, const ham_uint &n,
+                              const Param *par, ham_float *idx) const {
+  for (ham_uint i = 0; i != n; ++i) {
+    idx[i] = flux_idx(Hamvec<3, ham_float>{x[i], y[i], z[i]}, par);
+  }
+}
@@ -61,3 +61,19 @@ ham_float CRE_ana::write_field(const Hamvec<3, ham_float> &pos,
   return norm * beta_ratio * std::pow(gamma, flux_idx(pos, par)) *
          spatial_profile(pos, par);
 }
+
+void CRE_ana::flux_norm_batch(const ham_float *x, const ham_float *y,
+                         const ham_float *z, const ham_uint &n,
+                         const Param *par, ham_float *norm) const {
+  // position independent part of flux_norm
+  const ham_float gamma0{par->cre_ana.E0 / cgs::mec2};
+  const ham_float beta0{std::sqrt(1. - 1. / gamma0)};
+  const ham_float unit{4. * cgs::pi * cgs::mec /
+                       (cgs::GeV * cgs::m * cgs::m * cgs::sec * beta0)};
+  const ham_float norm0{par->cre_ana.j0 *
+                        std::pow(gamma0, -flux_idx(par->observer, par))};
+  for (ham_uint i = 0; i != n; ++i) {
+    norm[i] = norm0 * unit *
+              spatial_profile(Hamvec<3, ham_float>{x[i], y[i], z[i]}, par);
+  }
+}
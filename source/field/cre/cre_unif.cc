@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -57,3 +58,26 @@ ham_float CRE_unif::write_field(const Hamvec<3, ham_float> &pos,
   return norm * beta_ratio * std::pow(gamma, flux_idx(pos, par)) *
          spatial_profile(pos, par);
 }
+
+void CRE_unif::flux_norm_batch(const ham_float *x, const ham_float *y,
+                         const ham_float *z, const ham_uint &n,
+                         const Param *par, ham_float *norm) const {
+  // position independent part of flux_norm
+  const ham_float gamma0{par->cre_unif.E0 / cgs::mec2};
+  const ham_float beta0{std::sqrt(1. - 1. / gamma0)};
+  const ham_float unit{4. * cgs::pi * cgs::mec /
+                       (cgs::GeV * cgs::m * cgs::m * cgs::sec * beta0)};
+  const ham_float norm0{par->cre_unif.j0 *
+                        std::pow(gamma0, -flux_idx(par->observer, par))};
+  for (ham_uint i = 0; i != n; ++i) {
+    norm[i] = norm0 * unit *
+              spatial_profile(Hamvec<3, ham_float>{x[i], y[i], z[i]}, par);
+  }
+}
+
+void CRE_unif::flux_idx_batch(const ham_float *, const ham_float *,
+                              const ham_float *, const ham_uint &n,
+                              const Param *par, ham_float *idx) const {
+  // spectral index is uniform
+  std::fill(idx, idx + n, flux_idx(par->observer, par));
+}
@@ -11,6 +11,7 @@
 #include <hamunits.h>
 #include <hamvec.h>
 #include <param.h>
+#include <profiler.h>
 #include <tefield.h>
 #include <toolkit.h>
 
@@ -36,16 +37,17 @@ void TErnd_dft::write_grid(const Param *par, const TEreg *, const Grid_tereg *,
                            Grid_ternd *grid) const {
   // STEP I
   // GENERATE GAUSSIAN RANDOM FROM SPECTRUM
+  HAM_PROFILE_BEGIN(gaussian, "ternd_dft/gaussian");
   // initialize random seed
 #ifdef _OPENMP
   gsl_rng **threadvec = new gsl_rng *[omp_get_max_threads()];
   for (int b = 0; b < omp_get_max_threads(); ++b) {
     threadvec[b] = gsl_rng_alloc(gsl_rng_taus);
-    gsl_rng_set(threadvec[b], b + toolkit::random_seed(par->brnd_seed));
+    gsl_rng_set(threadvec[b], b + toolkit::random_seed(par->ternd_seed));
   }
 #else
   gsl_rng *r{gsl_rng_alloc(gsl_rng_taus)};
-  gsl_rng_set(r, toolkit::random_seed(par->brnd_seed));
+  gsl_rng_set(r, toolkit::random_seed(par->ternd_seed));
 #endif
   const ham_float lx{par->grid_ternd.x_max - par->grid_ternd.x_min};
   const ham_float ly{par->grid_ternd.y_max - par->grid_ternd.y_min};
@@ -72,8 +74,12 @@ void TErnd_dft::write_grid(const Param *par, const TEreg *, const Grid_tereg *,
         ky -= cgs::kpc * par->grid_ternd.ny / ly;
       const size_t idx_lv2{idx_lv1 + j * par->grid_ternd.nz};
       for (decltype(par->grid_ternd.nz) l = 0; l < par->grid_ternd.nz; ++l) {
-        if (i == 0 and j == 0 and l == 0)
+        // 0th term is zero, also after previous realization on same grid
+        if (i == 0 and j == 0 and l == 0) {
+          grid->te_k[0][0] = 0;
+          grid->te_k[0][1] = 0;
           continue;
+        }
         ham_float kz{cgs::kpc * l / lz};
         if (l >= (par->grid_ternd.nz + 1) / 2)
           kz -= cgs::kpc * par->grid_ternd.nz / lz;
@@ -96,8 +102,10 @@ void TErnd_dft::write_grid(const Param *par, const TEreg *, const Grid_tereg *,
 #endif
   // execute DFT backward plan
   fftw_execute_dft(grid->plan_te_bw, grid->te_k, grid->te_k);
+  HAM_PROFILE_END(gaussian);
   // STEP II
   // RESCALING FIELD PROFILE IN REAL SPACE
+  HAM_PROFILE("ternd_dft/rescale");
   // 1/sqrt(te_var)
   const ham_float te_var_invsq{
       1. /
@@ -120,8 +128,9 @@ void TErnd_dft::write_grid(const Param *par, const TEreg *, const Grid_tereg *,
         ham_float ratio{std::sqrt(spatial_profile(pos, par)) *
                         par->ternd_dft.rms * te_var_invsq};
         const size_t idx{idx_lv2 + l};
-        // manually pass back reprofiled Re part
-        grid->te[idx] = grid->te_k[idx][0] * ratio;
+        // manually pass back reprofiled Re part, transform is row-major,
+        // grid in its memory order
+        grid->te[grid->layout.index(i, j, l)] = grid->te_k[idx][0] * ratio;
       }
     }
   }
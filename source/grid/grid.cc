@@ -1,19 +1,196 @@
 // grid base class
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <grid.h>
+#include <hamarray.h>
+#include <hamgrid.h>
+#include <hamlayout.h>
+#include <hamtype.h>
+#include <hamwriter.h>
 #include <param.h>
 
 void Grid::build_grid(const Param *) {
   throw std::runtime_error("wrong inheritance");
 }
 
-void Grid::export_grid(const Param *) {
+// one bulk write per file
+void Grid::export_grid(const Param *par) {
+  for (const auto &f : export_data(par)) {
+    Hamwriter::dump(f.first, f.second.data(), f.second.size(),
+                    par->output.fsync);
+  }
+}
+
+Grid::file_list Grid::export_data(const Param *) {
   throw std::runtime_error("wrong inheritance");
 }
 
 void Grid::import_grid(const Param *) {
   throw std::runtime_error("wrong inheritance");
 }
+
+namespace {
+// own arrays of grid components, kept if already allocated,
+// interleaved in memory or not
+const std::vector<Hamarray<ham_store> *> &
+own_arrays(const std::vector<Hamarray<ham_store> *> &list, const ham_uint &n) {
+  for (auto &a : list) {
+    if (not *a or a->mapped() or a->size() != n) {
+      *a = Hamarray<ham_store>(n);
+    }
+  }
+  return list;
+}
+
+// de-interleave values of given type into component arrays
+// 1st argument: first value of first cell
+// 2nd argument: index of first cell
+// 3rd argument: number of cells
+// 4th argument: component arrays
+// 5th argument: memory order of arrays
+template <typename S>
+void decode(const char *src, const ham_uint &begin, const ham_uint &count,
+            const std::vector<Hamarray<ham_store> *> &out,
+            const Hamlayout &layout) {
+  const ham_uint ncomp{out.size()};
+  S value;
+  for (ham_uint i = 0; i != count; ++i) {
+    const ham_uint k{layout.at(begin + i)};
+    for (ham_uint c = 0; c != ncomp; ++c) {
+      std::memcpy(&value, src + (i * ncomp + c) * sizeof(S), sizeof(S));
+      (*out[c])[k] = value;
+    }
+  }
+}
+
+void decode(const hamgrid::header &h, const char *src, const ham_uint &begin,
+            const ham_uint &count,
+            const std::vector<Hamarray<ham_store> *> &out,
+            const Hamlayout &layout) {
+  if (hamgrid::itemsize(h) == sizeof(float)) {
+    decode<float>(src, begin, count, out, layout);
+  } else {
+    decode<double>(src, begin, count, out, layout);
+  }
+}
+} // namespace
+
+void Grid::import_file(const std::string &filename, const std::string &mode,
+                       const hamgrid::header &expected,
+                       const std::vector<Hamarray<ham_store> *> &list,
+                       const Hamlayout &layout, const std::size_t &budget) {
+  assert(!filename.empty());
+  assert(list.size() == expected.ncomp);
+  const ham_uint n{hamgrid::count(expected)};
+  const ham_uint ncomp{list.size()};
+  assert(layout.size() >= n);
+  auto verify = [&filename](const hamgrid::header &h,
+                            const std::uint64_t &sum) {
+    if (sum != h.checksum) {
+      throw std::runtime_error(filename + " fails checksum");
+    }
+  };
+  if (mode == "mmap" or mode == "populate") {
+    auto map = std::make_shared<const Hammap>(filename, mode == "populate");
+    const hamgrid::header h{hamgrid::parse(map->data(), map->size(), filename)};
+    hamgrid::check(h, expected, filename);
+    if (map->size() < h.offset + hamgrid::padded(h.bytes)) {
+      throw std::runtime_error(filename + " is truncated");
+    }
+    const char *payload{map->data() + h.offset};
+    // populated pages are all read anyway
+    if (mode == "populate") {
+      verify(h, hamgrid::checksum(hamgrid::checksum_basis, payload,
+                                  hamgrid::padded(h.bytes)));
+    }
+    if (hamgrid::bricked(h) and layout.row()) {
+      hamgrid::check_bricks(h, payload, filename);
+      const ham_uint cells[3]{h.nx, h.ny, h.nz};
+      // decoder keeps mapping alive
+      auto bricks = std::make_shared<const Hambricks<ham_store>>(
+          cells, h.nE, ncomp, h.brick, budget,
+          [map, h](const ham_uint &id, ham_store *out) {
+            hamgrid::unpack(h, map->data() + h.offset, id, out);
+          });
+      for (ham_uint c = 0; c != ncomp; ++c) {
+        *list[c] = Hamarray<ham_store>(bricks, c);
+      }
+      return;
+    }
+    if (hamgrid::bricked(h)) {
+      // mapping is released afterwards
+      hamgrid::check_bricks(h, payload, filename);
+      hamgrid::unpack(h, payload, own_arrays(list, layout.size()), layout);
+      return;
+    }
+    if (hamgrid::itemsize(h) == sizeof(ham_store) and layout.row()) {
+      // strided views sharing the mapping
+      const ham_store *src{reinterpret_cast<const ham_store *>(payload)};
+      for (ham_uint c = 0; c != ncomp; ++c) {
+        *list[c] = Hamarray<ham_store>(map, src + c, n, ncomp);
+      }
+      return;
+    }
+    // conversion into own arrays, mapping is released afterwards
+    decode(h, payload, 0, n, own_arrays(list, layout.size()), layout);
+    return;
+  }
+  if (mode != "stream") {
+    throw std::runtime_error("unsupported import mode " + mode);
+  }
+  std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+  if (not input.is_open()) {
+    throw std::runtime_error("cannot open " + filename);
+  }
+  input.seekg(0, input.end);
+  const std::uint64_t size{static_cast<std::uint64_t>(input.tellg())};
+  input.seekg(0, input.beg);
+  std::vector<char> buffer(std::min<std::uint64_t>(size, hamgrid::page));
+  input.read(buffer.data(), buffer.size());
+  const hamgrid::header h{
+      hamgrid::parse(buffer.data(), buffer.size(), filename)};
+  hamgrid::check(h, expected, filename);
+  if (size < h.offset + hamgrid::padded(h.bytes)) {
+    throw std::runtime_error(filename + " is truncated");
+  }
+  input.seekg(h.offset, input.beg);
+  const std::vector<Hamarray<ham_store> *> &out{
+      own_arrays(list, layout.size())};
+  if (hamgrid::bricked(h)) {
+    // compressed payload is read at once and decoded brick by brick
+    buffer.resize(hamgrid::padded(h.bytes));
+    if (not input.read(buffer.data(), buffer.size())) {
+      throw std::runtime_error("cannot read " + filename);
+    }
+    verify(h, hamgrid::checksum(hamgrid::checksum_basis, buffer.data(),
+                                buffer.size()));
+    hamgrid::check_bricks(h, buffer.data(), filename);
+    hamgrid::unpack(h, buffer.data(), out, layout);
+    return;
+  }
+  // bulk reads of even number of cells, so that every read but the
+  // last one covers whole checksum words
+  const std::size_t cell{ncomp * hamgrid::itemsize(h)};
+  const ham_uint chunk{std::min(n, static_cast<ham_uint>(1) << 16)};
+  buffer.resize(hamgrid::padded(chunk * cell));
+  std::uint64_t sum{hamgrid::checksum_basis};
+  for (ham_uint begin = 0; begin < n; begin += chunk) {
+    const ham_uint count{std::min(chunk, n - begin)};
+    const std::size_t bytes{hamgrid::padded(count * cell)};
+    if (not input.read(buffer.data(), bytes)) {
+      throw std::runtime_error("cannot read " + filename);
+    }
+    sum = hamgrid::checksum(sum, buffer.data(), bytes);
+    decode(h, buffer.data(), begin, count, out, layout);
+  }
+  verify(h, sum);
+}
@@ -2,13 +2,13 @@
 
 #include <array>
 #include <cassert>
-#include <fstream>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include <grid.h>
+#include <hamgrid.h>
 #include <hamtype.h>
 #include <param.h>
 
@@ -20,51 +20,35 @@ Grid_breg::Grid_breg(const Param *par) {
 }
 
 void Grid_breg::build_grid(const Param *par) {
+  layout = Hamlayout({par->grid_breg.nx, par->grid_breg.ny, par->grid_breg.nz},
+                     par->grid_breg.order);
+  interp = Haminterp(par->grid_breg, layout, par->grid_breg.interp);
   // allocate spatial domain regular magnetic field
-  bx = std::make_unique<ham_float[]>(par->grid_breg.full_size);
-  by = std::make_unique<ham_float[]>(par->grid_breg.full_size);
-  bz = std::make_unique<ham_float[]>(par->grid_breg.full_size);
+  // except for views into file mapping of import
+  if (not par->grid_breg.read_permission or
+      par->grid_breg.import_mode == "stream" or not layout.row()) {
+    if (par->grid_breg.interleave) {
+      // components of a vertex padded to 4 values
+      Hamarray<ham_store>::interleave({&bx, &by, &bz}, layout.size(), 4);
+    } else {
+      bx = Hamarray<ham_store>(layout.size());
+      by = Hamarray<ham_store>(layout.size());
+      bz = Hamarray<ham_store>(layout.size());
+    }
+  }
 }
 
-void Grid_breg::export_grid(const Param *par) {
+Grid::file_list Grid_breg::export_data(const Param *par) {
   assert(!par->grid_breg.filename.empty());
-  std::ofstream output(par->grid_breg.filename.c_str(),
-                       std::ios::out | std::ios::binary);
-  assert(output.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_breg.full_size) i = 0; i != par->grid_breg.full_size;
-       ++i) {
-    assert(!output.eof());
-    tmp = bx[i];
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    tmp = by[i];
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    tmp = bz[i];
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-  }
-  output.close();
+  return {{par->grid_breg.filename,
+           hamgrid::pack(hamgrid::describe("breg", par), {&bx, &by, &bz},
+                         layout)}};
 }
 
 void Grid_breg::import_grid(const Param *par) {
-  assert(!par->grid_breg.filename.empty());
-  std::ifstream input(par->grid_breg.filename.c_str(),
-                      std::ios::in | std::ios::binary);
-  assert(input.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_breg.full_size) i = 0; i != par->grid_breg.full_size;
-       ++i) {
-    assert(!input.eof());
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    bx[i] = tmp;
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    by[i] = tmp;
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    bz[i] = tmp;
-  }
-#ifndef NDEBUG
-  auto eof = input.tellg();
-  input.seekg(0, input.end);
-#endif
-  assert(eof == input.tellg());
-  input.close();
+  import_file(par->grid_breg.filename, par->grid_breg.import_mode,
+              hamgrid::describe("breg", par), {&bx, &by, &bz}, layout,
+              std::size_t(par->grid_breg.cache) << 20);
 }
+
+void Grid_breg::prefilter_grid() { interp.prefilter({&bx, &by, &bz}); }
@@ -2,7 +2,6 @@
 
 #include <array>
 #include <cassert>
-#include <fstream>
 #include <memory>
 #include <omp.h>
 #include <sstream>
@@ -12,6 +11,7 @@
 #include <fftw3.h>
 
 #include <grid.h>
+#include <hamgrid.h>
 #include <hamtype.h>
 #include <param.h>
 
@@ -23,10 +23,22 @@ Grid_brnd::Grid_brnd(const Param *par) {
 }
 
 void Grid_brnd::build_grid(const Param *par) {
+  layout = Hamlayout({par->grid_brnd.nx, par->grid_brnd.ny, par->grid_brnd.nz},
+                     par->grid_brnd.order);
+  interp = Haminterp(par->grid_brnd, layout, par->grid_brnd.interp);
   // allocate spatial domian magnetic field
-  bx = std::make_unique<ham_float[]>(par->grid_brnd.full_size);
-  by = std::make_unique<ham_float[]>(par->grid_brnd.full_size);
-  bz = std::make_unique<ham_float[]>(par->grid_brnd.full_size);
+  // except for views into file mapping of import
+  if (not par->grid_brnd.read_permission or
+      par->grid_brnd.import_mode == "stream" or not layout.row()) {
+    if (par->grid_brnd.interleave) {
+      // components of a vertex padded to 4 values
+      Hamarray<ham_store>::interleave({&bx, &by, &bz}, layout.size(), 4);
+    } else {
+      bx = Hamarray<ham_store>(layout.size());
+      by = Hamarray<ham_store>(layout.size());
+      bz = Hamarray<ham_store>(layout.size());
+    }
+  }
   // Fourier domain complex field
   c0 = fftw_alloc_complex(par->grid_brnd.full_size);
   c0[0][0] = 0;
@@ -54,45 +66,17 @@ void Grid_brnd::build_grid(const Param *par) {
                        c1, c1, FFTW_FORWARD, FFTW_ESTIMATE);
 }
 
-void Grid_brnd::export_grid(const Param *par) {
+Grid::file_list Grid_brnd::export_data(const Param *par) {
   assert(!par->grid_brnd.filename.empty());
-  std::ofstream output(par->grid_brnd.filename.c_str(),
-                       std::ios::out | std::ios::binary);
-  assert(output.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_brnd.full_size) i = 0; i != par->grid_brnd.full_size;
-       ++i) {
-    assert(!output.eof());
-    tmp = bx[i];
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    tmp = by[i];
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    tmp = bz[i];
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-  }
-  output.close();
+  return {{par->grid_brnd.filename,
+           hamgrid::pack(hamgrid::describe("brnd", par), {&bx, &by, &bz},
+                         layout)}};
 }
 
 void Grid_brnd::import_grid(const Param *par) {
-  assert(!par->grid_brnd.filename.empty());
-  std::ifstream input(par->grid_brnd.filename.c_str(),
-                      std::ios::in | std::ios::binary);
-  assert(input.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_brnd.full_size) i = 0; i != par->grid_brnd.full_size;
-       ++i) {
-    assert(!input.eof());
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    bx[i] = tmp;
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    by[i] = tmp;
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    bz[i] = tmp;
-  }
-#ifndef NDEBUG
-  auto eof = input.tellg();
-  input.seekg(0, input.end);
-#endif
-  assert(eof == input.tellg());
-  input.close();
+  import_file(par->grid_brnd.filename, par->grid_brnd.import_mode,
+              hamgrid::describe("brnd", par), {&bx, &by, &bz}, layout,
+              std::size_t(par->grid_brnd.cache) << 20);
 }
+
+void Grid_brnd::prefilter_grid() { interp.prefilter({&bx, &by, &bz}); }
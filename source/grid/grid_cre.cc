@@ -2,13 +2,13 @@
 
 #include <array>
 #include <cassert>
-#include <fstream>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include <grid.h>
+#include <hamgrid.h>
 #include <hamtype.h>
 #include <param.h>
 
@@ -20,41 +20,26 @@ Grid_cre::Grid_cre(const Param *par) {
 }
 
 void Grid_cre::build_grid(const Param *par) {
+  layout = Hamlayout({par->grid_cre.nx, par->grid_cre.ny, par->grid_cre.nz},
+                     "row", par->grid_cre.nE);
+  interp = Haminterp(par->grid_cre, layout);
   // allocate phase-space CRE flux
-  cre_flux = std::make_unique<ham_float[]>(par->grid_cre.cre_size);
+  // except for views into file mapping of import
+  if (not par->grid_cre.read_permission or
+      par->grid_cre.import_mode == "stream") {
+    cre_flux = Hamarray<ham_store>(par->grid_cre.cre_size);
+  }
 }
 
-void Grid_cre::export_grid(const Param *par) {
+Grid::file_list Grid_cre::export_data(const Param *par) {
   assert(!par->grid_cre.filename.empty());
-  std::ofstream output(par->grid_cre.filename.c_str(),
-                       std::ios::out | std::ios::binary);
-  assert(output.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_cre.cre_size) i = 0; i != par->grid_cre.cre_size;
-       ++i) {
-    assert(!output.eof());
-    tmp = cre_flux[i];
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-  }
-  output.close();
+  return {{par->grid_cre.filename,
+           hamgrid::pack(hamgrid::describe("cre", par), {&cre_flux},
+                         layout)}};
 }
 
 void Grid_cre::import_grid(const Param *par) {
-  assert(!par->grid_cre.filename.empty());
-  std::ifstream input(par->grid_cre.filename.c_str(),
-                      std::ios::in | std::ios::binary);
-  assert(input.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_cre.cre_size) i = 0; i != par->grid_cre.cre_size;
-       ++i) {
-    assert(!input.eof());
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    cre_flux[i] = tmp;
-  }
-#ifndef NDEBUG
-  auto eof = input.tellg();
-  input.seekg(0, input.end);
-#endif
-  assert(eof == input.tellg());
-  input.close();
+  import_file(par->grid_cre.filename, par->grid_cre.import_mode,
+              hamgrid::describe("cre", par), {&cre_flux}, layout,
+              std::size_t(par->grid_cre.cache) << 20);
 }
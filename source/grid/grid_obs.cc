@@ -1,11 +1,13 @@
 // observable field grid
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <fstream>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <grid.h>
@@ -21,25 +23,28 @@ Grid_obs::Grid_obs(const Param *par) { build_grid(par); }
 void Grid_obs::build_grid(const Param *par) {
   if (par->grid_obs.do_dm) {
     dm_map = std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_dm);
-    tmp_dm_map = std::make_unique<Hampix<ham_float>>();
   }
-  if (par->grid_obs.do_sync.back()) {
-    is_map =
-        std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_sync.back());
-    tmp_is_map = std::make_unique<Hampix<ham_float>>();
-    qs_map =
-        std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_sync.back());
-    tmp_qs_map = std::make_unique<Hampix<ham_float>>();
-    us_map =
-        std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_sync.back());
-    tmp_us_map = std::make_unique<Hampix<ham_float>>();
-    fd_map =
-        std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_sync.back());
-    tmp_fd_map = std::make_unique<Hampix<ham_float>>();
+  if (par->grid_obs.do_sync) {
+    const auto channels = par->grid_obs.sim_sync_freq.size();
+    is_map.clear();
+    qs_map.clear();
+    us_map.clear();
+    for (decltype(par->grid_obs.sim_sync_freq.size()) i = 0; i != channels;
+         ++i) {
+      is_map.push_back(
+          std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_sync[i]));
+      qs_map.push_back(
+          std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_sync[i]));
+      us_map.push_back(
+          std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_sync[i]));
+    }
+    // Faraday depth cache for inner shells
+    // at the finest synchrotron resolution
+    fd_map = std::make_unique<Hampix<ham_float>>(*std::max_element(
+        par->grid_obs.nside_sync.begin(), par->grid_obs.nside_sync.end()));
   }
   if (par->grid_obs.do_fd) {
     fd_map = std::make_unique<Hampix<ham_float>>(par->grid_obs.nside_fd);
-    tmp_fd_map = std::make_unique<Hampix<ham_float>>();
   }
   if (par->grid_obs.do_mask) {
     Hamio<ham_float> maskio(par->grid_obs.mask_name);
@@ -50,33 +55,65 @@ void Grid_obs::build_grid(const Param *par) {
   }
 }
 
-void Grid_obs::export_grid(const Param *par) {
-  Hamio<ham_float> expio;
+void Grid_obs::clear_grid() {
+  auto clear = [](Hampix<ham_float> *map) {
+    if (map != nullptr) {
+      for (ham_uint i = 0; i != map->npix(); ++i) {
+        map->data(i, 0.);
+      }
+    }
+  };
+  clear(dm_map.get());
+  clear(fd_map.get());
+  for (decltype(is_map.size()) i = 0; i != is_map.size(); ++i) {
+    clear(is_map[i].get());
+    clear(qs_map[i].get());
+    clear(us_map[i].get());
+  }
+}
+
+// file names carry suffix of current observer before extension
+// maps are named by export file name, in order of export
+std::vector<std::pair<std::string, Hampix<ham_float> *>>
+Grid_obs::export_list(const Param *par) {
+  std::vector<std::pair<std::string, Hampix<ham_float> *>> list;
+  auto tagged = [&par](std::string name, const std::string &stokes) {
+    return name.insert(name.size() - 4, par->grid_obs.origin_tag + stokes);
+  };
   if (par->grid_obs.do_dm) {
     // in units pc/cm^3, conventional units
     dm_map->rescale(cgs::ccm / cgs::pc);
-    expio.filename(par->grid_obs.sim_dm_name);
-    expio.dump(*dm_map);
+    list.emplace_back(tagged(par->grid_obs.sim_dm_name, ""), dm_map.get());
   }
-  if (par->grid_obs.do_sync.back()) {
+  if (par->grid_obs.do_sync) {
     // in units cmb K, conventional units
-    std::string name_i = par->grid_obs.sim_sync_name.back();
-    std::string name_q = par->grid_obs.sim_sync_name.back();
-    std::string name_u = par->grid_obs.sim_sync_name.back();
-    name_i.insert(name_i.size() - 4, "_I");
-    name_q.insert(name_q.size() - 4, "_Q");
-    name_u.insert(name_u.size() - 4, "_U");
-    expio.filename(name_i);
-    expio.dump(*is_map);
-    expio.filename(name_q);
-    expio.dump(*qs_map);
-    expio.filename(name_u);
-    expio.dump(*us_map);
+    for (decltype(is_map.size()) i = 0; i != is_map.size(); ++i) {
+      list.emplace_back(tagged(par->grid_obs.sim_sync_name[i], "_I"),
+                        is_map[i].get());
+      list.emplace_back(tagged(par->grid_obs.sim_sync_name[i], "_Q"),
+                        qs_map[i].get());
+      list.emplace_back(tagged(par->grid_obs.sim_sync_name[i], "_U"),
+                        us_map[i].get());
+    }
   }
   if (par->grid_obs.do_fd) {
     // FD units is rad*m^(-2) in our calculation
     fd_map->rescale(cgs::m * cgs::m);
-    expio.filename(par->grid_obs.sim_fd_name);
-    expio.dump(*fd_map);
+    list.emplace_back(tagged(par->grid_obs.sim_fd_name, ""), fd_map.get());
+  }
+  return list;
+}
+
+Grid::file_list Grid_obs::export_data(const Param *par) {
+  file_list result;
+  // maps are raw arrays of ham_float pixel values
+  for (const auto &m : export_list(par)) {
+    std::vector<char> data(m.second->npix() * sizeof(ham_float));
+    ham_float *out{reinterpret_cast<ham_float *>(data.data())};
+    for (ham_uint i = 0; i != m.second->npix(); ++i) {
+      out[i] = m.second->data(i);
+    }
+    result.emplace_back(m.first, std::move(data));
   }
+  return result;
 }
@@ -2,13 +2,13 @@
 
 #include <array>
 #include <cassert>
-#include <fstream>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include <grid.h>
+#include <hamgrid.h>
 #include <hamtype.h>
 #include <param.h>
 
@@ -19,42 +19,28 @@ Grid_tereg::Grid_tereg(const Param *par) {
 }
 
 void Grid_tereg::build_grid(const Param *par) {
+  layout = Hamlayout(
+      {par->grid_tereg.nx, par->grid_tereg.ny, par->grid_tereg.nz},
+      par->grid_tereg.order);
+  interp = Haminterp(par->grid_tereg, layout, par->grid_tereg.interp);
   // allocate spatial domain thermal electron field
-  te = std::make_unique<ham_float[]>(par->grid_tereg.full_size);
+  // except for views into file mapping of import
+  if (not par->grid_tereg.read_permission or
+      par->grid_tereg.import_mode == "stream" or not layout.row()) {
+    te = Hamarray<ham_store>(layout.size());
+  }
 }
 
-void Grid_tereg::export_grid(const Param *par) {
+Grid::file_list Grid_tereg::export_data(const Param *par) {
   assert(!par->grid_tereg.filename.empty());
-  std::ofstream output(par->grid_tereg.filename.c_str(),
-                       std::ios::out | std::ios::binary);
-  assert(output.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_tereg.full_size) i = 0;
-       i != par->grid_tereg.full_size; ++i) {
-    assert(!output.eof());
-    tmp = te[i];
-    assert(tmp >= 0);
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-  }
-  output.close();
+  return {{par->grid_tereg.filename,
+           hamgrid::pack(hamgrid::describe("tereg", par), {&te}, layout)}};
 }
 
 void Grid_tereg::import_grid(const Param *par) {
-  assert(!par->grid_tereg.filename.empty());
-  std::ifstream input(par->grid_tereg.filename.c_str(),
-                      std::ios::in | std::ios::binary);
-  assert(input.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_tereg.full_size) i = 0;
-       i != par->grid_tereg.full_size; ++i) {
-    assert(!input.eof());
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    te[i] = tmp;
-  }
-#ifndef NDEBUG
-  auto eof = input.tellg();
-  input.seekg(0, input.end);
-#endif
-  assert(eof == input.tellg());
-  input.close();
+  import_file(par->grid_tereg.filename, par->grid_tereg.import_mode,
+              hamgrid::describe("tereg", par), {&te}, layout,
+              std::size_t(par->grid_tereg.cache) << 20);
 }
+
+void Grid_tereg::prefilter_grid() { interp.prefilter({&te}); }
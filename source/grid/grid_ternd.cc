@@ -2,7 +2,6 @@
 
 #include <array>
 #include <cassert>
-#include <fstream>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -12,6 +11,7 @@
 #include <omp.h>
 
 #include <grid.h>
+#include <hamgrid.h>
 #include <hamtype.h>
 #include <param.h>
 
@@ -24,8 +24,16 @@ Grid_ternd::Grid_ternd(const Param *par) {
 }
 
 void Grid_ternd::build_grid(const Param *par) {
+  layout = Hamlayout(
+      {par->grid_ternd.nx, par->grid_ternd.ny, par->grid_ternd.nz},
+      par->grid_ternd.order);
+  interp = Haminterp(par->grid_ternd, layout, par->grid_ternd.interp);
   // allocate spatial domain thermal electron field
-  te = std::make_unique<ham_float[]>(par->grid_ternd.full_size);
+  // except for views into file mapping of import
+  if (not par->grid_ternd.read_permission or
+      par->grid_ternd.import_mode == "stream" or not layout.row()) {
+    te = Hamarray<ham_store>(layout.size());
+  }
   // allocate Fourier domain thermal electron field
   te_k = fftw_alloc_complex(par->grid_ternd.full_size);
   te_k[0][0] = 0;
@@ -39,37 +47,16 @@ void Grid_ternd::build_grid(const Param *par) {
                                 FFTW_ESTIMATE);
 }
 
-void Grid_ternd::export_grid(const Param *par) {
+Grid::file_list Grid_ternd::export_data(const Param *par) {
   assert(!par->grid_ternd.filename.empty());
-  std::ofstream output(par->grid_ternd.filename.c_str(),
-                       std::ios::out | std::ios::binary);
-  assert(output.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_ternd.full_size) i = 0;
-       i != par->grid_ternd.full_size; ++i) {
-    assert(!output.eof());
-    tmp = te[i];
-    output.write(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-  }
-  output.close();
+  return {{par->grid_ternd.filename,
+           hamgrid::pack(hamgrid::describe("ternd", par), {&te}, layout)}};
 }
 
 void Grid_ternd::import_grid(const Param *par) {
-  assert(!par->grid_ternd.filename.empty());
-  std::ifstream input(par->grid_ternd.filename.c_str(),
-                      std::ios::in | std::ios::binary);
-  assert(input.is_open());
-  ham_float tmp;
-  for (decltype(par->grid_ternd.full_size) i = 0;
-       i != par->grid_ternd.full_size; ++i) {
-    assert(!input.eof());
-    input.read(reinterpret_cast<char *>(&tmp), sizeof(ham_float));
-    te[i] = tmp;
-  }
-#ifndef NDEBUG
-  auto eof = input.tellg();
-  input.seekg(0, input.end);
-#endif
-  assert(eof == input.tellg());
-  input.close();
+  import_file(par->grid_ternd.filename, par->grid_ternd.import_mode,
+              hamgrid::describe("ternd", par), {&te}, layout,
+              std::size_t(par->grid_ternd.cache) << 20);
 }
+
+void Grid_ternd::prefilter_grid() { interp.prefilter({&te}); }
@@ -0,0 +1,154 @@
+// read-only memory mapping of grid files and cache of decoded bricks
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <hamarray.h>
+
+Hammap::Hammap(const std::string &filename, const bool &populate) {
+  const int fd{::open(filename.c_str(), O_RDONLY)};
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + filename + ": " +
+                             std::string(std::strerror(errno)));
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0 or info.st_size <= 0) {
+    ::close(fd);
+    throw std::runtime_error("cannot map empty file " + filename);
+  }
+  int flags{MAP_PRIVATE};
+#ifdef MAP_POPULATE
+  if (populate) {
+    flags |= MAP_POPULATE;
+  }
+#endif
+  void *addr{::mmap(nullptr, info.st_size, PROT_READ, flags, fd, 0)};
+  // mapping holds its own reference to file
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("cannot map " + filename + ": " +
+                             std::string(std::strerror(errno)));
+  }
+  this->ptr = static_cast<const char *>(addr);
+  this->bytes = info.st_size;
+  // hints only, failure is harmless
+  // without population, grid interpolation touches pages out of order
+#ifdef MAP_POPULATE
+  if (not populate) {
+    ::madvise(addr, this->bytes, MADV_RANDOM);
+  }
+#else
+  ::madvise(addr, this->bytes, populate ? MADV_WILLNEED : MADV_RANDOM);
+#endif
+}
+
+Hammap::~Hammap() {
+  if (this->ptr != nullptr) {
+    ::munmap(const_cast<char *>(this->ptr), this->bytes);
+  }
+}
+
+namespace {
+// serial numbers of Hambricks objects, zero marks unused pins
+std::atomic<std::uint64_t> serials{0};
+} // namespace
+
+template <typename T>
+Hambricks<T>::Hambricks(const ham_uint (&cells)[3], const ham_uint &nw,
+                        const ham_uint &ncomp, const ham_uint &edge,
+                        const std::size_t &budget, decoder decode)
+    : nw{nw}, ncomp{ncomp}, budget{budget}, decode{std::move(decode)},
+      serial{++serials} {
+  if (edge == 0 or (edge & (edge - 1)) != 0) {
+    throw std::runtime_error("brick edge length " + std::to_string(edge) +
+                             " is no power of 2");
+  }
+  this->shift = 0;
+  while ((ham_uint(1) << this->shift) != edge) {
+    ++this->shift;
+  }
+  this->length = nw;
+  for (int d = 0; d != 3; ++d) {
+    this->n[d] = cells[d];
+    this->nb[d] = (cells[d] + edge - 1) / edge;
+    this->length *= cells[d];
+  }
+}
+
+template <typename T> ham_uint Hambricks<T>::decoded() const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->count;
+}
+
+template <typename T> std::size_t Hambricks<T>::resident() const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->bytes;
+}
+
+template <typename T>
+const typename Hambricks<T>::brick &
+Hambricks<T>::load(const ham_uint &id) const {
+  std::shared_ptr<const brick> found;
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto it = this->cache.find(id);
+    if (it != this->cache.end()) {
+      this->order.splice(this->order.begin(), this->order, it->second.second);
+      found = it->second.first;
+    }
+  }
+  if (not found) {
+    // decoding takes no lock, other threads may decode the same brick
+    auto fresh = std::make_shared<brick>();
+    const ham_uint edge{ham_uint(1) << this->shift};
+    const ham_uint b[3]{id / this->nb[2] / this->nb[1],
+                        id / this->nb[2] % this->nb[1], id % this->nb[2]};
+    ham_uint size{this->nw * this->ncomp};
+    for (int d = 0; d != 3; ++d) {
+      fresh->n[d] = std::min(edge, this->n[d] - b[d] * edge);
+      size *= fresh->n[d];
+    }
+    fresh->values = std::make_unique<T[]>(size);
+    fresh->bytes = size * sizeof(T);
+    this->decode(id, fresh->values.get());
+    std::lock_guard<std::mutex> guard(this->lock);
+    ++this->count;
+    auto it = this->cache.find(id);
+    if (it != this->cache.end()) {
+      this->order.splice(this->order.begin(), this->order, it->second.second);
+      found = it->second.first;
+    } else {
+      found = fresh;
+      this->order.push_front(id);
+      this->cache.emplace(id, std::make_pair(found, this->order.begin()));
+      this->bytes += fresh->bytes;
+      // the brick just read is kept even beyond budget
+      while (this->bytes > this->budget and this->order.size() > 1) {
+        auto last = this->cache.find(this->order.back());
+        this->bytes -= last->second.first->bytes;
+        this->cache.erase(last);
+        this->order.pop_back();
+      }
+    }
+  }
+  pin &p{pins[next++ % npin]};
+  p.owner = this->serial;
+  p.id = id;
+  p.ptr = std::move(found);
+  return *p.ptr;
+}
+
+template class Hambricks<float>;
+template class Hambricks<double>;
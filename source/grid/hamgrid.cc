@@ -0,0 +1,540 @@
+// container format of field grid files
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <hamarray.h>
+#include <hamgrid.h>
+#include <hamtype.h>
+#include <hamwriter.h>
+#include <param.h>
+
+static_assert(sizeof(hamgrid::header) == 8 * 29, "padded grid file header");
+static_assert(sizeof(hamgrid::header) <= hamgrid::page, "grid file header");
+
+namespace {
+// text field of header, not necessarily terminated
+template <std::size_t N> std::string text(const char (&field)[N]) {
+  return std::string(field, strnlen(field, N));
+}
+
+template <std::size_t N>
+void set_text(char (&field)[N], const std::string &value) {
+  assert(value.size() < N);
+  std::memset(field, 0, N);
+  std::memcpy(field, value.data(), value.size());
+}
+
+// spatial position of first cell and number of cells of brick
+void brick_box(const hamgrid::header &h, const std::uint64_t &id,
+               std::uint64_t (&first)[3], std::uint64_t (&size)[3]) {
+  const std::uint64_t n[3]{h.nx, h.ny, h.nz};
+  const std::uint64_t nb[3]{(h.nx + h.brick - 1) / h.brick,
+                            (h.ny + h.brick - 1) / h.brick,
+                            (h.nz + h.brick - 1) / h.brick};
+  const std::uint64_t b[3]{id / nb[2] / nb[1], id / nb[2] % nb[1], id % nb[2]};
+  for (int d = 0; d != 3; ++d) {
+    first[d] = b[d] * h.brick;
+    size[d] = std::min(h.brick, n[d] - first[d]);
+  }
+}
+
+// number of values of brick, of all components
+std::uint64_t brick_values(const hamgrid::header &h, const std::uint64_t &id) {
+  std::uint64_t first[3], size[3];
+  brick_box(h, id, first, size);
+  return size[0] * size[1] * size[2] * h.nE * h.ncomp;
+}
+
+// call f(k, c, i) for k-th value of brick, which is i-th value of
+// component c
+template <typename F>
+void for_brick(const hamgrid::header &h, const std::uint64_t &id, F f) {
+  std::uint64_t first[3], size[3];
+  brick_box(h, id, first, size);
+  std::uint64_t k{0};
+  for (std::uint64_t c = 0; c != h.ncomp; ++c) {
+    for (std::uint64_t x = first[0]; x != first[0] + size[0]; ++x) {
+      for (std::uint64_t y = first[1]; y != first[1] + size[1]; ++y) {
+        for (std::uint64_t z = first[2]; z != first[2] + size[2]; ++z) {
+          const std::uint64_t i{((x * h.ny + y) * h.nz + z) * h.nE};
+          for (std::uint64_t e = 0; e != h.nE; ++e) {
+            f(k++, c, i + e);
+          }
+        }
+      }
+    }
+  }
+}
+
+// unsigned integer of value size
+template <std::size_t N> struct word;
+template <> struct word<4> { typedef std::uint32_t type; };
+template <> struct word<8> { typedef std::uint64_t type; };
+
+// XOR of preceding value leaves leading bytes of smooth values zero,
+// bytes are grouped by significance, and zero runs are coded as a
+// zero byte followed by run length less one
+template <typename S>
+void encode_lossless(const S *v, const std::size_t &n, std::vector<char> &out) {
+  typedef typename word<sizeof(S)>::type W;
+  std::vector<unsigned char> planes(n * sizeof(S));
+  W last{0};
+  for (std::size_t i = 0; i != n; ++i) {
+    W w;
+    std::memcpy(&w, v + i, sizeof(S));
+    const W x{static_cast<W>(w ^ last)};
+    last = w;
+    for (std::size_t b = 0; b != sizeof(S); ++b) {
+      planes[b * n + i] = static_cast<unsigned char>(x >> (8 * b));
+    }
+  }
+  for (std::size_t i = 0; i != planes.size();) {
+    if (planes[i] != 0) {
+      out.push_back(static_cast<char>(planes[i++]));
+      continue;
+    }
+    std::size_t run{1};
+    while (run != 256 and i + run != planes.size() and planes[i + run] == 0) {
+      ++run;
+    }
+    out.push_back(0);
+    out.push_back(static_cast<char>(run - 1));
+    i += run;
+  }
+}
+
+template <typename S>
+void decode_lossless(const char *src, const std::size_t &bytes,
+                     const std::size_t &n, S *v) {
+  typedef typename word<sizeof(S)>::type W;
+  std::vector<unsigned char> planes(n * sizeof(S));
+  std::size_t k{0};
+  for (std::size_t i = 0; i != bytes; ++i) {
+    const unsigned char c{static_cast<unsigned char>(src[i])};
+    // zero runs are left as initialized
+    const std::size_t run{
+        c != 0 ? 1
+               : (++i == bytes ? planes.size() + 1
+                               : static_cast<unsigned char>(src[i]) + 1u)};
+    if (k + run > planes.size()) {
+      throw std::runtime_error("corrupt lossless grid brick");
+    }
+    if (c != 0) {
+      planes[k] = c;
+    }
+    k += run;
+  }
+  if (k != planes.size()) {
+    throw std::runtime_error("corrupt lossless grid brick");
+  }
+  W last{0};
+  for (std::size_t i = 0; i != n; ++i) {
+    W x{0};
+    for (std::size_t b = 0; b != sizeof(S); ++b) {
+      x |= static_cast<W>(planes[b * n + i]) << (8 * b);
+    }
+    last ^= x;
+    std::memcpy(v + i, &last, sizeof(S));
+  }
+}
+
+// values rounded to multiples of step, differences of neighbouring
+// multiples as zigzag LEB128 integers
+void encode_lossy(const ham_store *v, const std::size_t &n,
+                  const double &step, std::vector<char> &out) {
+  std::int64_t last{0};
+  for (std::size_t i = 0; i != n; ++i) {
+    const double q{std::round(v[i] / step)};
+    if (not(std::fabs(q) < 4e18)) {
+      throw std::runtime_error("lossy grid codec requires finite values "
+                               "below 4e18 times tolerance");
+    }
+    const std::int64_t k{static_cast<std::int64_t>(q)};
+    const std::int64_t d{k - last};
+    last = k;
+    std::uint64_t z{(static_cast<std::uint64_t>(d) << 1) ^
+                    static_cast<std::uint64_t>(d >> 63)};
+    while (z >= 0x80) {
+      out.push_back(static_cast<char>((z & 0x7f) | 0x80));
+      z >>= 7;
+    }
+    out.push_back(static_cast<char>(z));
+  }
+}
+
+void decode_lossy(const char *src, const std::size_t &bytes,
+                  const std::size_t &n, const double &step, ham_store *v) {
+  std::size_t pos{0};
+  std::int64_t last{0};
+  for (std::size_t i = 0; i != n; ++i) {
+    std::uint64_t z{0};
+    for (unsigned shift = 0;; shift += 7) {
+      if (pos == bytes or shift > 63) {
+        throw std::runtime_error("corrupt lossy grid brick");
+      }
+      const unsigned char c{static_cast<unsigned char>(src[pos++])};
+      z |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+      if ((c & 0x80) == 0) {
+        break;
+      }
+    }
+    last += static_cast<std::int64_t>((z >> 1) ^ (~(z & 1) + 1));
+    v[i] = static_cast<ham_store>(last * step);
+  }
+  if (pos != bytes) {
+    throw std::runtime_error("corrupt lossy grid brick");
+  }
+}
+
+// offset of brick or payload end, relative to payload
+std::uint64_t brick_offset(const char *payload, const std::uint64_t &id) {
+  std::uint64_t offset;
+  std::memcpy(&offset, payload + id * 8, 8);
+  return offset;
+}
+
+// image of header and payload, checksum is filled in
+std::vector<char> seal(hamgrid::header h, std::vector<char> &&image) {
+  h.checksum = hamgrid::checksum(hamgrid::checksum_basis,
+                                 image.data() + h.offset,
+                                 hamgrid::padded(h.bytes));
+  std::memcpy(image.data(), &h, sizeof(hamgrid::header));
+  return std::move(image);
+}
+
+std::string dims(const hamgrid::header &h) {
+  std::string result{std::to_string(h.nx) + "x" + std::to_string(h.ny) +
+                     "x" + std::to_string(h.nz)};
+  if (h.nE > 1) {
+    result += "x" + std::to_string(h.nE);
+  }
+  return result;
+}
+} // namespace
+
+hamgrid::header hamgrid::describe(const std::string &kind, const Param *par) {
+  header h;
+  std::memset(&h, 0, sizeof(header));
+  set_text(h.magic, "HAMGRID");
+  h.version = version;
+  h.endian = endian;
+  set_text(h.kind, kind);
+  set_text(h.dtype, sizeof(ham_store) == sizeof(float) ? "f4" : "f8");
+  set_text(h.layout, "interleaved");
+  set_text(h.codec, "none");
+  h.offset = page;
+  h.nE = 1;
+  // spatial grid limits, size and export codec of given grid parameters
+  auto box = [&h](const auto &g) {
+    h.nx = g.nx;
+    h.ny = g.ny;
+    h.nz = g.nz;
+    h.x_min = g.x_min;
+    h.x_max = g.x_max;
+    h.y_min = g.y_min;
+    h.y_max = g.y_max;
+    h.z_min = g.z_min;
+    h.z_max = g.z_max;
+    if (g.codec != "none") {
+      set_text(h.layout, "brick");
+      set_text(h.codec, g.codec);
+      h.brick = g.brick;
+      h.tolerance = g.codec == "lossy" ? g.tolerance : 0.;
+    }
+  };
+  if (kind == "breg") {
+    box(par->grid_breg);
+    h.ncomp = 3;
+    h.param_hash = par->stage_key.breg;
+  } else if (kind == "brnd") {
+    box(par->grid_brnd);
+    h.ncomp = 3;
+    h.param_hash = par->stage_key.brnd;
+    if (par->grid_brnd.build_permission and
+        not par->grid_brnd.read_permission) {
+      h.seed = par->brnd_seed;
+    }
+  } else if (kind == "tereg") {
+    box(par->grid_tereg);
+    h.ncomp = 1;
+    h.param_hash = par->stage_key.tereg;
+  } else if (kind == "ternd") {
+    box(par->grid_ternd);
+    h.ncomp = 1;
+    h.param_hash = par->stage_key.ternd;
+    if (par->grid_ternd.build_permission and
+        not par->grid_ternd.read_permission) {
+      h.seed = par->ternd_seed;
+    }
+  } else if (kind == "cre") {
+    box(par->grid_cre);
+    h.ncomp = 1;
+    h.nE = par->grid_cre.nE;
+    h.E_min = par->grid_cre.E_min;
+    h.E_max = par->grid_cre.E_max;
+    h.param_hash = par->stage_key.cre;
+  } else {
+    throw std::runtime_error("unsupported grid kind " + kind);
+  }
+  if (not bricked(h)) {
+    h.bytes = count(h) * h.ncomp * itemsize(h);
+  }
+  return h;
+}
+
+hamgrid::header hamgrid::parse(const char *data, const std::size_t &size,
+                               const std::string &filename) {
+  if (size < sizeof(header) or std::memcmp(data, "HAMGRID", 8) != 0) {
+    throw std::runtime_error(filename +
+                             " is no grid file, raw grid files of former "
+                             "releases are converted by hamx_convert");
+  }
+  header h;
+  std::memcpy(&h, data, sizeof(header));
+  if (h.endian != endian) {
+    throw std::runtime_error(filename + " is of foreign byte order");
+  }
+  if (h.version != version) {
+    throw std::runtime_error(filename + " is of unsupported version " +
+                             std::to_string(h.version));
+  }
+  bool valid{(text(h.dtype) == "f4" or text(h.dtype) == "f8") and
+             h.offset >= sizeof(header) and h.offset % page == 0};
+  if (text(h.layout) == "interleaved") {
+    valid = valid and h.brick == 0 and
+            h.bytes == count(h) * h.ncomp * itemsize(h);
+  } else if (text(h.layout) == "brick") {
+    valid = valid and h.brick != 0 and (h.brick & (h.brick - 1)) == 0 and
+            (text(h.codec) == "lossless" or
+             (text(h.codec) == "lossy" and h.tolerance > 0.)) and
+            h.bytes >= (bricks(h) + 1) * 8;
+  } else {
+    valid = false;
+  }
+  if (not valid) {
+    throw std::runtime_error(filename + " has corrupt header");
+  }
+  return h;
+}
+
+void hamgrid::check(const header &found, const header &expected,
+                    const std::string &filename) {
+  if (text(found.kind) != text(expected.kind) or
+      found.ncomp != expected.ncomp) {
+    throw std::runtime_error(filename + " holds " + text(found.kind) +
+                             " grid, expected " + text(expected.kind));
+  }
+  if (found.nx != expected.nx or found.ny != expected.ny or
+      found.nz != expected.nz or found.nE != expected.nE) {
+    throw std::runtime_error(filename + " holds grid of " + dims(found) +
+                             ", expected " + dims(expected));
+  }
+  // limits parsed from the same XML text agree up to rounding
+  const double a[8]{found.x_min, found.x_max, found.y_min, found.y_max,
+                    found.z_min, found.z_max, found.E_min, found.E_max};
+  const double b[8]{expected.x_min, expected.x_max, expected.y_min,
+                    expected.y_max, expected.z_min, expected.z_max,
+                    expected.E_min, expected.E_max};
+  for (int i = 0; i != 8; ++i) {
+    if (std::fabs(a[i] - b[i]) >
+        1e-12 * std::max(std::fabs(a[i]), std::fabs(b[i]))) {
+      throw std::runtime_error(filename + " holds grid of other limits");
+    }
+  }
+}
+
+std::uint64_t hamgrid::checksum(std::uint64_t h, const char *data,
+                                const std::size_t &bytes) {
+  assert(bytes % 8 == 0);
+  for (std::size_t i = 0; i != bytes; i += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    h ^= word;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+std::vector<char>
+hamgrid::pack(header h, const std::vector<const Hamarray<ham_store> *> &list,
+              const Hamlayout &layout) {
+  assert(list.size() == h.ncomp);
+  assert(itemsize(h) == sizeof(ham_store));
+  const ham_uint n{count(h)};
+  const ham_uint ncomp{h.ncomp};
+  if (not bricked(h)) {
+    // zero initialized, for header and payload padding
+    std::vector<char> image(h.offset + padded(h.bytes));
+    ham_store *out{reinterpret_cast<ham_store *>(image.data() + h.offset)};
+    for (ham_uint c = 0; c != ncomp; ++c) {
+      const Hamarray<ham_store> &a{*list[c]};
+      assert(a.size() == layout.size() and layout.size() >= n);
+      for (ham_uint i = 0; i != n; ++i) {
+        out[i * ncomp + c] = a[layout.at(i)];
+      }
+    }
+    return seal(h, std::move(image));
+  }
+  const std::uint64_t nb{bricks(h)};
+  std::vector<std::vector<char>> streams(nb);
+  std::string failure;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (std::uint64_t id = 0; id < nb; ++id) {
+    std::vector<ham_store> values(brick_values(h, id));
+    for_brick(h, id, [&](const std::uint64_t &k, const std::uint64_t &c,
+                         const std::uint64_t &i) {
+      values[k] = (*list[c])[layout.at(i)];
+    });
+    try {
+      if (text(h.codec) == "lossless") {
+        encode_lossless(values.data(), values.size(), streams[id]);
+      } else {
+        encode_lossy(values.data(), values.size(), 2. * h.tolerance,
+                     streams[id]);
+      }
+    } catch (const std::exception &e) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      failure = e.what();
+    }
+  }
+  if (not failure.empty()) {
+    throw std::runtime_error(failure);
+  }
+  // brick offsets, then bricks
+  std::vector<std::uint64_t> table(nb + 1, (nb + 1) * 8);
+  for (std::uint64_t id = 0; id != nb; ++id) {
+    table[id + 1] = table[id] + streams[id].size();
+  }
+  h.bytes = table[nb];
+  std::vector<char> image(h.offset + padded(h.bytes));
+  char *out{image.data() + h.offset};
+  std::memcpy(out, table.data(), table.size() * 8);
+  for (std::uint64_t id = 0; id != nb; ++id) {
+    std::memcpy(out + table[id], streams[id].data(), streams[id].size());
+  }
+  return seal(h, std::move(image));
+}
+
+void hamgrid::check_bricks(const header &h, const char *payload,
+                           const std::string &filename) {
+  const std::uint64_t nb{bricks(h)};
+  std::uint64_t last{(nb + 1) * 8};
+  if (brick_offset(payload, 0) != last or
+      brick_offset(payload, nb) != h.bytes) {
+    throw std::runtime_error(filename + " has corrupt brick offsets");
+  }
+  for (std::uint64_t id = 1; id <= nb; ++id) {
+    const std::uint64_t offset{brick_offset(payload, id)};
+    if (offset < last) {
+      throw std::runtime_error(filename + " has corrupt brick offsets");
+    }
+    last = offset;
+  }
+}
+
+void hamgrid::unpack(const header &h, const char *payload,
+                     const std::uint64_t &id, ham_store *out) {
+  const std::uint64_t begin{brick_offset(payload, id)};
+  const std::uint64_t bytes{brick_offset(payload, id + 1) - begin};
+  const std::uint64_t n{brick_values(h, id)};
+  if (text(h.codec) == "lossy") {
+    decode_lossy(payload + begin, bytes, n, 2. * h.tolerance, out);
+  } else if (itemsize(h) == sizeof(ham_store)) {
+    decode_lossless(payload + begin, bytes, n, out);
+  } else if (itemsize(h) == sizeof(float)) {
+    std::vector<float> values(n);
+    decode_lossless(payload + begin, bytes, n, values.data());
+    std::copy(values.begin(), values.end(), out);
+  } else {
+    std::vector<double> values(n);
+    decode_lossless(payload + begin, bytes, n, values.data());
+    std::copy(values.begin(), values.end(), out);
+  }
+}
+
+void hamgrid::unpack(const header &h, const char *payload,
+                     const std::vector<Hamarray<ham_store> *> &out,
+                     const Hamlayout &layout) {
+  assert(out.size() == h.ncomp);
+  const std::uint64_t nb{bricks(h)};
+  std::string failure;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (std::uint64_t id = 0; id < nb; ++id) {
+    std::vector<ham_store> values(brick_values(h, id));
+    try {
+      unpack(h, payload, id, values.data());
+    } catch (const std::exception &e) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      failure = e.what();
+    }
+    for_brick(h, id, [&](const std::uint64_t &k, const std::uint64_t &c,
+                         const std::uint64_t &i) {
+      (*out[c])[layout.at(i)] = values[k];
+    });
+  }
+  if (not failure.empty()) {
+    throw std::runtime_error(failure);
+  }
+}
+
+// raw files hold ham_float values, kept as they are in interleaved layout
+void hamgrid::convert(const std::string &raw, const std::string &filename,
+                      header h) {
+  if (not bricked(h)) {
+    set_text(h.dtype, "f8");
+    h.bytes = count(h) * h.ncomp * sizeof(ham_float);
+  }
+  const std::uint64_t bytes{count(h) * h.ncomp * sizeof(ham_float)};
+  std::ifstream input(raw.c_str(), std::ios::in | std::ios::binary);
+  if (not input.is_open()) {
+    throw std::runtime_error("cannot open " + raw);
+  }
+  input.seekg(0, input.end);
+  if (static_cast<std::uint64_t>(input.tellg()) != bytes) {
+    throw std::runtime_error("size of " + raw + " mismatches grid of " +
+                             dims(h));
+  }
+  input.seekg(0, input.beg);
+  if (not bricked(h)) {
+    std::vector<char> image(h.offset + padded(h.bytes));
+    if (not input.read(image.data() + h.offset, h.bytes)) {
+      throw std::runtime_error("cannot read " + raw);
+    }
+    image = seal(h, std::move(image));
+    Hamwriter::dump(filename, image.data(), image.size(), false);
+    return;
+  }
+  std::vector<ham_float> values(count(h) * h.ncomp);
+  if (not input.read(reinterpret_cast<char *>(values.data()), bytes)) {
+    throw std::runtime_error("cannot read " + raw);
+  }
+  std::vector<Hamarray<ham_store>> comps;
+  std::vector<const Hamarray<ham_store> *> list;
+  for (std::uint64_t c = 0; c != h.ncomp; ++c) {
+    comps.emplace_back(count(h));
+    for (std::uint64_t i = 0; i != count(h); ++i) {
+      comps.back()[i] = values[i * h.ncomp + c];
+    }
+  }
+  for (const auto &a : comps) {
+    list.push_back(&a);
+  }
+  const std::vector<char> image{
+      pack(h, list, Hamlayout({h.nx, h.ny, h.nz}, "row", h.nE))};
+  Hamwriter::dump(filename, image.data(), image.size(), false);
+}
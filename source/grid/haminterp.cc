@@ -0,0 +1,471 @@
+// trilinear and tricubic interpolation of field grids
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <hamarray.h>
+#include <haminterp.h>
+#include <hamtype.h>
+#include <hamvec.h>
+
+constexpr ham_uint Haminterp::block;
+
+namespace {
+// weights of four vertices around a position
+// 1st argument: distance to second vertex in units of vertex spacing
+// 2nd argument: if cubic B-spline, otherwise Catmull-Rom spline
+// 3rd argument: weights
+void weights(const ham_float &t, const bool &spline, ham_float (&w)[4]) {
+  const ham_float t2{t * t};
+  if (spline) {
+    const ham_float s{1. - t};
+    w[0] = s * s * s / 6.;
+    w[1] = (t2 * (3. * t - 6.) + 4.) / 6.;
+    w[2] = ((3. - 3. * t) * t2 + 3. * t + 1.) / 6.;
+    w[3] = t2 * t / 6.;
+    return;
+  }
+  w[0] = 0.5 * t * ((2. - t) * t - 1.);
+  w[1] = 0.5 * (t2 * (3. * t - 5.) + 2.);
+  w[2] = 0.5 * t * ((4. - 3. * t) * t + 1.);
+  w[3] = 0.5 * t2 * (t - 1.);
+}
+
+// B-spline coefficients of values along lines, in place, by a causal
+// and an anti-causal recursive filter, values are mirrored at both ends,
+// lines are filtered together, so that loops run along neighbours
+// 1st argument: values, value v of line l at c[v * m + l]
+// 2nd argument: number of values per line
+// 3rd argument: number of lines
+void bspline(ham_float *c, const ham_uint &n, const ham_uint &m) {
+  if (n < 2) {
+    return;
+  }
+  // pole of cubic B-spline filter
+  const ham_float z{std::sqrt(3.) - 2.};
+  for (ham_uint k = 0; k < n * m; ++k) {
+    c[k] *= 6.;
+  }
+  // first causal coefficients, terms beyond horizon are negligible
+  const ham_uint horizon{static_cast<ham_uint>(
+      std::ceil(std::log(std::numeric_limits<ham_float>::epsilon()) /
+                std::log(std::fabs(z))))};
+  if (horizon < n) {
+    ham_float zk{z};
+    for (ham_uint k = 1; k < horizon; ++k) {
+      for (ham_uint l = 0; l < m; ++l) {
+        c[l] += zk * c[k * m + l];
+      }
+      zk *= z;
+    }
+  } else {
+    // whole mirrored lines
+    ham_float zk{z};
+    ham_float zm{std::pow(z, n - 1)};
+    for (ham_uint l = 0; l < m; ++l) {
+      c[l] += zm * c[(n - 1) * m + l];
+    }
+    zm *= zm / z;
+    for (ham_uint k = 1; k < n - 1; ++k) {
+      for (ham_uint l = 0; l < m; ++l) {
+        c[l] += (zk + zm) * c[k * m + l];
+      }
+      zk *= z;
+      zm /= z;
+    }
+    for (ham_uint l = 0; l < m; ++l) {
+      c[l] /= 1. - zk * zk;
+    }
+  }
+  for (ham_uint k = 1; k < n; ++k) {
+    for (ham_uint l = 0; l < m; ++l) {
+      c[k * m + l] += z * c[(k - 1) * m + l];
+    }
+  }
+  for (ham_uint l = 0; l < m; ++l) {
+    c[(n - 1) * m + l] =
+        z / (z * z - 1.) * (z * c[(n - 2) * m + l] + c[(n - 1) * m + l]);
+  }
+  for (ham_uint k = n - 1; k-- > 0;) {
+    for (ham_uint l = 0; l < m; ++l) {
+      c[k * m + l] = z * (c[(k + 1) * m + l] - c[k * m + l]);
+    }
+  }
+}
+} // namespace
+
+bool Haminterp::locate(const Hamvec<3, ham_float> &pos, stencil &s) const {
+  const ham_float t[3]{(pos[0] - this->lo[0]) * this->r[0],
+                       (pos[1] - this->lo[1]) * this->r[1],
+                       (pos[2] - this->lo[2]) * this->r[2]};
+  for (unsigned k = 0; k != 3; ++k) {
+    if (t[k] <= 0 or t[k] >= this->n[k] - 1) {
+      return false;
+    }
+  }
+  ham_uint *o[3]{s.x, s.y, s.z};
+  ham_float(*w[3])[4]{&s.wx, &s.wy, &s.wz};
+  for (unsigned k = 0; k != 3; ++k) {
+    const ham_uint *ok{this->layout.offsets(k)};
+    const long last{static_cast<long>(this->n[k]) - 1};
+    const long l{static_cast<long>(std::floor(t[k]))};
+    for (long v = 0; v != 4; ++v) {
+      // vertices beyond box mirrored at surface
+      const long m{std::abs(l - 1 + v)};
+      o[k][v] = ok[m > last ? 2 * last - m : m];
+    }
+    weights(t[k] - l, this->spline, *w[k]);
+  }
+  return true;
+}
+
+ham_float Haminterp::scalar(const Hamvec<3, ham_float> &pos,
+                            const Hamarray<ham_store> &f,
+                            const ham_uint &w) const {
+  assert(w < this->nw);
+  if (this->cubic) {
+    stencil s;
+    if (not this->locate(pos, s)) {
+      return 0.;
+    }
+    return f.chunked() ? this->tricubic(f, 1, s, w)
+                       : this->tricubic(f.data(), f.stride(), s, w);
+  }
+  cell c;
+  if (not this->locate(pos, c)) {
+    return 0.;
+  }
+  if (f.chunked()) {
+    return this->trilinear(f, 1, c.x[0] + w, c.x[1] + w, c.y[0], c.y[1],
+                           c.z[0], c.z[1], c.xd, c.yd, c.zd);
+  }
+  return this->trilinear(f.data(), f.stride(), c.x[0] + w, c.x[1] + w,
+                         c.y[0], c.y[1], c.z[0], c.z[1], c.xd, c.yd, c.zd);
+}
+
+Hamvec<3, ham_float> Haminterp::vector(const Hamvec<3, ham_float> &pos,
+                                       const Hamarray<ham_store> &fx,
+                                       const Hamarray<ham_store> &fy,
+                                       const Hamarray<ham_store> &fz) const {
+  if (this->cubic) {
+    stencil s;
+    if (not this->locate(pos, s)) {
+      return Hamvec<3, ham_float>{0., 0., 0.};
+    }
+    if (fx.chunked()) {
+      return Hamvec<3, ham_float>{this->tricubic(fx, 1, s, 0),
+                                  this->tricubic(fy, 1, s, 0),
+                                  this->tricubic(fz, 1, s, 0)};
+    }
+    return Hamvec<3, ham_float>{
+        this->tricubic(fx.data(), fx.stride(), s, 0),
+        this->tricubic(fy.data(), fy.stride(), s, 0),
+        this->tricubic(fz.data(), fz.stride(), s, 0)};
+  }
+  cell c;
+  if (not this->locate(pos, c)) {
+    return Hamvec<3, ham_float>{0., 0., 0.};
+  }
+  if (fx.chunked()) {
+    return Hamvec<3, ham_float>{
+        this->trilinear(fx, 1, c.x[0], c.x[1], c.y[0], c.y[1], c.z[0],
+                        c.z[1], c.xd, c.yd, c.zd),
+        this->trilinear(fy, 1, c.x[0], c.x[1], c.y[0], c.y[1], c.z[0],
+                        c.z[1], c.xd, c.yd, c.zd),
+        this->trilinear(fz, 1, c.x[0], c.x[1], c.y[0], c.y[1], c.z[0],
+                        c.z[1], c.xd, c.yd, c.zd)};
+  }
+  return Hamvec<3, ham_float>{
+      this->trilinear(fx.data(), fx.stride(), c.x[0], c.x[1], c.y[0], c.y[1],
+                      c.z[0], c.z[1], c.xd, c.yd, c.zd),
+      this->trilinear(fy.data(), fy.stride(), c.x[0], c.x[1], c.y[0], c.y[1],
+                      c.z[0], c.z[1], c.xd, c.yd, c.zd),
+      this->trilinear(fz.data(), fz.stride(), c.x[0], c.x[1], c.y[0], c.y[1],
+                      c.z[0], c.z[1], c.xd, c.yd, c.zd)};
+}
+
+bool Haminterp::interleaved(const Hamarray<ham_store> &fx,
+                            const Hamarray<ham_store> &fy,
+                            const Hamarray<ham_store> &fz) {
+  return not fx.chunked() and fx.stride() >= 3 and
+         fy.stride() == fx.stride() and fz.stride() == fx.stride() and
+         fy.data() == fx.data() + 1 and fz.data() == fx.data() + 2;
+}
+
+void Haminterp::locate(const ham_float *x, const ham_float *y,
+                       const ham_float *z, const ham_uint &m,
+                       cells &c) const {
+  assert(m <= block);
+  const ham_float ux{static_cast<ham_float>(this->n[0] - 1)};
+  const ham_float uy{static_cast<ham_float>(this->n[1] - 1)};
+  const ham_float uz{static_cast<ham_float>(this->n[2] - 1)};
+  const int lx{static_cast<int>(this->n[0] - 2)};
+  const int ly{static_cast<int>(this->n[1] - 2)};
+  const int lz{static_cast<int>(this->n[2] - 2)};
+  const ham_uint *ox{this->layout.offsets(0)};
+  const ham_uint *oy{this->layout.offsets(1)};
+  const ham_uint *oz{this->layout.offsets(2)};
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for (ham_uint i = 0; i < m; ++i) {
+    const ham_float tx{(x[i] - this->lo[0]) * this->r[0]};
+    const ham_float ty{(y[i] - this->lo[1]) * this->r[1]};
+    const ham_float tz{(z[i] - this->lo[2]) * this->r[2]};
+    // bitwise and, short circuit would branch
+    c.in[i] = (tx > 0) & (tx < ux) & (ty > 0) & (ty < uy) & (tz > 0) &
+              (tz < uz);
+    // clamped rather than selected, selecting on comparisons of
+    // floating point values keeps loops from vectorization, inner
+    // positions are left unchanged, outer ones get a valid cell
+    const ham_float cx{std::min(ux, std::max(0., tx))};
+    const ham_float cy{std::min(uy, std::max(0., ty))};
+    const ham_float cz{std::min(uz, std::max(0., tz))};
+    // truncation is floor of positive values, vertex numbers per
+    // direction fit into int, which converts in vector registers
+    const int xl{std::min(lx, static_cast<int>(cx))};
+    const int yl{std::min(ly, static_cast<int>(cy))};
+    const int zl{std::min(lz, static_cast<int>(cz))};
+    c.x0[i] = ox[xl];
+    c.x1[i] = ox[xl + 1];
+    c.y0[i] = oy[yl];
+    c.y1[i] = oy[yl + 1];
+    c.z0[i] = oz[zl];
+    c.z1[i] = oz[zl + 1];
+    c.xd[i] = cx - xl;
+    c.yd[i] = cy - yl;
+    c.zd[i] = cz - zl;
+  }
+}
+
+void Haminterp::scalar(const ham_float *x, const ham_float *y,
+                       const ham_float *z, const ham_uint &n,
+                       const Hamarray<ham_store> &f, ham_float *out) const {
+  // a flat grid has no inner positions, and no valid first cell
+  if (this->n[0] < 2 or this->n[1] < 2 or this->n[2] < 2) {
+    std::fill(out, out + n, 0.);
+    return;
+  }
+  if (this->cubic) {
+    for (ham_uint i = 0; i < n; ++i) {
+      out[i] = this->scalar(Hamvec<3, ham_float>{x[i], y[i], z[i]}, f);
+    }
+    return;
+  }
+  cells c;
+  const ham_store *p{f.data()};
+  const ham_uint st{f.stride()};
+  for (ham_uint begin = 0; begin < n; begin += block) {
+    const ham_uint m{std::min(block, n - begin)};
+    this->locate(x + begin, y + begin, z + begin, m, c);
+    ham_float *o{out + begin};
+    if (f.chunked()) {
+      // decoding bricks of outside positions is avoided
+      for (ham_uint i = 0; i < m; ++i) {
+        o[i] = c.in[i] ? this->trilinear(f, 1, c.x0[i], c.x1[i], c.y0[i],
+                                         c.y1[i], c.z0[i], c.z1[i], c.xd[i],
+                                         c.yd[i], c.zd[i])
+                       : 0.;
+      }
+      continue;
+    }
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (ham_uint i = 0; i < m; ++i) {
+      o[i] = this->trilinear(p, st, c.x0[i], c.x1[i], c.y0[i], c.y1[i],
+                             c.z0[i], c.z1[i], c.xd[i], c.yd[i], c.zd[i]);
+    }
+    // zeroed apart from gathers, a select among them would keep
+    // loads from being vectorized
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (ham_uint i = 0; i < m; ++i) {
+      o[i] = c.in[i] ? o[i] : 0.;
+    }
+  }
+}
+
+void Haminterp::vector(const ham_float *x, const ham_float *y,
+                       const ham_float *z, const ham_uint &n,
+                       const Hamarray<ham_store> &fx,
+                       const Hamarray<ham_store> &fy,
+                       const Hamarray<ham_store> &fz, ham_float *ox,
+                       ham_float *oy, ham_float *oz) const {
+  if (not interleaved(fx, fy, fz)) {
+    this->scalar(x, y, z, n, fx, ox);
+    this->scalar(x, y, z, n, fy, oy);
+    this->scalar(x, y, z, n, fz, oz);
+    return;
+  }
+  if (this->n[0] < 2 or this->n[1] < 2 or this->n[2] < 2) {
+    std::fill(ox, ox + n, 0.);
+    std::fill(oy, oy + n, 0.);
+    std::fill(oz, oz + n, 0.);
+    return;
+  }
+  if (this->cubic) {
+    for (ham_uint i = 0; i < n; ++i) {
+      const Hamvec<3, ham_float> v{
+          this->vector(Hamvec<3, ham_float>{x[i], y[i], z[i]}, fx, fy, fz)};
+      ox[i] = v[0];
+      oy[i] = v[1];
+      oz[i] = v[2];
+    }
+    return;
+  }
+  cells c;
+  // components of a vertex are neighbours in memory
+  const ham_store *p{fx.data()};
+  const ham_uint st{fx.stride()};
+  for (ham_uint begin = 0; begin < n; begin += block) {
+    const ham_uint m{std::min(block, n - begin)};
+    this->locate(x + begin, y + begin, z + begin, m, c);
+    ham_float *vx{ox + begin}, *vy{oy + begin}, *vz{oz + begin};
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (ham_uint i = 0; i < m; ++i) {
+      vx[i] = this->trilinear(p, st, c.x0[i], c.x1[i], c.y0[i], c.y1[i],
+                              c.z0[i], c.z1[i], c.xd[i], c.yd[i], c.zd[i]);
+      vy[i] = this->trilinear(p + 1, st, c.x0[i], c.x1[i], c.y0[i], c.y1[i],
+                              c.z0[i], c.z1[i], c.xd[i], c.yd[i], c.zd[i]);
+      vz[i] = this->trilinear(p + 2, st, c.x0[i], c.x1[i], c.y0[i], c.y1[i],
+                              c.z0[i], c.z1[i], c.xd[i], c.yd[i], c.zd[i]);
+    }
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (ham_uint i = 0; i < m; ++i) {
+      vx[i] = c.in[i] ? vx[i] : 0.;
+      vy[i] = c.in[i] ? vy[i] : 0.;
+      vz[i] = c.in[i] ? vz[i] : 0.;
+    }
+  }
+}
+
+void Haminterp::spectral(const ham_float *x, const ham_float *y,
+                         const ham_float *z, const ham_uint &n,
+                         const Hamarray<ham_store> &f, ham_float *out) const {
+  const ham_uint nw{this->nw};
+  if (this->n[0] < 2 or this->n[1] < 2 or this->n[2] < 2) {
+    std::fill(out, out + n * nw, 0.);
+    return;
+  }
+  if (this->cubic) {
+    stencil s;
+    for (ham_uint i = 0; i < n; ++i) {
+      ham_float *o{out + i * nw};
+      if (not this->locate(Hamvec<3, ham_float>{x[i], y[i], z[i]}, s)) {
+        std::fill(o, o + nw, 0.);
+        continue;
+      }
+      for (ham_uint e = 0; e < nw; ++e) {
+        o[e] = f.chunked() ? this->tricubic(f, 1, s, e)
+                           : this->tricubic(f.data(), f.stride(), s, e);
+      }
+    }
+    return;
+  }
+  cells c;
+  const ham_store *p{f.data()};
+  const ham_uint st{f.stride()};
+  for (ham_uint begin = 0; begin < n; begin += block) {
+    const ham_uint m{std::min(block, n - begin)};
+    this->locate(x + begin, y + begin, z + begin, m, c);
+    for (ham_uint i = 0; i < m; ++i) {
+      ham_float *o{out + (begin + i) * nw};
+      if (not c.in[i]) {
+        std::fill(o, o + nw, 0.);
+        continue;
+      }
+      if (f.chunked()) {
+        for (ham_uint e = 0; e < nw; ++e) {
+          o[e] = this->trilinear(f, 1, c.x0[i] + e, c.x1[i] + e, c.y0[i],
+                                 c.y1[i], c.z0[i], c.z1[i], c.xd[i], c.yd[i],
+                                 c.zd[i]);
+        }
+        continue;
+      }
+      // values of a vertex are contiguous, weights are shared
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for (ham_uint e = 0; e < nw; ++e) {
+        o[e] = this->trilinear(p, st, c.x0[i] + e, c.x1[i] + e, c.y0[i],
+                               c.y1[i], c.z0[i], c.z1[i], c.xd[i], c.yd[i],
+                               c.zd[i]);
+      }
+    }
+  }
+}
+
+void Haminterp::prefilter(
+    const std::vector<Hamarray<ham_store> *> &list) const {
+  if (not this->spline) {
+    return;
+  }
+  for (auto a : list) {
+    if (a->mapped()) {
+      // views are of row-major order
+      const Hamarray<ham_store> &view{*a};
+      Hamarray<ham_store> own(this->layout.size());
+      for (ham_uint k = 0; k < view.size(); ++k) {
+        own[k] = view[k];
+      }
+      *a = std::move(own);
+    }
+  }
+  // lines of vertices in each direction in turn, the filter is separable,
+  // lines neighbouring in the direction of higher index share cache
+  // lines in any memory order, and are filtered together
+  const ham_uint lanes{8};
+  for (unsigned d = 0; d != 3; ++d) {
+    const unsigned da{d == 0 ? 1u : 0u}, db{d == 2 ? 1u : 2u};
+    const ham_uint *o{this->layout.offsets(d)};
+    const ham_uint *oa{this->layout.offsets(da)};
+    const ham_uint *ob{this->layout.offsets(db)};
+    const ham_uint nd{this->n[d]}, nb{this->n[db]};
+    const ham_uint groups{(nb + lanes - 1) / lanes};
+    const ham_uint total{this->n[da] * groups};
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+      std::vector<ham_float> c(nd * lanes);
+#ifdef _OPENMP
+#pragma omp for
+#endif
+      for (ham_uint q = 0; q < total; ++q) {
+        const ham_uint a{q / groups}, b{q % groups * lanes};
+        const ham_uint m{std::min(lanes, nb - b)};
+        for (auto arr : list) {
+          Hamarray<ham_store> &f{*arr};
+          // grids without values are left as they are
+          if (not f) {
+            continue;
+          }
+          for (ham_uint w = 0; w != this->nw; ++w) {
+            for (ham_uint v = 0; v != nd; ++v) {
+              for (ham_uint l = 0; l != m; ++l) {
+                c[v * m + l] = f[oa[a] + ob[b + l] + o[v] + w];
+              }
+            }
+            bspline(c.data(), nd, m);
+            for (ham_uint v = 0; v != nd; ++v) {
+              for (ham_uint l = 0; l != m; ++l) {
+                f[oa[a] + ob[b + l] + o[v] + w] = c[v * m + l];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
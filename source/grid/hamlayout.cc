@@ -0,0 +1,60 @@
+// memory order of field grid values
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <hamlayout.h>
+#include <hamtype.h>
+
+constexpr ham_uint Hamlayout::edge;
+
+namespace {
+// bits of vertex index within brick, spread to every 3rd bit
+ham_uint spread(const ham_uint &v) {
+  ham_uint result{0};
+  for (ham_uint b = 0; (ham_uint(1) << b) < Hamlayout::edge; ++b) {
+    result |= ((v >> b) & 1) << (3 * b);
+  }
+  return result;
+}
+} // namespace
+
+Hamlayout::Hamlayout(const ham_uint (&cells)[3], const std::string &order,
+                     const ham_uint &nw)
+    : n{cells[0], cells[1], cells[2]}, nw{nw}, linear{order == "row"} {
+  if (this->linear) {
+    const ham_uint s[3]{cells[1] * cells[2] * nw, cells[2] * nw, nw};
+    for (unsigned d = 0; d != 3; ++d) {
+      this->t[d].resize(cells[d]);
+      for (ham_uint v = 0; v != cells[d]; ++v) {
+        this->t[d][v] = v * s[d];
+      }
+    }
+    this->length = cells[0] * cells[1] * cells[2] * nw;
+    return;
+  }
+  if (order != "brick" and order != "morton") {
+    throw std::runtime_error("unsupported grid order " + order);
+  }
+  // bricks in x, y and z direction, partial bricks are padded
+  ham_uint nb[3];
+  for (unsigned d = 0; d != 3; ++d) {
+    nb[d] = (cells[d] + edge - 1) / edge;
+  }
+  const ham_uint volume{edge * edge * edge * nw};
+  // distance between bricks, and between vertices within brick
+  const ham_uint sb[3]{nb[1] * nb[2] * volume, nb[2] * volume, volume};
+  const ham_uint sv[3]{edge * edge * nw, edge * nw, nw};
+  for (unsigned d = 0; d != 3; ++d) {
+    this->t[d].resize(cells[d]);
+    for (ham_uint v = 0; v != cells[d]; ++v) {
+      const ham_uint inner{v % edge};
+      // Z-order interleaves bits of x, y and z, x most significant
+      this->t[d][v] = v / edge * sb[d] + (order == "morton"
+                                              ? (spread(inner) << (2 - d)) * nw
+                                              : inner * sv[d]);
+    }
+  }
+  this->length = nb[0] * nb[1] * nb[2] * volume;
+}
@@ -0,0 +1,120 @@
+// background writer of binary output files
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <hamwriter.h>
+
+Hamwriter::Hamwriter(const std::size_t &limit) : limit{limit} {
+  worker = std::thread(&Hamwriter::run, this);
+}
+
+Hamwriter::~Hamwriter() {
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [this] { return queue.empty() and not busy; });
+    stop = true;
+  }
+  todo.notify_all();
+  worker.join();
+  if (not failure.empty()) {
+    std::cerr << "file output failed: " << failure << std::endl;
+  }
+}
+
+void Hamwriter::write(const std::string &name, std::vector<char> &&data,
+                      const bool &sync) {
+  const std::size_t bytes{data.size()};
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [this, &bytes] {
+      return queue.empty() or queued + bytes <= limit;
+    });
+    queue.push_back(job{name, std::move(data), sync});
+    queued += bytes;
+  }
+  todo.notify_one();
+}
+
+void Hamwriter::wait() {
+  std::unique_lock<std::mutex> guard(lock);
+  done.wait(guard, [this] { return queue.empty() and not busy; });
+  if (not failure.empty()) {
+    const std::string msg{failure};
+    failure.clear();
+    throw std::runtime_error(msg);
+  }
+}
+
+void Hamwriter::run() {
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    todo.wait(guard, [this] { return stop or not queue.empty(); });
+    if (queue.empty()) {
+      return;
+    }
+    job next{std::move(queue.front())};
+    queue.pop_front();
+    busy = true;
+    guard.unlock();
+    std::string msg;
+    try {
+      dump(next.name, next.data.data(), next.data.size(), next.sync);
+    } catch (const std::exception &e) {
+      msg = e.what();
+    }
+    const std::size_t bytes{next.data.size()};
+    // release image before reporting, submitters wait for memory
+    next.data = std::vector<char>();
+    guard.lock();
+    busy = false;
+    queued -= bytes;
+    if (failure.empty()) {
+      failure = msg;
+    }
+    done.notify_all();
+  }
+}
+
+void Hamwriter::dump(const std::string &name, const void *data,
+                     const std::size_t &bytes, const bool &sync) {
+  const int fd{::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)};
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + name + ": " +
+                             std::string(std::strerror(errno)));
+  }
+  const char *ptr{static_cast<const char *>(data)};
+  std::size_t left{bytes};
+  while (left > 0) {
+    // single write call is limited below 2 GiB on some systems
+    const ssize_t n{::write(fd, ptr, std::min(left, std::size_t(1) << 30))};
+    if (n < 0 and errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      const std::string msg{std::strerror(errno)};
+      ::close(fd);
+      throw std::runtime_error("cannot write " + name + ": " + msg);
+    }
+    ptr += n;
+    left -= n;
+  }
+  const bool flushed{not sync or ::fsync(fd) == 0};
+  const int err{errno};
+  if (::close(fd) != 0 or not flushed) {
+    throw std::runtime_error("cannot write " + name + ": " +
+                             std::string(std::strerror(flushed ? errno : err)));
+  }
+}
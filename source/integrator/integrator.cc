@@ -1,24 +1,27 @@
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <omp.h>
 #include <vector>
 
 #include <gsl/gsl_sf_gamma.h>
-#include <gsl/gsl_sf_synchrotron.h>
 
 #include <bfield.h>
 #include <crefield.h>
 #include <grid.h>
 #include <hamdis.h>
+#include <hammpi.h>
 #include <hamp.h>
 #include <hamtype.h>
 #include <hamunits.h>
 #include <hamvec.h>
 #include <integrator.h>
 #include <param.h>
+#include <profiler.h>
+#include <raycache.h>
 #include <tefield.h>
-#include <timer.h>
 
 void Integrator::write_grid(const Breg *breg, const Brnd *brnd,
                             const TEreg *tereg, const TErnd *ternd,
@@ -26,208 +29,1063 @@ void Integrator::write_grid(const Breg *breg, const Brnd *brnd,
                             const Grid_brnd *gbrnd, const Grid_tereg *gtereg,
                             const Grid_ternd *gternd, const Grid_cre *gcre,
                             Grid_obs *gobs, const Param *par) const {
-  auto shell_ref = std::make_unique<struct_shell>();
-  // loop through shells
-  for (decltype(par->grid_obs.total_shell) current_shell = 0;
-       current_shell != par->grid_obs.total_shell; ++current_shell) {
-    // get current shell nside & npix
-    const ham_uint current_nside{par->grid_obs.nside_shell[current_shell]};
-    const ham_uint current_npix{12 * current_nside * current_nside};
-    // get current mask
+  write_grid(breg, brnd, tereg, ternd, cre, gbreg, gbrnd, gtereg, gternd, gcre,
+             std::vector<Grid_obs *>{gobs}, std::vector<const Param *>{par});
+}
+
+// maps of each parameter class object are kept and composed apart,
+// shifted parameters share LoS samples, random fields and mask of the base
+void Integrator::write_grid(const Breg *breg, const Brnd *brnd,
+                            const TEreg *tereg, const TErnd *ternd,
+                            const CREfield *cre, const Grid_breg *gbreg,
+                            const Grid_brnd *gbrnd, const Grid_tereg *gtereg,
+                            const Grid_ternd *gternd, const Grid_cre *gcre,
+                            const std::vector<Grid_obs *> &gobs_list,
+                            const std::vector<const Param *> &par_list) const {
+  assert(gobs_list.size() == par_list.size());
+  Grid_obs *gobs{gobs_list.front()};
+  const Param *par{par_list.front()};
+  const ham_uint nvar{static_cast<ham_uint>(par_list.size())};
+  if (not(par->grid_obs.do_dm or par->grid_obs.do_fd or
+          par->grid_obs.do_sync)) {
+    return;
+  }
+  const ham_uint nshell{par->grid_obs.total_shell};
+  // MPI ranks share pixels of each shell
+  const ham_uint rank{hammpi::rank()};
+  const ham_uint nrank{hammpi::size()};
+  // synchrotron channel constants are shared by all shells
+  auto sync_ref = std::make_unique<struct_sync>();
+  assemble_sync_ref(sync_ref.get(), par);
+  // shells are integrated independently, without Faraday rotation
+  // from inner shells, their maps are kept until composition
+  std::vector<std::unique_ptr<struct_shell>> shell_refs;
+  // shell maps of each parameter class object
+  std::vector<std::vector<std::unique_ptr<struct_shell_maps>>> var_maps(nvar);
+  std::vector<std::unique_ptr<struct_shell_maps>> &shell_maps{var_maps[0]};
+  for (ham_uint s = 0; s != nshell; ++s) {
+    const ham_uint nside{par->grid_obs.nside_shell[s]};
     if (par->grid_obs.do_mask) {
-      gobs->mask_map->duplicate(current_nside);
+      gobs->mask_map->duplicate(nside);
+    }
+    shell_refs.push_back(std::make_unique<struct_shell>());
+    assemble_shell_ref(shell_refs.back().get(), par, s);
+    for (ham_uint v = 0; v != nvar; ++v) {
+      var_maps[v].push_back(std::make_unique<struct_shell_maps>());
+      assemble_shell_maps(var_maps[v].back().get(), nside, sync_ref.get(),
+                          par);
+    }
+  }
+  if (par->grid_obs.do_refine) {
+    assert(nvar == 1);
+    for (ham_uint s = 0; s != nshell; ++s) {
+      HAM_PROFILE_STAGE("integrator/shell");
+      refine_shell(par->grid_obs.nside_shell[s], shell_refs[s].get(),
+                   sync_ref.get(), breg, brnd, tereg, ternd, cre, gbreg, gbrnd,
+                   gtereg, gternd, gcre, gobs, shell_maps[s].get(), par);
+    }
+  } else {
+    // pixels are visited in RING order by default
+    // or in NESTED-order tiles, each tile as one chunk of work
+    std::vector<std::vector<ham_uint>> order(nshell);
+    std::vector<ham_uint> chunk(nshell, 1);
+    for (ham_uint s = 0; s != nshell; ++s) {
+      const Hampix<ham_float> &grid{shell_maps[s]->grid()};
+      if (par->grid_obs.do_nested) {
+        traversal_order(&order[s], grid);
+        const ham_uint tile{grid.nside() / par->grid_obs.nside_tile};
+        chunk[s] = std::max(tile * tile, static_cast<ham_uint>(1));
+      }
+      // cache slices are laid out at first visit of shell
+      if (this->cache != nullptr) {
+        if (not this->cache->ready(s, grid.npix())) {
+          std::vector<ham_uint> counts;
+          cache_counts(shell_refs[s].get(), grid, order[s], chunk[s], par,
+                       &counts);
+          this->cache->layout(s, counts);
+        }
+        shell_refs[s]->cached = true;
+      }
+    }
+    // chunks of all shells form one loop, larger shells first,
+    // so that small inner shells fill in idle threads at its end
+    std::vector<ham_uint> queue(nshell);
+    for (ham_uint s = 0; s != nshell; ++s) {
+      queue[s] = s;
+    }
+    std::stable_sort(queue.begin(), queue.end(),
+                     [&par](const ham_uint &a, const ham_uint &b) {
+                       return par->grid_obs.nside_shell[a] >
+                              par->grid_obs.nside_shell[b];
+                     });
+    // index of first chunk of each queued shell, with total as last entry
+    std::vector<ham_uint> first(nshell + 1, 0);
+    for (ham_uint q = 0; q != nshell; ++q) {
+      const ham_uint npix{shell_maps[queue[q]]->grid().npix()};
+      first[q + 1] = first[q] + (npix + chunk[queue[q]] - 1) / chunk[queue[q]];
     }
-    // prepare temporary maps for current shell
-    if (par->grid_obs.do_dm) {
-      gobs->tmp_dm_map->reset(current_nside);
-    }
-    if (par->grid_obs.do_sync.back()) {
-      gobs->tmp_is_map->reset(current_nside);
-      gobs->tmp_qs_map->reset(current_nside);
-      gobs->tmp_us_map->reset(current_nside);
-    }
-    if (par->grid_obs.do_fd or par->grid_obs.do_sync.back()) {
-      gobs->tmp_fd_map->reset(current_nside);
-    }
-    // setting for radial_integration
-    // call auxiliary function assemble_shell_ref
-    assemble_shell_ref(shell_ref.get(), par, current_shell);
-#ifndef NTIMING
-    auto tmr = std::make_unique<Timer>();
-    tmr->start("pix");
-#endif
 #ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic)
+#pragma omp parallel
 #endif
-    for (ham_uint ipix = 0; ipix < current_npix; ++ipix) {
+    {
+      HAM_PROFILE_STAGE("integrator/pixels");
+      // per-thread observable holder
       auto observables = std::make_unique<struct_observables>();
-      observables->is = 0.;
-      observables->qs = 0.;
-      observables->us = 0.;
-      observables->dm = 0.;
-      // check pixel masking
-      if ((not par->grid_obs.do_mask) or
-          gobs->mask_map->data(current_nside, ipix) == 1.0) {
-        // remember to complete logic for ptg assignment!
-        // and for caching Faraday depth and/or optical depth
-        // make serious tests after changing this part!
-        Hamp ptg;
-        if (par->grid_obs.do_dm) {
-          ptg = gobs->tmp_dm_map->pointing(ipix);
+      observables->is.resize(sync_ref->channels);
+      observables->qs.resize(sync_ref->channels);
+      observables->us.resize(sync_ref->channels);
+      // per-thread field samples along LoS
+      auto ray = std::make_unique<struct_ray>();
+      auto shifted = std::make_unique<struct_ray>();
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+      for (ham_uint iunit = 0; iunit < first.back(); ++iunit) {
+        const ham_uint q = std::upper_bound(first.begin(), first.end(), iunit) -
+                           first.begin() - 1;
+        const ham_uint s{queue[q]};
+        // chunks of work are dealt to MPI ranks in turn, per shell
+        const ham_uint k{iunit - first[q]};
+        if (k % nrank != rank) {
+          continue;
         }
-        if (par->grid_obs.do_fd) {
-          ptg = gobs->tmp_fd_map->pointing(ipix);
-          // cache Faraday rotation from inner shells
-          observables->fd = gobs->fd_map->interpolate(ptg);
-        } else if (par->grid_obs.do_sync.back()) {
-          ptg = gobs->tmp_is_map->pointing(ipix);
-          // cache Faraday rotation from inner shells
-          observables->fd = gobs->fd_map->interpolate(ptg);
+        struct_shell_maps *maps{shell_maps[s].get()};
+        const Hampix<ham_float> &grid{maps->grid()};
+        const ham_uint end{std::min((k + 1) * chunk[s], grid.npix())};
+        for (ham_uint iwork = k * chunk[s]; iwork != end; ++iwork) {
+          // results are always stored at RING index
+          const ham_uint ipix{order[s].empty() ? iwork : order[s][iwork]};
+          std::fill(observables->is.begin(), observables->is.end(), 0.);
+          std::fill(observables->qs.begin(), observables->qs.end(), 0.);
+          std::fill(observables->us.begin(), observables->us.end(), 0.);
+          observables->dm = 0.;
+          // Faraday rotation from inner shells is applied at composition
+          observables->fd = 0.;
+          // check pixel masking
+          const bool active{(not par->grid_obs.do_mask) or
+                            gobs->mask_map->data(grid.nside(), ipix) == 1.0};
+          if (active) {
+            // core function!
+            radial_integration(shell_refs[s].get(), sync_ref.get(),
+                               grid.pointing(ipix), ipix, observables.get(),
+                               ray.get(), breg, brnd, tereg, ternd, cre, gbreg,
+                               gbrnd, gtereg, gternd, gcre, par);
+          }
+          // collect from pixels
+          store_observables(ipix, observables.get(), sync_ref.get(), maps,
+                            par);
+          // masked pixels stay zero for all parameters
+          for (ham_uint v = 1; v < nvar; ++v) {
+            if (active) {
+              shifted_integration(shell_refs[s].get(), sync_ref.get(),
+                                  grid.pointing(ipix), ray.get(),
+                                  observables.get(), shifted.get(), breg,
+                                  tereg, cre, gbreg, gtereg, gcre,
+                                  par_list[v]);
+            }
+            store_observables(ipix, observables.get(), sync_ref.get(),
+                              var_maps[v][s].get(), par_list[v]);
+          }
         }
-        // core function!
-#ifndef NTIMING
-        tmr->start("kernel");
-#endif
-        radial_integration(shell_ref.get(), ptg, observables.get(), breg, brnd,
-                           tereg, ternd, cre, gbreg, gbrnd, gtereg, gternd,
-                           gcre, par);
-#ifndef NTIMING
-        tmr->start("kernel");
+      }
+    }
+    // pixels of other ranks are zero in local shell maps
+    for (auto &var : var_maps) {
+      for (auto &maps : var) {
+        std::vector<Hampix<ham_float> *> list;
+        maps->collect(&list);
+        reduce_maps(list);
+      }
+    }
+  }
+  for (ham_uint v = 0; v != nvar; ++v) {
+    compose_shells(&var_maps[v], sync_ref.get(), gobs_list[v], par_list[v]);
+  }
+}
+
+void Integrator::assemble_shell_maps(struct_shell_maps *maps,
+                                     const ham_uint &nside,
+                                     const struct_sync *sync_ref,
+                                     const Param *par) const {
+  if (par->grid_obs.do_dm) {
+    maps->dm = std::make_unique<Hampix<ham_float>>(nside);
+  }
+  if (par->grid_obs.do_sync) {
+    for (decltype(sync_ref->channels) c = 0; c != sync_ref->channels; ++c) {
+      maps->is.push_back(std::make_unique<Hampix<ham_float>>(nside));
+      maps->qs.push_back(std::make_unique<Hampix<ham_float>>(nside));
+      maps->us.push_back(std::make_unique<Hampix<ham_float>>(nside));
+    }
+  }
+  if (par->grid_obs.do_fd or par->grid_obs.do_sync) {
+    maps->fd = std::make_unique<Hampix<ham_float>>(nside);
+  }
+}
+
+// shells are composed from inside out, Q/U of each shell are rotated
+// by Faraday depth of inner shells, interpolated at its pixels exactly
+// as inner Faraday depth used to be read before integrating the shell,
+// while emission and Faraday depth of the shell itself are unaffected
+void Integrator::compose_shells(
+    std::vector<std::unique_ptr<struct_shell_maps>> *shell_maps,
+    const struct_sync *sync_ref, Grid_obs *gobs, const Param *par) const {
+  HAM_PROFILE_STAGE("integrator/compose");
+  for (auto &maps : *shell_maps) {
+    if (par->grid_obs.do_sync) {
+      const Hampix<ham_float> &grid{*(maps->fd)};
+#ifdef _OPENMP
+#pragma omp parallel for
 #endif
+      for (ham_uint ipix = 0; ipix < grid.npix(); ++ipix) {
+        const ham_float inner_fd{
+            gobs->fd_map->interpolate(grid.pointing(ipix))};
+        for (decltype(sync_ref->channels) c = 0; c != sync_ref->channels;
+             ++c) {
+          const ham_float angle{2. * inner_fd * sync_ref->lambda_square[c]};
+          const ham_float q{maps->qs[c]->data(ipix)};
+          const ham_float u{maps->us[c]->data(ipix)};
+          maps->qs[c]->data(ipix, std::cos(angle) * q - std::sin(angle) * u);
+          maps->us[c]->data(ipix, std::sin(angle) * q + std::cos(angle) * u);
+        }
       }
-      // collect from pixels
-      if (par->grid_obs.do_dm) {
-        gobs->tmp_dm_map->data(ipix, observables->dm);
+    }
+    // accumulating new shell map to sim map
+    if (par->grid_obs.do_dm) {
+      gobs->dm_map->accumulate(*(maps->dm));
+    }
+    if (par->grid_obs.do_sync) {
+      for (decltype(sync_ref->channels) c = 0; c != sync_ref->channels; ++c) {
+        gobs->is_map[c]->accumulate(*(maps->is[c]));
+        gobs->qs_map[c]->accumulate(*(maps->qs[c]));
+        gobs->us_map[c]->accumulate(*(maps->us[c]));
       }
-      if (par->grid_obs.do_sync.back()) {
-        gobs->tmp_is_map->data(
-            ipix,
-            temp_convert(observables->is, par->grid_obs.sim_sync_freq.back()));
-        gobs->tmp_qs_map->data(
-            ipix,
-            temp_convert(observables->qs, par->grid_obs.sim_sync_freq.back()));
-        gobs->tmp_us_map->data(
-            ipix,
-            temp_convert(observables->us, par->grid_obs.sim_sync_freq.back()));
+    }
+    // Faraday depth is also cached for outer shell synchrotron emission
+    if (par->grid_obs.do_fd or par->grid_obs.do_sync) {
+      gobs->fd_map->accumulate(*(maps->fd));
+    }
+    // shell maps are released once composed
+    maps.reset();
+  }
+}
+
+void Integrator::store_observables(const ham_uint &ipix,
+                                   const struct_observables *observables,
+                                   const struct_sync *sync_ref,
+                                   struct_shell_maps *maps,
+                                   const Param *par) const {
+  HAM_PROFILE("integrator/map write");
+  if (par->grid_obs.do_dm) {
+    maps->dm->data(ipix, observables->dm);
+  }
+  if (par->grid_obs.do_sync) {
+    for (decltype(sync_ref->channels) c = 0; c != sync_ref->channels; ++c) {
+      maps->is[c]->data(ipix,
+                        temp_convert(observables->is[c], sync_ref->freq[c]));
+      maps->qs[c]->data(ipix,
+                        temp_convert(observables->qs[c], sync_ref->freq[c]));
+      maps->us[c]->data(ipix,
+                        temp_convert(observables->us[c], sync_ref->freq[c]));
+    }
+  }
+  if (par->grid_obs.do_fd or par->grid_obs.do_sync) {
+    maps->fd->data(ipix, observables->fd);
+  }
+}
+
+// level maps hold dm, fd, and I/Q/U per channel in brightness
+// a pixel is refined if any observable is mispredicted by bilinear
+// interpolation of the parent level by more than tolerance times the
+// RMS of parent level map, Q and U are compared with RMS of PI
+void Integrator::refine_shell(
+    const ham_uint &nside, const struct_shell *shell_ref,
+    const struct_sync *sync_ref, const Breg *breg, const Brnd *brnd,
+    const TEreg *tereg, const TErnd *ternd, const CREfield *cre,
+    const Grid_breg *gbreg, const Grid_brnd *gbrnd, const Grid_tereg *gtereg,
+    const Grid_ternd *gternd, const Grid_cre *gcre, const Grid_obs *gobs,
+    struct_shell_maps *maps, const Param *par) const {
+  const ham_uint channels{sync_ref->channels};
+  const ham_uint nmaps{2 + 3 * channels};
+  // pixels are integrated by MPI ranks in turn,
+  // predicted pixels are filled by rank 0 only
+  const ham_uint rank{hammpi::rank()};
+  const ham_uint nrank{hammpi::size()};
+  std::vector<std::unique_ptr<Hampix<ham_float>>> parent, child;
+  // pixels whose children are to be integrated
+  std::vector<char> refine;
+  // refinement threshold per map, negative for unchecked observables
+  std::vector<ham_float> limit(nmaps, -1.);
+  ham_uint level_nside{std::min(par->grid_obs.nside_refine, nside)};
+  for (;; level_nside *= 2) {
+    HAM_PROFILE_STAGE("integrator/refine level");
+    const bool coarsest{parent.empty()};
+    child.clear();
+    for (ham_uint k = 0; k != nmaps; ++k) {
+      child.push_back(std::make_unique<Hampix<ham_float>>(level_nside));
+    }
+    const ham_uint level_npix{child[0]->npix()};
+    std::vector<char> child_refine(level_npix, 0);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+      auto observables = std::make_unique<struct_observables>();
+      observables->is.resize(channels);
+      observables->qs.resize(channels);
+      observables->us.resize(channels);
+      auto ray = std::make_unique<struct_ray>();
+      std::vector<ham_float> value(nmaps), prediction(nmaps);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+      for (ham_uint ipix = 0; ipix < level_npix; ++ipix) {
+        const Hamp ptg{child[0]->pointing(ipix)};
+        bool integrate{coarsest};
+        if (not coarsest) {
+          ham_int ix, iy, face;
+          child[0]->rpixxyf(ipix, ix, iy, face);
+          integrate = refine[parent[0]->xyfrpix(ix >> 1, iy >> 1, face)];
+          for (ham_uint k = 0; k != nmaps; ++k) {
+            prediction[k] = parent[k]->interpolate(ptg);
+          }
+        }
+        const bool contribute{integrate ? ipix % nrank == rank : rank == 0};
+        if (integrate and contribute) {
+          // Faraday rotation from inner shells is applied at composition
+          observables->fd = 0.;
+          radial_integration(shell_ref, sync_ref, ptg, ipix,
+                             observables.get(), ray.get(), breg, brnd, tereg,
+                             ternd, cre, gbreg, gbrnd, gtereg, gternd, gcre,
+                             par);
+          value[0] = observables->dm;
+          value[1] = observables->fd;
+          for (ham_uint c = 0; c != channels; ++c) {
+            value[2 + 3 * c] = observables->is[c];
+            value[3 + 3 * c] = observables->qs[c];
+            value[4 + 3 * c] = observables->us[c];
+          }
+          child_refine[ipix] = coarsest;
+          for (ham_uint k = 0; k != nmaps; ++k) {
+            if (limit[k] >= 0 and
+                std::fabs(value[k] - prediction[k]) > limit[k]) {
+              child_refine[ipix] = 1;
+            }
+          }
+        }
+        for (ham_uint k = 0; k != nmaps; ++k) {
+          child[k]->data(ipix, not contribute ? 0.
+                                              : (integrate ? value[k]
+                                                           : prediction[k]));
+        }
       }
-      if (par->grid_obs.do_fd or par->grid_obs.do_sync.back()) {
-        gobs->tmp_fd_map->data(ipix, observables->fd);
+    }
+    if (nrank > 1) {
+      std::vector<Hampix<ham_float> *> maps;
+      for (auto &m : child) {
+        maps.push_back(m.get());
       }
+      reduce_maps(maps);
+      hammpi::allreduce_max(child_refine.data(), level_npix);
+    }
+    if (level_nside == nside) {
+      break;
     }
-#ifndef NTIMING
-    tmr->stop("pix");
-    tmr->print();
+    // refinement spreads to in-face neighbours, so that pixels next to
+    // sharp structure are refined even if they are predicted well
+    refine.assign(level_npix, 0);
+    const ham_int n{static_cast<ham_int>(level_nside)};
+#ifdef _OPENMP
+#pragma omp parallel for
 #endif
-    // accumulating new shell map to sim map
+    for (ham_uint ipix = 0; ipix < level_npix; ++ipix) {
+      ham_int ix, iy, face;
+      child[0]->rpixxyf(ipix, ix, iy, face);
+      for (ham_int jx = std::max(ix - 1, ham_int(0));
+           jx <= std::min(ix + 1, n - 1); ++jx) {
+        for (ham_int jy = std::max(iy - 1, ham_int(0));
+             jy <= std::min(iy + 1, n - 1); ++jy) {
+          refine[ipix] |= child_refine[child[0]->xyfrpix(jx, jy, face)];
+        }
+      }
+    }
+    // thresholds from RMS of current level
+    std::vector<ham_float> ms(nmaps, 0.);
+    for (ham_uint ipix = 0; ipix < level_npix; ++ipix) {
+      for (ham_uint k = 0; k != nmaps; ++k) {
+        ms[k] += child[k]->data(ipix) * child[k]->data(ipix);
+      }
+    }
+    const ham_float tol{par->grid_obs.tol_refine};
     if (par->grid_obs.do_dm) {
-      gobs->dm_map->accumulate(*(gobs->tmp_dm_map));
+      limit[0] = tol * std::sqrt(ms[0] / level_npix);
     }
-    if (par->grid_obs.do_sync.back()) {
-      gobs->is_map->accumulate(*(gobs->tmp_is_map));
-      gobs->qs_map->accumulate(*(gobs->tmp_qs_map));
-      gobs->us_map->accumulate(*(gobs->tmp_us_map));
+    if (par->grid_obs.do_fd or par->grid_obs.do_sync) {
+      limit[1] = tol * std::sqrt(ms[1] / level_npix);
     }
-    if (par->grid_obs.do_fd) {
-      gobs->fd_map->accumulate(*(gobs->tmp_fd_map));
-    } // end shell accumulation
-  }   // end shell iteration
+    if (par->grid_obs.do_sync) {
+      for (ham_uint c = 0; c != channels; ++c) {
+        limit[2 + 3 * c] = tol * std::sqrt(ms[2 + 3 * c] / level_npix);
+        limit[3 + 3 * c] =
+            tol * std::sqrt((ms[3 + 3 * c] + ms[4 + 3 * c]) / level_npix);
+        limit[4 + 3 * c] = limit[3 + 3 * c];
+      }
+    }
+    parent.swap(child);
+  }
+  // store finest level, masked pixels are zeroed
+  auto observables = std::make_unique<struct_observables>();
+  observables->is.resize(channels);
+  observables->qs.resize(channels);
+  observables->us.resize(channels);
+  const bool masked{par->grid_obs.do_mask};
+  for (ham_uint ipix = 0; ipix < child[0]->npix(); ++ipix) {
+    const ham_float keep{
+        (masked and gobs->mask_map->data(nside, ipix) != 1.0) ? 0. : 1.};
+    observables->dm = keep * child[0]->data(ipix);
+    observables->fd = keep * child[1]->data(ipix);
+    for (ham_uint c = 0; c != channels; ++c) {
+      observables->is[c] = keep * child[2 + 3 * c]->data(ipix);
+      observables->qs[c] = keep * child[3 + 3 * c]->data(ipix);
+      observables->us[c] = keep * child[4 + 3 * c]->data(ipix);
+    }
+    store_observables(ipix, observables.get(), sync_ref, maps, par);
+  }
+}
+
+// maps are packed into one buffer for a single reduction
+void Integrator::reduce_maps(
+    const std::vector<Hampix<ham_float> *> &maps) const {
+  if (hammpi::size() == 1 or maps.empty()) {
+    return;
+  }
+  HAM_PROFILE_STAGE("integrator/reduce");
+  const ham_uint npix{maps[0]->npix()};
+  std::vector<ham_float> buffer(maps.size() * npix);
+  for (ham_uint k = 0; k != maps.size(); ++k) {
+    for (ham_uint ipix = 0; ipix != npix; ++ipix) {
+      buffer[k * npix + ipix] = maps[k]->data(ipix);
+    }
+  }
+  hammpi::allreduce_sum(buffer.data(), buffer.size());
+  for (ham_uint k = 0; k != maps.size(); ++k) {
+    for (ham_uint ipix = 0; ipix != npix; ++ipix) {
+      maps[k]->data(ipix, buffer[k * npix + ipix]);
+    }
+  }
+}
+
+// NESTED index bits interleave ix (even) and iy (odd) within a face
+void Integrator::traversal_order(std::vector<ham_uint> *order,
+                                 const Hampix<ham_float> &map) const {
+  const ham_uint nside{map.nside()};
+  const ham_uint face_size{nside * nside};
+  order->resize(12 * face_size);
+  auto compress = [](ham_uint v) {
+    ham_int r{0};
+    for (ham_uint b = 0; v != 0; ++b, v >>= 2) {
+      r |= static_cast<ham_int>(v & 1) << b;
+    }
+    return r;
+  };
+  for (ham_uint i = 0; i != order->size(); ++i) {
+    const ham_int face{static_cast<ham_int>(i / face_size)};
+    const ham_uint p{i % face_size};
+    (*order)[i] = map.xyfrpix(compress(p), compress(p >> 1), face);
+  }
 }
 
 void Integrator::radial_integration(
-    const struct_shell *shell_ref, const Hamp &ptg_in,
-    struct_observables *pixobs, const Breg *breg, const Brnd *brnd,
-    const TEreg *tereg, const TErnd *ternd, const CREfield *cre,
-    const Grid_breg *gbreg, const Grid_brnd *gbrnd, const Grid_tereg *gtereg,
-    const Grid_ternd *gternd, const Grid_cre *gcre, const Param *par) const {
+    const struct_shell *shell_ref, const struct_sync *sync_ref,
+    const Hamp &ptg_in, const ham_uint &ipix, struct_observables *pixobs,
+    struct_ray *ray,
+    const Breg *breg, const Brnd *brnd, const TEreg *tereg, const TErnd *ternd,
+    const CREfield *cre, const Grid_breg *gbreg, const Grid_brnd *gbrnd,
+    const Grid_tereg *gtereg, const Grid_ternd *gternd, const Grid_cre *gcre,
+    const Param *par) const {
+  HAM_COUNT("integrator/LoS", 1);
   // pass in fd, zero others
   ham_float inner_shells_fd{0.};
-  if (par->grid_obs.do_fd or par->grid_obs.do_sync.back()) {
+  if (par->grid_obs.do_fd or par->grid_obs.do_sync) {
     inner_shells_fd = pixobs->fd;
   }
+  reset_observables(pixobs);
+  // pre-calculated LoS versor
+  const Hamvec<3, ham_float> los_direction{
+      los_versor(ptg_in.theta(), ptg_in.phi())};
+  // Gamma function products are reused while spectral index is unchanged
+  struct_gamma_memo gamma_memo;
+  if (par->grid_obs.do_adaptive) {
+    adaptive_integration(shell_ref, sync_ref, ptg_in, los_direction,
+                         inner_shells_fd, &gamma_memo, pixobs, ray, breg, brnd,
+                         tereg, ternd, cre, gbreg, gbrnd, gtereg, gternd, gcre,
+                         par);
+    compensate_observables(pixobs);
+    HAM_COUNT("integrator/samples", ray->size);
+    return;
+  }
+  // read all fields along LoS at once, or replay them from cache
+  if (shell_ref->cached and this->cache->filled(shell_ref->shell_num, ipix)) {
+    replay_ray(ray, shell_ref, los_direction, ipix, cre, gcre, par);
+  } else {
+    assemble_ray(ray, shell_ref, los_direction, breg, brnd, tereg, ternd, cre,
+                 gbreg, gbrnd, gtereg, gternd, gcre, par);
+    if (shell_ref->cached) {
+      this->cache->store(shell_ref->shell_num, ipix, ray->size,
+                         ray->btot_x.data(), ray->btot_y.data(),
+                         ray->btot_z.data(), ray->tetot.data());
+    }
+  }
+  evaluate_ray(ray, 0, sync_ref, ptg_in, los_direction, &gamma_memo, par);
+  // radial accumulation
+  HAM_PROFILE("integrator/accumulate");
+  for (decltype(ray->size) looper = 0; looper < ray->size; ++looper) {
+    accumulate_sample(ray, looper, shell_ref->delta_d, sync_ref,
+                      inner_shells_fd, pixobs, par);
+  }
+  compensate_observables(pixobs);
+  HAM_COUNT("integrator/samples", ray->size);
+}
+
+void Integrator::shifted_integration(
+    const struct_shell *shell_ref, const struct_sync *sync_ref,
+    const Hamp &ptg_in, const struct_ray *base, struct_observables *pixobs,
+    struct_ray *ray, const Breg *breg, const TEreg *tereg,
+    const CREfield *cre, const Grid_breg *gbreg, const Grid_tereg *gtereg,
+    const Grid_cre *gcre, const Param *par) const {
+  reset_observables(pixobs);
+  const Hamvec<3, ham_float> los_direction{
+      los_versor(ptg_in.theta(), ptg_in.phi())};
+  struct_gamma_memo gamma_memo;
+  {
+    HAM_PROFILE("integrator/field lookup");
+    const ham_uint n{base->size};
+    ray->size = n;
+    ray->x = base->x;
+    ray->y = base->y;
+    ray->z = base->z;
+    ray->brnd_x = base->brnd_x;
+    ray->brnd_y = base->brnd_y;
+    ray->brnd_z = base->brnd_z;
+    ray->ternd = base->ternd;
+    ray->breg_x.resize(n);
+    ray->breg_y.resize(n);
+    ray->breg_z.resize(n);
+    ray->tereg.resize(n);
+    breg->read_field_batch(ray->x.data(), ray->y.data(), ray->z.data(), n,
+                           par, gbreg, ray->breg_x.data(), ray->breg_y.data(),
+                           ray->breg_z.data());
+    tereg->read_field_batch(ray->x.data(), ray->y.data(), ray->z.data(), n,
+                            par, gtereg, ray->tereg.data());
+    ray->btot_x.resize(n);
+    ray->btot_y.resize(n);
+    ray->btot_z.resize(n);
+    ray->tetot.resize(n);
+    for (ham_uint i = 0; i != n; ++i) {
+      ray->btot_x[i] = ray->breg_x[i] + ray->brnd_x[i];
+      ray->btot_y[i] = ray->breg_y[i] + ray->brnd_y[i];
+      ray->btot_z[i] = ray->breg_z[i] + ray->brnd_z[i];
+      ray->tetot[i] = ray->tereg[i] + ray->ternd[i];
+    }
+    sample_cre(ray, 0, n, cre, gcre, par);
+  }
+  evaluate_ray(ray, 0, sync_ref, ptg_in, los_direction, &gamma_memo, par);
+  HAM_PROFILE("integrator/accumulate");
+  // Faraday rotation from inner shells is applied at composition
+  for (decltype(ray->size) looper = 0; looper < ray->size; ++looper) {
+    accumulate_sample(ray, looper, shell_ref->delta_d, sync_ref, 0., pixobs,
+                      par);
+  }
+  compensate_observables(pixobs);
+}
+
+void Integrator::reset_observables(struct_observables *pixobs) const {
   pixobs->dm = 0.;
   pixobs->fd = 0.;
-  pixobs->is = 0.;
-  pixobs->us = 0.;
-  pixobs->qs = 0.;
+  std::fill(pixobs->is.begin(), pixobs->is.end(), 0.);
+  std::fill(pixobs->qs.begin(), pixobs->qs.end(), 0.);
+  std::fill(pixobs->us.begin(), pixobs->us.end(), 0.);
+  pixobs->dm_c = 0.;
+  pixobs->fd_c = 0.;
+  pixobs->is_c.assign(pixobs->is.size(), 0.);
+  pixobs->qs_c.assign(pixobs->qs.size(), 0.);
+  pixobs->us_c.assign(pixobs->us.size(), 0.);
+}
+
+void Integrator::compensate_observables(struct_observables *pixobs) const {
+  pixobs->dm += pixobs->dm_c;
+  pixobs->fd += pixobs->fd_c;
+  for (decltype(pixobs->is.size()) c = 0; c != pixobs->is.size(); ++c) {
+    pixobs->is[c] += pixobs->is_c[c];
+    pixobs->qs[c] += pixobs->qs_c[c];
+    pixobs->us[c] += pixobs->us_c[c];
+  }
+  pixobs->dm_c = 0.;
+  pixobs->fd_c = 0.;
+  std::fill(pixobs->is_c.begin(), pixobs->is_c.end(), 0.);
+  std::fill(pixobs->qs_c.begin(), pixobs->qs_c.end(), 0.);
+  std::fill(pixobs->us_c.begin(), pixobs->us_c.end(), 0.);
+}
+
+// embedded midpoint/Simpson pair on cells [d, d+h]
+// Simpson sum is kept, its difference to midpoint sum is the error estimate
+// cell ends and halved cells reuse samples already in ray
+void Integrator::adaptive_integration(
+    const struct_shell *shell_ref, const struct_sync *sync_ref,
+    const Hamp &ptg_in, const Hamvec<3, ham_float> &los_direction,
+    const ham_float &inner_shells_fd, struct_gamma_memo *gamma_memo,
+    struct_observables *pixobs, struct_ray *ray, const Breg *breg,
+    const Brnd *brnd, const TEreg *tereg, const TErnd *ternd,
+    const CREfield *cre, const Grid_breg *gbreg, const Grid_brnd *gbrnd,
+    const Grid_tereg *gtereg, const Grid_ternd *gternd, const Grid_cre *gcre,
+    const Param *par) const {
+  ham_float seg_lo[2], seg_hi[2];
+  const ham_uint segments{
+      clip_los(shell_ref, los_direction, par, seg_lo, seg_hi)};
+  // trial observables of midpoint and Simpson sums
+  struct_observables coarse{*pixobs}, fine{*pixobs};
+  ray->size = 0;
+  ham_float h{shell_ref->delta_d};
+  for (ham_uint s = 0; s != segments; ++s) {
+    ham_float d{seg_lo[s]};
+    ham_uint left{sample_ray(ray, &d, 1, los_direction, breg, brnd, tereg,
+                             ternd, cre, gbreg, gbrnd, gtereg, gternd, gcre,
+                             par)};
+    evaluate_ray(ray, left, sync_ref, ptg_in, los_direction, gamma_memo, par);
+    while (d < seg_hi[s]) {
+      ham_float width{std::min(h, seg_hi[s] - d)};
+      const ham_float dist[2]{d + 0.5 * width, d + width};
+      ham_uint mid{sample_ray(ray, dist, 2, los_direction, breg, brnd, tereg,
+                              ternd, cre, gbreg, gbrnd, gtereg, gternd, gcre,
+                              par)};
+      evaluate_ray(ray, mid, sync_ref, ptg_in, los_direction, gamma_memo, par);
+      ham_uint right{mid + 1};
+      bool halved{false};
+      for (;;) {
+        coarse = *pixobs;
+        accumulate_sample(ray, mid, width, sync_ref, inner_shells_fd, &coarse,
+                          par);
+        fine = *pixobs;
+        accumulate_sample(ray, left, width / 6., sync_ref, inner_shells_fd,
+                          &fine, par);
+        accumulate_sample(ray, mid, 4. * width / 6., sync_ref, inner_shells_fd,
+                          &fine, par);
+        accumulate_sample(ray, right, width / 6., sync_ref, inner_shells_fd,
+                          &fine, par);
+        // steps never go below the fixed resolution
+        if (width <= shell_ref->delta_d or
+            check_adaptive_tolerance(pixobs, &coarse, &fine, shell_ref->tol,
+                                     par)) {
+          break;
+        }
+        // former midpoint becomes right end of halved cell
+        width *= 0.5;
+        right = mid;
+        const ham_float d_mid{d + 0.5 * width};
+        mid = sample_ray(ray, &d_mid, 1, los_direction, breg, brnd, tereg,
+                         ternd, cre, gbreg, gbrnd, gtereg, gternd, gcre, par);
+        evaluate_ray(ray, mid, sync_ref, ptg_in, los_direction, gamma_memo,
+                     par);
+        halved = true;
+      }
+      std::swap(*pixobs, fine);
+      d = (seg_hi[s] - d - width < 1e-6 * shell_ref->delta_d) ? seg_hi[s]
+                                                               : d + width;
+      left = right;
+      // grow step only after first-try acceptance
+      h = halved ? width : std::min(2. * width, shell_ref->delta_max);
+    }
+  }
+}
+
+// relative error of DM, FD and I/Q/U accumulated in shell,
+// scaled by the larger of accumulated value and its increment,
+// Q/U error is taken jointly, scaled as polarized intensity
+bool Integrator::check_adaptive_tolerance(const struct_observables *base,
+                                          const struct_observables *coarse,
+                                          const struct_observables *fine,
+                                          const ham_float &tol,
+                                          const Param *par) const {
+  auto within = [&tol](const ham_float &err, const ham_float &total,
+                       const ham_float &inc) {
+    return err <= tol * std::max(std::fabs(total), std::fabs(inc));
+  };
+  if (par->grid_obs.do_dm and
+      not within(std::fabs(fine->dm - coarse->dm), fine->dm,
+                 fine->dm - base->dm)) {
+    return false;
+  }
+  if ((par->grid_obs.do_fd or par->grid_obs.do_sync) and
+      not within(std::fabs(fine->fd - coarse->fd), fine->fd,
+                 fine->fd - base->fd)) {
+    return false;
+  }
+  if (par->grid_obs.do_sync) {
+    for (decltype(fine->is.size()) c = 0; c != fine->is.size(); ++c) {
+      if (not within(std::fabs(fine->is[c] - coarse->is[c]), fine->is[c],
+                     fine->is[c] - base->is[c])) {
+        return false;
+      }
+      const ham_float pi{std::hypot(fine->qs[c], fine->us[c])};
+      const ham_float pi_inc{
+          std::hypot(fine->qs[c] - base->qs[c], fine->us[c] - base->us[c])};
+      // error of Q and U together, so that it does not depend on
+      // Faraday rotation from inner shells, applied at composition
+      if (not within(std::hypot(fine->qs[c] - coarse->qs[c],
+                                fine->us[c] - coarse->us[c]),
+                     pi, pi_inc)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void Integrator::evaluate_ray(struct_ray *ray, const ham_uint &offset,
+                              const struct_sync *sync_ref, const Hamp &ptg_in,
+                              const Hamvec<3, ham_float> &los_direction,
+                              struct_gamma_memo *gamma_memo,
+                              const Param *par) const {
+  HAM_PROFILE("integrator/emissivity");
   // angular position
   const ham_float THE{ptg_in.theta()};
   const ham_float PHI{ptg_in.phi()};
-  // pre-calculated LoS versor
-  const Hamvec<3, ham_float> los_direction{los_versor(THE, PHI)};
-  // emission related constants
-  ham_float lambda_square = 0., i2bt_sync = 0., fd_forefactor = 0.;
-  if (par->grid_obs.do_sync.back()) {
-    // for calculating synchrotron emission
-    lambda_square = (cgs::c_light / par->grid_obs.sim_sync_freq.back()) *
-                    (cgs::c_light / par->grid_obs.sim_sync_freq.back());
-    // convert sync intensity(freq) to brightness temperature, Rayleigh-Jeans
-    // law
-    i2bt_sync = cgs::c_light * cgs::c_light /
-                (2. * cgs::kB * par->grid_obs.sim_sync_freq.back() *
-                 par->grid_obs.sim_sync_freq.back());
-  }
-  if (par->grid_obs.do_fd) {
-    fd_forefactor =
-        -(cgs::qe * cgs::qe * cgs::qe) / (2. * cgs::pi * cgs::mec2 * cgs::mec2);
+  const ham_uint channels{sync_ref->channels};
+  ray->te.resize(ray->size);
+  ray->b_par.resize(ray->size);
+  if (par->grid_obs.do_sync) {
+    ray->ipa.resize(ray->size);
+    ray->j_tot.resize(ray->size * channels);
+    ray->j_pol.resize(ray->size * channels);
   }
-  // radial accumulation
-  for (decltype(shell_ref->step) looper = 0; looper < shell_ref->step;
-       ++looper) {
-    // ec and gc position
-    Hamvec<3, ham_float> oc_pos{los_direction * shell_ref->dist[looper]};
-    Hamvec<3, ham_float> pos{oc_pos + par->observer};
-    // check LoS depth limit
-    if (check_simulation_lower_limit(pos.length(), par->grid_obs.gc_r_min))
-      continue;
-    if (check_simulation_upper_limit(pos.length(), par->grid_obs.gc_r_max))
-      continue;
-    if (check_simulation_lower_limit(pos[2], par->grid_obs.gc_z_min))
-      continue;
-    if (check_simulation_upper_limit(pos[2], par->grid_obs.gc_z_max))
-      continue;
-    // regular magnetic field
-    Hamvec<3, ham_float> B_vec{breg->read_field(pos, par, gbreg)};
-    // add random magnetic field
-    B_vec += brnd->read_field(pos, par, gbrnd);
+  for (ham_uint looper = offset; looper < ray->size; ++looper) {
+    // regular and random magnetic field
+    const Hamvec<3, ham_float> B_vec{ray->btot_x[looper], ray->btot_y[looper],
+                                     ray->btot_z[looper]};
     const ham_float B_par{los_parproj(B_vec, los_direction)};
     assert(std::isfinite(B_par));
-    // be aware of un-resolved random B_per in calculating emissivity
-    const ham_float B_per{los_perproj(B_vec, los_direction)};
-    assert(std::isfinite(B_per));
-    // thermal electron field
-    ham_float te{tereg->read_field(pos, par, gtereg)};
-    // add random thermal electron field
-    te += ternd->read_field(pos, par, gternd);
+    ray->b_par[looper] = B_par;
+    // regular and random thermal electron field
+    ham_float te{ray->tetot[looper]};
     // to avoid negative value
     te *= ham_float(te > 0.);
     assert(std::isfinite(te));
-    // dispersion measure
-    if (par->grid_obs.do_dm) {
-      pixobs->dm += te * shell_ref->delta_d;
-    }
-    // Faraday depth
-    if (par->grid_obs.do_fd or par->grid_obs.do_sync.back()) {
-      pixobs->fd += te * B_par * fd_forefactor * shell_ref->delta_d;
-    }
+    ray->te[looper] = te;
     // Synchrotron emission
-    if (par->grid_obs.do_sync.back()) {
-      const ham_float Jtot{sync_emissivity_t(pos, par, cre, gcre, B_per) *
-                           shell_ref->delta_d * i2bt_sync};
-      // J_pol receives no contribution from unresolved random field
-      const ham_float Jpol{sync_emissivity_p(pos, par, cre, gcre, B_per) *
-                           shell_ref->delta_d * i2bt_sync};
-      assert(Jtot < 1e30 and Jpol < 1e30 and Jtot >= 0 and Jpol >= 0);
-      pixobs->is += Jtot;
+    if (par->grid_obs.do_sync) {
+      // be aware of un-resolved random B_per in calculating emissivity
+      const ham_float B_per{los_perproj(B_vec, los_direction)};
+      assert(std::isfinite(B_per));
       // intrinsic polarization angle, following IAU definition
-      const ham_float qui{(inner_shells_fd + pixobs->fd) * lambda_square +
-                          sync_ipa(B_vec, THE, PHI)};
+      ray->ipa[looper] = sync_ipa(B_vec, THE, PHI);
+      for (decltype(sync_ref->channels) c = 0; c != channels; ++c) {
+        ray->j_tot[looper * channels + c] = sync_emissivity_t(
+            ray, looper, par, sync_ref, gamma_memo, B_per, sync_ref->freq[c]);
+        // J_pol receives no contribution from unresolved random field
+        ray->j_pol[looper * channels + c] = sync_emissivity_p(
+            ray, looper, par, sync_ref, gamma_memo, B_per, sync_ref->freq[c]);
+      }
+    }
+  }
+}
+
+void Integrator::accumulate_sample(const struct_ray *ray,
+                                   const ham_uint &looper,
+                                   const ham_float &delta_d,
+                                   const struct_sync *sync_ref,
+                                   const ham_float &inner_shells_fd,
+                                   struct_observables *pixobs,
+                                   const Param *par) const {
+  // LoS sums are compensated against rounding error
+  // dispersion measure
+  if (par->grid_obs.do_dm) {
+    compensated_add(&pixobs->dm, &pixobs->dm_c, ray->te[looper] * delta_d);
+  }
+  // Faraday depth
+  if (par->grid_obs.do_fd or par->grid_obs.do_sync) {
+    const ham_float fd_forefactor{-(cgs::qe * cgs::qe * cgs::qe) /
+                                  (2. * cgs::pi * cgs::mec2 * cgs::mec2)};
+    compensated_add(
+        &pixobs->fd, &pixobs->fd_c,
+        ray->te[looper] * ray->b_par[looper] * fd_forefactor * delta_d);
+  }
+  // Synchrotron emission
+  if (par->grid_obs.do_sync) {
+    const ham_uint channels{sync_ref->channels};
+    for (decltype(sync_ref->channels) c = 0; c != channels; ++c) {
+      const ham_float Jtot{ray->j_tot[looper * channels + c] * delta_d *
+                           sync_ref->i2bt[c]};
+      const ham_float Jpol{ray->j_pol[looper * channels + c] * delta_d *
+                           sync_ref->i2bt[c]};
+      assert(Jtot < 1e30 and Jpol < 1e30 and Jtot >= 0 and Jpol >= 0);
+      compensated_add(&pixobs->is[c], &pixobs->is_c[c], Jtot);
+      // observed polarization angle, with Faraday rotation
+      const ham_float qui{(inner_shells_fd + pixobs->fd) *
+                              sync_ref->lambda_square[c] +
+                          ray->ipa[looper]};
       assert(std::isfinite(qui));
-      pixobs->qs += std::cos(2. * qui) * Jpol;
-      pixobs->us += std::sin(2. * qui) * Jpol;
+      compensated_add(&pixobs->qs[c], &pixobs->qs_c[c],
+                      std::cos(2. * qui) * Jpol);
+      compensated_add(&pixobs->us[c], &pixobs->us_c[c],
+                      std::sin(2. * qui) * Jpol);
     }
   }
 }
 
+void Integrator::assemble_ray(
+    struct_ray *ray, const struct_shell *shell_ref,
+    const Hamvec<3, ham_float> &los_direction, const Breg *breg,
+    const Brnd *brnd, const TEreg *tereg, const TErnd *ternd,
+    const CREfield *cre, const Grid_breg *gbreg, const Grid_brnd *gbrnd,
+    const Grid_tereg *gtereg, const Grid_ternd *gternd, const Grid_cre *gcre,
+    const Param *par) const {
+  // radial steps within simulation limits
+  ham_uint begin[2], end[2];
+  const ham_uint ranges{clip_ray(shell_ref, los_direction, par, begin, end)};
+  ray->size = 0;
+  for (ham_uint r = 0; r != ranges; ++r) {
+    sample_ray(ray, shell_ref->dist.data() + begin[r], end[r] - begin[r],
+               los_direction, breg, brnd, tereg, ternd, cre, gbreg, gbrnd,
+               gtereg, gternd, gcre, par);
+  }
+}
+
+void Integrator::replay_ray(struct_ray *ray, const struct_shell *shell_ref,
+                            const Hamvec<3, ham_float> &los_direction,
+                            const ham_uint &ipix, const CREfield *cre,
+                            const Grid_cre *gcre, const Param *par) const {
+  HAM_PROFILE("integrator/cache replay");
+  // same radial steps as cached
+  ham_uint begin[2], end[2];
+  const ham_uint ranges{clip_ray(shell_ref, los_direction, par, begin, end)};
+  ray->size = 0;
+  for (ham_uint r = 0; r != ranges; ++r) {
+    sample_position(ray, shell_ref->dist.data() + begin[r], end[r] - begin[r],
+                    los_direction, par);
+  }
+  ray->btot_x.resize(ray->size);
+  ray->btot_y.resize(ray->size);
+  ray->btot_z.resize(ray->size);
+  ray->tetot.resize(ray->size);
+  this->cache->load(shell_ref->shell_num, ipix, ray->btot_x.data(),
+                    ray->btot_y.data(), ray->btot_z.data(),
+                    ray->tetot.data());
+  sample_cre(ray, 0, ray->size, cre, gcre, par);
+}
+
+ham_uint Integrator::sample_ray(
+    struct_ray *ray, const ham_float *dist, const ham_uint &n,
+    const Hamvec<3, ham_float> &los_direction, const Breg *breg,
+    const Brnd *brnd, const TEreg *tereg, const TErnd *ternd,
+    const CREfield *cre, const Grid_breg *gbreg, const Grid_brnd *gbrnd,
+    const Grid_tereg *gtereg, const Grid_ternd *gternd, const Grid_cre *gcre,
+    const Param *par) const {
+  HAM_PROFILE("integrator/field lookup");
+  const ham_uint offset{sample_position(ray, dist, n, los_direction, par)};
+  const ham_float *x{ray->x.data() + offset};
+  const ham_float *y{ray->y.data() + offset};
+  const ham_float *z{ray->z.data() + offset};
+  // magnetic fields
+  ray->breg_x.resize(ray->size);
+  ray->breg_y.resize(ray->size);
+  ray->breg_z.resize(ray->size);
+  ray->brnd_x.resize(ray->size);
+  ray->brnd_y.resize(ray->size);
+  ray->brnd_z.resize(ray->size);
+  breg->read_field_batch(x, y, z, n, par, gbreg, ray->breg_x.data() + offset,
+                         ray->breg_y.data() + offset,
+                         ray->breg_z.data() + offset);
+  brnd->read_field_batch(x, y, z, n, par, gbrnd, ray->brnd_x.data() + offset,
+                         ray->brnd_y.data() + offset,
+                         ray->brnd_z.data() + offset);
+  // thermal electron fields
+  ray->tereg.resize(ray->size);
+  ray->ternd.resize(ray->size);
+  tereg->read_field_batch(x, y, z, n, par, gtereg,
+                          ray->tereg.data() + offset);
+  ternd->read_field_batch(x, y, z, n, par, gternd,
+                          ray->ternd.data() + offset);
+  // totals
+  ray->btot_x.resize(ray->size);
+  ray->btot_y.resize(ray->size);
+  ray->btot_z.resize(ray->size);
+  ray->tetot.resize(ray->size);
+  for (ham_uint i = offset; i != ray->size; ++i) {
+    ray->btot_x[i] = ray->breg_x[i] + ray->brnd_x[i];
+    ray->btot_y[i] = ray->breg_y[i] + ray->brnd_y[i];
+    ray->btot_z[i] = ray->breg_z[i] + ray->brnd_z[i];
+    ray->tetot[i] = ray->tereg[i] + ray->ternd[i];
+  }
+  sample_cre(ray, offset, n, cre, gcre, par);
+  return offset;
+}
+
+ham_uint Integrator::sample_position(struct_ray *ray, const ham_float *dist,
+                                     const ham_uint &n,
+                                     const Hamvec<3, ham_float> &los_direction,
+                                     const Param *par) const {
+  const ham_uint offset{ray->size};
+  ray->size += n;
+  // capacity is kept by per-thread ray, no reallocation after first LoS
+  ray->x.resize(ray->size);
+  ray->y.resize(ray->size);
+  ray->z.resize(ray->size);
+  for (ham_uint i = 0; i != n; ++i) {
+    // ec and gc position
+    Hamvec<3, ham_float> oc_pos{los_direction * dist[i]};
+    Hamvec<3, ham_float> pos{oc_pos + par->grid_obs.origin};
+    ray->x[offset + i] = pos[0];
+    ray->y[offset + i] = pos[1];
+    ray->z[offset + i] = pos[2];
+  }
+  return offset;
+}
+
+void Integrator::sample_cre(struct_ray *ray, const ham_uint &offset,
+                            const ham_uint &n, const CREfield *cre,
+                            const Grid_cre *gcre, const Param *par) const {
+  if (not par->grid_obs.do_sync) {
+    return;
+  }
+  const ham_float *x{ray->x.data() + offset};
+  const ham_float *y{ray->y.data() + offset};
+  const ham_float *z{ray->z.data() + offset};
+  if (par->grid_cre.read_permission) {
+    ray->cre_flux.resize(ray->size * par->grid_cre.nE);
+    cre->read_grid_num_batch(x, y, z, n, par, gcre,
+                             ray->cre_flux.data() + offset * par->grid_cre.nE);
+  } else {
+    ray->cre_idx.resize(ray->size);
+    ray->cre_norm.resize(ray->size);
+    cre->flux_idx_batch(x, y, z, n, par, ray->cre_idx.data() + offset);
+    cre->flux_norm_batch(x, y, z, n, par, ray->cre_norm.data() + offset);
+  }
+}
+
+// pixels are dealt to MPI ranks as in pixel loop of write_grid
+void Integrator::cache_counts(const struct_shell *shell_ref,
+                              const Hampix<ham_float> &map,
+                              const std::vector<ham_uint> &order,
+                              const ham_uint &chunk, const Param *par,
+                              std::vector<ham_uint> *counts) const {
+  const ham_uint rank{hammpi::rank()};
+  const ham_uint nrank{hammpi::size()};
+  const ham_uint npix{map.npix()};
+  counts->assign(npix, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (ham_uint iwork = 0; iwork < npix; ++iwork) {
+    if ((iwork / chunk) % nrank != rank) {
+      continue;
+    }
+    const ham_uint ipix{order.empty() ? iwork : order[iwork]};
+    const Hamp ptg{map.pointing(ipix)};
+    ham_uint begin[2], end[2];
+    const ham_uint ranges{clip_ray(
+        shell_ref, los_versor(ptg.theta(), ptg.phi()), par, begin, end)};
+    for (ham_uint r = 0; r != ranges; ++r) {
+      (*counts)[ipix] += end[r] - begin[r];
+    }
+  }
+}
+
+// LoS d -> observer + d*versor is clipped analytically,
+// z slab and gc_r_max sphere bound one interval in d,
+// gc_r_min sphere may cut out a middle part of it
+ham_uint Integrator::clip_los(const struct_shell *shell_ref,
+                              const Hamvec<3, ham_float> &los_direction,
+                              const Param *par, ham_float *seg_lo,
+                              ham_float *seg_hi) const {
+  const Hamvec<3, ham_float> &obs{par->grid_obs.origin};
+  ham_float d_lo{shell_ref->d_start}, d_hi{shell_ref->d_stop};
+  // z slab
+  if (los_direction[2] != 0) {
+    ham_float z_lo{(par->grid_obs.gc_z_min - obs[2]) / los_direction[2]};
+    ham_float z_hi{(par->grid_obs.gc_z_max - obs[2]) / los_direction[2]};
+    if (z_lo > z_hi)
+      std::swap(z_lo, z_hi);
+    d_lo = std::max(d_lo, z_lo);
+    d_hi = std::min(d_hi, z_hi);
+  } else if (obs[2] < par->grid_obs.gc_z_min or
+             obs[2] > par->grid_obs.gc_z_max) {
+    return 0;
+  }
+  // |observer + d*versor|^2 = d^2 + 2*proj*d + obs2
+  const ham_float proj{obs.dotprod(los_direction)};
+  const ham_float obs2{obs.dotprod(obs)};
+  // gc_r_max sphere
+  const ham_float disc_max{proj * proj - obs2 +
+                           par->grid_obs.gc_r_max * par->grid_obs.gc_r_max};
+  if (disc_max < 0)
+    return 0;
+  d_lo = std::max(d_lo, -proj - std::sqrt(disc_max));
+  d_hi = std::min(d_hi, -proj + std::sqrt(disc_max));
+  // gc_r_min sphere
+  ham_float cut_lo{d_hi}, cut_hi{d_hi};
+  const ham_float disc_min{proj * proj - obs2 +
+                           par->grid_obs.gc_r_min * par->grid_obs.gc_r_min};
+  if (disc_min > 0) {
+    cut_lo = -proj - std::sqrt(disc_min);
+    cut_hi = -proj + std::sqrt(disc_min);
+  }
+  ham_uint segments{0};
+  if (d_lo < std::min(d_hi, cut_lo)) {
+    seg_lo[segments] = d_lo;
+    seg_hi[segments] = std::min(d_hi, cut_lo);
+    ++segments;
+  }
+  if (std::max(d_lo, cut_hi) < d_hi) {
+    seg_lo[segments] = std::max(d_lo, cut_hi);
+    seg_hi[segments] = d_hi;
+    ++segments;
+  }
+  return segments;
+}
+
+ham_uint Integrator::clip_ray(const struct_shell *shell_ref,
+                              const Hamvec<3, ham_float> &los_direction,
+                              const Param *par, ham_uint *begin,
+                              ham_uint *end) const {
+  ham_float seg_lo[2], seg_hi[2];
+  const ham_uint segments{
+      clip_los(shell_ref, los_direction, par, seg_lo, seg_hi)};
+  // convert to step index, with dist[k] = d_start + (k+0.5)*delta_d
+  const ham_uint step{shell_ref->step};
+  auto valid = [&](const ham_uint &k) {
+    Hamvec<3, ham_float> oc_pos{los_direction * shell_ref->dist[k]};
+    return check_simulation_volume(oc_pos + par->grid_obs.origin, par);
+  };
+  ham_uint ranges{0};
+  // ranges are ordered and disjoint
+  ham_uint k_floor{0};
+  for (ham_uint s = 0; s != segments; ++s) {
+    const ham_float k0{std::ceil(
+        (seg_lo[s] - shell_ref->d_start) / shell_ref->delta_d - 0.5)};
+    const ham_float k1{std::floor(
+        (seg_hi[s] - shell_ref->d_start) / shell_ref->delta_d + 0.5)};
+    ham_uint k_begin = static_cast<ham_uint>(
+        std::min(std::max(k0, ham_float(k_floor)), ham_float(step)));
+    ham_uint k_end = static_cast<ham_uint>(
+        std::min(std::max(k1, ham_float(k_begin)), ham_float(step)));
+    // settle rounding at range ends with the exact check
+    while (k_begin < k_end and not valid(k_begin))
+      ++k_begin;
+    while (k_begin > k_floor and valid(k_begin - 1))
+      --k_begin;
+    while (k_end > k_begin and not valid(k_end - 1))
+      --k_end;
+    while (k_end < step and valid(k_end))
+      ++k_end;
+    if (k_begin < k_end) {
+      begin[ranges] = k_begin;
+      end[ranges] = k_end;
+      k_floor = k_end;
+      ++ranges;
+    }
+  }
+  return ranges;
+}
+
 // assembling shell_ref structure
 void Integrator::assemble_shell_ref(struct_shell *target, const Param *par,
                                     const ham_uint &shell_num) const {
@@ -243,6 +1101,16 @@ void Integrator::assemble_shell_ref(struct_shell *target, const Param *par,
   for (ham_uint i = 0; i < target->step; ++i) {
     target->dist.push_back(target->d_start + (i + 0.5) * target->delta_d);
   }
+  // adaptive integration starts from and never goes below delta_d
+  if (par->grid_obs.do_adaptive) {
+    target->tol = par->grid_obs.tol_shell[shell_num];
+    target->delta_max = std::max(par->grid_obs.oc_r_res_max, target->delta_d);
+  } else {
+    target->tol = 0;
+    target->delta_max = target->delta_d;
+  }
+  // set by write_grid when cache is in use
+  target->cached = false;
 #ifdef VERBOSE
   std::cout << "shell reference: " << std::endl
             << "shell No. " << target->shell_num << std::endl
@@ -254,6 +1122,64 @@ void Integrator::assemble_shell_ref(struct_shell *target, const Param *par,
 #endif
 }
 
+// assembling sync_ref structure
+void Integrator::assemble_sync_ref(struct_sync *target,
+                                   const Param *par) const {
+  target->channels = 0;
+  target->freq.clear();
+  target->lambda_square.clear();
+  target->i2bt.clear();
+  target->KE.clear();
+  target->inv_beta.clear();
+  target->dE.clear();
+  target->x_mid.clear();
+  target->kernel.reset();
+  if (not par->grid_obs.do_sync) {
+    return;
+  }
+  target->channels = par->grid_obs.sim_sync_freq.size();
+  for (auto &f : par->grid_obs.sim_sync_freq) {
+    target->freq.push_back(f);
+    // for calculating Faraday rotation of synchrotron emission
+    target->lambda_square.push_back((cgs::c_light / f) * (cgs::c_light / f));
+    // convert sync intensity(freq) to brightness temperature,
+    // Rayleigh-Jeans law
+    target->i2bt.push_back(cgs::c_light * cgs::c_light /
+                           (2. * cgs::kB * f * f));
+  }
+  // CRE spectral table in cgs units
+  if (par->grid_cre.read_permission) {
+    const ham_uint nE{par->grid_cre.nE};
+    for (decltype(par->grid_cre.nE) i = 0; i != nE; ++i) {
+      const ham_float E{par->grid_cre.E_min *
+                        std::exp(i * par->grid_cre.E_fact)};
+      target->KE.push_back(E);
+      target->inv_beta.push_back(1. / std::sqrt(1 - cgs::mec2 / E));
+    }
+    // midpoint rule in energy bins
+    for (decltype(par->grid_cre.nE) i = 0; i + 1 < nE; ++i) {
+      const ham_float &E0{target->KE[i]};
+      const ham_float &E1{target->KE[i + 1]};
+      target->dE.push_back(std::fabs(E1 - E0));
+      target->x_mid.push_back(0.5 * (1. / (E1 * E1) + 1. / (E0 * E0)));
+    }
+    target->kernel = std::make_unique<Sync_kernel>(par->grid_cre.kernel_tol);
+  }
+}
+
+// Gamma function products in analytic CRE synchrotron emissivity
+// depend only on spectral index
+void Integrator::update_gamma_memo(struct_gamma_memo *memo,
+                                   const ham_float &index) const {
+  if (memo->index == index) {
+    return;
+  }
+  const ham_float g{gsl_sf_gamma(-0.25 * index - 1. / 12.)};
+  memo->gamma_t = gsl_sf_gamma(-0.25 * index + 19. / 12.) * g;
+  memo->gamma_p = gsl_sf_gamma(-0.25 * index + 7. / 12.) * g;
+  memo->index = index;
+}
+
 // calculate synchrotron emission intrinsic polarization angle
 ham_float Integrator::sync_ipa(const Hamvec<3, ham_float> &input,
                                const ham_float &the_ec,
@@ -280,45 +1206,47 @@ ham_float Integrator::temp_convert(const ham_float &temp_br,
 }
 
 // cre synchrotron J_tot(\nu)
-ham_float Integrator::sync_emissivity_t(const Hamvec<3, ham_float> &pos,
-                                        const Param *par, const CREfield *cre,
-                                        const Grid_cre *grid,
-                                        const ham_float &Bper) const {
+ham_float Integrator::sync_emissivity_t(struct_ray *ray,
+                                        const ham_uint &step, const Param *par,
+                                        const struct_sync *sync_ref,
+                                        struct_gamma_memo *memo,
+                                        const ham_float &Bper,
+                                        const ham_float &freq) const {
   ham_float J{0};
   // calculate from grid
   if (par->grid_cre.read_permission) {
-    // allocate energy grid
-    std::unique_ptr<ham_float[]> KE =
-        std::make_unique<ham_float[]>(par->grid_cre.nE);
-    // we need F(x[E]) in spectral integration
-    std::unique_ptr<ham_float[]> x =
-        std::make_unique<ham_float[]>(par->grid_cre.nE);
-    std::unique_ptr<ham_float[]> beta =
-        std::make_unique<ham_float[]>(par->grid_cre.nE);
     // consts used for converting E to x, using cgs units
-    const ham_float x_fact{4. * cgs::pi * par->grid_obs.sim_sync_freq.back() *
-                           cgs::mec * cgs::mec2 * cgs::mec2 /
-                           (3. * cgs::qe * std::fabs(Bper))};
-    // KE, x, beta arrays in cgs units
-    for (decltype(par->grid_cre.nE) i = 0; i != par->grid_cre.nE; ++i) {
-      KE[i] = par->grid_cre.E_min * std::exp(i * par->grid_cre.E_fact);
-      x[i] = x_fact / (KE[i] * KE[i]);
-      beta[i] = std::sqrt(1 - cgs::mec2 / KE[i]);
-    }
+    const ham_float x_fact{4. * cgs::pi * freq * cgs::mec * cgs::mec2 *
+                           cgs::mec2 / (3. * cgs::qe * std::fabs(Bper))};
+    // x decreases with energy, bins with x > 100 are skipped
+    // for their negligible contribution
+    const auto start = std::partition_point(
+        sync_ref->x_mid.begin(), sync_ref->x_mid.end(),
+        [&x_fact](const ham_float &v) { return x_fact * v > 100; });
+    const ham_uint i_begin = start - sync_ref->x_mid.begin();
+    const ham_uint i_end = sync_ref->x_mid.size();
+    // CRE flux at energy nodes of current step
+    const ham_float *cre_flux{ray->cre_flux.data() + step * par->grid_cre.nE};
     // spectral integral
-    for (decltype(par->grid_cre.nE) i = 0; i != par->grid_cre.nE - 1; ++i) {
-      const ham_float xv{0.5 * (x[i + 1] + x[i])};
-      // avoid underflow in gsl functions
-      if (xv > 100) {
-        continue;
+    if (i_begin < i_end) {
+      // kernel values of all contributing bins in one batch
+      const ham_uint n{i_end - i_begin};
+      ray->kernel_x.resize(n);
+      ray->kernel_val.resize(n);
+      for (ham_uint i = i_begin; i != i_end; ++i) {
+        ray->kernel_x[i - i_begin] = x_fact * sync_ref->x_mid[i];
+      }
+      sync_ref->kernel->F_batch(ray->kernel_x.data(), n,
+                                ray->kernel_val.data());
+      ham_float flux_lo{cre_flux[i_begin] * sync_ref->inv_beta[i_begin]};
+      for (ham_uint i = i_begin; i != i_end; ++i) {
+        const ham_float flux_hi{cre_flux[i + 1] * sync_ref->inv_beta[i + 1]};
+        // we put beta here, midpoint rule
+        const ham_float flux{0.5 * (flux_hi + flux_lo)};
+        assert(flux >= 0);
+        J += ray->kernel_val[i - i_begin] * flux * sync_ref->dE[i];
+        flux_lo = flux_hi;
       }
-      const ham_float dE{std::fabs(KE[i + 1] - KE[i])};
-      // we put beta here, midpoint rule
-      const ham_float flux{
-          0.5 * (cre->read_grid_num(pos, i + 1, par, grid) / beta[i + 1] +
-                 cre->read_grid_num(pos, i, par, grid) / beta[i])};
-      assert(flux >= 0);
-      J += gsl_sf_synchrotron_1(xv) * flux * dE;
     }
     // do energy spectrum integration at given position
     // unit_factor for DIFFERENTIAL density flux, [GeV m^2 s sr]^-1
@@ -333,47 +1261,34 @@ ham_float Integrator::sync_emissivity_t(const Hamvec<3, ham_float> &pos,
   else {
     // allocating values to index, norm according to user defined model
     // user may consider building derived class from CRE_ana
-    const ham_float index{cre->flux_idx(pos, par)};
+    const ham_float index{ray->cre_idx[step]};
+    update_gamma_memo(memo, index);
     // coefficients which do not attend integration
-    const ham_float norm{cre->flux_norm(pos, par) * 1.73205081 *
+    const ham_float norm{ray->cre_norm[step] * 1.73205081 *
                          (cgs::qe * cgs::qe * cgs::qe) * std::fabs(Bper) /
                          (4. * cgs::pi * cgs::mec2 * (1. - index))};
     // synchrotron integration
-    const ham_float A{2. * cgs::pi * par->grid_obs.sim_sync_freq.back() *
-                      cgs::mec / (3. * cgs::qe * std::fabs(Bper))};
-    J = norm * (std::pow(A, 0.5 * (index + 1)) *
-                gsl_sf_gamma(-0.25 * index + 19. / 12.) *
-                gsl_sf_gamma(-0.25 * index - 1. / 12.));
+    const ham_float A{2. * cgs::pi * freq * cgs::mec /
+                      (3. * cgs::qe * std::fabs(Bper))};
+    J = norm * (std::pow(A, 0.5 * (index + 1)) * memo->gamma_t);
   }
   return J;
 }
 
 // cre synchrotron J_pol(\nu)
-ham_float Integrator::sync_emissivity_p(const Hamvec<3, ham_float> &pos,
-                                        const Param *par, const CREfield *cre,
-                                        const Grid_cre *grid,
-                                        const ham_float &Bper) const {
+ham_float Integrator::sync_emissivity_p(struct_ray *ray,
+                                        const ham_uint &step, const Param *par,
+                                        const struct_sync *sync_ref,
+                                        struct_gamma_memo *memo,
+                                        const ham_float &Bper,
+                                        const ham_float &freq) const {
   ham_float J{0};
   // calculate from grid
   if (par->grid_cre.read_permission) {
-    // allocate energy grid
-    std::unique_ptr<ham_float[]> KE =
-        std::make_unique<ham_float[]>(par->grid_cre.nE);
-    // we need F(x[E]) in spectral integration
-    std::unique_ptr<ham_float[]> x =
-        std::make_unique<ham_float[]>(par->grid_cre.nE);
-    std::unique_ptr<ham_float[]> beta =
-        std::make_unique<ham_float[]>(par->grid_cre.nE);
     // consts used for converting E to x, using cgs units
-    const ham_float x_fact{(2. * cgs::mec * cgs::mec2 * cgs::mec2 * 2. *
-                            cgs::pi * par->grid_obs.sim_sync_freq.back()) /
-                           (3. * cgs::qe * std::fabs(Bper))};
-    // KE, x, beta arrays in cgs units
-    for (decltype(par->grid_cre.nE) i = 0; i != par->grid_cre.nE; ++i) {
-      KE[i] = par->grid_cre.E_min * std::exp(i * par->grid_cre.E_fact);
-      x[i] = x_fact / (KE[i] * KE[i]);
-      beta[i] = std::sqrt(1 - cgs::mec2 / KE[i]);
-    }
+    const ham_float x_fact{
+        (2. * cgs::mec * cgs::mec2 * cgs::mec2 * 2. * cgs::pi * freq) /
+        (3. * cgs::qe * std::fabs(Bper))};
     // do energy spectrum integration at given position
     // unit_factor for DIFFERENTIAL density flux, [GeV m^2 s sr]^-1
     // n(E,pos) = \phi(E,pos)*(4\pi/\beta*c), the relatin between flux \phi and
@@ -381,20 +1296,35 @@ ham_float Integrator::sync_emissivity_p(const Hamvec<3, ham_float> &pos,
     const ham_float fore_factor{
         1.73205081 * cgs::qe * cgs::qe * cgs::qe * std::fabs(Bper) /
         (cgs::mec2 * cgs::c_light * cgs::GeV * cgs::m * cgs::m * cgs::sec)};
+    // x decreases with energy, bins with x > 100 are skipped
+    // for their negligible contribution
+    const auto start = std::partition_point(
+        sync_ref->x_mid.begin(), sync_ref->x_mid.end(),
+        [&x_fact](const ham_float &v) { return x_fact * v > 100; });
+    const ham_uint i_begin = start - sync_ref->x_mid.begin();
+    const ham_uint i_end = sync_ref->x_mid.size();
+    // CRE flux at energy nodes of current step
+    const ham_float *cre_flux{ray->cre_flux.data() + step * par->grid_cre.nE};
     // spectral integral
-    for (decltype(par->grid_cre.nE) i = 0; i != par->grid_cre.nE - 1; ++i) {
-      const ham_float xv{0.5 * (x[i + 1] + x[i])};
-      // avoid underflow in gsl functions
-      if (xv > 100) {
-        continue;
+    if (i_begin < i_end) {
+      // kernel values of all contributing bins in one batch
+      const ham_uint n{i_end - i_begin};
+      ray->kernel_x.resize(n);
+      ray->kernel_val.resize(n);
+      for (ham_uint i = i_begin; i != i_end; ++i) {
+        ray->kernel_x[i - i_begin] = x_fact * sync_ref->x_mid[i];
+      }
+      sync_ref->kernel->G_batch(ray->kernel_x.data(), n,
+                                ray->kernel_val.data());
+      ham_float flux_lo{cre_flux[i_begin] * sync_ref->inv_beta[i_begin]};
+      for (ham_uint i = i_begin; i != i_end; ++i) {
+        const ham_float flux_hi{cre_flux[i + 1] * sync_ref->inv_beta[i + 1]};
+        // we put beta here, midpoint rule
+        const ham_float flux{0.5 * (flux_hi + flux_lo)};
+        assert(flux >= 0);
+        J += ray->kernel_val[i - i_begin] * flux * sync_ref->dE[i];
+        flux_lo = flux_hi;
       }
-      const ham_float dE{std::fabs(KE[i + 1] - KE[i])};
-      // we put beta here, midpoint rule
-      const ham_float flux{
-          0.5 * (cre->read_grid_num(pos, i + 1, par, grid) / beta[i + 1] +
-                 cre->read_grid_num(pos, i, par, grid) / beta[i])};
-      assert(flux >= 0);
-      J += gsl_sf_synchrotron_2(xv) * flux * dE;
     }
     J *= fore_factor;
   }
@@ -402,17 +1332,16 @@ ham_float Integrator::sync_emissivity_p(const Hamvec<3, ham_float> &pos,
   else {
     // allocating values to index, norm according to user defined model
     // user may consider building derived class from CRE_ana
-    const ham_float index{cre->flux_idx(pos, par)};
+    const ham_float index{ray->cre_idx[step]};
+    update_gamma_memo(memo, index);
     // coefficients which do not attend integration
-    const ham_float norm{cre->flux_norm(pos, par) * 1.73205081 *
+    const ham_float norm{ray->cre_norm[step] * 1.73205081 *
                          (cgs::qe * cgs::qe * cgs::qe) * std::fabs(Bper) /
                          (16. * cgs::pi * cgs::mec2)};
     // synchrotron integration
-    const ham_float A{2. * cgs::pi * par->grid_obs.sim_sync_freq.back() *
-                      cgs::mec / (3. * cgs::qe * std::fabs(Bper))};
-    J = norm * (std::pow(A, 0.5 * (index + 1)) *
-                gsl_sf_gamma(-0.25 * index + 7. / 12.) *
-                gsl_sf_gamma(-0.25 * index - 1. / 12.));
+    const ham_float A{2. * cgs::pi * freq * cgs::mec /
+                      (3. * cgs::qe * std::fabs(Bper))};
+    J = norm * (std::pow(A, 0.5 * (index + 1)) * memo->gamma_p);
   }
   // the last 4pi comes from solid-angle integration/deviation,
   // check eq(6.16) in Ribiki-Lightman's where Power is defined,
@@ -0,0 +1,192 @@
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hamtype.h>
+#include <raycache.h>
+
+constexpr ham_uint Ray_cache::width;
+
+namespace {
+// file signature
+const char magic[8]{'h', 'a', 'm', 'x', 'r', 'a', 'y', 'c'};
+
+template <typename T> void put(std::ofstream &out, const T &v) {
+  out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <typename T> void put(std::ofstream &out, const std::vector<T> &v) {
+  put(out, static_cast<std::uint64_t>(v.size()));
+  out.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+}
+
+template <typename T> void get(std::ifstream &in, T &v) {
+  in.read(reinterpret_cast<char *>(&v), sizeof(T));
+}
+
+template <typename T> void get(std::ifstream &in, std::vector<T> &v) {
+  std::uint64_t n;
+  get(in, n);
+  v.resize(n);
+  in.read(reinterpret_cast<char *>(v.data()), n * sizeof(T));
+}
+} // namespace
+
+void Ray_cache::open(const std::uint64_t &k, const bool &s,
+                     const std::string &filename) {
+  if (k != this->key or s != this->single) {
+    clear();
+    this->key = k;
+    this->single = s;
+  }
+  this->dirty = false;
+  if (this->shells.empty() and not filename.empty()) {
+    read(filename);
+  }
+}
+
+void Ray_cache::clear() {
+  this->shells.clear();
+  this->dirty = false;
+}
+
+bool Ray_cache::ready(const ham_uint &shell, const ham_uint &npix) const {
+  return shell < this->shells.size() and
+         this->shells[shell].filled.size() == npix;
+}
+
+void Ray_cache::layout(const ham_uint &shell,
+                       const std::vector<ham_uint> &counts) {
+  if (this->shells.size() <= shell) {
+    this->shells.resize(shell + 1);
+  }
+  struct_slices &target = this->shells[shell];
+  target.offset.assign(counts.size() + 1, 0);
+  for (ham_uint ipix = 0; ipix != counts.size(); ++ipix) {
+    target.offset[ipix + 1] = target.offset[ipix] + counts[ipix];
+  }
+  target.filled.assign(counts.size(), 0);
+  const ham_uint total{width * target.offset.back()};
+  target.data64.clear();
+  target.data32.clear();
+  if (this->single) {
+    target.data32.resize(total);
+  } else {
+    target.data64.resize(total);
+  }
+  this->dirty = true;
+}
+
+void Ray_cache::store(const ham_uint &shell, const ham_uint &ipix,
+                      const ham_uint &n, const ham_float *bx,
+                      const ham_float *by, const ham_float *bz,
+                      const ham_float *te) {
+  if (n != samples(shell, ipix)) {
+    return;
+  }
+  struct_slices &target = this->shells[shell];
+  const ham_uint begin{width * target.offset[ipix]};
+  for (ham_uint i = 0; i != n; ++i) {
+    const ham_uint idx{begin + width * i};
+    if (this->single) {
+      target.data32[idx] = static_cast<float>(bx[i]);
+      target.data32[idx + 1] = static_cast<float>(by[i]);
+      target.data32[idx + 2] = static_cast<float>(bz[i]);
+      target.data32[idx + 3] = static_cast<float>(te[i]);
+    } else {
+      target.data64[idx] = bx[i];
+      target.data64[idx + 1] = by[i];
+      target.data64[idx + 2] = bz[i];
+      target.data64[idx + 3] = te[i];
+    }
+  }
+  target.filled[ipix] = 1;
+  this->dirty.store(true, std::memory_order_relaxed);
+}
+
+void Ray_cache::load(const ham_uint &shell, const ham_uint &ipix,
+                     ham_float *bx, ham_float *by, ham_float *bz,
+                     ham_float *te) const {
+  const struct_slices &target = this->shells[shell];
+  const ham_uint begin{width * target.offset[ipix]};
+  const ham_uint n{samples(shell, ipix)};
+  for (ham_uint i = 0; i != n; ++i) {
+    const ham_uint idx{begin + width * i};
+    if (this->single) {
+      bx[i] = target.data32[idx];
+      by[i] = target.data32[idx + 1];
+      bz[i] = target.data32[idx + 2];
+      te[i] = target.data32[idx + 3];
+    } else {
+      bx[i] = target.data64[idx];
+      by[i] = target.data64[idx + 1];
+      bz[i] = target.data64[idx + 2];
+      te[i] = target.data64[idx + 3];
+    }
+  }
+}
+
+ham_uint Ray_cache::pixels() const {
+  ham_uint sum{0};
+  for (const auto &s : this->shells) {
+    for (const auto &f : s.filled) {
+      sum += static_cast<ham_uint>(f);
+    }
+  }
+  return sum;
+}
+
+void Ray_cache::save(const std::string &filename) const {
+  std::ofstream output(filename.c_str(), std::ios::out | std::ios::binary);
+  if (!output.is_open()) {
+    throw std::runtime_error("open file error: " + filename);
+  }
+  output.write(magic, sizeof(magic));
+  put(output, this->key);
+  put(output, static_cast<std::uint8_t>(this->single));
+  put(output, static_cast<std::uint64_t>(this->shells.size()));
+  for (const auto &s : this->shells) {
+    put(output, s.offset);
+    put(output, s.filled);
+    put(output, s.data64);
+    put(output, s.data32);
+  }
+  if (!output.good()) {
+    throw std::runtime_error("write file error: " + filename);
+  }
+}
+
+bool Ray_cache::read(const std::string &filename) {
+  std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!input.is_open()) {
+    return false;
+  }
+  char sign[sizeof(magic)];
+  input.read(sign, sizeof(magic));
+  std::uint64_t k;
+  std::uint8_t s;
+  get(input, k);
+  get(input, s);
+  if (!input.good() or std::string(sign, sizeof(sign)) !=
+                           std::string(magic, sizeof(magic)) or
+      k != this->key or static_cast<bool>(s) != this->single) {
+    return false;
+  }
+  std::uint64_t n;
+  get(input, n);
+  std::vector<struct_slices> content(n);
+  for (auto &c : content) {
+    get(input, c.offset);
+    get(input, c.filled);
+    get(input, c.data64);
+    get(input, c.data32);
+  }
+  if (!input.good()) {
+    throw std::runtime_error("read file error: " + filename);
+  }
+  this->shells = std::move(content);
+  return true;
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include <hamtype.h>
+#include <hamunits.h>
+#include <synckernel.h>
+
+Sync_kernel::Sync_kernel(const ham_float &tol) {
+  if (!(tol > 0))
+    throw std::runtime_error("invalid synchrotron kernel accuracy");
+  // asymptotic expansion of K_\nu(x), mu = 4\nu^2
+  // K_\nu(x) ~ sqrt(pi/2x) e^{-x} \sum_k a_k x^{-k}
+  // a_k = \prod_{j=1}^k (mu-(2j-1)^2) / (k! 8^k)
+  const ham_uint terms{12};
+  std::vector<ham_float> a53(terms), a23(terms);
+  a53[0] = 1.;
+  a23[0] = 1.;
+  for (ham_uint k = 1; k != terms; ++k) {
+    const ham_float odd{(2. * k - 1.) * (2. * k - 1.)};
+    a53[k] = a53[k - 1] * (100. / 9. - odd) / (8. * k);
+    a23[k] = a23[k - 1] * (16. / 9. - odd) / (8. * k);
+  }
+  // G(x) = x K_{2/3}(x)
+  this->asym_G = a23;
+  // F(x) = x \int_x^\infty K_{5/3}(t) dt, with
+  // \int_x^\infty t^{-k-1/2} e^{-t} dt ~ x^{-k-1/2} e^{-x}
+  // \sum_m (-1)^m (k+1/2)_m x^{-m}
+  this->asym_F.assign(terms, 0.);
+  for (ham_uint k = 0; k != terms; ++k) {
+    ham_float rising{1.};
+    for (ham_uint m = 0; k + m != terms; ++m) {
+      this->asym_F[k + m] += a53[k] * rising;
+      rising *= -(k + 0.5 + m);
+    }
+  }
+  // refine tables until accuracy target is met
+  for (ham_uint nodes = 8;; nodes *= 2) {
+    build(nodes);
+    this->err = max_error();
+    if (this->err <= tol)
+      break;
+    if (nodes >= 1024)
+      throw std::runtime_error("unreachable synchrotron kernel accuracy");
+  }
+}
+
+void Sync_kernel::build(const ham_uint &nodes) {
+  this->npd = nodes;
+  this->u_lo = std::log(this->x_lo);
+  const ham_float u_hi{std::log(this->x_hi)};
+  const ham_float decades{(u_hi - this->u_lo) / std::log(10.)};
+  const ham_uint n = static_cast<ham_uint>(std::ceil(decades * nodes)) + 1;
+  this->du = (u_hi - this->u_lo) / (n - 1);
+  this->inv_du = 1. / this->du;
+  // one extra node at each end keeps 4-point stencil inside table
+  this->tab_F.resize(n + 2);
+  this->tab_G.resize(n + 2);
+  for (ham_uint k = 0; k != n + 2; ++k) {
+    const ham_float x{std::exp(this->u_lo + (k - 1.) * this->du)};
+    this->tab_F[k] = quad_F(x);
+    this->tab_G[k] = quad_G(x);
+  }
+}
+
+ham_float Sync_kernel::max_error() const {
+  ham_float max_err{0};
+  const ham_uint n = this->tab_F.size() - 2;
+  for (ham_uint k = 0; k != n - 1; ++k) {
+    const ham_float u{this->u_lo + (k + 0.5) * this->du};
+    const ham_float x{std::exp(u)};
+    const ham_float ref_F{quad_F(x)};
+    const ham_float ref_G{quad_G(x)};
+    max_err =
+        std::max(max_err, std::fabs(interp(this->tab_F, u) - ref_F) / ref_F);
+    max_err =
+        std::max(max_err, std::fabs(interp(this->tab_G, u) - ref_G) / ref_G);
+  }
+  return max_err;
+}
+
+// trapezoid rule converges exponentially for integrands
+// analytic in a strip around real axis
+ham_float Sync_kernel::quad_F(const ham_float &x) const {
+  const ham_float h{0.05};
+  ham_float sum{0.5};
+  for (ham_uint k = 1;; ++k) {
+    const ham_float t{k * h};
+    const ham_float c{std::cosh(t)};
+    const ham_float term{std::exp(-x * (c - 1.)) * std::cosh(5. * t / 3.) /
+                         c};
+    sum += term;
+    if (term < 1e-17 * sum)
+      break;
+  }
+  return x * h * sum;
+}
+
+ham_float Sync_kernel::quad_G(const ham_float &x) const {
+  const ham_float h{0.05};
+  ham_float sum{0.5};
+  for (ham_uint k = 1;; ++k) {
+    const ham_float t{k * h};
+    const ham_float term{std::exp(-x * (std::cosh(t) - 1.)) *
+                         std::cosh(2. * t / 3.)};
+    sum += term;
+    if (term < 1e-17 * sum)
+      break;
+  }
+  return x * h * sum;
+}
+
+ham_float Sync_kernel::interp(const std::vector<ham_float> &tab,
+                               const ham_float &u) const {
+  const ham_float t{std::max((u - this->u_lo) * this->inv_du, 0.)};
+  const ham_uint i =
+      std::min(static_cast<ham_uint>(t), static_cast<ham_uint>(tab.size() - 4));
+  const ham_float s{t - i};
+  // stencil at (i-1, i, i+1, i+2) in table node index
+  const ham_float *p{tab.data() + i};
+  const ham_float sm{s - 1.}, sp{s + 1.}, s2{s - 2.};
+  return (-s * sm * s2 * p[0] + 3. * sp * sm * s2 * p[1] -
+          3. * sp * s * s2 * p[2] + sp * s * sm * p[3]) /
+         6.;
+}
+
+ham_float Sync_kernel::asym(const std::vector<ham_float> &c,
+                             const ham_float &x) const {
+  const ham_float inv_x{1. / x};
+  ham_float sum{0};
+  for (auto it = c.rbegin(); it != c.rend(); ++it)
+    sum = sum * inv_x + *it;
+  return std::sqrt(0.5 * cgs::pi * x) * std::exp(-x) * sum;
+}
+
+// leading series at small x
+// F(x) ~ 2^{5/3}pi/(sqrt(3)Gamma(1/3)) x^{1/3}
+// (1 - Gamma(1/3)/2 (x/2)^{2/3} + 3/4 (x/2)^2)
+// G(x) ~ 2^{2/3}pi/(sqrt(3)Gamma(1/3)) x^{1/3}
+// (1 - Gamma(1/3)/(2^{1/3}Gamma(2/3)) (x/2)^{4/3} + 3/4 x^2)
+ham_float Sync_kernel::F(const ham_float &x) const {
+  if (x <= 0)
+    return 0;
+  if (x < this->x_lo) {
+    const ham_float z{std::cbrt(x)};
+    return 2.14952824153447863671 * z *
+           (1. - 8.43812762813205e-01 * z * z + 0.1875 * x * x);
+  }
+  if (x > this->x_hi)
+    return asym(this->asym_F, x);
+  return interp(this->tab_F, std::log(x)) * std::exp(-x);
+}
+
+ham_float Sync_kernel::G(const ham_float &x) const {
+  if (x <= 0)
+    return 0;
+  if (x < this->x_lo) {
+    const ham_float z{std::cbrt(x)};
+    return 1.07476412076723931836 * z *
+           (1. - 1.17767156510235e+00 * z * x + 0.75 * x * x);
+  }
+  if (x > this->x_hi)
+    return asym(this->asym_G, x);
+  return interp(this->tab_G, std::log(x)) * std::exp(-x);
+}
+
+// table pass runs over all elements without branches, x is clamped
+// into table range, elements outside it are redone by the scalar
+// kernel in a second pass, which is rare along LoS
+void Sync_kernel::batch(const std::vector<ham_float> &tab,
+                        ham_float (Sync_kernel::*kernel)(const ham_float &)
+                            const,
+                        const ham_float *x, const ham_uint &n,
+                        ham_float *out) const {
+  const ham_float *p{tab.data()};
+  const ham_float last{static_cast<ham_float>(tab.size() - 4)};
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for (ham_uint i = 0; i != n; ++i) {
+    const ham_float xc{std::min(std::max(x[i], this->x_lo), this->x_hi)};
+    // same stencil as interp
+    const ham_float t{
+        std::max((std::log(xc) - this->u_lo) * this->inv_du, 0.)};
+    const int k{static_cast<int>(std::min(t, last))};
+    const ham_float s{t - k};
+    const ham_float sm{s - 1.}, sp{s + 1.}, s2{s - 2.};
+    out[i] = (-s * sm * s2 * p[k] + 3. * sp * sm * s2 * p[k + 1] -
+              3. * sp * s * s2 * p[k + 2] + sp * s * sm * p[k + 3]) /
+             6. * std::exp(-xc);
+  }
+  for (ham_uint i = 0; i != n; ++i) {
+    if (not(x[i] >= this->x_lo and x[i] <= this->x_hi))
+      out[i] = (this->*kernel)(x[i]);
+  }
+}
+
+void Sync_kernel::F_batch(const ham_float *x, const ham_uint &n,
+                          ham_float *out) const {
+  batch(this->tab_F, &Sync_kernel::F, x, n, out);
+}
+
+void Sync_kernel::G_batch(const ham_float *x, const ham_uint &n,
+                          ham_float *out) const {
+  batch(this->tab_G, &Sync_kernel::G, x, n, out);
+}
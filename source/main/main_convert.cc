@@ -0,0 +1,92 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <grid.h>
+#include <hamarray.h>
+#include <hamgrid.h>
+#include <hamlayout.h>
+#include <hamtype.h>
+#include <hamwriter.h>
+#include <param.h>
+
+// grid size and limits are given by XML parameters
+// only if the grid is read or written
+bool grid_given(const Param &par, const std::string &kind) {
+  if (kind == "breg") {
+    return par.grid_breg.read_permission or par.grid_breg.write_permission;
+  } else if (kind == "brnd") {
+    return par.grid_brnd.read_permission or par.grid_brnd.write_permission;
+  } else if (kind == "tereg") {
+    return par.grid_tereg.read_permission or par.grid_tereg.write_permission;
+  } else if (kind == "ternd") {
+    return par.grid_ternd.read_permission or par.grid_ternd.write_permission;
+  } else if (kind == "cre") {
+    return par.grid_cre.read_permission or par.grid_cre.write_permission;
+  }
+  throw std::runtime_error("unsupported grid kind " + kind);
+}
+
+// if file starts as a grid file
+bool grid_file(const std::string &filename) {
+  std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+  char magic[8]{};
+  input.read(magic, 8);
+  return std::string(magic) == "HAMGRID";
+}
+
+// grid file in layout and codec of XML parameters
+void reencode(const std::string &input, const std::string &output,
+              const hamgrid::header &h) {
+  std::vector<Hamarray<ham_store>> comps(h.ncomp);
+  std::vector<Hamarray<ham_store> *> list;
+  std::vector<const Hamarray<ham_store> *> values;
+  for (auto &a : comps) {
+    list.push_back(&a);
+    values.push_back(&a);
+  }
+  // files are row-major whatever the memory order of grids
+  const Hamlayout layout({h.nx, h.ny, h.nz}, "row", h.nE);
+  Grid::import_file(input, "stream", h, list, layout, 0);
+  const std::vector<char> image{hamgrid::pack(h, values, layout)};
+  Hamwriter::dump(output, image.data(), image.size(), false);
+}
+
+int main(int argc, char **argv) {
+  if (argc == 2 and std::string(argv[1]) == "-h") {
+    std::cout << "to convert a raw grid file of former releases, or a grid "
+                 "file into another codec use"
+              << std::endl
+              << "hamx_convert [XML parameter file path] "
+                 "[breg|brnd|tereg|ternd|cre] [input file path] "
+                 "[grid file path]"
+              << std::endl
+              << "grid size, limits and codec are taken from the XML "
+                 "parameter file,"
+              << std::endl
+              << "where the grid needs read or write permission in fieldio"
+              << std::endl;
+    return EXIT_SUCCESS;
+  }
+  if (argc != 5) {
+    std::cout << "wrong input(s)!" << std::endl
+              << "try hamx_convert -h for more details." << std::endl;
+    throw std::runtime_error("exit before execution");
+  }
+  const Param par{std::string(argv[1])};
+  const std::string kind(argv[2]);
+  if (not grid_given(par, kind)) {
+    throw std::runtime_error("no read or write permission of " + kind +
+                             " grid in " + std::string(argv[1]));
+  }
+  const hamgrid::header h{hamgrid::describe(kind, &par)};
+  if (grid_file(argv[3])) {
+    reencode(argv[3], argv[4], h);
+  } else {
+    hamgrid::convert(argv[3], argv[4], h);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <mpi.h>
+
+#include <hammpi.h>
+#include <pipeline.h>
+#include <timer.h>
+
+// MPI version of hamx
+// every rank builds or imports fields and shares LoS integration,
+// output maps are written by rank 0
+int main(int argc, char **argv) {
+  // OpenMP threads are spawned between MPI calls only
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+  const bool master{hammpi::rank() == 0};
+  // helping
+  if (argc != 2 and argc != 3) {
+    if (master) {
+      std::cout << "wrong input(s)!" << std::endl
+                << "hammurabi X requires the path to the XML parameter file"
+                << std::endl
+                << "try hamx_mpi -h for more details." << std::endl;
+    }
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  const std::string input(argv[1]);
+  if (input == "-h") {
+    if (master) {
+      std::cout << "to execute hammurabi X with MPI you need to use"
+                << std::endl
+                << "mpirun -np [ranks] hamx_mpi [XML parameter file path]"
+                << std::endl
+                << "or in batch mode, one run per line of parameter overrides"
+                << std::endl
+                << "mpirun -np [ranks] hamx_mpi [XML parameter file path] "
+                   "[JSON-lines file path]"
+                << std::endl
+                << "an XML template file can be found in the templates "
+                   "directory"
+                << std::endl;
+    }
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+  }
+  try {
+#ifndef NTIMING
+    auto tmr = std::make_unique<Timer>();
+    tmr->start("main");
+#endif
+    auto run = std::make_unique<Pipeline>(input);
+    if (argc == 3) {
+      run->assemble_batch(std::string(argv[2]));
+    } else {
+      run->assemble_grid();
+      run->assemble_tereg();
+      run->assemble_breg();
+      run->assemble_ternd();
+      run->assemble_brnd();
+      run->assemble_cre();
+      run->assemble_obs();
+    }
+    run->wait_export();
+    run->export_profile();
+#ifndef NTIMING
+    tmr->stop("main");
+    if (master) {
+      tmr->print();
+    }
+#endif
+  } catch (const std::exception &e) {
+    // one failing rank would leave others waiting in collectives
+    std::cerr << "rank " << hammpi::rank() << ": " << e.what() << std::endl;
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
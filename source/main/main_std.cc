@@ -5,11 +5,12 @@
 #include <string>
 
 #include <pipeline.h>
+#include <server.h>
 #include <timer.h>
 
 int main(int argc, char **argv) {
   // helping
-  if (argc != 2) {
+  if (argc < 2 or argc > 4 or (argc == 4 and std::string(argv[2]) != "-s")) {
     std::cout << "wrong input(s)!" << std::endl
               << "hammurabi X requires the path to the XML parameter file"
               << std::endl
@@ -20,6 +21,14 @@ int main(int argc, char **argv) {
   if (input == "-h") {
     std::cout << "to execute hammurabi X you need to use" << std::endl
               << "hamx [XML parameter file path]" << std::endl
+              << "or in batch mode, one run per line of parameter overrides"
+              << std::endl
+              << "hamx [XML parameter file path] [JSON-lines file path]"
+              << std::endl
+              << "or as resident server of requests on a UNIX-domain socket"
+              << std::endl
+              << "hamx [XML parameter file path] -s [socket file path]"
+              << std::endl
               << "an XML template file can be found in the templates directory"
               << std::endl;
     return EXIT_SUCCESS;
@@ -28,14 +37,27 @@ int main(int argc, char **argv) {
   auto tmr = std::make_unique<Timer>();
   tmr->start("main");
 #endif
-  auto run = std::make_unique<Pipeline>(input);
-  run->assemble_grid();
-  run->assemble_tereg();
-  run->assemble_breg();
-  run->assemble_ternd();
-  run->assemble_brnd();
-  run->assemble_cre();
-  run->assemble_obs();
+  if (argc == 4) {
+    auto server = std::make_unique<Server>(input);
+    server->serve(std::string(argv[3]));
+    server->wait_export();
+    server->export_profile();
+  } else {
+    auto run = std::make_unique<Pipeline>(input);
+    if (argc == 3) {
+      run->assemble_batch(std::string(argv[2]));
+    } else {
+      run->assemble_grid();
+      run->assemble_tereg();
+      run->assemble_breg();
+      run->assemble_ternd();
+      run->assemble_brnd();
+      run->assemble_cre();
+      run->assemble_obs();
+    }
+    run->wait_export();
+    run->export_profile();
+  }
 #ifndef NTIMING
   tmr->stop("main");
   tmr->print();
@@ -1,7 +1,12 @@
 #include <cmath>
+#include <fstream>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
+#include <hamgrid.h>
 #include <hamtype.h>
 #include <hamunits.h>
 #include <hamvec.h>
@@ -9,22 +14,60 @@
 #include <tinyxml2.h>
 #include <toolkit.h>
 
-Param::Param(const std::string file_name) {
-  // load xml file
-  std::unique_ptr<tinyxml2::XMLDocument> doc{toolkit::loadxml(file_name)};
-  // observer position
-  tinyxml2::XMLElement *ptr{toolkit::tracexml(doc.get(), {"grid", "observer"})};
-  observer =
-      Hamvec<3, ham_float>{cgs::kpc * toolkit::fetchfloat(ptr, "value", "x"),
-                           cgs::kpc * toolkit::fetchfloat(ptr, "value", "y"),
-                           cgs::kpc * toolkit::fetchfloat(ptr, "value", "z")};
+Param::Param(const std::string file_name)
+    : Param(toolkit::loadxml(file_name).get()) {}
+
+Param::Param(tinyxml2::XMLDocument *doc) {
+  // observer positions, maps are integrated from each of them
+  // while field models refer to the first one only
+  tinyxml2::XMLElement *ptr{toolkit::tracexml(doc, {"grid"})};
+  for (auto e = ptr->FirstChildElement("observer"); e != nullptr;
+       e = e->NextSiblingElement("observer")) {
+    grid_obs.observer_list.push_back(
+        Hamvec<3, ham_float>{cgs::kpc * toolkit::fetchfloat(e, "value", "x"),
+                             cgs::kpc * toolkit::fetchfloat(e, "value", "y"),
+                             cgs::kpc * toolkit::fetchfloat(e, "value", "z")});
+  }
+  if (grid_obs.observer_list.empty()) {
+    throw std::runtime_error("missing observer");
+  }
+  observer = grid_obs.observer_list.front();
+  grid_obs.origin = observer;
+  grid_obs.origin_tag.clear();
   // collect parameters
-  obs_param(doc.get());
-  breg_param(doc.get());
-  brnd_param(doc.get());
-  tereg_param(doc.get());
-  ternd_param(doc.get());
-  cre_param(doc.get());
+  profile_param(doc);
+  output_param(doc);
+  obs_param(doc);
+  breg_param(doc);
+  brnd_param(doc);
+  tereg_param(doc);
+  ternd_param(doc);
+  cre_param(doc);
+  gradient_param(doc);
+  stage_param(doc);
+  cache_param(doc);
+}
+
+void Param::profile_param(tinyxml2::XMLDocument *doc) {
+  tinyxml2::XMLElement *ptr{toolkit::tracexml(doc, {})};
+  profile.do_profile = false;
+  if (ptr->FirstChildElement("profile") != nullptr and
+      toolkit::fetchbool(ptr, "cue", "profile")) {
+    profile.do_profile = true;
+    profile.filename = toolkit::fetchstring(ptr, "filename", "profile");
+    profile.format = toolkit::fetchstring(ptr, "format", "profile");
+    if (profile.format != "json" and profile.format != "chrome") {
+      throw std::runtime_error("unsupported profile format");
+    }
+  }
+}
+
+void Param::output_param(tinyxml2::XMLDocument *doc) {
+  tinyxml2::XMLElement *ptr{toolkit::tracexml(doc, {})};
+  if (ptr->FirstChildElement("output") != nullptr) {
+    output.async = toolkit::fetchbool(ptr, "async", "output");
+    output.fsync = toolkit::fetchbool(ptr, "fsync", "output");
+  }
 }
 
 void Param::obs_param(tinyxml2::XMLDocument *doc) {
@@ -51,25 +94,22 @@ void Param::obs_param(tinyxml2::XMLDocument *doc) {
     grid_obs.do_fd = false;
   }
   // if synchrotron emission is required
+  // only channels with cue="1" are recorded
+  // all recorded channels are integrated in a single LoS pass
+  grid_obs.do_sync = false;
   if (ptr->FirstChildElement("sync") != nullptr) {
     grid_obs.write_permission = true;
-    tinyxml2::XMLElement *subptr{
-        toolkit::tracexml(doc, {"observable", "sync"})};
-    grid_obs.do_sync.push_back(toolkit::fetchbool(subptr, "cue"));
-    grid_obs.sim_sync_freq.push_back(toolkit::fetchfloat(subptr, "freq") *
-                                     cgs::GHz);
-    grid_obs.sim_sync_name.push_back(toolkit::fetchstring(subptr, "filename"));
-    grid_obs.nside_sync.push_back(toolkit::fetchuint(subptr, "nside"));
-    for (auto e = subptr->NextSiblingElement("sync"); e != nullptr;
+    for (auto e = ptr->FirstChildElement("sync"); e != nullptr;
          e = e->NextSiblingElement("sync")) {
-      grid_obs.do_sync.push_back(toolkit::fetchbool(e, "cue"));
+      if (not toolkit::fetchbool(e, "cue")) {
+        continue;
+      }
+      grid_obs.do_sync = true;
       grid_obs.sim_sync_freq.push_back(toolkit::fetchfloat(e, "freq") *
                                        cgs::GHz);
       grid_obs.sim_sync_name.push_back(toolkit::fetchstring(e, "filename"));
       grid_obs.nside_sync.push_back(toolkit::fetchuint(e, "nside"));
     }
-  } else {
-    grid_obs.do_sync.push_back(false);
   }
   // if any observable is requried
   if (grid_obs.write_permission) {
@@ -131,6 +171,76 @@ void Param::obs_param(tinyxml2::XMLDocument *doc) {
     } else {
       throw std::runtime_error("unsupported layer option");
     }
+    // adaptive radial integration
+    // tolerances are listed from inside out, the last one is repeated
+    grid_obs.do_adaptive = false;
+    grid_obs.tol_shell.clear();
+    if (ptr->FirstChildElement("adaptive") != nullptr and
+        toolkit::fetchbool(ptr, "cue", "adaptive")) {
+      tinyxml2::XMLElement *subptr{
+          toolkit::tracexml(doc, {"grid", "shell", "adaptive"})};
+      grid_obs.do_adaptive = true;
+      grid_obs.oc_r_res_max =
+          toolkit::fetchfloat(subptr, "value", "oc_r_res_max") * cgs::kpc;
+      for (auto e = subptr->FirstChildElement("tol"); e != nullptr;
+           e = e->NextSiblingElement("tol")) {
+        grid_obs.tol_shell.push_back(toolkit::fetchfloat(e, "value"));
+      }
+      if (grid_obs.tol_shell.empty()) {
+        throw std::runtime_error("missing adaptive tolerance");
+      }
+      grid_obs.tol_shell.resize(grid_obs.total_shell,
+                                grid_obs.tol_shell.back());
+    }
+    // angular refinement and pixel traversal order
+    // both rely on NESTED indexing, which requires nside of power 2
+    auto pow2 = [](const ham_uint &n) { return n > 0 and !(n & (n - 1)); };
+    grid_obs.do_refine = false;
+    if (ptr->FirstChildElement("refine") != nullptr and
+        toolkit::fetchbool(ptr, "cue", "refine")) {
+      tinyxml2::XMLElement *subptr{
+          toolkit::tracexml(doc, {"grid", "shell", "refine"})};
+      grid_obs.do_refine = true;
+      grid_obs.nside_refine = toolkit::fetchuint(subptr, "value", "nside_min");
+      grid_obs.tol_refine = toolkit::fetchfloat(subptr, "value", "tol");
+      if (not pow2(grid_obs.nside_refine)) {
+        throw std::runtime_error("invalid refinement nside");
+      }
+    }
+    grid_obs.do_nested = false;
+    if (ptr->FirstChildElement("traversal") != nullptr and
+        toolkit::fetchbool(ptr, "cue", "traversal")) {
+      grid_obs.do_nested = true;
+      grid_obs.nside_tile = toolkit::fetchuint(
+          toolkit::tracexml(doc, {"grid", "shell", "traversal"}), "value",
+          "nside_tile");
+      if (not pow2(grid_obs.nside_tile)) {
+        throw std::runtime_error("invalid traversal tile nside");
+      }
+    }
+    // field samples are cached at fixed radial steps of every pixel
+    grid_obs.do_cache = false;
+    if (ptr->FirstChildElement("cache") != nullptr and
+        toolkit::fetchbool(ptr, "cue", "cache")) {
+      grid_obs.do_cache = true;
+      grid_obs.cache_single =
+          toolkit::fetchstring(ptr, "precision", "cache") == "single";
+      grid_obs.cache_name = toolkit::fetchstring(ptr, "filename", "cache");
+      if (grid_obs.do_adaptive or grid_obs.do_refine) {
+        throw std::runtime_error(
+            "LoS cache requires non-adaptive and non-refined integration");
+      }
+      if (grid_obs.observer_list.size() > 1) {
+        throw std::runtime_error("LoS cache requires single observer");
+      }
+    }
+    if (grid_obs.do_refine or grid_obs.do_nested) {
+      for (auto n : grid_obs.nside_shell) {
+        if (not pow2(n)) {
+          throw std::runtime_error("NESTED indexing requires nside of 2^n");
+        }
+      }
+    }
     // get mask map upon request
     ptr = toolkit::tracexml(doc, {"mask"});
     if (toolkit::fetchbool(ptr, "cue")) {
@@ -150,6 +260,8 @@ void Param::breg_param(tinyxml2::XMLDocument *doc) {
     grid_breg.read_permission = toolkit::fetchbool(ptr, "read", "breg");
     grid_breg.write_permission = toolkit::fetchbool(ptr, "write", "breg");
     grid_breg.filename = toolkit::fetchstring(ptr, "filename", "breg");
+    grid_breg.import_mode = import_param(ptr, "breg");
+    codec_param(ptr, "breg", grid_breg);
   }
   // breg internal
   ptr = toolkit::tracexml(doc, {"magneticfield"});
@@ -264,6 +376,9 @@ void Param::breg_param(tinyxml2::XMLDocument *doc) {
     grid_breg.y_min = cgs::kpc * toolkit::fetchfloat(subptr, "value", "y_min");
     grid_breg.z_max = cgs::kpc * toolkit::fetchfloat(subptr, "value", "z_max");
     grid_breg.z_min = cgs::kpc * toolkit::fetchfloat(subptr, "value", "z_min");
+    grid_breg.order = order_param(subptr);
+    grid_breg.interp = interp_param(subptr);
+    grid_breg.interleave = subptr->BoolAttribute("interleave", false);
   }
 }
 
@@ -274,6 +389,8 @@ void Param::brnd_param(tinyxml2::XMLDocument *doc) {
     grid_brnd.read_permission = toolkit::fetchbool(ptr, "read", "brnd");
     grid_brnd.write_permission = toolkit::fetchbool(ptr, "write", "brnd");
     grid_brnd.filename = toolkit::fetchstring(ptr, "filename", "brnd");
+    grid_brnd.import_mode = import_param(ptr, "brnd");
+    codec_param(ptr, "brnd", grid_brnd);
   }
   // brnd internal
   ptr = toolkit::tracexml(doc, {"magneticfield"});
@@ -352,6 +469,9 @@ void Param::brnd_param(tinyxml2::XMLDocument *doc) {
     grid_brnd.y_min = cgs::kpc * toolkit::fetchfloat(ptr, "value", "y_min");
     grid_brnd.z_max = cgs::kpc * toolkit::fetchfloat(ptr, "value", "z_max");
     grid_brnd.z_min = cgs::kpc * toolkit::fetchfloat(ptr, "value", "z_min");
+    grid_brnd.order = order_param(ptr);
+    grid_brnd.interp = interp_param(ptr);
+    grid_brnd.interleave = ptr->BoolAttribute("interleave", false);
   }
 }
 
@@ -362,6 +482,8 @@ void Param::tereg_param(tinyxml2::XMLDocument *doc) {
     grid_tereg.read_permission = toolkit::fetchbool(ptr, "read", "tereg");
     grid_tereg.write_permission = toolkit::fetchbool(ptr, "write", "tereg");
     grid_tereg.filename = toolkit::fetchstring(ptr, "filename", "tereg");
+    grid_tereg.import_mode = import_param(ptr, "tereg");
+    codec_param(ptr, "tereg", grid_tereg);
   }
   // tereg internal
   ptr = toolkit::tracexml(doc, {"thermalelectron"});
@@ -556,6 +678,8 @@ void Param::tereg_param(tinyxml2::XMLDocument *doc) {
     grid_tereg.y_min = cgs::kpc * toolkit::fetchfloat(ptr, "value", "y_min");
     grid_tereg.z_max = cgs::kpc * toolkit::fetchfloat(ptr, "value", "z_max");
     grid_tereg.z_min = cgs::kpc * toolkit::fetchfloat(ptr, "value", "z_min");
+    grid_tereg.order = order_param(ptr);
+    grid_tereg.interp = interp_param(ptr);
   }
 }
 
@@ -566,6 +690,8 @@ void Param::ternd_param(tinyxml2::XMLDocument *doc) {
     grid_ternd.read_permission = toolkit::fetchbool(ptr, "read", "ternd");
     grid_ternd.write_permission = toolkit::fetchbool(ptr, "write", "ternd");
     grid_ternd.filename = toolkit::fetchstring(ptr, "filename", "ternd");
+    grid_ternd.import_mode = import_param(ptr, "ternd");
+    codec_param(ptr, "ternd", grid_ternd);
   }
   // ternd internal
   ptr = toolkit::tracexml(doc, {"thermalelectron"});
@@ -608,6 +734,8 @@ void Param::ternd_param(tinyxml2::XMLDocument *doc) {
     grid_ternd.y_min = cgs::kpc * toolkit::fetchfloat(ptr, "value", "y_min");
     grid_ternd.z_max = cgs::kpc * toolkit::fetchfloat(ptr, "value", "z_max");
     grid_ternd.z_min = cgs::kpc * toolkit::fetchfloat(ptr, "value", "z_min");
+    grid_ternd.order = order_param(ptr);
+    grid_ternd.interp = interp_param(ptr);
   }
 }
 
@@ -618,6 +746,8 @@ void Param::cre_param(tinyxml2::XMLDocument *doc) {
     grid_cre.read_permission = toolkit::fetchbool(ptr, "read", "cre");
     grid_cre.write_permission = toolkit::fetchbool(ptr, "write", "cre");
     grid_cre.filename = toolkit::fetchstring(ptr, "filename", "cre");
+    grid_cre.import_mode = import_param(ptr, "cre");
+    codec_param(ptr, "cre", grid_cre);
   }
   // cre internal
   ptr = toolkit::tracexml(doc, {"cre"});
@@ -666,5 +796,259 @@ void Param::cre_param(tinyxml2::XMLDocument *doc) {
     grid_cre.z_max = cgs::kpc * toolkit::fetchfloat(ptr, "value", "z_max");
     grid_cre.z_min = cgs::kpc * toolkit::fetchfloat(ptr, "value", "z_min");
     grid_cre.cre_size = grid_cre.nE * grid_cre.nx * grid_cre.ny * grid_cre.nz;
+    // optional synchrotron kernel accuracy
+    if (ptr->FirstChildElement("kernel_tol") != nullptr) {
+      grid_cre.kernel_tol = toolkit::fetchfloat(ptr, "value", "kernel_tol");
+    }
+  }
+}
+
+// mapped grid must not be overwritten by export of itself,
+// as truncating a mapped file invalidates the mapping
+std::string Param::import_param(tinyxml2::XMLElement *el,
+                                const std::string &key) {
+  tinyxml2::XMLElement *io{el->FirstChildElement(key.c_str())};
+  const char *mode{io->Attribute("import")};
+  if (mode == nullptr) {
+    return "stream";
   }
+  const std::string result{mode};
+  if (result != "stream" and result != "mmap" and result != "populate") {
+    throw std::runtime_error("unsupported import mode " + result + " of " +
+                             key);
+  }
+  if (result != "stream" and io->BoolAttribute("read") and
+      io->BoolAttribute("write")) {
+    throw std::runtime_error("mapped import of " + key +
+                             " cannot be exported");
+  }
+  return result;
+}
+
+std::string Param::order_param(tinyxml2::XMLElement *box) {
+  const char *order{box->Attribute("order")};
+  if (order == nullptr) {
+    return "row";
+  }
+  const std::string result{order};
+  if (result != "row" and result != "brick" and result != "morton") {
+    throw std::runtime_error("unsupported grid order " + result + " of " +
+                             box->Name());
+  }
+  return result;
+}
+
+std::string Param::interp_param(tinyxml2::XMLElement *box) {
+  const char *interp{box->Attribute("interp")};
+  if (interp == nullptr) {
+    return "linear";
+  }
+  const std::string result{interp};
+  if (result != "linear" and result != "catmull-rom" and
+      result != "bspline") {
+    throw std::runtime_error("unsupported grid interpolation " + result +
+                             " of " + box->Name());
+  }
+  return result;
+}
+
+// optional export codec of field grid, "none" by default,
+// lossy codec requires an error bound, bricks are of 2^k cells in edge
+template <typename G>
+void Param::codec_param(tinyxml2::XMLElement *el, const std::string &key,
+                        G &grid) {
+  tinyxml2::XMLElement *io{el->FirstChildElement(key.c_str())};
+  const char *codec{io->Attribute("codec")};
+  grid.codec = codec == nullptr ? "none" : codec;
+  if (grid.codec != "none" and grid.codec != "lossless" and
+      grid.codec != "lossy") {
+    throw std::runtime_error("unsupported codec " + grid.codec + " of " +
+                             key);
+  }
+  grid.tolerance = io->DoubleAttribute("tolerance", 0.);
+  if (grid.codec == "lossy" and not(grid.tolerance > 0.)) {
+    throw std::runtime_error("lossy codec of " + key +
+                             " requires positive tolerance");
+  }
+  grid.brick = io->UnsignedAttribute("brick", 32);
+  if (grid.brick == 0 or grid.brick > 1024 or
+      (grid.brick & (grid.brick - 1)) != 0) {
+    throw std::runtime_error("brick edge length of " + key +
+                             " is no power of 2 up to 1024");
+  }
+  grid.cache = io->UnsignedAttribute("cache", 1024);
+  if (grid.cache == 0) {
+    throw std::runtime_error("brick cache of " + key + " is empty");
+  }
+}
+
+// only analytic regular fields and CRE can be shifted, as the
+// integrator re-reads them at LoS samples of the base parameters,
+// while random fields and field grids are kept
+void Param::gradient_param(tinyxml2::XMLDocument *doc) {
+  tinyxml2::XMLElement *ptr{toolkit::tracexml(doc, {})};
+  gradient.do_gradient = false;
+  gradient.name.clear();
+  gradient.keychain.clear();
+  gradient.shift.clear();
+  if (ptr->FirstChildElement("gradient") == nullptr or
+      not toolkit::fetchbool(ptr, "cue", "gradient")) {
+    return;
+  }
+  gradient.do_gradient = true;
+  const ham_float step{toolkit::fetchfloat(ptr, "step", "gradient")};
+  if (not(step > 0.)) {
+    throw std::runtime_error("invalid gradient step");
+  }
+  if (grid_obs.do_adaptive or grid_obs.do_refine or grid_obs.do_cache) {
+    throw std::runtime_error("gradient requires uniform LoS integration "
+                             "without refinement and cache");
+  }
+  ptr = toolkit::tracexml(doc, {"gradient"});
+  for (auto e = ptr->FirstChildElement("param"); e != nullptr;
+       e = e->NextSiblingElement("param")) {
+    const std::string path{toolkit::fetchstring(e, "path")};
+    std::vector<std::string> keys;
+    std::stringstream ss(path);
+    for (std::string key; std::getline(ss, key, '/');) {
+      keys.push_back(key);
+    }
+    const bool regular{keys.size() > 2 and keys[1] == "regular"};
+    const bool valid{
+        (regular and keys[0] == "magneticfield" and
+         not grid_breg.read_permission) or
+        (regular and keys[0] == "thermalelectron" and
+         not grid_tereg.read_permission) or
+        (keys.size() > 1 and keys[0] == "cre" and
+         not grid_cre.read_permission)};
+    // element with value attribute is required
+    tinyxml2::XMLElement *target{valid ? toolkit::tracexml(doc, {}) : nullptr};
+    for (auto k = keys.begin(); target != nullptr and k != keys.end(); ++k) {
+      target = target->FirstChildElement(k->c_str());
+    }
+    if (target == nullptr or target->Attribute("value") == nullptr) {
+      throw std::runtime_error("unsupported gradient parameter: " + path);
+    }
+    const ham_float value{toolkit::fetchfloat(target, "value")};
+    gradient.name.push_back(toolkit::fetchstring(e, "name"));
+    gradient.keychain.push_back(keys);
+    // relative step, absolute for vanishing parameter
+    gradient.shift.push_back(value == 0. ? step : step * std::fabs(value));
+  }
+  if (gradient.name.empty()) {
+    throw std::runtime_error("missing gradient parameter");
+  }
+}
+
+// each key hashes printed XML elements of a stage, with those of
+// its field grid and the first observer, whom field models refer to
+void Param::stage_param(tinyxml2::XMLDocument *doc) {
+  auto element = [&doc](const std::vector<std::string> &keychain) {
+    tinyxml2::XMLElement *el{doc->FirstChildElement("root")};
+    for (auto k = keychain.begin(); el != nullptr and k != keychain.end();
+         ++k) {
+      el = el->FirstChildElement(k->c_str());
+    }
+    return el;
+  };
+  auto print = [&element](const std::vector<std::string> &keychain) {
+    tinyxml2::XMLElement *el{element(keychain)};
+    if (el == nullptr) {
+      return std::string();
+    }
+    tinyxml2::XMLPrinter printer(nullptr, true);
+    el->Accept(&printer);
+    return std::string(printer.CStr());
+  };
+  // grid allocation depends on I/O, box and model switch
+  auto grid = [&](const std::string &name,
+                  const std::vector<std::string> &model) {
+    tinyxml2::XMLElement *el{element(model)};
+    const char *cue{el == nullptr ? nullptr : el->Attribute("cue")};
+    return print({"fieldio", name}) + print({"grid", "box_" + name}) +
+           (cue == nullptr ? "" : cue);
+  };
+  const std::string observer{print({"grid", "observer"})};
+  const std::string tereg{grid("tereg", {"thermalelectron", "regular"})};
+  const std::string breg{grid("breg", {"magneticfield", "regular"})};
+  const std::string ternd{grid("ternd", {"thermalelectron", "random"})};
+  const std::string brnd{grid("brnd", {"magneticfield", "random"})};
+  const std::string cre{grid("cre", {"cre"})};
+  stage_key.grid_tereg = toolkit::hash(tereg);
+  stage_key.grid_breg = toolkit::hash(breg);
+  stage_key.grid_ternd = toolkit::hash(ternd);
+  stage_key.grid_brnd = toolkit::hash(brnd);
+  stage_key.grid_cre = toolkit::hash(cre);
+  stage_key.grid_obs = toolkit::hash(print({"observable"}) + print({"mask"}));
+  stage_key.tereg = toolkit::hash(
+      tereg + observer + print({"thermalelectron", "regular"}));
+  stage_key.breg =
+      toolkit::hash(breg + observer + print({"magneticfield", "regular"}));
+  stage_key.ternd = toolkit::hash(
+      ternd + observer + print({"thermalelectron", "random"}));
+  // random magnetic field follows regular one
+  stage_key.brnd =
+      toolkit::hash(brnd + observer + print({"magneticfield", "random"}) +
+                    std::to_string(stage_key.breg));
+  stage_key.cre = toolkit::hash(cre + observer + print({"cre"}));
+}
+
+// field samples depend on everything but observables, mask, CRE
+// and profiling, so the key is a hash of the XML tree without them,
+// and of headers of imported grid files, whose checksums follow file
+// content that the XML tree does not show
+// samples are kept per field realization, so any change of field
+// parameters, amplitudes included, discards them
+void Param::cache_param(tinyxml2::XMLDocument *doc) {
+  if (not grid_obs.do_cache) {
+    return;
+  }
+  tinyxml2::XMLDocument copy;
+  doc->DeepCopy(&copy);
+  tinyxml2::XMLElement *root{copy.FirstChildElement("root")};
+  auto drop = [](tinyxml2::XMLElement *parent, const char *name) {
+    if (parent != nullptr) {
+      while (parent->FirstChildElement(name) != nullptr) {
+        parent->DeleteChild(parent->FirstChildElement(name));
+      }
+    }
+  };
+  drop(root, "observable");
+  drop(root, "mask");
+  drop(root, "cre");
+  drop(root, "profile");
+  drop(root, "gradient");
+  drop(root->FirstChildElement("fieldio"), "cre");
+  tinyxml2::XMLElement *grid{root->FirstChildElement("grid")};
+  drop(grid, "box_cre");
+  drop(grid->FirstChildElement("shell"), "cache");
+  tinyxml2::XMLPrinter printer(nullptr, true);
+  copy.Print(&printer);
+  // missing files are left to grid import
+  auto imported = [](const bool &read, const std::string &filename) {
+    if (not read) {
+      return std::string();
+    }
+    std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+    if (not input.is_open()) {
+      return std::string();
+    }
+    std::vector<char> buffer(hamgrid::page);
+    input.read(buffer.data(), buffer.size());
+    const hamgrid::header h{
+        hamgrid::parse(buffer.data(), input.gcount(), filename)};
+    return std::to_string(h.bytes) + "_" + std::to_string(h.checksum);
+  };
+  grid_obs.cache_key = toolkit::hash(
+      printer.CStr() +
+      imported(grid_breg.read_permission, grid_breg.filename) +
+      imported(grid_brnd.read_permission, grid_brnd.filename) +
+      imported(grid_tereg.read_permission, grid_tereg.filename) +
+      imported(grid_ternd.read_permission, grid_ternd.filename));
+  // seed 0 gives a new random realization in every run
+  grid_obs.cache_stable =
+      not((grid_brnd.build_permission and not grid_brnd.read_permission and
+           brnd_seed == 0) or
+          (grid_ternd.build_permission and not grid_ternd.read_permission and
+           ternd_seed == 0));
 }
@@ -1,36 +1,84 @@
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <bfield.h>
 #include <crefield.h>
 #include <grid.h>
+#include <hammpi.h>
 #include <hamtype.h>
+#include <hamwriter.h>
 #include <integrator.h>
 #include <param.h>
 #include <pipeline.h>
+#include <profiler.h>
 #include <tefield.h>
 #include <toolkit.h>
 
 // constructor
-Pipeline::Pipeline(const std::string &filename) {
-  par = std::make_unique<Param>(filename);
+Pipeline::Pipeline(const std::string &filename) : xml_name{filename} {
+  std::unique_ptr<tinyxml2::XMLDocument> doc{toolkit::loadxml(filename)};
+  par = std::make_unique<Param>(doc.get());
+  assemble_shift(doc.get());
+}
+
+// shifted parameters are parsed from copies of XML document
+void Pipeline::assemble_shift(tinyxml2::XMLDocument *doc) {
+  par_shift.clear();
+  if (not par->gradient.do_gradient) {
+    return;
+  }
+  // file name with suffix before extension, as in Grid_obs::export_grid
+  auto suffix = [](std::string name, const std::string &tag) {
+    return name.insert(name.size() - 4, "_d" + tag);
+  };
+  for (ham_uint k = 0; k != par->gradient.name.size(); ++k) {
+    tinyxml2::XMLElement *ptr{
+        toolkit::tracexml(doc, par->gradient.keychain[k])};
+    const ham_float value{toolkit::fetchfloat(ptr, "value")};
+    for (const ham_float sign : {1., -1.}) {
+      tinyxml2::XMLDocument copy;
+      doc->DeepCopy(&copy);
+      toolkit::tracexml(&copy, par->gradient.keychain[k])
+          ->SetAttribute("value", value + sign * par->gradient.shift[k]);
+      par_shift.push_back(std::make_unique<Param>(&copy));
+    }
+    // derivative maps are written with parameters shifted upwards
+    const std::string &tag{par->gradient.name[k]};
+    Param::param_obs_grid &target{par_shift[2 * k]->grid_obs};
+    target.sim_dm_name = suffix(target.sim_dm_name, tag);
+    target.sim_fd_name = suffix(target.sim_fd_name, tag);
+    for (auto &name : target.sim_sync_name) {
+      name = suffix(name, tag);
+    }
+  }
 }
 
 void Pipeline::assemble_grid() {
+  HAM_PROFILE_STAGE("pipeline/grid");
   grid_tereg = std::make_unique<Grid_tereg>(par.get());
   grid_breg = std::make_unique<Grid_breg>(par.get());
   grid_brnd = std::make_unique<Grid_brnd>(par.get());
   grid_ternd = std::make_unique<Grid_ternd>(par.get());
   grid_cre = std::make_unique<Grid_cre>(par.get());
   grid_obs = std::make_unique<Grid_obs>(par.get());
+  built.grid_tereg = par->stage_key.grid_tereg;
+  built.grid_breg = par->stage_key.grid_breg;
+  built.grid_brnd = par->stage_key.grid_brnd;
+  built.grid_ternd = par->stage_key.grid_ternd;
+  built.grid_cre = par->stage_key.grid_cre;
+  built.grid_obs = par->stage_key.grid_obs;
 }
 
 // regular thermel electron field
 void Pipeline::assemble_tereg() {
+  HAM_PROFILE_STAGE("pipeline/tereg");
+  built.tereg = par->stage_key.tereg;
   if (!par->grid_tereg.build_permission) {
     tereg = std::make_unique<TEreg>();
     return;
@@ -49,12 +97,18 @@ void Pipeline::assemble_tereg() {
   if (par->grid_tereg.write_permission) {
     // write out binary file and exit
     tereg->write_grid(par.get(), grid_tereg.get());
-    grid_tereg->export_grid(par.get());
+    if (hammpi::rank() == 0) {
+      export_file(grid_tereg.get(), par.get());
+    }
   }
+  // exported as values, read as interpolation coefficients
+  grid_tereg->prefilter_grid();
 }
 
 // regular magnetic field
 void Pipeline::assemble_breg() {
+  HAM_PROFILE_STAGE("pipeline/breg");
+  built.breg = par->stage_key.breg;
   if (!par->grid_breg.build_permission) {
     breg = std::make_unique<Breg>();
     return;
@@ -73,12 +127,18 @@ void Pipeline::assemble_breg() {
   // if export to file
   if (par->grid_breg.write_permission) {
     breg->write_grid(par.get(), grid_breg.get());
-    grid_breg->export_grid(par.get());
+    if (hammpi::rank() == 0) {
+      export_file(grid_breg.get(), par.get());
+    }
   }
+  // exported as values, read as interpolation coefficients
+  grid_breg->prefilter_grid();
 }
 
 // random thermal electron field
 void Pipeline::assemble_ternd() {
+  HAM_PROFILE_STAGE("pipeline/ternd");
+  built.ternd = par->stage_key.ternd;
   // if import from file, no need to build specific fe_rnd class
   if (par->grid_ternd.read_permission) {
     grid_ternd->import_grid(par.get());
@@ -91,19 +151,24 @@ void Pipeline::assemble_ternd() {
       // fill grid with random fields
       ternd->write_grid(par.get(), tereg.get(), grid_tereg.get(),
                         grid_ternd.get());
+      // MPI ranks share the realization of rank 0
+      hammpi::broadcast(grid_ternd->te.data(), grid_ternd->te.size());
     } else
       throw std::runtime_error("unsupported brnd model");
   } else {
     ternd = std::make_unique<TErnd>();
   }
   // if export to file
-  if (par->grid_ternd.write_permission) {
-    grid_ternd->export_grid(par.get());
+  if (par->grid_ternd.write_permission and hammpi::rank() == 0) {
+    export_file(grid_ternd.get(), par.get());
   }
+  grid_ternd->prefilter_grid();
 }
 
 // random magnetic field
 void Pipeline::assemble_brnd() {
+  HAM_PROFILE_STAGE("pipeline/brnd");
+  built.brnd = par->stage_key.brnd;
   if (par->grid_brnd.read_permission) {
     grid_brnd->import_grid(par.get());
     brnd = std::make_unique<Brnd>();
@@ -123,18 +188,31 @@ void Pipeline::assemble_brnd() {
       brnd->write_grid(par.get(), breg.get(), grid_breg.get(), grid_brnd.get());
     } else
       throw std::runtime_error("unsupported brnd model");
+    // MPI ranks share the realization of rank 0
+    if (grid_brnd->bx.stride() == 1) {
+      hammpi::broadcast(grid_brnd->bx.data(), grid_brnd->bx.size());
+      hammpi::broadcast(grid_brnd->by.data(), grid_brnd->by.size());
+      hammpi::broadcast(grid_brnd->bz.data(), grid_brnd->bz.size());
+    } else {
+      // interleaved components share one allocation, led by bx
+      hammpi::broadcast(&grid_brnd->bx[0],
+                        grid_brnd->bx.size() * grid_brnd->bx.stride());
+    }
   } else {
     // without read permission, return zeros
     brnd = std::make_unique<Brnd>();
   }
   // if export to file
-  if (par->grid_brnd.write_permission) {
-    grid_brnd->export_grid(par.get());
+  if (par->grid_brnd.write_permission and hammpi::rank() == 0) {
+    export_file(grid_brnd.get(), par.get());
   }
+  grid_brnd->prefilter_grid();
 }
 
 // cre flux field
 void Pipeline::assemble_cre() {
+  HAM_PROFILE_STAGE("pipeline/cre");
+  built.cre = par->stage_key.cre;
   if (par->grid_cre.read_permission) {
     grid_cre->import_grid(par.get());
     cre = std::make_unique<CRE_num>();
@@ -149,34 +227,230 @@ void Pipeline::assemble_cre() {
   // if export to file
   if (par->grid_cre.write_permission) {
     cre->write_grid(par.get(), grid_cre.get());
-    grid_cre->export_grid(par.get());
+    if (hammpi::rank() == 0) {
+      export_file(grid_cre.get(), par.get());
+    }
   }
 }
 
 // LoS integration for observables
+// all synchrotron channels are integrated in one pass
+// with MPI, every rank holds the full maps and rank 0 writes them
 void Pipeline::assemble_obs() {
-  intobj = std::make_unique<Integrator>();
+  HAM_PROFILE_STAGE("pipeline/obs");
+  // LoS field samples are replayed if fields are unchanged,
+  // with several MPI ranks each rank caches its own pixels
+  Ray_cache *cache{nullptr};
+  std::string cache_name{par->grid_obs.cache_name};
+  if (par->grid_obs.do_cache and par->grid_obs.cache_stable) {
+    if (not ray_cache) {
+      ray_cache = std::make_unique<Ray_cache>();
+    }
+    if (not cache_name.empty() and hammpi::size() > 1) {
+      cache_name += "." + std::to_string(hammpi::rank());
+    }
+    // pixels are dealt to ranks by rank number
+    ray_cache->open(par->grid_obs.cache_key + hammpi::size(),
+                    par->grid_obs.cache_single, cache_name);
+    cache = ray_cache.get();
+  }
+  intobj = std::make_unique<Integrator>(cache);
   if (par->grid_obs.write_permission) {
-    const auto repeat = par->grid_obs.do_sync.size();
-    for (ham_uint i = 0; i < repeat; ++i) {
-      if (i > 0) {
-        par->grid_obs.do_dm = false;
-        par->grid_obs.do_fd = false;
-        // need to rebuild integration grid
-        grid_obs->build_grid(par.get());
+    // one set of maps per observer, from the same fields,
+    // pipeline ends with maps of the last observer
+    for (ham_uint o = 0; o != par->grid_obs.observer_list.size(); ++o) {
+      select_observer(o);
+      grid_obs->clear_grid();
+      if (par->gradient.do_gradient) {
+        assemble_gradient();
+      } else {
+        intobj->write_grid(breg.get(), brnd.get(), tereg.get(), ternd.get(),
+                           cre.get(), grid_breg.get(), grid_brnd.get(),
+                           grid_tereg.get(), grid_ternd.get(), grid_cre.get(),
+                           grid_obs.get(), par.get());
+      }
+      if (hammpi::rank() == 0) {
+        export_obs(grid_obs.get(), par.get());
+        for (ham_uint k = 0; k != grid_grad.size(); ++k) {
+          export_obs(grid_grad[k].get(), par_shift[2 * k].get());
+        }
+      }
+    }
+    select_observer(0);
+  }
+  if (cache != nullptr and cache->modified() and not cache_name.empty()) {
+    cache->save(cache_name);
+  }
+}
+
+void Pipeline::export_obs(Grid_obs *grid, const Param *p) {
+  export_file(grid, p);
+}
+
+// arrays are packed in calling thread, so that grids and maps
+// can change while their files are written
+void Pipeline::export_file(Grid *grid, const Param *p) {
+  if (not p->output.async) {
+    grid->export_grid(p);
+    return;
+  }
+  if (not writer) {
+    writer = std::make_unique<Hamwriter>();
+  }
+  for (auto &f : grid->export_data(p)) {
+    writer->write(f.first, std::move(f.second), p->output.fsync);
+  }
+}
+
+void Pipeline::wait_export() {
+  if (writer) {
+    writer->wait();
+  }
+}
+
+// the first observer keeps map file names of the run
+void Pipeline::select_observer(const ham_uint &o) {
+  const std::string tag{run_tag +
+                        (o == 0 ? "" : "_obs" + std::to_string(o))};
+  par->grid_obs.origin = par->grid_obs.observer_list[o];
+  par->grid_obs.origin_tag = tag;
+  for (auto &p : par_shift) {
+    p->grid_obs.origin = par->grid_obs.observer_list[o];
+    p->grid_obs.origin_tag = tag;
+  }
+}
+
+// derivatives are taken wrt parameter values in XML units,
+// random fields and field grids are kept fixed
+void Pipeline::assemble_gradient() {
+  std::vector<std::unique_ptr<Grid_obs>> grid_shift;
+  std::vector<Grid_obs *> gobs_list{grid_obs.get()};
+  std::vector<const Param *> par_list{par.get()};
+  for (auto &p : par_shift) {
+    grid_shift.push_back(std::make_unique<Grid_obs>(p.get()));
+    gobs_list.push_back(grid_shift.back().get());
+    par_list.push_back(p.get());
+  }
+  intobj->write_grid(breg.get(), brnd.get(), tereg.get(), ternd.get(),
+                     cre.get(), grid_breg.get(), grid_brnd.get(),
+                     grid_tereg.get(), grid_ternd.get(), grid_cre.get(),
+                     gobs_list, par_list);
+  grid_grad.clear();
+  for (ham_uint k = 0; k != par->gradient.shift.size(); ++k) {
+    Grid_obs *up{grid_shift[2 * k].get()};
+    const Grid_obs *down{grid_shift[2 * k + 1].get()};
+    const ham_float scale{0.5 / par->gradient.shift[k]};
+    auto difference = [&scale](Hampix<ham_float> *a,
+                               const Hampix<ham_float> *b) {
+      if (a == nullptr) {
+        return;
       }
-      intobj->write_grid(breg.get(), brnd.get(), tereg.get(), ternd.get(),
-                         cre.get(), grid_breg.get(), grid_brnd.get(),
-                         grid_tereg.get(), grid_ternd.get(), grid_cre.get(),
-                         grid_obs.get(), par.get());
-      grid_obs->export_grid(par.get());
-      // delete obsolete parameters
-      if (par->grid_obs.do_sync.back()) {
-        par->grid_obs.nside_sync.pop_back();
-        par->grid_obs.do_sync.pop_back();
-        par->grid_obs.sim_sync_freq.pop_back();
-        par->grid_obs.sim_sync_name.pop_back();
+      for (ham_uint i = 0; i != a->npix(); ++i) {
+        a->data(i, (a->data(i) - b->data(i)) * scale);
       }
+    };
+    difference(up->dm_map.get(), down->dm_map.get());
+    difference(up->fd_map.get(), down->fd_map.get());
+    for (decltype(up->is_map.size()) c = 0; c != up->is_map.size(); ++c) {
+      difference(up->is_map[c].get(), down->is_map[c].get());
+      difference(up->qs_map[c].get(), down->qs_map[c].get());
+      difference(up->us_map[c].get(), down->us_map[c].get());
     }
+    grid_grad.push_back(std::move(grid_shift[2 * k]));
+  }
+}
+
+// grids are allocated again only if their size or I/O changed,
+// random fields without fixed seed are new in every run
+void Pipeline::rerun(tinyxml2::XMLDocument *doc, const std::string &tag) {
+  // files of previous runs may be read by this one
+  wait_export();
+  par = std::make_unique<Param>(doc);
+  assemble_shift(doc);
+  run_tag = tag;
+  const Param::param_stage &key{par->stage_key};
+  if (built.grid_tereg != key.grid_tereg) {
+    grid_tereg = std::make_unique<Grid_tereg>(par.get());
+    built.grid_tereg = key.grid_tereg;
+  }
+  if (built.grid_breg != key.grid_breg) {
+    grid_breg = std::make_unique<Grid_breg>(par.get());
+    built.grid_breg = key.grid_breg;
+  }
+  if (built.grid_brnd != key.grid_brnd) {
+    grid_brnd = std::make_unique<Grid_brnd>(par.get());
+    built.grid_brnd = key.grid_brnd;
+  }
+  if (built.grid_ternd != key.grid_ternd) {
+    grid_ternd = std::make_unique<Grid_ternd>(par.get());
+    built.grid_ternd = key.grid_ternd;
+  }
+  if (built.grid_cre != key.grid_cre) {
+    grid_cre = std::make_unique<Grid_cre>(par.get());
+    built.grid_cre = key.grid_cre;
+  }
+  if (built.grid_obs != key.grid_obs) {
+    grid_obs = std::make_unique<Grid_obs>(par.get());
+    built.grid_obs = key.grid_obs;
+  }
+  if (built.tereg != key.tereg) {
+    assemble_tereg();
+  }
+  if (built.breg != key.breg) {
+    assemble_breg();
+  }
+  if (built.ternd != key.ternd or
+      (par->grid_ternd.build_permission and
+       not par->grid_ternd.read_permission and par->ternd_seed == 0)) {
+    assemble_ternd();
+  }
+  if (built.brnd != key.brnd or
+      (par->grid_brnd.build_permission and
+       not par->grid_brnd.read_permission and par->brnd_seed == 0)) {
+    assemble_brnd();
+  }
+  if (built.cre != key.cre) {
+    assemble_cre();
+  }
+  assemble_obs();
+}
+
+// runs are numbered by non-empty lines, from zero
+void Pipeline::assemble_batch(const std::string &filename) {
+  std::ifstream input(filename.c_str());
+  if (!input.is_open()) {
+    throw std::runtime_error("open file error: " + filename);
+  }
+  std::unique_ptr<tinyxml2::XMLDocument> base{toolkit::loadxml(xml_name)};
+  ham_uint count{0};
+  for (std::string line; std::getline(input, line);) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    tinyxml2::XMLDocument doc;
+    base->DeepCopy(&doc);
+    for (const auto &item : toolkit::parse_record(line)) {
+      toolkit::override_xml(&doc, item.first, item.second);
+    }
+    rerun(&doc, "_run" + std::to_string(count++));
+  }
+}
+
+// with several MPI ranks, each rank writes its own file
+// with rank index appended to file name
+void Pipeline::export_profile() const {
+#ifndef NTIMING
+  if (not par->profile.do_profile) {
+    return;
+  }
+  std::string filename{par->profile.filename};
+  if (hammpi::size() > 1) {
+    filename += "." + std::to_string(hammpi::rank());
+  }
+  if (par->profile.format == "chrome") {
+    Profiler::instance().export_trace(filename);
+  } else {
+    Profiler::instance().export_json(filename);
   }
+#endif
 }
@@ -0,0 +1,180 @@
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <grid.h>
+#include <hamtype.h>
+#include <param.h>
+#include <pipeline.h>
+#include <server.h>
+#include <tinyxml2.h>
+#include <toolkit.h>
+
+namespace {
+// client closing early must not raise SIGPIPE in server
+#ifdef MSG_NOSIGNAL
+const int send_flags{MSG_NOSIGNAL};
+#else
+const int send_flags{0};
+#endif
+
+// write whole buffer into socket
+// return false if client is gone
+bool send_all(const int &fd, const std::string &data) {
+  std::size_t done{0};
+  while (done < data.size()) {
+    const ssize_t n{
+        ::send(fd, data.data() + done, data.size() - done, send_flags)};
+    if (n < 0 and errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+// remove socket file, any other file at path is kept
+// return false if path holds a file other than a socket
+bool unlink_socket(const std::string &path) {
+  struct stat st;
+  if (::lstat(path.c_str(), &st) != 0) {
+    return true;
+  }
+  if (not S_ISSOCK(st.st_mode)) {
+    return false;
+  }
+  ::unlink(path.c_str());
+  return true;
+}
+} // namespace
+
+Server::Server(const std::string &filename)
+    : Pipeline(filename), base{toolkit::loadxml(filename)} {}
+
+// one client at a time, requests of a client are answered in order
+void Server::serve(const std::string &path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  if (path.empty() or path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("invalid socket path: " + path);
+  }
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  const int fd{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  if (fd < 0) {
+    throw std::runtime_error("socket error: " +
+                             std::string(std::strerror(errno)));
+  }
+  // socket file left by a previous server
+  if (not unlink_socket(path)) {
+    ::close(fd);
+    throw std::runtime_error("socket error: path exists: " + path);
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 or
+      ::listen(fd, 1) != 0) {
+    const std::string msg{std::strerror(errno)};
+    ::close(fd);
+    throw std::runtime_error("socket error: " + msg + ": " + path);
+  }
+  bool running{true};
+  std::string reply;
+  char chunk[4096];
+  while (running) {
+    const int client{::accept(fd, nullptr, nullptr)};
+    if (client < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      const std::string msg{std::strerror(errno)};
+      ::close(fd);
+      unlink_socket(path);
+      throw std::runtime_error("socket error: " + msg + ": " + path);
+    }
+    std::string buffer;
+    while (running) {
+      const std::size_t eol{buffer.find('\n')};
+      if (eol == std::string::npos) {
+        const ssize_t n{::recv(client, chunk, sizeof(chunk), 0)};
+        if (n < 0 and errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          break;
+        }
+        buffer.append(chunk, n);
+        continue;
+      }
+      const std::string line{buffer.substr(0, eol)};
+      buffer.erase(0, eol + 1);
+      running = respond(line, reply);
+      if (not send_all(client, reply)) {
+        break;
+      }
+    }
+    ::close(client);
+  }
+  ::close(fd);
+  unlink_socket(path);
+}
+
+// overrides apply to the base document, not to the previous request
+bool Server::respond(const std::string &line, std::string &reply) {
+  const std::size_t first{line.find_first_not_of(" \t\r")};
+  if (first == std::string::npos) {
+    reply = "error empty request\n";
+    return true;
+  }
+  const std::size_t last{line.find_last_not_of(" \t\r")};
+  if (line.compare(first, last - first + 1, "shutdown") == 0) {
+    reply = "bye\n";
+    return false;
+  }
+  tinyxml2::XMLDocument doc;
+  base->DeepCopy(&doc);
+  payload.clear();
+  payload_count = 0;
+  try {
+    for (const auto &item : toolkit::parse_record(line)) {
+      toolkit::override_xml(&doc, item.first, item.second);
+    }
+    rerun(&doc, "");
+  } catch (const std::exception &e) {
+    // stages of a failed run are not trusted by next request
+    built = Param::param_stage();
+    payload.clear();
+    std::string msg{e.what()};
+    for (auto &c : msg) {
+      c = (c == '\n') ? ' ' : c;
+    }
+    reply = "error " + msg + "\n";
+    return true;
+  }
+  reply = "ok " + std::to_string(payload_count) + "\n";
+  reply += payload;
+  payload.clear();
+  return true;
+}
+
+void Server::export_obs(Grid_obs *grid, const Param *p) {
+  for (const auto &m : grid->export_list(p)) {
+    const ham_uint npix{m.second->npix()};
+    payload += m.first + " " + std::to_string(npix) + "\n";
+    payload.reserve(payload.size() + npix * sizeof(ham_float));
+    for (ham_uint i = 0; i != npix; ++i) {
+      const ham_float v{m.second->data(i)};
+      payload.append(reinterpret_cast<const char *>(&v), sizeof(ham_float));
+    }
+    ++payload_count;
+  }
+}
@@ -0,0 +1,209 @@
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <hammpi.h>
+#include <hamtype.h>
+#include <profiler.h>
+
+constexpr ham_uint Profiler::capacity;
+
+Profiler::Profiler() : epoch{clock::now()} {}
+
+Profiler &Profiler::instance() {
+  static Profiler prof;
+  return prof;
+}
+
+ham_uint Profiler::find(const std::vector<std::string> &names,
+                        const std::string &name) const {
+  for (ham_uint i = 0; i != names.size(); ++i) {
+    if (names[i] == name)
+      return i;
+  }
+  return capacity;
+}
+
+ham_uint Profiler::region(const std::string &name, const bool &stage) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  const ham_uint id{find(this->region_name, name)};
+  if (id != capacity)
+    return id;
+  if (this->region_name.size() == capacity)
+    throw std::runtime_error("too many profiling regions");
+  this->region_stage[this->region_name.size()] = stage;
+  this->region_name.push_back(name);
+  return this->region_name.size() - 1;
+}
+
+ham_uint Profiler::counter(const std::string &name) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  const ham_uint id{find(this->counter_name, name)};
+  if (id != capacity)
+    return id;
+  if (this->counter_name.size() == capacity)
+    throw std::runtime_error("too many profiling counters");
+  this->counter_name.push_back(name);
+  return this->counter_name.size() - 1;
+}
+
+// each thread caches pointer to its own records,
+// records live as long as the profiler
+Profiler::struct_thread *Profiler::local() {
+  thread_local struct_thread *rec{nullptr};
+  if (rec == nullptr) {
+    auto fresh = std::make_unique<struct_thread>();
+    fresh->time.fill(0.);
+    fresh->calls.fill(0);
+    fresh->count.fill(0);
+    rec = fresh.get();
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->records.push_back(std::move(fresh));
+  }
+  return rec;
+}
+
+void Profiler::add_time(const ham_uint &id, const tick &begin,
+                        const tick &end) {
+  struct_thread *rec{local()};
+  const ham_float us{
+      std::chrono::duration<ham_float, std::micro>(end - begin).count()};
+  rec->time[id] += us;
+  ++rec->calls[id];
+  if (this->region_stage[id]) {
+    rec->events.push_back(
+        {id,
+         std::chrono::duration<ham_float, std::micro>(begin - this->epoch)
+             .count(),
+         us});
+  }
+}
+
+void Profiler::reset() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  for (auto &rec : this->records) {
+    rec->time.fill(0.);
+    rec->calls.fill(0);
+    rec->count.fill(0);
+    rec->events.clear();
+  }
+}
+
+ham_float Profiler::total_time(const std::string &name) const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  const ham_uint id{find(this->region_name, name)};
+  ham_float sum{0.};
+  if (id != capacity) {
+    for (auto &rec : this->records)
+      sum += rec->time[id];
+  }
+  // in milliseconds
+  return 1e-3 * sum;
+}
+
+ham_uint Profiler::total_calls(const std::string &name) const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  const ham_uint id{find(this->region_name, name)};
+  ham_uint sum{0};
+  if (id != capacity) {
+    for (auto &rec : this->records)
+      sum += rec->calls[id];
+  }
+  return sum;
+}
+
+ham_uint Profiler::total_count(const std::string &name) const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  const ham_uint id{find(this->counter_name, name)};
+  ham_uint sum{0};
+  if (id != capacity) {
+    for (auto &rec : this->records)
+      sum += rec->count[id];
+  }
+  return sum;
+}
+
+ham_uint Profiler::threads() const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->records.size();
+}
+
+// region times are reported in milliseconds,
+// per-thread lists follow the order in which threads first recorded
+std::string Profiler::summary() const {
+  std::ostringstream out;
+  out << std::setprecision(12);
+  out << "\"regions\": [";
+  for (ham_uint id = 0; id != this->region_name.size(); ++id) {
+    ham_float time{0.};
+    ham_uint calls{0};
+    std::ostringstream per_time, per_calls;
+    per_time << std::setprecision(12);
+    for (ham_uint t = 0; t != this->records.size(); ++t) {
+      time += this->records[t]->time[id];
+      calls += this->records[t]->calls[id];
+      per_time << (t ? ", " : "") << 1e-3 * this->records[t]->time[id];
+      per_calls << (t ? ", " : "") << this->records[t]->calls[id];
+    }
+    out << (id ? ",\n" : "\n") << "  {\"name\": \"" << this->region_name[id]
+        << "\", \"stage\": " << (this->region_stage[id] ? "true" : "false")
+        << ", \"calls\": " << calls << ", \"time_ms\": " << 1e-3 * time
+        << ", \"thread_calls\": [" << per_calls.str()
+        << "], \"thread_time_ms\": [" << per_time.str() << "]}";
+  }
+  out << "\n],\n\"counters\": [";
+  for (ham_uint id = 0; id != this->counter_name.size(); ++id) {
+    ham_uint count{0};
+    std::ostringstream per_count;
+    for (ham_uint t = 0; t != this->records.size(); ++t) {
+      count += this->records[t]->count[id];
+      per_count << (t ? ", " : "") << this->records[t]->count[id];
+    }
+    out << (id ? ",\n" : "\n") << "  {\"name\": \"" << this->counter_name[id]
+        << "\", \"count\": " << count << ", \"thread_count\": ["
+        << per_count.str() << "]}";
+  }
+  out << "\n]";
+  return out.str();
+}
+
+void Profiler::export_json(const std::string &filename) const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  std::ofstream output(filename.c_str(), std::ios::out);
+  if (!output.is_open())
+    throw std::runtime_error("open file error: " + filename);
+  output << "{\n\"rank\": " << hammpi::rank() << ",\n\"threads\": "
+         << this->records.size() << ",\n"
+         << summary() << "\n}\n";
+}
+
+// stage calls become complete events, with MPI rank as process
+// and thread record index as thread
+void Profiler::export_trace(const std::string &filename) const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  std::ofstream output(filename.c_str(), std::ios::out);
+  if (!output.is_open())
+    throw std::runtime_error("open file error: " + filename);
+  output << std::setprecision(15);
+  output << "{\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [";
+  bool first{true};
+  for (ham_uint t = 0; t != this->records.size(); ++t) {
+    output << (first ? "\n" : ",\n") << "{\"name\": \"thread_name\", "
+           << "\"ph\": \"M\", \"pid\": " << hammpi::rank()
+           << ", \"tid\": " << t << ", \"args\": {\"name\": \"thread " << t
+           << "\"}}";
+    first = false;
+    for (const auto &e : this->records[t]->events) {
+      output << ",\n{\"name\": \"" << this->region_name[e.id]
+             << "\", \"cat\": \"stage\", \"ph\": \"X\", \"ts\": " << e.begin
+             << ", \"dur\": " << e.duration << ", \"pid\": " << hammpi::rank()
+             << ", \"tid\": " << t << "}";
+    }
+  }
+  output << "\n],\n\"otherData\": {\n" << summary() << "\n}}\n";
+}
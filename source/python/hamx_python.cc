@@ -0,0 +1,524 @@
+// Python extension module _hamx
+//
+// Pipeline objects run the pipeline in process and expose observable
+// maps and field grids through the buffer protocol, so that
+// numpy.asarray takes them without copying,
+// maps are strided views into HEALPix nodes, grids are C-ordered
+//
+// arrays are read-only and belong to the run that produced them,
+// a pipeline refuses to run while buffers of its arrays are exported,
+// and arrays of earlier runs refuse to export
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <grid.h>
+#include <hamarray.h>
+#include <hamdis.h>
+#include <hamtype.h>
+#include <param.h>
+#include <pipeline.h>
+#include <tinyxml2.h>
+#include <toolkit.h>
+
+namespace {
+
+// raw array description
+struct array_view {
+  std::string name;
+  const void *buf;
+  // "d" or "f"
+  const char *format;
+  Py_ssize_t itemsize;
+  std::vector<Py_ssize_t> shape, strides;
+};
+
+// contiguous C-ordered array
+template <typename T>
+array_view c_array(const std::string &name, const T *buf,
+                   const std::vector<Py_ssize_t> &shape) {
+  std::vector<Py_ssize_t> strides(shape.size(), sizeof(T));
+  for (auto i = shape.size() - 1; i > 0; --i) {
+    strides[i - 1] = strides[i] * shape[i];
+  }
+  return array_view{name, buf, sizeof(T) == sizeof(float) ? "f" : "d",
+                    sizeof(T), shape, strides};
+}
+
+// grid component, strided if a view into an interleaved file mapping
+template <typename T>
+array_view c_array(const std::string &name, const Hamarray<T> &a,
+                   const std::vector<Py_ssize_t> &shape) {
+  array_view result{c_array(name, a.data(), shape)};
+  for (auto &s : result.strides) {
+    s *= a.stride();
+  }
+  return result;
+}
+
+// pipeline with parameters from XML text and maps kept in memory
+class Pipeline_py final : public Pipeline {
+public:
+  Pipeline_py(const std::string &text) { load(text); }
+  // replace XML document, parameters are parsed at next run
+  // 1st argument: XML document text
+  void load(const std::string &text) {
+    if (doc.Parse(text.c_str()) != tinyxml2::XML_SUCCESS) {
+      throw std::runtime_error("XML parse error: " +
+                               std::string(doc.ErrorStr()));
+    }
+    if (not par) {
+      // stages called one by one use parameters of construction
+      par = std::make_unique<Param>(&doc);
+      assemble_shift(&doc);
+    }
+  }
+  // override one parameter of XML document, applied at next run
+  // 1st argument: dotted key path, see toolkit::override_xml
+  // 2nd argument: new value
+  void set(const std::string &key, const std::string &value) {
+    toolkit::override_xml(&doc, key, value);
+  }
+  // XML document text
+  std::string text() const {
+    tinyxml2::XMLPrinter printer;
+    doc.Print(&printer);
+    return printer.CStr();
+  }
+  // assemble stages whose parameters changed, then observables,
+  // field files requested by XML are written upon return
+  void run() {
+    rerun(&doc, "");
+    wait_export();
+  }
+  void assemble_obs() override {
+    maps.clear();
+    kept.clear();
+    Pipeline::assemble_obs();
+  }
+  // observable maps of last integration
+  std::vector<array_view> map_views() const {
+    std::vector<array_view> result;
+    for (const auto &m : maps) {
+      result.push_back(array_view{
+          m.first,
+          m.second->data_address(),
+          "d",
+          sizeof(ham_float),
+          {static_cast<Py_ssize_t>(m.second->npix())},
+          {static_cast<Py_ssize_t>(sizeof(Node<ham_float>))}});
+    }
+    return result;
+  }
+  // allocated field grids, grids decoded on demand hold no array, grids
+  // of other than row-major memory order are not C-ordered, grids of
+  // B-spline interpolation hold coefficients rather than values
+  std::vector<array_view> field_views() const {
+    std::vector<array_view> result;
+    auto shape = [](const ham_uint &nx, const ham_uint &ny,
+                    const ham_uint &nz) {
+      return std::vector<Py_ssize_t>{static_cast<Py_ssize_t>(nx),
+                                     static_cast<Py_ssize_t>(ny),
+                                     static_cast<Py_ssize_t>(nz)};
+    };
+    if (grid_breg and grid_breg->bx and not grid_breg->bx.chunked() and
+        grid_breg->layout.row() and not grid_breg->interp.prefiltered()) {
+      const auto s = shape(par->grid_breg.nx, par->grid_breg.ny,
+                           par->grid_breg.nz);
+      result.push_back(c_array("breg_x", grid_breg->bx, s));
+      result.push_back(c_array("breg_y", grid_breg->by, s));
+      result.push_back(c_array("breg_z", grid_breg->bz, s));
+    }
+    if (grid_brnd and grid_brnd->bx and not grid_brnd->bx.chunked() and
+        grid_brnd->layout.row() and not grid_brnd->interp.prefiltered()) {
+      const auto s = shape(par->grid_brnd.nx, par->grid_brnd.ny,
+                           par->grid_brnd.nz);
+      result.push_back(c_array("brnd_x", grid_brnd->bx, s));
+      result.push_back(c_array("brnd_y", grid_brnd->by, s));
+      result.push_back(c_array("brnd_z", grid_brnd->bz, s));
+    }
+    if (grid_tereg and grid_tereg->te and not grid_tereg->te.chunked() and
+        grid_tereg->layout.row() and not grid_tereg->interp.prefiltered()) {
+      result.push_back(c_array("tereg", grid_tereg->te,
+                               shape(par->grid_tereg.nx, par->grid_tereg.ny,
+                                     par->grid_tereg.nz)));
+    }
+    if (grid_ternd and grid_ternd->te and not grid_ternd->te.chunked() and
+        grid_ternd->layout.row() and not grid_ternd->interp.prefiltered()) {
+      result.push_back(c_array("ternd", grid_ternd->te,
+                               shape(par->grid_ternd.nx, par->grid_ternd.ny,
+                                     par->grid_ternd.nz)));
+    }
+    if (grid_cre and grid_cre->cre_flux and not grid_cre->cre_flux.chunked()) {
+      std::vector<Py_ssize_t> s{shape(par->grid_cre.nx, par->grid_cre.ny,
+                                      par->grid_cre.nz)};
+      s.insert(s.begin(), static_cast<Py_ssize_t>(par->grid_cre.nE));
+      result.push_back(c_array("cre", grid_cre->cre_flux, s));
+    }
+    return result;
+  }
+
+protected:
+  tinyxml2::XMLDocument doc;
+  // maps by export file name
+  std::vector<std::pair<std::string, const Hampix<ham_float> *>> maps;
+  // copies of maps from observers before the last one,
+  // whose observable grid is reused
+  std::vector<std::unique_ptr<Hampix<ham_float>>> kept;
+  void export_obs(Grid_obs *grid, const Param *p) override {
+    for (const auto &m : grid->export_list(p)) {
+      if (par->grid_obs.observer_list.size() > 1) {
+        kept.push_back(std::make_unique<Hampix<ham_float>>(*m.second));
+        maps.emplace_back(m.first, kept.back().get());
+      } else {
+        maps.emplace_back(m.first, m.second);
+      }
+    }
+  }
+};
+
+struct PipelineObject {
+  PyObject_HEAD
+  Pipeline_py *pipe;
+  // number of exported buffers
+  Py_ssize_t exports;
+  // incremented by every call that may change arrays
+  unsigned long generation;
+  // set while a stage runs without GIL
+  bool busy;
+};
+
+struct ArrayObject {
+  PyObject_HEAD
+  PipelineObject *owner;
+  unsigned long generation;
+  array_view view;
+};
+
+// type slots are filled in module initialization
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+PyTypeObject PipelineType = {PyVarObject_HEAD_INIT(NULL, 0)};
+PyTypeObject ArrayType = {PyVarObject_HEAD_INIT(NULL, 0)};
+#pragma GCC diagnostic pop
+
+// ArrayObject
+
+void array_dealloc(ArrayObject *self) {
+  Py_XDECREF(self->owner);
+  self->view.~array_view();
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject *>(self));
+}
+
+int array_getbuffer(ArrayObject *self, Py_buffer *view, int flags) {
+  if (self->generation != self->owner->generation) {
+    PyErr_SetString(PyExc_BufferError, "array of a previous run");
+    return -1;
+  }
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "array is read-only");
+    return -1;
+  }
+  const array_view &a{self->view};
+  Py_ssize_t count{1};
+  for (const auto &n : a.shape) {
+    count *= n;
+  }
+  const bool contiguous{a.strides.back() == a.itemsize};
+  if (not contiguous and (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+    PyErr_SetString(PyExc_BufferError, "array is strided");
+    return -1;
+  }
+  view->obj = reinterpret_cast<PyObject *>(self);
+  Py_INCREF(self);
+  view->buf = const_cast<void *>(a.buf);
+  view->len = count * a.itemsize;
+  view->readonly = 1;
+  view->itemsize = a.itemsize;
+  view->format =
+      (flags & PyBUF_FORMAT) ? const_cast<char *>(a.format) : nullptr;
+  view->ndim = static_cast<int>(a.shape.size());
+  view->shape = (flags & PyBUF_ND) == PyBUF_ND
+                    ? const_cast<Py_ssize_t *>(a.shape.data())
+                    : nullptr;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES
+                      ? const_cast<Py_ssize_t *>(a.strides.data())
+                      : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  ++self->owner->exports;
+  return 0;
+}
+
+void array_releasebuffer(ArrayObject *self, Py_buffer *) {
+  --self->owner->exports;
+}
+
+PyBufferProcs array_as_buffer = {
+    reinterpret_cast<getbufferproc>(array_getbuffer),
+    reinterpret_cast<releasebufferproc>(array_releasebuffer)};
+
+PyObject *array_repr(ArrayObject *self) {
+  std::string shape;
+  for (const auto &n : self->view.shape) {
+    shape += (shape.empty() ? "" : ", ") + std::to_string(n);
+  }
+  return PyUnicode_FromFormat("<_hamx.Array %s (%s)>",
+                              self->view.name.c_str(), shape.c_str());
+}
+
+// dictionary of arrays by name
+PyObject *array_dict(PipelineObject *owner,
+                     const std::vector<array_view> &views) {
+  PyObject *dict{PyDict_New()};
+  if (dict == nullptr) {
+    return nullptr;
+  }
+  for (const auto &v : views) {
+    ArrayObject *a{PyObject_New(ArrayObject, &ArrayType)};
+    if (a == nullptr) {
+      Py_DECREF(dict);
+      return nullptr;
+    }
+    new (&a->view) array_view(v);
+    Py_INCREF(owner);
+    a->owner = owner;
+    a->generation = owner->generation;
+    const int status{PyDict_SetItemString(dict, v.name.c_str(),
+                                          reinterpret_cast<PyObject *>(a))};
+    Py_DECREF(a);
+    if (status != 0) {
+      Py_DECREF(dict);
+      return nullptr;
+    }
+  }
+  return dict;
+}
+
+// PipelineObject
+
+void pipeline_dealloc(PipelineObject *self) {
+  delete self->pipe;
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject *>(self));
+}
+
+PyObject *pipeline_new(PyTypeObject *type, PyObject *, PyObject *) {
+  PipelineObject *self{
+      reinterpret_cast<PipelineObject *>(type->tp_alloc(type, 0))};
+  if (self != nullptr) {
+    self->pipe = nullptr;
+    self->exports = 0;
+    self->generation = 0;
+    self->busy = false;
+  }
+  return reinterpret_cast<PyObject *>(self);
+}
+
+int pipeline_init(PipelineObject *self, PyObject *args, PyObject *) {
+  const char *text;
+  if (not PyArg_ParseTuple(args, "s", &text)) {
+    return -1;
+  }
+  try {
+    delete self->pipe;
+    self->pipe = nullptr;
+    self->pipe = new Pipeline_py(text);
+  } catch (const std::exception &e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return -1;
+  }
+  return 0;
+}
+
+// arrays must not be in use while a stage changes them
+bool pipeline_ready(PipelineObject *self) {
+  if (self->pipe == nullptr) {
+    PyErr_SetString(PyExc_RuntimeError, "pipeline is not initialized");
+    return false;
+  }
+  if (self->busy) {
+    PyErr_SetString(PyExc_RuntimeError, "pipeline is running");
+    return false;
+  }
+  if (self->exports > 0) {
+    PyErr_SetString(PyExc_BufferError,
+                    "existing exports of pipeline arrays");
+    return false;
+  }
+  return true;
+}
+
+// run pipeline member without GIL
+// 1st argument: Python pipeline object
+// 2nd argument: member of Pipeline_py to call
+template <typename F> PyObject *pipeline_call(PipelineObject *self, F f) {
+  if (not pipeline_ready(self)) {
+    return nullptr;
+  }
+  ++self->generation;
+  self->busy = true;
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS;
+  try {
+    f(self->pipe);
+  } catch (const std::exception &e) {
+    error = e.what();
+  }
+  Py_END_ALLOW_THREADS;
+  self->busy = false;
+  if (not error.empty()) {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return nullptr;
+  }
+  Py_RETURN_NONE;
+}
+
+PyObject *pipeline_run(PipelineObject *self, PyObject *args) {
+  const char *text{nullptr};
+  if (not PyArg_ParseTuple(args, "|z", &text)) {
+    return nullptr;
+  }
+  const std::string xml{text == nullptr ? "" : text};
+  return pipeline_call(self, [&xml](Pipeline_py *p) {
+    if (not xml.empty()) {
+      p->load(xml);
+    }
+    p->run();
+  });
+}
+
+PyObject *pipeline_set(PipelineObject *self, PyObject *args) {
+  const char *key, *value;
+  if (not PyArg_ParseTuple(args, "ss", &key, &value)) {
+    return nullptr;
+  }
+  if (self->pipe == nullptr) {
+    PyErr_SetString(PyExc_RuntimeError, "pipeline is not initialized");
+    return nullptr;
+  }
+  try {
+    self->pipe->set(key, value);
+  } catch (const std::exception &e) {
+    PyErr_SetString(PyExc_KeyError, e.what());
+    return nullptr;
+  }
+  Py_RETURN_NONE;
+}
+
+PyObject *pipeline_xml(PipelineObject *self, PyObject *) {
+  if (self->pipe == nullptr) {
+    PyErr_SetString(PyExc_RuntimeError, "pipeline is not initialized");
+    return nullptr;
+  }
+  return PyUnicode_FromString(self->pipe->text().c_str());
+}
+
+PyObject *pipeline_maps(PipelineObject *self, PyObject *) {
+  if (self->pipe == nullptr) {
+    PyErr_SetString(PyExc_RuntimeError, "pipeline is not initialized");
+    return nullptr;
+  }
+  return array_dict(self, self->pipe->map_views());
+}
+
+PyObject *pipeline_fields(PipelineObject *self, PyObject *) {
+  if (self->pipe == nullptr) {
+    PyErr_SetString(PyExc_RuntimeError, "pipeline is not initialized");
+    return nullptr;
+  }
+  return array_dict(self, self->pipe->field_views());
+}
+
+#define HAMX_STAGE(stage)                                                      \
+  PyObject *pipeline_##stage(PipelineObject *self, PyObject *) {               \
+    return pipeline_call(self, [](Pipeline_py *p) { p->stage(); });            \
+  }
+HAMX_STAGE(assemble_grid)
+HAMX_STAGE(assemble_tereg)
+HAMX_STAGE(assemble_breg)
+HAMX_STAGE(assemble_ternd)
+HAMX_STAGE(assemble_brnd)
+HAMX_STAGE(assemble_cre)
+HAMX_STAGE(assemble_obs)
+#undef HAMX_STAGE
+
+PyMethodDef pipeline_methods[] = {
+    {"run", reinterpret_cast<PyCFunction>(pipeline_run), METH_VARARGS,
+     "run([xml]): assemble stages with changed parameters and observables, "
+     "optionally replacing the XML document first"},
+    {"set", reinterpret_cast<PyCFunction>(pipeline_set), METH_VARARGS,
+     "set(key, value): override a parameter by dotted key path, "
+     "applied at next run"},
+    {"xml", reinterpret_cast<PyCFunction>(pipeline_xml), METH_NOARGS,
+     "xml(): current XML document text"},
+    {"maps", reinterpret_cast<PyCFunction>(pipeline_maps), METH_NOARGS,
+     "maps(): observable maps of last run by file name"},
+    {"fields", reinterpret_cast<PyCFunction>(pipeline_fields), METH_NOARGS,
+     "fields(): allocated field grids by name"},
+    {"assemble_grid", reinterpret_cast<PyCFunction>(pipeline_assemble_grid),
+     METH_NOARGS, "allocate grids"},
+    {"assemble_tereg", reinterpret_cast<PyCFunction>(pipeline_assemble_tereg),
+     METH_NOARGS, "regular thermal electron field"},
+    {"assemble_breg", reinterpret_cast<PyCFunction>(pipeline_assemble_breg),
+     METH_NOARGS, "regular magnetic field"},
+    {"assemble_ternd", reinterpret_cast<PyCFunction>(pipeline_assemble_ternd),
+     METH_NOARGS, "random thermal electron field"},
+    {"assemble_brnd", reinterpret_cast<PyCFunction>(pipeline_assemble_brnd),
+     METH_NOARGS, "random magnetic field"},
+    {"assemble_cre", reinterpret_cast<PyCFunction>(pipeline_assemble_cre),
+     METH_NOARGS, "cosmic ray electron field"},
+    {"assemble_obs", reinterpret_cast<PyCFunction>(pipeline_assemble_obs),
+     METH_NOARGS, "LoS integration into observable maps"},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef hamx_module = {PyModuleDef_HEAD_INIT,
+                           "_hamx",
+                           "in-process hammurabi X pipeline",
+                           -1,
+                           nullptr,
+                           nullptr,
+                           nullptr,
+                           nullptr,
+                           nullptr};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit__hamx() {
+  ArrayType.tp_name = "_hamx.Array";
+  ArrayType.tp_basicsize = sizeof(ArrayObject);
+  ArrayType.tp_dealloc = reinterpret_cast<destructor>(array_dealloc);
+  ArrayType.tp_repr = reinterpret_cast<reprfunc>(array_repr);
+  ArrayType.tp_as_buffer = &array_as_buffer;
+  ArrayType.tp_flags = Py_TPFLAGS_DEFAULT;
+  ArrayType.tp_doc = "read-only array of a pipeline run";
+  PipelineType.tp_name = "_hamx.Pipeline";
+  PipelineType.tp_basicsize = sizeof(PipelineObject);
+  PipelineType.tp_dealloc = reinterpret_cast<destructor>(pipeline_dealloc);
+  PipelineType.tp_flags = Py_TPFLAGS_DEFAULT;
+  PipelineType.tp_doc = "Pipeline(xml): pipeline from XML document text";
+  PipelineType.tp_methods = pipeline_methods;
+  PipelineType.tp_init = reinterpret_cast<initproc>(pipeline_init);
+  PipelineType.tp_new = pipeline_new;
+  if (PyType_Ready(&ArrayType) < 0 or PyType_Ready(&PipelineType) < 0) {
+    return nullptr;
+  }
+  PyObject *module{PyModule_Create(&hamx_module)};
+  if (module == nullptr) {
+    return nullptr;
+  }
+  Py_INCREF(&PipelineType);
+  if (PyModule_AddObject(module, "Pipeline",
+                         reinterpret_cast<PyObject *>(&PipelineType)) < 0) {
+    Py_DECREF(&PipelineType);
+    Py_DECREF(module);
+    return nullptr;
+  }
+  return module;
+}
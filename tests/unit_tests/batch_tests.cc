@@ -0,0 +1,129 @@
+// unit tests for batch mode
+// reruns assemble only stages with changed parameters and
+// reproduce maps of separate pipelines
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <bfield.h>
+#include <grid.h>
+#include <hamtype.h>
+#include <param.h>
+#include <tinyxml2.h>
+#include <toolkit.h>
+
+#include "pipeline_test.h"
+
+// remove map files of given run suffix
+// return number of removed files
+ham_uint remove_maps(const std::string &tag) {
+  ham_uint count{0};
+  for (const char *name :
+       {"dm", "fd", "sync_23_I", "sync_23_Q", "sync_23_U", "sync_1.4_I",
+        "sync_1.4_Q", "sync_1.4_U"}) {
+    std::string filename{std::string(name) + ".bin"};
+    const std::size_t cut{filename.find("_", 5)};
+    filename.insert(cut == std::string::npos ? filename.size() - 4 : cut, tag);
+    count += (std::remove(filename.c_str()) == 0);
+  }
+  return count;
+}
+
+// testing:
+// Param::stage_param
+TEST(batch, stage_key) {
+  auto key = [](const std::string &path, const std::string &value) {
+    auto doc = toolkit::loadxml("reference/pipeline_tests.xml");
+    if (not path.empty()) {
+      toolkit::override_xml(doc.get(), path, value);
+    }
+    Param par(doc.get());
+    return par.stage_key;
+  };
+  const Param::param_stage base{key("", "")};
+  const Param::param_stage cre{key("cre.unif.alpha", "2.5")};
+  EXPECT_NE(cre.cre, base.cre);
+  EXPECT_EQ(cre.breg, base.breg);
+  EXPECT_EQ(cre.ternd, base.ternd);
+  EXPECT_EQ(cre.grid_cre, base.grid_cre);
+  // random magnetic field follows regular one
+  const Param::param_stage breg{key("magneticfield.regular.unif.bp", "3")};
+  EXPECT_NE(breg.breg, base.breg);
+  EXPECT_NE(breg.brnd, base.brnd);
+  EXPECT_EQ(breg.grid_breg, base.grid_breg);
+  EXPECT_EQ(breg.tereg, base.tereg);
+  // grid allocation depends on box only
+  const Param::param_stage rms{
+      key("thermalelectron.random.global.dft.rms", "0.02")};
+  EXPECT_NE(rms.ternd, base.ternd);
+  EXPECT_EQ(rms.grid_ternd, base.grid_ternd);
+  const Param::param_stage box{key("grid.box_ternd.nx", "16")};
+  EXPECT_NE(box.grid_ternd, base.grid_ternd);
+  // observables do not invalidate fields
+  const Param::param_stage obs{key("observable.dm@nside", "4")};
+  EXPECT_NE(obs.grid_obs, base.grid_obs);
+  EXPECT_EQ(obs.tereg, base.tereg);
+  EXPECT_EQ(obs.cre, base.cre);
+}
+
+// testing:
+// Pipeline::rerun
+TEST(batch, rerun) {
+  Pipeline_test run("reference/pipeline_tests.xml");
+  auto doc = toolkit::loadxml("reference/pipeline_tests.xml");
+  run.rerun(doc.get(), "_run0");
+  const Breg *breg{run.breg_field()};
+  const Grid_ternd *gternd{run.ternd_grid()};
+  const Grid_obs *gobs{run.obs_grid()};
+  const ham_float te{gternd->te[0]};
+  // CRE only
+  toolkit::override_xml(doc.get(), "cre.unif.alpha", "2.5");
+  run.rerun(doc.get(), "_run1");
+  EXPECT_EQ(run.breg_field(), breg);
+  EXPECT_EQ(run.ternd_grid(), gternd);
+  EXPECT_EQ(run.obs_grid(), gobs);
+  EXPECT_EQ(gternd->te[0], te);
+  doc->SaveFile("batch_tests.xml");
+  Pipeline_test single("batch_tests.xml");
+  single.run();
+  EXPECT_EQ(map_values(run.obs_grid()), map_values(single.obs_grid()));
+  // random field on the same grid
+  toolkit::override_xml(doc.get(), "thermalelectron.random.global.dft.rms",
+                        "0.02");
+  run.rerun(doc.get(), "_run2");
+  EXPECT_EQ(run.ternd_grid(), gternd);
+  EXPECT_EQ(run.breg_field(), breg);
+  EXPECT_NEAR(gternd->te[0], 2. * te, 1e-12 * std::fabs(te));
+  doc->SaveFile("batch_tests.xml");
+  Pipeline_test other("batch_tests.xml");
+  other.run();
+  EXPECT_EQ(map_values(run.obs_grid()), map_values(other.obs_grid()));
+  std::remove("batch_tests.xml");
+  for (const std::string tag : {"_run0", "_run1", "_run2", ""}) {
+    EXPECT_EQ(remove_maps(tag), 8u) << tag;
+  }
+}
+
+// testing:
+// Pipeline::assemble_batch
+TEST(batch, assemble_batch) {
+  {
+    std::ofstream output("batch_tests.jsonl");
+    output << R"({"cre.unif.alpha": 2.5})" << std::endl
+           << std::endl
+           << R"({"magneticfield.regular.unif.bp": 3.0,)"
+           << R"( "observable.sync[1]@freq": 1.5})" << std::endl;
+  }
+  Pipeline_test run("reference/pipeline_tests.xml");
+  run.assemble_batch("batch_tests.jsonl");
+  std::remove("batch_tests.jsonl");
+  EXPECT_EQ(remove_maps("_run0"), 8u);
+  EXPECT_EQ(remove_maps("_run1"), 8u);
+  EXPECT_EQ(remove_maps("_run2"), 0u);
+}
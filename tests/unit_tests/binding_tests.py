@@ -0,0 +1,155 @@
+# unit tests for Python extension module _hamx
+# maps of in-process runs are compared with maps written by hamx,
+# whose path is given by environment variable HAMX
+
+import array
+import os
+import subprocess
+import sys
+import unittest
+
+import _hamx
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+XML = 'reference/pipeline_tests.xml'
+NAMES = ['dm.bin', 'sync_23_I.bin', 'sync_23_Q.bin', 'sync_23_U.bin',
+         'sync_1.4_I.bin', 'sync_1.4_Q.bin', 'sync_1.4_U.bin', 'fd.bin']
+
+
+def executable_maps(text):
+    """
+    maps written by hamx from given XML text
+    """
+    with open('binding_tests.xml', 'w') as f:
+        f.write(text)
+    subprocess.run([os.environ['HAMX'], 'binding_tests.xml'], check=True,
+                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    os.remove('binding_tests.xml')
+    result = dict()
+    for name in NAMES:
+        values = array.array('d')
+        with open(name, 'rb') as f:
+            values.frombytes(f.read())
+        os.remove(name)
+        result[name] = values.tolist()
+    return result
+
+
+class binding(unittest.TestCase):
+
+    def setUp(self):
+        with open(XML) as f:
+            self.text = f.read()
+
+    def test_maps(self):
+        """
+        Pipeline.run, Pipeline.set, Pipeline.maps
+        """
+        pipe = _hamx.Pipeline(self.text)
+        pipe.run()
+        maps = pipe.maps()
+        self.assertEqual(sorted(maps), sorted(NAMES))
+        view = memoryview(maps['dm.bin'])
+        self.assertTrue(view.readonly)
+        self.assertEqual(view.format, 'd')
+        self.assertEqual(view.shape, (768,))
+        # strided view into HEALPix nodes
+        self.assertFalse(view.c_contiguous)
+        view.release()
+        expected = executable_maps(self.text)
+        for name in NAMES:
+            self.assertEqual(memoryview(maps[name]).tolist(), expected[name])
+        # only changed stages are assembled again
+        pipe.set('cre.unif.alpha', '2.5')
+        pipe.run()
+        maps = pipe.maps()
+        expected = executable_maps(pipe.xml())
+        for name in NAMES:
+            self.assertEqual(memoryview(maps[name]).tolist(), expected[name])
+        # whole document replaced
+        pipe.run(self.text)
+        self.assertNotEqual(memoryview(pipe.maps()['sync_23_I.bin']).tolist(),
+                            expected['sync_23_I.bin'])
+
+    def test_fields(self):
+        """
+        Pipeline.assemble_*, Pipeline.fields
+        """
+        pipe = _hamx.Pipeline(self.text)
+        for stage in ['grid', 'tereg', 'breg', 'ternd', 'brnd', 'cre']:
+            getattr(pipe, 'assemble_' + stage)()
+        fields = pipe.fields()
+        self.assertEqual(sorted(fields), ['ternd'])
+        view = memoryview(fields['ternd'])
+        self.assertEqual(view.shape, (32, 32, 16))
+        self.assertIn(view.format, ['d', 'f'])
+        self.assertTrue(view.c_contiguous)
+        self.assertNotEqual(max(view.tolist()[3][5]), 0.)
+        view.release()
+        pipe.assemble_obs()
+        self.assertEqual(len(pipe.maps()), len(NAMES))
+
+    def test_exports(self):
+        """
+        buffer exports block runs, arrays of previous runs are invalid
+        """
+        pipe = _hamx.Pipeline(self.text)
+        pipe.run()
+        dm = pipe.maps()['dm.bin']
+        view = memoryview(dm)
+        with self.assertRaises(BufferError):
+            pipe.run()
+        view.release()
+        pipe.run()
+        with self.assertRaises(BufferError):
+            memoryview(dm)
+
+    def test_errors(self):
+        """
+        C++ exceptions raise Python exceptions
+        """
+        with self.assertRaises(RuntimeError):
+            _hamx.Pipeline('<root>')
+        pipe = _hamx.Pipeline(self.text)
+        with self.assertRaises(KeyError):
+            pipe.set('cre.unif.beta', '1')
+        pipe.run()
+        self.assertEqual(len(pipe.maps()), len(NAMES))
+
+    @unittest.skipIf(np is None, 'numpy is not available')
+    def test_numpy(self):
+        """
+        zero-copy arrays, hampyx running in process
+        """
+        pipe = _hamx.Pipeline(self.text)
+        pipe.run()
+        dm = np.asarray(pipe.maps()['dm.bin'])
+        self.assertEqual(dm.shape, (768,))
+        self.assertGreater(dm.strides[0], dm.itemsize)
+        self.assertFalse(dm.flags.writeable)
+        expected = executable_maps(self.text)
+        self.assertEqual(dm.tolist(), expected['dm.bin'])
+        del dm
+        sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', '..'))
+        import hampyx
+        obj = hampyx.Hampyx(xml_path=os.path.abspath(XML))
+        obj()
+        self.assertEqual(obj.sim_map[('dm', 'nan', '8', 'nan')].tolist(),
+                         expected['dm.bin'])
+        self.assertEqual(obj.sim_map[('sync', '1.4', '16', 'U')].tolist(),
+                         expected['sync_1.4_U.bin'])
+        self.assertEqual(obj.sim_map[('fd', 'nan', '16', 'nan')].tolist(),
+                         expected['fd.bin'])
+        # modified parameters apply to next run
+        obj.mod_par(keychain=['cre', 'unif', 'alpha'], attrib={'value': '2.5'})
+        obj()
+        self.assertNotEqual(obj.sim_map[('sync', '23', '8', 'I')].tolist(),
+                            expected['sync_23_I.bin'])
+
+
+if __name__ == '__main__':
+    unittest.main()
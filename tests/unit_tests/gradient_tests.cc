@@ -0,0 +1,129 @@
+// unit tests for parameter gradient maps
+// derivative maps of one pass are compared with central difference
+// of separate runs with shifted parameters
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <hamtype.h>
+#include <param.h>
+#include <tinyxml2.h>
+#include <toolkit.h>
+
+#include "pipeline_test.h"
+
+// maps of full pipeline
+// 1st argument: XML parameter file
+std::vector<ham_float> simulate(const std::string &filename) {
+  Pipeline_test run(filename);
+  run.run();
+  return map_values(run.obs_grid());
+}
+
+// modified copy of XML parameter file in temporary directory, return
+// path of copy
+// 1st argument: temporary directory
+// 2nd argument: modification of XML document
+std::string edit_xml(const Scratch &scratch,
+                     const std::function<void(tinyxml2::XMLDocument *)> &edit) {
+  const std::string copy{scratch.xml("reference/gradient_tests.xml")};
+  tinyxml2::XMLDocument doc;
+  doc.LoadFile(copy.c_str());
+  edit(&doc);
+  doc.SaveFile(copy.c_str());
+  return copy;
+}
+
+// testing:
+// Param::gradient_param
+TEST(gradient, param) {
+  Param par("reference/gradient_tests.xml");
+  EXPECT_TRUE(par.gradient.do_gradient);
+  ASSERT_EQ(par.gradient.name.size(), 3u);
+  EXPECT_EQ(par.gradient.name[2], "alpha");
+  EXPECT_EQ(par.gradient.keychain[1],
+            (std::vector<std::string>{"thermalelectron", "regular", "unif",
+                                      "r0"}));
+  // relative step
+  EXPECT_DOUBLE_EQ(par.gradient.shift[0], 0.5e-3);
+  EXPECT_DOUBLE_EQ(par.gradient.shift[2], 3.0e-3);
+  // observable parameters are not supported
+  const Scratch scratch;
+  for (const char *path : {"observable/dm", "magneticfield/regular/unif/bx"}) {
+    const std::string xml{
+        edit_xml(scratch, [&path](tinyxml2::XMLDocument *doc) {
+          toolkit::tracexml(doc, {"gradient", "param"})
+              ->SetAttribute("path", path);
+        })};
+    EXPECT_THROW(Param{xml}, std::runtime_error);
+  }
+  // cached LoS samples are not shifted
+  const std::string xml{edit_xml(scratch, [](tinyxml2::XMLDocument *doc) {
+    tinyxml2::XMLElement *e{doc->NewElement("cache")};
+    e->SetAttribute("cue", "1");
+    e->SetAttribute("precision", "double");
+    e->SetAttribute("filename", "");
+    toolkit::tracexml(doc, {"grid", "shell"})->InsertEndChild(e);
+  })};
+  EXPECT_THROW(Param{xml}, std::runtime_error);
+}
+
+// testing:
+// Integrator::write_grid with shifted parameters
+// Integrator::shifted_integration
+// Pipeline::assemble_gradient
+TEST(gradient, maps) {
+  const Scratch scratch;
+  auto run = std::make_unique<Pipeline_test>(
+      scratch.xml("reference/gradient_tests.xml"));
+  run->run();
+  const Param *par{run->param()};
+  for (ham_uint k = 0; k != par->gradient.name.size(); ++k) {
+    const std::vector<std::string> &keys{par->gradient.keychain[k]};
+    tinyxml2::XMLDocument reference;
+    reference.LoadFile("reference/gradient_tests.xml");
+    const ham_float value{
+        toolkit::fetchfloat(toolkit::tracexml(&reference, keys), "value")};
+    const ham_float h{par->gradient.shift[k]};
+    std::vector<std::vector<ham_float>> maps;
+    for (const ham_float sign : {1., -1.}) {
+      const std::string xml{edit_xml(scratch, [&](tinyxml2::XMLDocument *doc) {
+        toolkit::tracexml(doc, keys)->SetAttribute("value", value + sign * h);
+        toolkit::tracexml(doc, {"gradient"})->SetAttribute("cue", "0");
+      })};
+      maps.push_back(simulate(xml));
+    }
+    const std::vector<ham_float> result{
+        map_values(run->gradient_grid(k))};
+    ASSERT_EQ(result.size(), maps[0].size());
+    ham_float scale{0.};
+    for (const auto &v : result) {
+      scale = std::max(scale, std::fabs(v));
+    }
+    EXPECT_GT(scale, 0.);
+    for (ham_uint i = 0; i != result.size(); ++i) {
+      EXPECT_NEAR(result[i], (maps[0][i] - maps[1][i]) * 0.5 / h,
+                  1e-10 * scale);
+    }
+  }
+  // derivative maps are written with suffixed names
+  for (const std::string tag : {"_dbv", "_dr0", "_dalpha"}) {
+    for (const std::string &name :
+         {"dm" + tag, "fd" + tag, "sync_23" + tag + "_I",
+          "sync_23" + tag + "_Q", "sync_23" + tag + "_U",
+          "sync_1.4" + tag + "_I", "sync_1.4" + tag + "_Q",
+          "sync_1.4" + tag + "_U"}) {
+      EXPECT_EQ(::access(scratch.path(name + ".bin").c_str(), F_OK), 0)
+          << name;
+    }
+  }
+}
@@ -5,18 +5,34 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <memory>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <bfield.h>
 #include <crefield.h>
 #include <grid.h>
+#include <hamarray.h>
+#include <hamgrid.h>
+#include <haminterp.h>
+#include <hamlayout.h>
 #include <hamtype.h>
 #include <hamvec.h>
 #include <tefield.h>
 #include <toolkit.h>
 
+// interpolation tolerance, grids stored in single precision
+// are checked to single precision
+const ham_float tolerance{sizeof(ham_store) < sizeof(ham_float) ? 1.0e-6
+                                                                 : 1.0e-10};
+
 void fill_breg_grid(const Param *par, Grid_breg *grid);
 void fill_brnd_grid(const Param *par, Grid_brnd *grid);
 void fill_tereg_grid(const Param *par, Grid_tereg *grid);
@@ -35,8 +51,7 @@ void fill_breg_grid(const Param *par, Grid_breg *grid) {
       gc_pos[1] = j * ly / (par->grid_breg.ny - 1) + par->grid_breg.y_min;
       for (decltype(par->grid_breg.nz) k = 0; k != par->grid_breg.nz; ++k) {
         gc_pos[2] = k * lz / (par->grid_breg.nz - 1) + par->grid_breg.z_min;
-        ham_uint idx{toolkit::index3d(par->grid_breg.nx, par->grid_breg.ny,
-                                      par->grid_breg.nz, i, j, k)};
+        const ham_uint idx{grid->layout.index(i, j, k)};
         grid->bx[idx] = gc_pos[0];
         grid->by[idx] = gc_pos[1];
         grid->bz[idx] = gc_pos[2];
@@ -57,8 +72,7 @@ void fill_brnd_grid(const Param *par, Grid_brnd *grid) {
       gc_pos[1] = j * ly / (par->grid_brnd.ny - 1) + par->grid_brnd.y_min;
       for (decltype(par->grid_brnd.nz) k = 0; k != par->grid_brnd.nz; ++k) {
         gc_pos[2] = k * lz / (par->grid_brnd.nz - 1) + par->grid_brnd.z_min;
-        ham_uint idx{toolkit::index3d(par->grid_brnd.nx, par->grid_brnd.ny,
-                                      par->grid_brnd.nz, i, j, k)};
+        const ham_uint idx{grid->layout.index(i, j, k)};
         grid->bx[idx] = gc_pos[0];
         grid->by[idx] = gc_pos[1];
         grid->bz[idx] = gc_pos[2];
@@ -78,8 +92,7 @@ void fill_ternd_grid(const Param *par, Grid_ternd *grid) {
     for (decltype(par->grid_ternd.ny) j = 0; j != par->grid_ternd.ny; ++j) {
       gc_pos[1] = ly * j / (par->grid_ternd.ny - 1) + par->grid_ternd.y_min;
       for (decltype(par->grid_ternd.nz) k = 0; k != par->grid_ternd.nz; ++k) {
-        ham_uint idx{toolkit::index3d(par->grid_ternd.nx, par->grid_ternd.ny,
-                                      par->grid_ternd.nz, i, j, k)};
+        const ham_uint idx{grid->layout.index(i, j, k)};
         gc_pos[2] = lz * k / (par->grid_ternd.nz - 1) + par->grid_ternd.z_min;
         grid->te[idx] = gc_pos[0] + gc_pos[1] + gc_pos[2];
       }
@@ -98,8 +111,7 @@ void fill_tereg_grid(const Param *par, Grid_tereg *grid) {
     for (decltype(par->grid_tereg.ny) j = 0; j != par->grid_tereg.ny; ++j) {
       gc_pos[1] = ly * j / (par->grid_tereg.ny - 1) + par->grid_tereg.y_min;
       for (decltype(par->grid_tereg.nz) k = 0; k != par->grid_tereg.nz; ++k) {
-        ham_uint idx{toolkit::index3d(par->grid_tereg.nx, par->grid_tereg.ny,
-                                      par->grid_tereg.nz, i, j, k)};
+        const ham_uint idx{grid->layout.index(i, j, k)};
         gc_pos[2] = lz * k / (par->grid_tereg.nz - 1) + par->grid_tereg.z_min;
         grid->te[idx] = gc_pos[0] + gc_pos[1] + gc_pos[2];
       }
@@ -159,9 +171,9 @@ TEST(grid, breg_grid) {
   std::uniform_real_distribution<> dis(0.0, 1.0);
   Hamvec<3, ham_float> baseline(dis(gen), dis(gen), dis(gen));
   auto test_b = test_breg->read_grid(baseline, test_par.get(), test_grid.get());
-  EXPECT_NEAR(test_b[0], baseline[0], 1.0e-10);
-  EXPECT_NEAR(test_b[1], baseline[1], 1.0e-10);
-  EXPECT_NEAR(test_b[2], baseline[2], 1.0e-10);
+  EXPECT_NEAR(test_b[0], baseline[0], tolerance);
+  EXPECT_NEAR(test_b[1], baseline[1], tolerance);
+  EXPECT_NEAR(test_b[2], baseline[2], tolerance);
 }
 
 // testing:
@@ -191,9 +203,9 @@ TEST(grid, brnd_grid) {
   std::uniform_real_distribution<> dis(0.0, 1.0);
   Hamvec<3, ham_float> baseline(dis(gen), dis(gen), dis(gen));
   auto test_b = test_brnd->read_grid(baseline, test_par.get(), test_grid.get());
-  EXPECT_NEAR(test_b[0], baseline[0], 1.0e-10);
-  EXPECT_NEAR(test_b[1], baseline[1], 1.0e-10);
-  EXPECT_NEAR(test_b[2], baseline[2], 1.0e-10);
+  EXPECT_NEAR(test_b[0], baseline[0], tolerance);
+  EXPECT_NEAR(test_b[1], baseline[1], tolerance);
+  EXPECT_NEAR(test_b[2], baseline[2], tolerance);
 }
 
 // testing:
@@ -224,7 +236,7 @@ TEST(grid, tereg_grid) {
   Hamvec<3, ham_float> baseline(dis(gen), dis(gen), dis(gen));
   auto test_te =
       test_tereg->read_grid(baseline, test_par.get(), test_grid.get());
-  EXPECT_NEAR(test_te, baseline[0] + baseline[1] + baseline[2], 1.0e-10);
+  EXPECT_NEAR(test_te, baseline[0] + baseline[1] + baseline[2], tolerance);
 }
 
 // testing:
@@ -256,7 +268,7 @@ TEST(grid, ternd_grid) {
   Hamvec<3, ham_float> baseline(dis(gen), dis(gen), dis(gen));
   auto test_te =
       test_ternd->read_grid(baseline, test_par.get(), test_grid.get());
-  EXPECT_NEAR(test_te, baseline[0] + baseline[1] + baseline[2], 1.0e-10);
+  EXPECT_NEAR(test_te, baseline[0] + baseline[1] + baseline[2], tolerance);
 }
 
 // testing:
@@ -298,5 +310,1068 @@ TEST(grid, cre_grid) {
       test_par->grid_cre.E_min * std::exp(idxE * test_par->grid_cre.E_fact);
   auto test_c =
       test_cre->read_grid_num(baseline, idxE, test_par.get(), test_grid.get());
-  EXPECT_NEAR(test_c, baseline[0] + baseline[1] + baseline[2] + E, 1.0e-10);
+  EXPECT_NEAR(test_c, baseline[0] + baseline[1] + baseline[2] + E, tolerance);
+}
+
+// testing:
+// Breg::read_grid_batch
+// Brnd::read_grid_batch
+TEST(grid, bfield_grid_batch) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_breg.nx = 10;
+  test_par->grid_breg.ny = 8;
+  test_par->grid_breg.nz = 29;
+  test_par->grid_breg.x_max = 1;
+  test_par->grid_breg.x_min = 0;
+  test_par->grid_breg.y_max = 1;
+  test_par->grid_breg.y_min = 0;
+  test_par->grid_breg.z_max = 1;
+  test_par->grid_breg.z_min = 0;
+  test_par->grid_breg.full_size = 2320;
+  test_par->grid_breg.read_permission = true;
+  test_par->grid_brnd.nx = 10;
+  test_par->grid_brnd.ny = 8;
+  test_par->grid_brnd.nz = 29;
+  test_par->grid_brnd.x_max = 1;
+  test_par->grid_brnd.x_min = 0;
+  test_par->grid_brnd.y_max = 1;
+  test_par->grid_brnd.y_min = 0;
+  test_par->grid_brnd.z_max = 1;
+  test_par->grid_brnd.z_min = 0;
+  test_par->grid_brnd.full_size = 2320;
+  test_par->grid_brnd.read_permission = true;
+  auto test_grid_breg = std::make_unique<Grid_breg>(test_par.get());
+  auto test_grid_brnd = std::make_unique<Grid_brnd>(test_par.get());
+  fill_breg_grid(test_par.get(), test_grid_breg.get());
+  fill_brnd_grid(test_par.get(), test_grid_brnd.get());
+  auto test_breg = std::make_unique<Breg>();
+  auto test_brnd = std::make_unique<Brnd>();
+  // batch of positions, partially outside the box
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<> dis(-0.2, 1.2);
+  const ham_uint n{64};
+  std::vector<ham_float> x(n), y(n), z(n), bx(n), by(n), bz(n);
+  for (ham_uint i = 0; i != n; ++i) {
+    x[i] = dis(gen);
+    y[i] = dis(gen);
+    z[i] = dis(gen);
+  }
+  test_breg->read_field_batch(x.data(), y.data(), z.data(), n, test_par.get(),
+                              test_grid_breg.get(), bx.data(), by.data(),
+                              bz.data());
+  for (ham_uint i = 0; i != n; ++i) {
+    const Hamvec<3, ham_float> test_b{test_breg->read_field(
+        Hamvec<3, ham_float>{x[i], y[i], z[i]}, test_par.get(),
+        test_grid_breg.get())};
+    EXPECT_DOUBLE_EQ(bx[i], test_b[0]);
+    EXPECT_DOUBLE_EQ(by[i], test_b[1]);
+    EXPECT_DOUBLE_EQ(bz[i], test_b[2]);
+  }
+  test_brnd->read_field_batch(x.data(), y.data(), z.data(), n, test_par.get(),
+                              test_grid_brnd.get(), bx.data(), by.data(),
+                              bz.data());
+  for (ham_uint i = 0; i != n; ++i) {
+    const Hamvec<3, ham_float> test_b{test_brnd->read_field(
+        Hamvec<3, ham_float>{x[i], y[i], z[i]}, test_par.get(),
+        test_grid_brnd.get())};
+    EXPECT_DOUBLE_EQ(bx[i], test_b[0]);
+    EXPECT_DOUBLE_EQ(by[i], test_b[1]);
+    EXPECT_DOUBLE_EQ(bz[i], test_b[2]);
+  }
+}
+
+// testing:
+// TEreg::read_grid_batch
+// TErnd::read_grid_batch
+TEST(grid, tefield_grid_batch) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_tereg.nx = 10;
+  test_par->grid_tereg.ny = 8;
+  test_par->grid_tereg.nz = 29;
+  test_par->grid_tereg.x_max = 1;
+  test_par->grid_tereg.x_min = 0;
+  test_par->grid_tereg.y_max = 1;
+  test_par->grid_tereg.y_min = 0;
+  test_par->grid_tereg.z_max = 1;
+  test_par->grid_tereg.z_min = 0;
+  test_par->grid_tereg.full_size = 2320;
+  test_par->grid_tereg.read_permission = true;
+  test_par->grid_ternd.nx = 10;
+  test_par->grid_ternd.ny = 8;
+  test_par->grid_ternd.nz = 29;
+  test_par->grid_ternd.x_max = 1;
+  test_par->grid_ternd.x_min = 0;
+  test_par->grid_ternd.y_max = 1;
+  test_par->grid_ternd.y_min = 0;
+  test_par->grid_ternd.z_max = 1;
+  test_par->grid_ternd.z_min = 0;
+  test_par->grid_ternd.full_size = 2320;
+  test_par->grid_ternd.read_permission = true;
+  auto test_grid_tereg = std::make_unique<Grid_tereg>(test_par.get());
+  auto test_grid_ternd = std::make_unique<Grid_ternd>(test_par.get());
+  fill_tereg_grid(test_par.get(), test_grid_tereg.get());
+  fill_ternd_grid(test_par.get(), test_grid_ternd.get());
+  auto test_tereg = std::make_unique<TEreg>();
+  auto test_ternd = std::make_unique<TErnd>();
+  // batch of positions, partially outside the box
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<> dis(-0.2, 1.2);
+  const ham_uint n{64};
+  std::vector<ham_float> x(n), y(n), z(n), te(n);
+  for (ham_uint i = 0; i != n; ++i) {
+    x[i] = dis(gen);
+    y[i] = dis(gen);
+    z[i] = dis(gen);
+  }
+  test_tereg->read_field_batch(x.data(), y.data(), z.data(), n,
+                               test_par.get(), test_grid_tereg.get(),
+                               te.data());
+  for (ham_uint i = 0; i != n; ++i) {
+    EXPECT_DOUBLE_EQ(te[i], test_tereg->read_field(
+                                Hamvec<3, ham_float>{x[i], y[i], z[i]},
+                                test_par.get(), test_grid_tereg.get()));
+  }
+  test_ternd->read_field_batch(x.data(), y.data(), z.data(), n,
+                               test_par.get(), test_grid_ternd.get(),
+                               te.data());
+  for (ham_uint i = 0; i != n; ++i) {
+    EXPECT_DOUBLE_EQ(te[i], test_ternd->read_field(
+                                Hamvec<3, ham_float>{x[i], y[i], z[i]},
+                                test_par.get(), test_grid_ternd.get()));
+  }
+}
+
+// testing:
+// CRE::read_grid_num_batch
+TEST(grid, cre_grid_batch) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_cre.nx = 10;
+  test_par->grid_cre.ny = 8;
+  test_par->grid_cre.nz = 29;
+  test_par->grid_cre.nE = 19;
+  test_par->grid_cre.x_max = 1;
+  test_par->grid_cre.x_min = 0;
+  test_par->grid_cre.y_max = 1;
+  test_par->grid_cre.y_min = 0;
+  test_par->grid_cre.z_max = 1;
+  test_par->grid_cre.z_min = 0;
+  test_par->grid_cre.E_min = 0.01;
+  test_par->grid_cre.E_max = 1;
+  test_par->grid_cre.E_fact =
+      std::log(test_par->grid_cre.E_max / test_par->grid_cre.E_min) /
+      (test_par->grid_cre.nE - 1);
+  test_par->grid_cre.cre_size = 44080;
+  test_par->grid_cre.read_permission = true;
+  auto test_grid = std::make_unique<Grid_cre>(test_par.get());
+  fill_cre_grid(test_par.get(), test_grid.get());
+  auto test_cre = std::make_unique<CRE_num>();
+  // batch of positions, partially outside the box
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<> dis(-0.2, 1.2);
+  const ham_uint n{16};
+  const ham_uint nE{test_par->grid_cre.nE};
+  std::vector<ham_float> x(n), y(n), z(n), flux(n * nE);
+  for (ham_uint i = 0; i != n; ++i) {
+    x[i] = dis(gen);
+    y[i] = dis(gen);
+    z[i] = dis(gen);
+  }
+  test_cre->read_grid_num_batch(x.data(), y.data(), z.data(), n,
+                                test_par.get(), test_grid.get(), flux.data());
+  for (ham_uint i = 0; i != n; ++i) {
+    for (ham_uint e = 0; e != nE; ++e) {
+      EXPECT_DOUBLE_EQ(flux[i * nE + e],
+                       test_cre->read_grid_num(
+                           Hamvec<3, ham_float>{x[i], y[i], z[i]}, e,
+                           test_par.get(), test_grid.get()));
+    }
+  }
+}
+
+// testing:
+// CRE::read_grid
+TEST(grid, cre_grid_energy) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_cre.nx = 10;
+  test_par->grid_cre.ny = 8;
+  test_par->grid_cre.nz = 29;
+  test_par->grid_cre.nE = 19;
+  test_par->grid_cre.x_max = 1;
+  test_par->grid_cre.x_min = 0;
+  test_par->grid_cre.y_max = 1;
+  test_par->grid_cre.y_min = 0;
+  test_par->grid_cre.z_max = 1;
+  test_par->grid_cre.z_min = 0;
+  test_par->grid_cre.E_min = 0.01;
+  test_par->grid_cre.E_max = 1;
+  test_par->grid_cre.E_fact =
+      std::log(test_par->grid_cre.E_max / test_par->grid_cre.E_min) /
+      (test_par->grid_cre.nE - 1);
+  test_par->grid_cre.cre_size = 44080;
+  test_par->grid_cre.read_permission = true;
+  auto test_grid = std::make_unique<Grid_cre>(test_par.get());
+  fill_cre_grid(test_par.get(), test_grid.get());
+  auto test_cre = std::make_unique<CRE_num>();
+  const Hamvec<3, ham_float> pos{0.31, 0.52, 0.73};
+  // energies of inner bins
+  for (ham_uint m = 1; m != test_par->grid_cre.nE - 1; ++m) {
+    const ham_float E{test_par->grid_cre.E_min *
+                      std::exp(m * test_par->grid_cre.E_fact)};
+    EXPECT_NEAR(
+        test_cre->read_grid(pos, E, test_par.get(), test_grid.get()),
+        test_cre->read_grid_num(pos, m, test_par.get(), test_grid.get()),
+        tolerance);
+  }
+  // between bins, linear in log(E)
+  const ham_float E{test_par->grid_cre.E_min *
+                    std::exp(4.25 * test_par->grid_cre.E_fact)};
+  EXPECT_NEAR(
+      test_cre->read_grid(pos, E, test_par.get(), test_grid.get()),
+      0.75 * test_cre->read_grid_num(pos, 4, test_par.get(), test_grid.get()) +
+          0.25 * test_cre->read_grid_num(pos, 5, test_par.get(),
+                                         test_grid.get()),
+      tolerance);
+  // outside energy range
+  EXPECT_EQ(test_cre->read_grid(pos, 0.5 * test_par->grid_cre.E_min,
+                                test_par.get(), test_grid.get()),
+            0.);
+}
+
+// testing:
+// Hamarray::interleave
+// Haminterp::vector
+TEST(grid, interleaved_grid) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_brnd.nx = 10;
+  test_par->grid_brnd.ny = 8;
+  test_par->grid_brnd.nz = 29;
+  test_par->grid_brnd.x_max = 1;
+  test_par->grid_brnd.x_min = 0;
+  test_par->grid_brnd.y_max = 1;
+  test_par->grid_brnd.y_min = 0;
+  test_par->grid_brnd.z_max = 1;
+  test_par->grid_brnd.z_min = 0;
+  test_par->grid_brnd.full_size = 2320;
+  test_par->grid_brnd.read_permission = true;
+  test_par->grid_brnd.filename = "grid_tests_interleaved.bin";
+  auto base_grid = std::make_unique<Grid_brnd>(test_par.get());
+  test_par->grid_brnd.interleave = true;
+  auto test_grid = std::make_unique<Grid_brnd>(test_par.get());
+  fill_brnd_grid(test_par.get(), base_grid.get());
+  fill_brnd_grid(test_par.get(), test_grid.get());
+  EXPECT_FALSE(
+      Haminterp::interleaved(base_grid->bx, base_grid->by, base_grid->bz));
+  EXPECT_TRUE(
+      Haminterp::interleaved(test_grid->bx, test_grid->by, test_grid->bz));
+  EXPECT_EQ(test_grid->bx.stride(), 4u);
+  EXPECT_FALSE(test_grid->bx.mapped());
+  // first vertex starts a cache line
+  const Grid_brnd *view{test_grid.get()};
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(view->bx.data()) % 64, 0u);
+  // batch of positions over several blocks, partially outside the box
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<> dis(-0.2, 1.2);
+  const ham_uint n{200};
+  std::vector<ham_float> x(n), y(n), z(n), bx(n), by(n), bz(n), cx(n),
+      cy(n), cz(n);
+  for (ham_uint i = 0; i != n; ++i) {
+    x[i] = dis(gen);
+    y[i] = dis(gen);
+    z[i] = dis(gen);
+  }
+  // vertices on box surface are outside
+  x[0] = 0;
+  y[1] = 1;
+  auto test_brnd = std::make_unique<Brnd>();
+  test_brnd->read_field_batch(x.data(), y.data(), z.data(), n,
+                              test_par.get(), base_grid.get(), bx.data(),
+                              by.data(), bz.data());
+  test_brnd->read_field_batch(x.data(), y.data(), z.data(), n,
+                              test_par.get(), test_grid.get(), cx.data(),
+                              cy.data(), cz.data());
+  for (ham_uint i = 0; i != n; ++i) {
+    EXPECT_DOUBLE_EQ(bx[i], cx[i]);
+    EXPECT_DOUBLE_EQ(by[i], cy[i]);
+    EXPECT_DOUBLE_EQ(bz[i], cz[i]);
+    const Hamvec<3, ham_float> test_b{test_brnd->read_field(
+        Hamvec<3, ham_float>{x[i], y[i], z[i]}, test_par.get(),
+        test_grid.get())};
+    EXPECT_DOUBLE_EQ(cx[i], test_b[0]);
+    EXPECT_DOUBLE_EQ(cy[i], test_b[1]);
+    EXPECT_DOUBLE_EQ(cz[i], test_b[2]);
+    const bool inside{x[i] > 0 and x[i] < 1 and y[i] > 0 and y[i] < 1 and
+                      z[i] > 0 and z[i] < 1};
+    if (inside) {
+      EXPECT_NEAR(cx[i], x[i], tolerance);
+      EXPECT_NEAR(cy[i], y[i], tolerance);
+      EXPECT_NEAR(cz[i], z[i], tolerance);
+    } else {
+      EXPECT_EQ(cx[i], 0.);
+      EXPECT_EQ(cy[i], 0.);
+      EXPECT_EQ(cz[i], 0.);
+    }
+  }
+  // import into interleaved arrays keeps them
+  test_grid->export_grid(test_par.get());
+  auto read_grid = std::make_unique<Grid_brnd>(test_par.get());
+  read_grid->import_grid(test_par.get());
+  EXPECT_EQ(read_grid->bx.stride(), 4u);
+  for (ham_uint i = 0; i != test_par->grid_brnd.full_size; ++i) {
+    EXPECT_EQ(read_grid->bx[i], base_grid->bx[i]);
+    EXPECT_EQ(read_grid->by[i], base_grid->by[i]);
+    EXPECT_EQ(read_grid->bz[i], base_grid->bz[i]);
+  }
+  std::remove(test_par->grid_brnd.filename.c_str());
+}
+
+// testing:
+// Hamlayout::index
+// Hamlayout::at
+TEST(grid, layout) {
+  const ham_uint n[3]{10, 8, 29};
+  for (ham_uint nw : {1, 3}) {
+    const Hamlayout row(n, "row", nw);
+    EXPECT_TRUE(row.row());
+    EXPECT_EQ(row.size(), 2320 * nw);
+    for (ham_uint i = 0; i != n[0]; ++i) {
+      for (ham_uint j = 0; j != n[1]; ++j) {
+        for (ham_uint l = 0; l != n[2]; ++l) {
+          EXPECT_EQ(row.index(i, j, l),
+                    toolkit::index4d(n[0], n[1], n[2], nw, i, j, l, 0));
+        }
+      }
+    }
+    for (const std::string order : {"brick", "morton"}) {
+      const Hamlayout tiled(n, order, nw);
+      EXPECT_FALSE(tiled.row());
+      // bricks of 8^3 vertices, padded at upper boundaries
+      EXPECT_EQ(tiled.size(), 16 * 8 * 32 * nw);
+      std::vector<bool> taken(tiled.size(), false);
+      for (ham_uint k = 0; k != 2320 * nw; ++k) {
+        const ham_uint cell{k / nw};
+        const ham_uint pos{tiled.at(k)};
+        EXPECT_EQ(pos, tiled.index(cell / n[2] / n[1], cell / n[2] % n[1],
+                                   cell % n[2]) +
+                           k % nw);
+        ASSERT_LT(pos, tiled.size());
+        EXPECT_FALSE(taken[pos]);
+        taken[pos] = true;
+      }
+      // vertices of a brick are neighbours in memory
+      EXPECT_LT(tiled.index(7, 7, 7), 512 * nw);
+      EXPECT_EQ(tiled.index(0, 0, 8), 512 * nw);
+    }
+    const Hamlayout morton(n, "morton", nw);
+    EXPECT_EQ(morton.index(0, 0, 1), nw);
+    EXPECT_EQ(morton.index(0, 1, 0), 2 * nw);
+    EXPECT_EQ(morton.index(1, 0, 0), 4 * nw);
+    EXPECT_EQ(morton.index(1, 1, 1), 7 * nw);
+    EXPECT_EQ(morton.index(0, 0, 2), 8 * nw);
+  }
+  EXPECT_THROW(Hamlayout(n, "column"), std::runtime_error);
+}
+
+// testing:
+// Grid_brnd::build_grid
+// Grid_tereg::build_grid
+// Haminterp::vector
+// Haminterp::scalar
+TEST(grid, ordered_grid) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_brnd.nx = 10;
+  test_par->grid_brnd.ny = 8;
+  test_par->grid_brnd.nz = 29;
+  test_par->grid_brnd.x_max = 1;
+  test_par->grid_brnd.x_min = 0;
+  test_par->grid_brnd.y_max = 1;
+  test_par->grid_brnd.y_min = 0;
+  test_par->grid_brnd.z_max = 1;
+  test_par->grid_brnd.z_min = 0;
+  test_par->grid_brnd.full_size = 2320;
+  test_par->grid_brnd.read_permission = true;
+  test_par->grid_brnd.filename = "grid_tests_ordered_brnd.bin";
+  test_par->grid_tereg.nx = 10;
+  test_par->grid_tereg.ny = 8;
+  test_par->grid_tereg.nz = 29;
+  test_par->grid_tereg.x_max = 1;
+  test_par->grid_tereg.x_min = 0;
+  test_par->grid_tereg.y_max = 1;
+  test_par->grid_tereg.y_min = 0;
+  test_par->grid_tereg.z_max = 1;
+  test_par->grid_tereg.z_min = 0;
+  test_par->grid_tereg.full_size = 2320;
+  test_par->grid_tereg.read_permission = true;
+  test_par->grid_tereg.filename = "grid_tests_ordered_tereg.bin";
+  auto base_brnd = std::make_unique<Grid_brnd>(test_par.get());
+  auto base_tereg = std::make_unique<Grid_tereg>(test_par.get());
+  test_par->grid_brnd.order = "morton";
+  test_par->grid_brnd.interleave = true;
+  test_par->grid_tereg.order = "brick";
+  auto test_brnd = std::make_unique<Grid_brnd>(test_par.get());
+  auto test_tereg = std::make_unique<Grid_tereg>(test_par.get());
+  EXPECT_EQ(test_brnd->bx.size(), 4096u);
+  EXPECT_EQ(test_tereg->te.size(), 4096u);
+  fill_brnd_grid(test_par.get(), base_brnd.get());
+  fill_brnd_grid(test_par.get(), test_brnd.get());
+  fill_tereg_grid(test_par.get(), base_tereg.get());
+  fill_tereg_grid(test_par.get(), test_tereg.get());
+  // memory order leaves interpolation unchanged
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<> dis(-0.2, 1.2);
+  const ham_uint n{200};
+  std::vector<ham_float> x(n), y(n), z(n), bx(n), by(n), bz(n), cx(n),
+      cy(n), cz(n), te(n), ce(n);
+  for (ham_uint i = 0; i != n; ++i) {
+    x[i] = dis(gen);
+    y[i] = dis(gen);
+    z[i] = dis(gen);
+  }
+  auto brnd = std::make_unique<Brnd>();
+  auto tereg = std::make_unique<TEreg>();
+  brnd->read_field_batch(x.data(), y.data(), z.data(), n, test_par.get(),
+                         base_brnd.get(), bx.data(), by.data(), bz.data());
+  brnd->read_field_batch(x.data(), y.data(), z.data(), n, test_par.get(),
+                         test_brnd.get(), cx.data(), cy.data(), cz.data());
+  tereg->read_grid_batch(x.data(), y.data(), z.data(), n, test_par.get(),
+                         base_tereg.get(), te.data());
+  tereg->read_grid_batch(x.data(), y.data(), z.data(), n, test_par.get(),
+                         test_tereg.get(), ce.data());
+  for (ham_uint i = 0; i != n; ++i) {
+    const Hamvec<3, ham_float> pos{x[i], y[i], z[i]};
+    EXPECT_EQ(bx[i], cx[i]);
+    EXPECT_EQ(by[i], cy[i]);
+    EXPECT_EQ(bz[i], cz[i]);
+    EXPECT_EQ(te[i], ce[i]);
+    const Hamvec<3, ham_float> test_b{
+        brnd->read_field(pos, test_par.get(), test_brnd.get())};
+    EXPECT_EQ(cx[i], test_b[0]);
+    EXPECT_EQ(cy[i], test_b[1]);
+    EXPECT_EQ(cz[i], test_b[2]);
+    EXPECT_EQ(ce[i], tereg->read_grid(pos, test_par.get(), test_tereg.get()));
+  }
+  // files are row-major, import converts into any order, mapped import
+  // of other than row-major order converts into own arrays
+  test_brnd->export_grid(test_par.get());
+  test_tereg->export_grid(test_par.get());
+  base_brnd->import_grid(test_par.get());
+  test_par->grid_tereg.order = "row";
+  test_par->grid_tereg.import_mode = "mmap";
+  auto row_tereg = std::make_unique<Grid_tereg>(test_par.get());
+  row_tereg->import_grid(test_par.get());
+  EXPECT_TRUE(row_tereg->te.mapped());
+  test_par->grid_brnd.order = "brick";
+  test_par->grid_brnd.import_mode = "mmap";
+  auto read_brnd = std::make_unique<Grid_brnd>(test_par.get());
+  read_brnd->import_grid(test_par.get());
+  EXPECT_FALSE(read_brnd->bx.mapped());
+  EXPECT_EQ(read_brnd->bx.stride(), 4u);
+  for (ham_uint i = 0; i != test_par->grid_brnd.nx; ++i) {
+    for (ham_uint j = 0; j != test_par->grid_brnd.ny; ++j) {
+      for (ham_uint l = 0; l != test_par->grid_brnd.nz; ++l) {
+        const ham_uint a{base_brnd->layout.index(i, j, l)};
+        const ham_uint b{test_brnd->layout.index(i, j, l)};
+        const ham_uint c{read_brnd->layout.index(i, j, l)};
+        EXPECT_EQ(base_brnd->bx[a], test_brnd->bx[b]);
+        EXPECT_EQ(base_brnd->by[a], test_brnd->by[b]);
+        EXPECT_EQ(base_brnd->bz[a], test_brnd->bz[b]);
+        EXPECT_EQ(read_brnd->bx[c], test_brnd->bx[b]);
+        EXPECT_EQ(read_brnd->by[c], test_brnd->by[b]);
+        EXPECT_EQ(read_brnd->bz[c], test_brnd->bz[b]);
+        const Grid_tereg *view{row_tereg.get()};
+        EXPECT_EQ(view->te[row_tereg->layout.index(i, j, l)],
+                  test_tereg->te[test_tereg->layout.index(i, j, l)]);
+      }
+    }
+  }
+  // compressed bricks of files are converted likewise
+  test_par->grid_tereg.order = "brick";
+  test_par->grid_tereg.codec = "lossless";
+  test_par->grid_tereg.brick = 4;
+  test_tereg->export_grid(test_par.get());
+  test_par->grid_tereg.order = "morton";
+  for (const std::string mode : {"stream", "mmap"}) {
+    test_par->grid_tereg.import_mode = mode;
+    auto read_tereg = std::make_unique<Grid_tereg>(test_par.get());
+    read_tereg->import_grid(test_par.get());
+    EXPECT_FALSE(read_tereg->te.mapped());
+    for (ham_uint i = 0; i != test_par->grid_tereg.nx; ++i) {
+      for (ham_uint j = 0; j != test_par->grid_tereg.ny; ++j) {
+        for (ham_uint l = 0; l != test_par->grid_tereg.nz; ++l) {
+          EXPECT_EQ(read_tereg->te[read_tereg->layout.index(i, j, l)],
+                    test_tereg->te[test_tereg->layout.index(i, j, l)]);
+        }
+      }
+    }
+  }
+  std::remove(test_par->grid_brnd.filename.c_str());
+  std::remove(test_par->grid_tereg.filename.c_str());
+}
+
+// testing:
+// Haminterp::prefilter
+// Haminterp::scalar
+// Haminterp::vector
+TEST(grid, cubic_grid) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_brnd.nx = 10;
+  test_par->grid_brnd.ny = 8;
+  test_par->grid_brnd.nz = 29;
+  test_par->grid_brnd.x_max = 1;
+  test_par->grid_brnd.x_min = 0;
+  test_par->grid_brnd.y_max = 1;
+  test_par->grid_brnd.y_min = 0;
+  test_par->grid_brnd.z_max = 1;
+  test_par->grid_brnd.z_min = 0;
+  test_par->grid_brnd.full_size = 2320;
+  test_par->grid_brnd.read_permission = true;
+  test_par->grid_brnd.filename = "grid_tests_cubic_brnd.bin";
+  test_par->grid_tereg.nx = 10;
+  test_par->grid_tereg.ny = 8;
+  test_par->grid_tereg.nz = 29;
+  test_par->grid_tereg.x_max = 1;
+  test_par->grid_tereg.x_min = 0;
+  test_par->grid_tereg.y_max = 1;
+  test_par->grid_tereg.y_min = 0;
+  test_par->grid_tereg.z_max = 1;
+  test_par->grid_tereg.z_min = 0;
+  test_par->grid_tereg.full_size = 2320;
+  test_par->grid_tereg.read_permission = true;
+  const ham_uint n[3]{10, 8, 29};
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<> dis(0.0, 1.0);
+  std::vector<ham_float> values(3 * 2320);
+  for (auto &v : values) {
+    v = dis(gen);
+  }
+  // vertex position, at an integer multiple of vertex spacing
+  auto vertex = [&n](const ham_uint &i, const ham_uint &j, const ham_uint &l) {
+    return Hamvec<3, ham_float>{ham_float(i) / (n[0] - 1),
+                                ham_float(j) / (n[1] - 1),
+                                ham_float(l) / (n[2] - 1)};
+  };
+  auto tereg = std::make_unique<TEreg>();
+  auto brnd = std::make_unique<Brnd>();
+  for (const std::string order : {"row", "morton"}) {
+    // both splines pass through values at vertices, B-splines only
+    // after prefilter
+    for (const std::string method : {"catmull-rom", "bspline"}) {
+      test_par->grid_tereg.order = order;
+      test_par->grid_tereg.interp = method;
+      test_par->grid_brnd.order = order;
+      test_par->grid_brnd.interp = method;
+      test_par->grid_brnd.interleave = order == "morton";
+      auto test_tereg = std::make_unique<Grid_tereg>(test_par.get());
+      auto test_brnd = std::make_unique<Grid_brnd>(test_par.get());
+      EXPECT_EQ(test_tereg->interp.prefiltered(), method == "bspline");
+      for (ham_uint k = 0; k != 2320; ++k) {
+        const ham_uint pos{test_tereg->layout.at(k)};
+        test_tereg->te[pos] = values[k];
+        test_brnd->bx[test_brnd->layout.at(k)] = values[k];
+        test_brnd->by[test_brnd->layout.at(k)] = values[k + 2320];
+        test_brnd->bz[test_brnd->layout.at(k)] = values[k + 4640];
+      }
+      test_tereg->prefilter_grid();
+      test_brnd->prefilter_grid();
+      if (method == "bspline") {
+        EXPECT_NE(test_tereg->te[test_tereg->layout.index(1, 1, 1)],
+                  values[toolkit::index3d(n[0], n[1], n[2], 1, 1, 1)]);
+      }
+      for (ham_uint i = 1; i != n[0] - 1; ++i) {
+        for (ham_uint j = 1; j != n[1] - 1; ++j) {
+          for (ham_uint l = 1; l != n[2] - 1; ++l) {
+            const ham_uint k{toolkit::index3d(n[0], n[1], n[2], i, j, l)};
+            const Hamvec<3, ham_float> pos{vertex(i, j, l)};
+            EXPECT_NEAR(
+                tereg->read_grid(pos, test_par.get(), test_tereg.get()),
+                values[k], 10 * tolerance);
+            const Hamvec<3, ham_float> b{
+                brnd->read_field(pos, test_par.get(), test_brnd.get())};
+            EXPECT_NEAR(b[0], values[k], 10 * tolerance);
+            EXPECT_NEAR(b[1], values[k + 2320], 10 * tolerance);
+            EXPECT_NEAR(b[2], values[k + 4640], 10 * tolerance);
+          }
+        }
+      }
+      // batch reads match single reads, positions outside give zero
+      std::uniform_real_distribution<> box(-0.2, 1.2);
+      const ham_uint m{200};
+      std::vector<ham_float> x(m), y(m), z(m), te(m), bx(m), by(m), bz(m);
+      for (ham_uint i = 0; i != m; ++i) {
+        x[i] = box(gen);
+        y[i] = box(gen);
+        z[i] = box(gen);
+      }
+      tereg->read_grid_batch(x.data(), y.data(), z.data(), m, test_par.get(),
+                             test_tereg.get(), te.data());
+      brnd->read_field_batch(x.data(), y.data(), z.data(), m, test_par.get(),
+                             test_brnd.get(), bx.data(), by.data(),
+                             bz.data());
+      for (ham_uint i = 0; i != m; ++i) {
+        const Hamvec<3, ham_float> pos{x[i], y[i], z[i]};
+        EXPECT_EQ(te[i],
+                  tereg->read_grid(pos, test_par.get(), test_tereg.get()));
+        const Hamvec<3, ham_float> b{
+            brnd->read_field(pos, test_par.get(), test_brnd.get())};
+        EXPECT_EQ(bx[i], b[0]);
+        EXPECT_EQ(by[i], b[1]);
+        EXPECT_EQ(bz[i], b[2]);
+        if (x[i] < 0 or x[i] > 1 or y[i] < 0 or y[i] > 1 or z[i] < 0 or
+            z[i] > 1) {
+          EXPECT_EQ(te[i], 0.);
+        }
+      }
+    }
+  }
+  // Catmull-Rom splines reproduce quadratic fields, where all vertices
+  // around a position are within box
+  test_par->grid_tereg.order = "row";
+  test_par->grid_tereg.interp = "catmull-rom";
+  auto test_tereg = std::make_unique<Grid_tereg>(test_par.get());
+  auto quadratic = [](const Hamvec<3, ham_float> &pos) {
+    return pos[0] * pos[0] - 2 * pos[1] * pos[2] + pos[2] * pos[2] + pos[0];
+  };
+  for (ham_uint i = 0; i != n[0]; ++i) {
+    for (ham_uint j = 0; j != n[1]; ++j) {
+      for (ham_uint l = 0; l != n[2]; ++l) {
+        test_tereg->te[test_tereg->layout.index(i, j, l)] =
+            quadratic(vertex(i, j, l));
+      }
+    }
+  }
+  for (ham_uint i = 0; i != 100; ++i) {
+    const Hamvec<3, ham_float> pos{(1 + dis(gen) * (n[0] - 3)) / (n[0] - 1),
+                                   (1 + dis(gen) * (n[1] - 3)) / (n[1] - 1),
+                                   (1 + dis(gen) * (n[2] - 3)) / (n[2] - 1)};
+    EXPECT_NEAR(tereg->read_grid(pos, test_par.get(), test_tereg.get()),
+                quadratic(pos), 10 * tolerance);
+  }
+  // mapped import of B-spline grid is filtered in own arrays
+  test_par->grid_brnd.order = "row";
+  test_par->grid_brnd.interp = "bspline";
+  test_par->grid_brnd.interleave = false;
+  auto test_brnd = std::make_unique<Grid_brnd>(test_par.get());
+  for (ham_uint k = 0; k != 2320; ++k) {
+    test_brnd->bx[k] = values[k];
+    test_brnd->by[k] = values[k + 2320];
+    test_brnd->bz[k] = values[k + 4640];
+  }
+  test_brnd->export_grid(test_par.get());
+  test_par->grid_brnd.import_mode = "mmap";
+  auto read_brnd = std::make_unique<Grid_brnd>(test_par.get());
+  read_brnd->import_grid(test_par.get());
+  EXPECT_TRUE(read_brnd->bx.mapped());
+  test_brnd->prefilter_grid();
+  read_brnd->prefilter_grid();
+  EXPECT_FALSE(read_brnd->bx.mapped());
+  for (ham_uint k = 0; k != 2320; ++k) {
+    EXPECT_EQ(read_brnd->bx[k], test_brnd->bx[k]);
+    EXPECT_EQ(read_brnd->by[k], test_brnd->by[k]);
+    EXPECT_EQ(read_brnd->bz[k], test_brnd->bz[k]);
+  }
+  std::remove(test_par->grid_brnd.filename.c_str());
+  EXPECT_THROW(Haminterp(test_par->grid_brnd, read_brnd->layout, "cubic"),
+               std::runtime_error);
+}
+
+// accuracy versus grid size, maximal error of a smooth field of unit
+// wave length and amplitude 1.5 at inner positions, by vertices in
+// each direction:
+//
+//   vertices    linear      catmull-rom   bspline
+//   9           2.1e-1      2.6e-2        2.0e-2
+//   17          5.5e-2      2.2e-3        8.4e-4
+//   33          1.4e-2      2.1e-4        1.1e-5
+//
+// so that cubic splines at half the vertices per direction, an eighth
+// of memory, are more accurate than linear interpolation
+// testing:
+// Haminterp::prefilter
+// Haminterp::scalar
+TEST(grid, interp_accuracy) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_tereg.x_max = 1;
+  test_par->grid_tereg.x_min = 0;
+  test_par->grid_tereg.y_max = 1;
+  test_par->grid_tereg.y_min = 0;
+  test_par->grid_tereg.z_max = 1;
+  test_par->grid_tereg.z_min = 0;
+  test_par->grid_tereg.read_permission = true;
+  const ham_float pi{3.14159265358979323846};
+  auto field = [&pi](const Hamvec<3, ham_float> &pos) {
+    return std::sin(2 * pi * pos[0]) * std::cos(2 * pi * pos[1]) *
+               std::sin(2 * pi * pos[2]) +
+           0.5 * std::cos(2 * pi * (pos[0] + pos[1]));
+  };
+  // positions away from box surface
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<> dis(0.25, 0.75);
+  const ham_uint m{2000};
+  std::vector<ham_float> x(m), y(m), z(m), te(m);
+  for (ham_uint i = 0; i != m; ++i) {
+    x[i] = dis(gen);
+    y[i] = dis(gen);
+    z[i] = dis(gen);
+  }
+  auto tereg = std::make_unique<TEreg>();
+  auto error = [&](const ham_uint &cells, const std::string &method) {
+    test_par->grid_tereg.nx = cells + 1;
+    test_par->grid_tereg.ny = cells + 1;
+    test_par->grid_tereg.nz = cells + 1;
+    test_par->grid_tereg.full_size = (cells + 1) * (cells + 1) * (cells + 1);
+    test_par->grid_tereg.interp = method;
+    auto test_grid = std::make_unique<Grid_tereg>(test_par.get());
+    for (ham_uint i = 0; i != cells + 1; ++i) {
+      for (ham_uint j = 0; j != cells + 1; ++j) {
+        for (ham_uint l = 0; l != cells + 1; ++l) {
+          test_grid->te[test_grid->layout.index(i, j, l)] = field(
+              Hamvec<3, ham_float>{ham_float(i) / cells, ham_float(j) / cells,
+                                   ham_float(l) / cells});
+        }
+      }
+    }
+    test_grid->prefilter_grid();
+    tereg->read_grid_batch(x.data(), y.data(), z.data(), m, test_par.get(),
+                           test_grid.get(), te.data());
+    ham_float result{0};
+    for (ham_uint i = 0; i != m; ++i) {
+      result = std::max(
+          result,
+          std::fabs(te[i] - field(Hamvec<3, ham_float>{x[i], y[i], z[i]})));
+    }
+    return result;
+  };
+  const std::string methods[3]{"linear", "catmull-rom", "bspline"};
+  ham_float e[3][3];
+  for (ham_uint c = 0; c != 3; ++c) {
+    for (ham_uint k = 0; k != 3; ++k) {
+      e[c][k] = error(8 << c, methods[k]);
+    }
+  }
+  for (ham_uint c = 0; c != 2; ++c) {
+    // half the vertices per direction suffice
+    EXPECT_LT(e[c][1], e[c + 1][0]);
+    EXPECT_LT(e[c][2], e[c + 1][0]);
+    EXPECT_LT(e[c][2], e[c][1]);
+    // second order of linear, third and fourth order of cubic splines
+    EXPECT_GT(e[c][0] / e[c + 1][0], 3.);
+    EXPECT_GT(e[c][1] / e[c + 1][1], 6.);
+    EXPECT_GT(e[c][2] / e[c + 1][2], 12.);
+  }
+}
+
+// testing:
+// Grid_brnd::import_grid
+// Grid_cre::import_grid
+// hamgrid::parse
+// hamgrid::check
+TEST(grid, import_grid) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_brnd.nx = 10;
+  test_par->grid_brnd.ny = 8;
+  test_par->grid_brnd.nz = 29;
+  test_par->grid_brnd.x_max = 1;
+  test_par->grid_brnd.x_min = 0;
+  test_par->grid_brnd.y_max = 1;
+  test_par->grid_brnd.y_min = 0;
+  test_par->grid_brnd.z_max = 1;
+  test_par->grid_brnd.z_min = 0;
+  test_par->grid_brnd.full_size = 2320;
+  test_par->grid_brnd.read_permission = true;
+  test_par->grid_brnd.filename = "grid_tests_brnd.bin";
+  test_par->grid_cre.nx = 10;
+  test_par->grid_cre.ny = 8;
+  test_par->grid_cre.nz = 29;
+  test_par->grid_cre.nE = 19;
+  test_par->grid_cre.x_max = 1;
+  test_par->grid_cre.x_min = 0;
+  test_par->grid_cre.y_max = 1;
+  test_par->grid_cre.y_min = 0;
+  test_par->grid_cre.z_max = 1;
+  test_par->grid_cre.z_min = 0;
+  test_par->grid_cre.E_min = 0.01;
+  test_par->grid_cre.E_max = 1;
+  test_par->grid_cre.E_fact =
+      std::log(test_par->grid_cre.E_max / test_par->grid_cre.E_min) /
+      (test_par->grid_cre.nE - 1);
+  test_par->grid_cre.cre_size = 44080;
+  test_par->grid_cre.read_permission = true;
+  test_par->grid_cre.filename = "grid_tests_cre.bin";
+  auto base_brnd = std::make_unique<Grid_brnd>(test_par.get());
+  fill_brnd_grid(test_par.get(), base_brnd.get());
+  base_brnd->export_grid(test_par.get());
+  auto base_cre = std::make_unique<Grid_cre>(test_par.get());
+  fill_cre_grid(test_par.get(), base_cre.get());
+  base_cre->export_grid(test_par.get());
+  for (const std::string mode : {"stream", "mmap", "populate"}) {
+    test_par->grid_brnd.import_mode = mode;
+    test_par->grid_cre.import_mode = mode;
+    auto test_brnd = std::make_unique<Grid_brnd>(test_par.get());
+    test_brnd->import_grid(test_par.get());
+    EXPECT_EQ(test_brnd->bx.mapped(), mode != "stream") << mode;
+    EXPECT_EQ(test_brnd->by.stride(), test_brnd->by.mapped() ? 3u : 1u);
+    for (ham_uint i = 0; i != test_par->grid_brnd.full_size; ++i) {
+      EXPECT_EQ(test_brnd->bx[i], base_brnd->bx[i]);
+      EXPECT_EQ(test_brnd->by[i], base_brnd->by[i]);
+      EXPECT_EQ(test_brnd->bz[i], base_brnd->bz[i]);
+    }
+    auto test_cre = std::make_unique<Grid_cre>(test_par.get());
+    test_cre->import_grid(test_par.get());
+    EXPECT_EQ(test_cre->cre_flux.mapped(), mode != "stream");
+    EXPECT_EQ(test_cre->cre_flux.stride(), 1u);
+    for (ham_uint i = 0; i != test_par->grid_cre.cre_size; ++i) {
+      EXPECT_EQ(test_cre->cre_flux[i], base_cre->cre_flux[i]);
+    }
+    // interpolation reads views alike
+    auto test_b = std::make_unique<Brnd>();
+    const Hamvec<3, ham_float> pos{0.31, 0.52, 0.73};
+    const auto b{test_b->read_grid(pos, test_par.get(), test_brnd.get())};
+    EXPECT_NEAR(b[0], pos[0], tolerance);
+    EXPECT_NEAR(b[1], pos[1], tolerance);
+    EXPECT_NEAR(b[2], pos[2], tolerance);
+  }
+  // file not matching grid size
+  test_par->grid_brnd.nz = 28;
+  test_par->grid_brnd.full_size = 2240;
+  for (const std::string mode : {"stream", "mmap"}) {
+    test_par->grid_brnd.import_mode = mode;
+    auto test_brnd = std::make_unique<Grid_brnd>(test_par.get());
+    EXPECT_THROW(test_brnd->import_grid(test_par.get()), std::runtime_error);
+  }
+  // file of other grid kind
+  test_par->grid_cre.filename = "grid_tests_brnd.bin";
+  auto test_cre = std::make_unique<Grid_cre>(test_par.get());
+  EXPECT_THROW(test_cre->import_grid(test_par.get()), std::runtime_error);
+  test_par->grid_cre.filename = "grid_tests_cre.bin";
+  // corrupted payload, detected unless mapped lazily
+  {
+    std::fstream file("grid_tests_cre.bin",
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(hamgrid::page + 100);
+    file.put('x');
+  }
+  for (const std::string mode : {"stream", "populate"}) {
+    test_par->grid_cre.import_mode = mode;
+    auto test_cre = std::make_unique<Grid_cre>(test_par.get());
+    EXPECT_THROW(test_cre->import_grid(test_par.get()), std::runtime_error);
+  }
+  test_par->grid_cre.import_mode = "mmap";
+  test_cre = std::make_unique<Grid_cre>(test_par.get());
+  EXPECT_NO_THROW(test_cre->import_grid(test_par.get()));
+  std::remove("grid_tests_brnd.bin");
+  std::remove("grid_tests_cre.bin");
+}
+
+// testing:
+// hamgrid::convert
+// Grid_tereg::import_grid
+TEST(grid, convert_grid) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_tereg.nx = 10;
+  test_par->grid_tereg.ny = 8;
+  test_par->grid_tereg.nz = 29;
+  test_par->grid_tereg.x_max = 1;
+  test_par->grid_tereg.x_min = 0;
+  test_par->grid_tereg.y_max = 1;
+  test_par->grid_tereg.y_min = 0;
+  test_par->grid_tereg.z_max = 1;
+  test_par->grid_tereg.z_min = 0;
+  test_par->grid_tereg.full_size = 2320;
+  test_par->grid_tereg.read_permission = true;
+  test_par->grid_tereg.filename = "grid_tests_tereg.bin";
+  // raw file of former releases
+  std::vector<ham_float> raw(test_par->grid_tereg.full_size);
+  for (ham_uint i = 0; i != raw.size(); ++i) {
+    raw[i] = 0.5 * i;
+  }
+  {
+    std::ofstream output("grid_tests_tereg.raw",
+                         std::ios::out | std::ios::binary);
+    output.write(reinterpret_cast<const char *>(raw.data()),
+                 raw.size() * sizeof(ham_float));
+  }
+  // raw file is rejected by import
+  test_par->grid_tereg.filename = "grid_tests_tereg.raw";
+  auto test_grid = std::make_unique<Grid_tereg>(test_par.get());
+  EXPECT_THROW(test_grid->import_grid(test_par.get()), std::runtime_error);
+  // raw file not matching grid size
+  test_par->grid_tereg.nz = 28;
+  EXPECT_THROW(hamgrid::convert("grid_tests_tereg.raw", "grid_tests_tereg.bin",
+                                hamgrid::describe("tereg", test_par.get())),
+               std::runtime_error);
+  test_par->grid_tereg.nz = 29;
+  hamgrid::convert("grid_tests_tereg.raw", "grid_tests_tereg.bin",
+                   hamgrid::describe("tereg", test_par.get()));
+  test_par->grid_tereg.filename = "grid_tests_tereg.bin";
+  for (const std::string mode : {"stream", "mmap", "populate"}) {
+    test_par->grid_tereg.import_mode = mode;
+    test_grid = std::make_unique<Grid_tereg>(test_par.get());
+    test_grid->import_grid(test_par.get());
+    // converted values keep double precision in file
+    EXPECT_EQ(test_grid->te.mapped(),
+              mode != "stream" and sizeof(ham_store) == sizeof(ham_float));
+    for (ham_uint i = 0; i != raw.size(); ++i) {
+      EXPECT_EQ(test_grid->te[i], static_cast<ham_store>(raw[i]));
+    }
+  }
+  std::remove("grid_tests_tereg.raw");
+  std::remove("grid_tests_tereg.bin");
+}
+
+// testing:
+// Grid_brnd::export_grid
+// Grid_brnd::import_grid
+// Grid_cre::export_grid
+// Grid_cre::import_grid
+// hamgrid::pack
+// hamgrid::unpack
+TEST(grid, brick_grid) {
+  auto test_par = std::make_unique<Param>();
+  test_par->grid_brnd.nx = 10;
+  test_par->grid_brnd.ny = 8;
+  test_par->grid_brnd.nz = 29;
+  test_par->grid_brnd.x_max = 1;
+  test_par->grid_brnd.x_min = 0;
+  test_par->grid_brnd.y_max = 1;
+  test_par->grid_brnd.y_min = 0;
+  test_par->grid_brnd.z_max = 1;
+  test_par->grid_brnd.z_min = 0;
+  test_par->grid_brnd.full_size = 2320;
+  test_par->grid_brnd.read_permission = true;
+  test_par->grid_brnd.filename = "grid_tests_brnd.bin";
+  // bricks cut at upper boundaries
+  test_par->grid_brnd.codec = "lossless";
+  test_par->grid_brnd.brick = 4;
+  test_par->grid_cre.nx = 10;
+  test_par->grid_cre.ny = 8;
+  test_par->grid_cre.nz = 29;
+  test_par->grid_cre.nE = 19;
+  test_par->grid_cre.x_max = 1;
+  test_par->grid_cre.x_min = 0;
+  test_par->grid_cre.y_max = 1;
+  test_par->grid_cre.y_min = 0;
+  test_par->grid_cre.z_max = 1;
+  test_par->grid_cre.z_min = 0;
+  test_par->grid_cre.E_min = 0.01;
+  test_par->grid_cre.E_max = 1;
+  test_par->grid_cre.E_fact =
+      std::log(test_par->grid_cre.E_max / test_par->grid_cre.E_min) /
+      (test_par->grid_cre.nE - 1);
+  test_par->grid_cre.cre_size = 44080;
+  test_par->grid_cre.read_permission = true;
+  test_par->grid_cre.filename = "grid_tests_cre.bin";
+  test_par->grid_cre.codec = "lossy";
+  test_par->grid_cre.tolerance = 1e-3;
+  test_par->grid_cre.brick = 8;
+  auto base_brnd = std::make_unique<Grid_brnd>(test_par.get());
+  fill_brnd_grid(test_par.get(), base_brnd.get());
+  base_brnd->export_grid(test_par.get());
+  auto base_cre = std::make_unique<Grid_cre>(test_par.get());
+  fill_cre_grid(test_par.get(), base_cre.get());
+  base_cre->export_grid(test_par.get());
+  // smooth values take less than interleaved layout
+  {
+    std::ifstream file("grid_tests_cre.bin", std::ios::in | std::ios::binary);
+    file.seekg(0, file.end);
+    EXPECT_LT(static_cast<ham_uint>(file.tellg()),
+              hamgrid::page + test_par->grid_cre.cre_size * sizeof(ham_store));
+  }
+  // lossy values within tolerance, up to rounding of storage
+  const ham_float bound{1e-3 + 4 * tolerance};
+  for (const std::string mode : {"stream", "mmap", "populate"}) {
+    test_par->grid_brnd.import_mode = mode;
+    test_par->grid_cre.import_mode = mode;
+    auto test_brnd = std::make_unique<Grid_brnd>(test_par.get());
+    test_brnd->import_grid(test_par.get());
+    // values decoded on demand are read-only
+    const Grid_brnd *brnd{test_brnd.get()};
+    EXPECT_EQ(brnd->bx.chunked(), mode != "stream") << mode;
+    for (ham_uint i = 0; i != test_par->grid_brnd.full_size; ++i) {
+      EXPECT_EQ(brnd->bx[i], base_brnd->bx[i]);
+      EXPECT_EQ(brnd->by[i], base_brnd->by[i]);
+      EXPECT_EQ(brnd->bz[i], base_brnd->bz[i]);
+    }
+    auto test_cre = std::make_unique<Grid_cre>(test_par.get());
+    test_cre->import_grid(test_par.get());
+    const Grid_cre *cre{test_cre.get()};
+    EXPECT_EQ(cre->cre_flux.chunked(), mode != "stream");
+    for (ham_uint i = 0; i != test_par->grid_cre.cre_size; ++i) {
+      EXPECT_NEAR(cre->cre_flux[i], base_cre->cre_flux[i], bound);
+    }
+    // interpolation reads decoded values alike
+    auto test_b = std::make_unique<Brnd>();
+    const Hamvec<3, ham_float> pos{0.31, 0.52, 0.73};
+    const auto b{test_b->read_grid(pos, test_par.get(), test_brnd.get())};
+    EXPECT_NEAR(b[0], pos[0], tolerance);
+    EXPECT_NEAR(b[1], pos[1], tolerance);
+    EXPECT_NEAR(b[2], pos[2], tolerance);
+  }
+  // corrupted brick is detected by checksum unless mapped lazily
+  {
+    std::fstream file("grid_tests_brnd.bin",
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(hamgrid::page + 2000);
+    file.put('x');
+  }
+  for (const std::string mode : {"stream", "populate"}) {
+    test_par->grid_brnd.import_mode = mode;
+    auto test_brnd = std::make_unique<Grid_brnd>(test_par.get());
+    EXPECT_THROW(test_brnd->import_grid(test_par.get()), std::runtime_error);
+  }
+  std::remove("grid_tests_brnd.bin");
+  std::remove("grid_tests_cre.bin");
+}
+
+// testing:
+// Hambricks::at
+// Hambricks::decoded
+// Hambricks::resident
+TEST(grid, brick_cache) {
+  const ham_uint cells[3]{6, 5, 7};
+  // value index as value, bricks of 2x2x2 cells and 2 values per cell,
+  // budget of four full bricks
+  auto bricks = std::make_shared<const Hambricks<ham_store>>(
+      cells, 2, 2, 2, 4 * 2 * 2 * 8 * sizeof(ham_store),
+      [&cells](const ham_uint &id, ham_store *out) {
+        const ham_uint b[3]{id / 4 / 3, id / 4 % 3, id % 4};
+        ham_uint k{0};
+        for (ham_uint c = 0; c != 2; ++c) {
+          for (ham_uint x = 2 * b[0]; x != std::min(2 * b[0] + 2, cells[0]);
+               ++x) {
+            for (ham_uint y = 2 * b[1];
+                 y != std::min(2 * b[1] + 2, cells[1]); ++y) {
+              for (ham_uint z = 2 * b[2];
+                   z != std::min(2 * b[2] + 2, cells[2]); ++z) {
+                for (ham_uint e = 0; e != 2; ++e) {
+                  out[k++] = ((x * 5 + y) * 7 + z) * 2 + e + 1000 * c;
+                }
+              }
+            }
+          }
+        }
+      });
+  const Hamarray<ham_store> a(bricks, 0), b(bricks, 1);
+  ASSERT_EQ(a.size(), 420u);
+  EXPECT_TRUE(a.chunked() and a.mapped());
+  // reads within a brick decode it once
+  EXPECT_EQ(a[0], 0.);
+  EXPECT_EQ(b[1], 1001.);
+  EXPECT_EQ(a[15], 15.);
+  EXPECT_EQ(bricks->decoded(), 1u);
+  for (ham_uint i = 0; i != a.size(); ++i) {
+    EXPECT_EQ(a[i], ham_store(i));
+    EXPECT_EQ(b[i], ham_store(i + 1000));
+  }
+  EXPECT_LE(bricks->resident(), 4 * 2 * 2 * 8 * sizeof(ham_store));
+  // evicted bricks are decoded again
+  const ham_uint count{bricks->decoded()};
+  EXPECT_GT(count, 36u);
+  ham_float sum{0};
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+ : sum)
+#endif
+  for (ham_uint i = 0; i < a.size(); ++i) {
+    sum += a[a.size() - 1 - i] + b[i];
+  }
+  EXPECT_EQ(sum, 419. * 210. * 2. + 420000.);
+  EXPECT_GT(bricks->decoded(), count);
 }
@@ -0,0 +1,110 @@
+// unit tests for MPI distribution
+// built with ENABLE_MPI and run on two ranks
+
+#include <gtest/gtest.h>
+
+#include <mpi.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <grid.h>
+#include <hammpi.h>
+#include <hamtype.h>
+#include <integrator.h>
+#include <param.h>
+
+#include "pipeline_test.h"
+
+// pipeline integrating without exporting maps
+class Pipeline_mpi final : public Pipeline_test {
+public:
+  Pipeline_mpi(const std::string &filename) : Pipeline_test(filename) {}
+  // LoS integration into maps of observable grid
+  const Grid_obs *integrate_grid() {
+    intobj = std::make_unique<Integrator>();
+    intobj->write_grid(breg.get(), brnd.get(), tereg.get(), ternd.get(),
+                       cre.get(), grid_breg.get(), grid_brnd.get(),
+                       grid_tereg.get(), grid_ternd.get(), grid_cre.get(),
+                       grid_obs.get(), par.get());
+    return grid_obs.get();
+  }
+};
+
+// run pipeline on given communicator and collect all maps
+// 1st argument: communicator
+// 2nd argument: NESTED traversal
+// 3rd argument: angular refinement
+std::vector<std::vector<ham_float>> simulate(MPI_Comm comm, const bool &nested,
+                                             const bool &refine) {
+  hammpi::communicator() = comm;
+  auto run = std::make_unique<Pipeline_mpi>("reference/mpi_tests.xml");
+  run->param()->grid_obs.do_nested = nested;
+  run->param()->grid_obs.nside_tile = 2;
+  run->param()->grid_obs.do_refine = refine;
+  run->param()->grid_obs.nside_refine = 4;
+  run->param()->grid_obs.tol_refine = 1e-2;
+  run->fields();
+  auto result = map_arrays(run->integrate_grid());
+  hammpi::communicator() = MPI_COMM_WORLD;
+  return result;
+}
+
+// testing:
+// hammpi::rank
+// hammpi::size
+// hammpi::allreduce_sum
+// hammpi::allreduce_max
+// hammpi::broadcast
+TEST(hammpi, collectives) {
+  int world_rank, world_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  ASSERT_TRUE(hammpi::active());
+  EXPECT_EQ(hammpi::rank(), ham_uint(world_rank));
+  EXPECT_EQ(hammpi::size(), ham_uint(world_size));
+  const ham_float r{static_cast<ham_float>(world_rank)};
+  std::vector<ham_float> sum(7, r + 1.);
+  hammpi::allreduce_sum(sum.data(), sum.size());
+  for (auto v : sum) {
+    EXPECT_EQ(v, 0.5 * world_size * (world_size + 1));
+  }
+  std::vector<char> flag(5, 0);
+  flag[world_rank % 5] = 1;
+  hammpi::allreduce_max(flag.data(), flag.size());
+  for (int i = 0; i != 5; ++i) {
+    EXPECT_EQ(flag[i], i < world_size ? 1 : 0);
+  }
+  std::vector<ham_float> copy(3, r);
+  hammpi::broadcast(copy.data(), copy.size());
+  for (auto v : copy) {
+    EXPECT_EQ(v, 0.);
+  }
+}
+
+// testing:
+// Integrator::write_grid
+// Integrator::refine_shell
+// Integrator::reduce_maps
+// distributed maps are identical to serial maps
+TEST(hammpi, shell_partition) {
+  for (const bool nested : {false, true}) {
+    for (const bool refine : {false, true}) {
+      const auto serial = simulate(MPI_COMM_SELF, nested, refine);
+      const auto shared = simulate(MPI_COMM_WORLD, nested, refine);
+      ASSERT_EQ(serial.size(), shared.size());
+      for (ham_uint k = 0; k != serial.size(); ++k) {
+        EXPECT_EQ(serial[k], shared[k]);
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  ::testing::InitGoogleTest(&argc, argv);
+  const int result{RUN_ALL_TESTS()};
+  MPI_Finalize();
+  return result;
+}
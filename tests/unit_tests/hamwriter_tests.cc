@@ -0,0 +1,84 @@
+// unit tests for background file writer
+// files are written in order of submission and complete upon wait,
+// failures are reported by wait
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <hamtype.h>
+#include <hamwriter.h>
+
+// read whole file
+std::vector<char> read_file(const std::string &name) {
+  std::ifstream input(name.c_str(), std::ios::in | std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(input),
+                           std::istreambuf_iterator<char>());
+}
+
+// testing:
+// Hamwriter::write
+// Hamwriter::wait
+TEST(writer, write) {
+  std::vector<std::vector<char>> expected;
+  {
+    // queue limit below file size, submission waits for writer
+    Hamwriter writer(1000);
+    for (ham_uint k = 0; k != 6; ++k) {
+      std::vector<char> data(1500 + k);
+      for (ham_uint i = 0; i != data.size(); ++i) {
+        data[i] = static_cast<char>(k + 3 * i);
+      }
+      expected.push_back(data);
+      writer.write("hamwriter_tests_" + std::to_string(k % 3) + ".bin",
+                   std::move(data), k == 5);
+    }
+    writer.wait();
+    // later submissions of a file overwrite earlier ones
+    for (ham_uint k = 0; k != 3; ++k) {
+      EXPECT_EQ(read_file("hamwriter_tests_" + std::to_string(k) + ".bin"),
+                expected[k + 3]);
+    }
+    // destruction waits as well
+    writer.write("hamwriter_tests_0.bin", std::vector<char>(expected[0]),
+                 false);
+  }
+  EXPECT_EQ(read_file("hamwriter_tests_0.bin"), expected[0]);
+  for (ham_uint k = 0; k != 3; ++k) {
+    std::remove(("hamwriter_tests_" + std::to_string(k) + ".bin").c_str());
+  }
+}
+
+// testing:
+// Hamwriter::wait
+TEST(writer, failure) {
+  Hamwriter writer;
+  writer.write("no_such_directory/hamwriter_tests.bin",
+               std::vector<char>(10, 'a'), false);
+  writer.write("hamwriter_tests.bin", std::vector<char>(10, 'b'), false);
+  EXPECT_THROW(writer.wait(), std::runtime_error);
+  // failure is reported once, other files are written
+  EXPECT_NO_THROW(writer.wait());
+  EXPECT_EQ(read_file("hamwriter_tests.bin"), std::vector<char>(10, 'b'));
+  std::remove("hamwriter_tests.bin");
+}
+
+// testing:
+// Hamwriter::dump
+TEST(writer, dump) {
+  const std::vector<ham_float> data{1., 2., 3.};
+  Hamwriter::dump("hamwriter_tests.bin", data.data(),
+                  data.size() * sizeof(ham_float), true);
+  const std::vector<char> image{read_file("hamwriter_tests.bin")};
+  ASSERT_EQ(image.size(), data.size() * sizeof(ham_float));
+  EXPECT_EQ(reinterpret_cast<const ham_float *>(image.data())[2], 3.);
+  std::remove("hamwriter_tests.bin");
+  EXPECT_THROW(Hamwriter::dump("no_such_directory/hamwriter_tests.bin",
+                               data.data(), sizeof(ham_float), false),
+               std::runtime_error);
+}
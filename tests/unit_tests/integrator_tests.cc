@@ -2,6 +2,9 @@
 
 #include <gtest/gtest.h>
 
+#include <gsl/gsl_sf_gamma.h>
+
+#include <algorithm>
 #include <cmath>
 #include <grid.h>
 #include <hamtype.h>
@@ -9,6 +12,7 @@
 #include <integrator.h>
 #include <memory>
 #include <random>
+#include <vector>
 
 // testing:
 // Integrator::check_simulation_upper_limit
@@ -136,6 +140,288 @@ TEST(integrator, shell_info_assembling) {
   EXPECT_EQ(ref->dist[idx], ref->d_start + (idx + 0.5) * ref->delta_d);
   idx = smp5(rng);
   EXPECT_EQ(ref->dist[idx], ref->d_start + (idx + 0.5) * ref->delta_d);
+  // angular refinement
+  EXPECT_TRUE(par->grid_obs.do_refine);
+  EXPECT_EQ(par->grid_obs.nside_refine, ham_uint(4));
+  EXPECT_EQ(par->grid_obs.tol_refine, 1e-2);
+  EXPECT_FALSE(par->grid_obs.do_nested);
+  // adaptive tolerance per shell, the last one repeated
+  EXPECT_TRUE(par->grid_obs.do_adaptive);
+  const ham_float tol[3] = {1e-3, 1e-2, 1e-2};
+  for (ham_uint i = 0; i != 3; ++i) {
+    pipe->assemble_shell_ref(ref.get(), par.get(), i);
+    EXPECT_EQ(ref->tol, tol[i]);
+    EXPECT_NEAR(ref->delta_max, 0.5 * cgs::kpc, 1.0e-10 * cgs::kpc);
+  }
+}
+
+// testing:
+// Integrator::check_adaptive_tolerance
+TEST(integrator, adaptive_tolerance) {
+  auto pipe = std::make_unique<Integrator>();
+  auto par = std::make_unique<Param>("reference/int_tests_01.xml");
+  EXPECT_FALSE(par->grid_obs.do_adaptive);
+  par->grid_obs.do_dm = true;
+  par->grid_obs.do_fd = true;
+  par->grid_obs.do_sync = true;
+  Integrator::struct_observables base, coarse, fine;
+  base.dm = 1.;
+  base.fd = -2.;
+  base.is = {1.};
+  base.qs = {0.3};
+  base.us = {-0.4};
+  coarse = base;
+  fine = base;
+  // increments of high and low order sums differ by 0.1%
+  coarse.dm += 1.;
+  fine.dm += 1.001;
+  EXPECT_TRUE(
+      pipe->check_adaptive_tolerance(&base, &coarse, &fine, 1e-3, par.get()));
+  EXPECT_FALSE(
+      pipe->check_adaptive_tolerance(&base, &coarse, &fine, 1e-4, par.get()));
+  // Q error is scaled by polarized intensity
+  coarse = base;
+  fine = base;
+  coarse.qs[0] += 0.;
+  fine.qs[0] += 1e-4;
+  EXPECT_TRUE(
+      pipe->check_adaptive_tolerance(&base, &coarse, &fine, 1e-3, par.get()));
+  EXPECT_FALSE(
+      pipe->check_adaptive_tolerance(&base, &coarse, &fine, 1e-4, par.get()));
+  // disabled observables are not checked
+  par->grid_obs.do_sync = false;
+  EXPECT_TRUE(
+      pipe->check_adaptive_tolerance(&base, &coarse, &fine, 1e-4, par.get()));
+}
+
+// testing:
+// Integrator::check_adaptive_tolerance
+// Q/U error does not depend on polarization angle
+TEST(integrator, adaptive_tolerance_rotation) {
+  auto pipe = std::make_unique<Integrator>();
+  auto par = std::make_unique<Param>("reference/int_tests_01.xml");
+  par->grid_obs.do_sync = true;
+  Integrator::struct_observables base, coarse, fine;
+  base.dm = 0.;
+  base.fd = 0.;
+  base.is = {1.};
+  for (const ham_float angle : {0., 0.3, 0.25 * cgs::pi, 2.}) {
+    // same error vector, rotated with accumulated Q/U
+    base.qs = {std::cos(angle)};
+    base.us = {std::sin(angle)};
+    coarse = base;
+    fine = base;
+    fine.qs[0] += 1e-4 * std::cos(angle + 1.);
+    fine.us[0] += 1e-4 * std::sin(angle + 1.);
+    EXPECT_TRUE(pipe->check_adaptive_tolerance(&base, &coarse, &fine, 1.1e-4,
+                                               par.get()));
+    EXPECT_FALSE(pipe->check_adaptive_tolerance(&base, &coarse, &fine,
+                                                0.9e-4, par.get()));
+  }
+}
+
+// testing:
+// Integrator::assemble_shell_maps
+// Integrator::compose_shells
+// Q/U of outer shell are rotated by Faraday depth of inner shell
+TEST(integrator, shell_composition) {
+  auto pipe = std::make_unique<Integrator>();
+  auto par = std::make_unique<Param>("reference/int_tests_01.xml");
+  auto gobs = std::make_unique<Grid_obs>(par.get());
+  auto sync_ref = std::make_unique<Integrator::struct_sync>();
+  pipe->assemble_sync_ref(sync_ref.get(), par.get());
+  const ham_uint channels{sync_ref->channels};
+  std::vector<std::unique_ptr<Integrator::struct_shell_maps>> shell_maps;
+  for (const ham_uint nside : {8, 16}) {
+    shell_maps.push_back(std::make_unique<Integrator::struct_shell_maps>());
+    pipe->assemble_shell_maps(shell_maps.back().get(), nside, sync_ref.get(),
+                              par.get());
+  }
+  ASSERT_EQ(shell_maps[0]->is.size(), channels);
+  EXPECT_EQ(shell_maps[1]->grid().nside(), ham_uint(16));
+  std::vector<Hampix<ham_float> *> list;
+  shell_maps[0]->collect(&list);
+  EXPECT_EQ(list.size(), 2 + 3 * channels);
+  // inner shell is a Faraday screen, outer shell emits polarization
+  const ham_float screen{1e-3};
+  for (ham_uint ipix = 0; ipix != shell_maps[0]->grid().npix(); ++ipix) {
+    shell_maps[0]->dm->data(ipix, 1.);
+    shell_maps[0]->fd->data(ipix, screen);
+  }
+  for (ham_uint ipix = 0; ipix != shell_maps[1]->grid().npix(); ++ipix) {
+    shell_maps[1]->dm->data(ipix, 2.);
+    for (ham_uint c = 0; c != channels; ++c) {
+      shell_maps[1]->is[c]->data(ipix, 3.);
+      shell_maps[1]->qs[c]->data(ipix, 3.);
+    }
+  }
+  pipe->compose_shells(&shell_maps, sync_ref.get(), gobs.get(), par.get());
+  EXPECT_FALSE(shell_maps[0]);
+  EXPECT_FALSE(shell_maps[1]);
+  for (ham_uint ipix = 0; ipix != gobs->dm_map->npix(); ++ipix) {
+    EXPECT_NEAR(gobs->dm_map->data(ipix), 3., 1e-12);
+    EXPECT_NEAR(gobs->fd_map->data(ipix), screen, 1e-12 * screen);
+  }
+  for (ham_uint c = 0; c != channels; ++c) {
+    const ham_float angle{2. * screen * sync_ref->lambda_square[c]};
+    for (ham_uint ipix = 0; ipix != gobs->qs_map[c]->npix(); ++ipix) {
+      EXPECT_NEAR(gobs->is_map[c]->data(ipix), 3., 1e-12);
+      EXPECT_NEAR(gobs->qs_map[c]->data(ipix), 3. * std::cos(angle), 1e-12);
+      EXPECT_NEAR(gobs->us_map[c]->data(ipix), 3. * std::sin(angle), 1e-12);
+    }
+  }
+}
+
+// testing:
+// Integrator::clip_ray
+// Integrator::check_simulation_volume
+TEST(integrator, ray_clipping) {
+  auto pipe = std::make_unique<Integrator>();
+  auto ref = std::make_unique<Integrator::struct_shell>();
+  auto par = std::make_unique<Param>("reference/int_tests_01.xml");
+  par->observer = Hamvec<3, ham_float>{-8.3 * cgs::kpc, 0., 0.006 * cgs::kpc};
+  par->grid_obs.origin = par->observer;
+  par->grid_obs.gc_r_min = 3. * cgs::kpc;
+  par->grid_obs.gc_r_max = 20. * cgs::kpc;
+  par->grid_obs.gc_z_min = -2. * cgs::kpc;
+  par->grid_obs.gc_z_max = 2. * cgs::kpc;
+  pipe->assemble_shell_ref(ref.get(), par.get(), 0);
+  // random directions, plus the galactic centre and the galactic plane
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<ham_float> smp(0., 1.);
+  std::vector<Hamvec<3, ham_float>> dirs{
+      {1., 0., 0.}, {-1., 0., 0.}, {0., 1., 0.}, {0., 0., 1.}};
+  for (ham_uint i = 0; i != 500; ++i) {
+    const ham_float theta{std::acos(1. - 2. * smp(rng))};
+    dirs.push_back(pipe->los_versor(theta, cgs::twopi * smp(rng)));
+  }
+  for (auto &d : dirs) {
+    ham_uint begin[2], end[2];
+    const ham_uint ranges{
+        pipe->clip_ray(ref.get(), d, par.get(), begin, end)};
+    EXPECT_LE(ranges, ham_uint(2));
+    std::vector<bool> clipped(ref->step, false);
+    for (ham_uint r = 0; r != ranges; ++r) {
+      EXPECT_LT(begin[r], end[r]);
+      if (r > 0) {
+        EXPECT_LT(end[r - 1], begin[r]);
+      }
+      for (ham_uint k = begin[r]; k != end[r]; ++k) {
+        clipped[k] = true;
+      }
+    }
+    // identical to stepwise boundary checks
+    for (ham_uint k = 0; k != ref->step; ++k) {
+      const Hamvec<3, ham_float> pos{d * ref->dist[k] + par->grid_obs.origin};
+      EXPECT_EQ(clipped[k], pipe->check_simulation_volume(pos, par.get()));
+    }
+  }
+  // direction towards galactic centre is split by gc_r_min sphere
+  ham_uint begin[2], end[2];
+  EXPECT_EQ(pipe->clip_ray(ref.get(), dirs[0], par.get(), begin, end),
+            ham_uint(2));
+}
+
+// testing:
+// Integrator::traversal_order
+TEST(integrator, traversal_order) {
+  auto pipe = std::make_unique<Integrator>();
+  std::vector<ham_uint> order;
+  // nside 1, NESTED and RING coincide
+  pipe->traversal_order(&order, Hampix<ham_float>(1));
+  for (ham_uint i = 0; i != 12; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+  // values from HEALPix nest2ring
+  pipe->traversal_order(&order, Hampix<ham_float>(2));
+  EXPECT_EQ(order[0], ham_uint(13));
+  EXPECT_EQ(order[3], ham_uint(0));
+  EXPECT_EQ(order[47], ham_uint(35));
+  // permutation consistent with RING to xyf conversion
+  const Hampix<ham_float> map(16);
+  pipe->traversal_order(&order, map);
+  std::vector<bool> visited(map.npix(), false);
+  for (ham_uint i = 0; i != order.size(); ++i) {
+    ASSERT_LT(order[i], map.npix());
+    EXPECT_FALSE(visited[order[i]]);
+    visited[order[i]] = true;
+    ham_int ix, iy, face;
+    map.rpixxyf(order[i], ix, iy, face);
+    ham_uint nest{static_cast<ham_uint>(face) * 256};
+    for (ham_uint b = 0; b != 4; ++b) {
+      nest |= ((ix >> b) & 1) << (2 * b);
+      nest |= ((iy >> b) & 1) << (2 * b + 1);
+    }
+    EXPECT_EQ(nest, i);
+  }
+}
+
+// testing:
+// Integrator::assemble_sync_ref
+TEST(integrator, sync_info_assembling) {
+  auto pipe = std::make_unique<Integrator>();
+  auto ref = std::make_unique<Integrator::struct_sync>();
+  auto par = std::make_unique<Param>("reference/int_tests_01.xml");
+  pipe->assemble_sync_ref(ref.get(), par.get());
+  // all channels are assembled for a single pass
+  ham_uint test_unsigned = 2;
+  EXPECT_EQ(ref->channels, test_unsigned);
+  EXPECT_EQ(ref->freq.size(), test_unsigned);
+  EXPECT_EQ(ref->lambda_square.size(), test_unsigned);
+  EXPECT_EQ(ref->i2bt.size(), test_unsigned);
+  const ham_float freq[2] = {23.0 * cgs::GHz, 1.4 * cgs::GHz};
+  for (ham_uint c = 0; c != 2; ++c) {
+    EXPECT_EQ(ref->freq[c], freq[c]);
+    const ham_float lambda{cgs::c_light / freq[c]};
+    EXPECT_NEAR(ref->lambda_square[c], lambda * lambda,
+                1.0e-12 * lambda * lambda);
+    const ham_float i2bt{cgs::c_light * cgs::c_light /
+                         (2. * cgs::kB * freq[c] * freq[c])};
+    EXPECT_NEAR(ref->i2bt[c], i2bt, 1.0e-12 * i2bt);
+  }
+}
+
+// testing:
+// Integrator::assemble_sync_ref with CRE spectral table
+// Integrator::update_gamma_memo
+TEST(integrator, cre_spectrum_assembling) {
+  auto pipe = std::make_unique<Integrator>();
+  auto ref = std::make_unique<Integrator::struct_sync>();
+  auto par = std::make_unique<Param>("reference/int_tests_01.xml");
+  par->grid_cre.read_permission = true;
+  par->grid_cre.nE = 11;
+  par->grid_cre.E_min = 0.1 * cgs::GeV;
+  par->grid_cre.E_max = 100 * cgs::GeV;
+  par->grid_cre.E_fact =
+      std::log(par->grid_cre.E_max / par->grid_cre.E_min) / 10;
+  pipe->assemble_sync_ref(ref.get(), par.get());
+  EXPECT_EQ(ref->KE.size(), par->grid_cre.nE);
+  EXPECT_EQ(ref->inv_beta.size(), par->grid_cre.nE);
+  EXPECT_EQ(ref->dE.size(), par->grid_cre.nE - 1);
+  EXPECT_EQ(ref->x_mid.size(), par->grid_cre.nE - 1);
+  EXPECT_NEAR(ref->KE.front(), par->grid_cre.E_min, 1.0e-12 * cgs::GeV);
+  EXPECT_NEAR(ref->KE.back(), par->grid_cre.E_max, 1.0e-10 * cgs::GeV);
+  for (ham_uint i = 0; i != par->grid_cre.nE - 1; ++i) {
+    const ham_float E0{ref->KE[i]};
+    const ham_float E1{ref->KE[i + 1]};
+    EXPECT_NEAR(ref->inv_beta[i], 1. / std::sqrt(1. - cgs::mec2 / E0),
+                1.0e-12);
+    EXPECT_NEAR(ref->dE[i], E1 - E0, 1.0e-12 * (E1 - E0));
+    EXPECT_NEAR(ref->x_mid[i], 0.5 / (E0 * E0) + 0.5 / (E1 * E1),
+                1.0e-12 * ref->x_mid[i]);
+  }
+  // x decreases with energy
+  EXPECT_TRUE(std::is_sorted(ref->x_mid.rbegin(), ref->x_mid.rend()));
+  // Gamma function memo
+  Integrator::struct_gamma_memo memo;
+  const ham_float index{-3.0};
+  pipe->update_gamma_memo(&memo, index);
+  EXPECT_EQ(memo.index, index);
+  const ham_float g{gsl_sf_gamma(-0.25 * index - 1. / 12.)};
+  EXPECT_NEAR(memo.gamma_t, gsl_sf_gamma(-0.25 * index + 19. / 12.) * g,
+              1.0e-12 * memo.gamma_t);
+  EXPECT_NEAR(memo.gamma_p, gsl_sf_gamma(-0.25 * index + 7. / 12.) * g,
+              1.0e-12 * memo.gamma_p);
 }
 
 // testing:
@@ -0,0 +1,67 @@
+// unit tests for multi-observer integration
+// maps of every observer are compared with single-observer runs
+// from the same fields
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <hamtype.h>
+#include <hamunits.h>
+#include <hamvec.h>
+#include <param.h>
+
+#include "pipeline_test.h"
+
+// testing:
+// Param::Param, observer list
+TEST(observer, param) {
+  Param par("reference/observer_tests.xml");
+  ASSERT_EQ(par.grid_obs.observer_list.size(), 2u);
+  EXPECT_EQ(par.observer[0], -8.3 * cgs::kpc);
+  EXPECT_EQ(par.grid_obs.origin[0], -8.3 * cgs::kpc);
+  EXPECT_EQ(par.grid_obs.observer_list[1][1], 2. * cgs::kpc);
+  EXPECT_TRUE(par.grid_obs.origin_tag.empty());
+}
+
+// testing:
+// Pipeline::select_observer
+// Grid_obs::export_grid with observer suffix
+TEST(observer, maps) {
+  const Scratch scratch;
+  const std::string xml{scratch.xml("reference/observer_tests.xml")};
+  Pipeline_test run(xml);
+  run.fields();
+  // last observer, with fields referring to the first one
+  const std::vector<ham_float> result{map_values(run.integrate())};
+  // observer is reset after integration
+  EXPECT_EQ(run.param()->grid_obs.origin[0], -8.3 * cgs::kpc);
+  EXPECT_TRUE(run.param()->grid_obs.origin_tag.empty());
+  for (const char *name :
+       {"dm_obs1", "fd_obs1", "sync_23_obs1_I", "sync_23_obs1_Q",
+        "sync_23_obs1_U", "sync_1.4_obs1_I", "sync_1.4_obs1_Q",
+        "sync_1.4_obs1_U"}) {
+    EXPECT_EQ(::access(scratch.path(std::string(name) + ".bin").c_str(), F_OK),
+              0)
+        << name;
+  }
+  // single observer run from second position, same fields
+  Pipeline_test single(xml);
+  single.fields();
+  Param *par{single.param()};
+  par->grid_obs.observer_list.resize(1);
+  par->grid_obs.observer_list[0] =
+      Hamvec<3, ham_float>{-4. * cgs::kpc, 2. * cgs::kpc, 0.5 * cgs::kpc};
+  const std::vector<ham_float> expected{map_values(single.integrate())};
+  ASSERT_EQ(result.size(), expected.size());
+  for (ham_uint i = 0; i != result.size(); ++i) {
+    EXPECT_EQ(result[i], expected[i]);
+  }
+  // integration from another position differs
+  par->grid_obs.observer_list[0] = par->observer;
+  EXPECT_NE(map_values(single.integrate()), expected);
+}
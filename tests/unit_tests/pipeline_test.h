@@ -0,0 +1,167 @@
+// pipeline with access to its stages, parameters, fields and maps,
+// shared by unit tests running the pipeline
+//
+// maps written by a test go to a private temporary directory, see
+// Scratch, so that tests sharing the test directory do not see files
+// of one another
+
+#ifndef HAMMURABI_PIPELINE_TEST_H
+#define HAMMURABI_PIPELINE_TEST_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <bfield.h>
+#include <grid.h>
+#include <hamtype.h>
+#include <param.h>
+#include <pipeline.h>
+#include <raycache.h>
+#include <tinyxml2.h>
+#include <toolkit.h>
+
+class Pipeline_test : public Pipeline {
+public:
+  Pipeline_test(const std::string &filename) : Pipeline(filename) {}
+  virtual ~Pipeline_test() = default;
+  Param *param() { return par.get(); }
+  Ray_cache *cache() { return ray_cache.get(); }
+  const Breg *breg_field() const { return breg.get(); }
+  const Grid_ternd *ternd_grid() const { return grid_ternd.get(); }
+  const Grid_obs *obs_grid() const { return grid_obs.get(); }
+  // observable grid of derivative maps of k-th gradient parameter
+  const Grid_obs *gradient_grid(const ham_uint &k) const {
+    return grid_grad[k].get();
+  }
+  // drop regular magnetic field, later LoS read zero field
+  void drop_breg() { breg = std::make_unique<Breg>(); }
+  // assemble all field stages
+  void fields() {
+    assemble_grid();
+    assemble_tereg();
+    assemble_breg();
+    assemble_ternd();
+    assemble_brnd();
+    assemble_cre();
+  }
+  // single run of all stages
+  void run() {
+    fields();
+    assemble_obs();
+  }
+  // LoS integration into fresh maps
+  const Grid_obs *integrate() {
+    grid_obs = std::make_unique<Grid_obs>(par.get());
+    assemble_obs();
+    return grid_obs.get();
+  }
+};
+
+// maps of observable grid, in order DM, Faraday depth and Stokes I, Q
+// and U of each synchrotron channel
+// 1st argument: observable grid
+inline std::vector<std::vector<ham_float>> map_arrays(const Grid_obs *gobs) {
+  std::vector<Hampix<ham_float> *> maps{gobs->dm_map.get(),
+                                        gobs->fd_map.get()};
+  for (ham_uint c = 0; c != gobs->is_map.size(); ++c) {
+    maps.push_back(gobs->is_map[c].get());
+    maps.push_back(gobs->qs_map[c].get());
+    maps.push_back(gobs->us_map[c].get());
+  }
+  std::vector<std::vector<ham_float>> result;
+  for (auto m : maps) {
+    result.emplace_back(m->npix());
+    for (ham_uint i = 0; i != m->npix(); ++i) {
+      result.back()[i] = m->data(i);
+    }
+  }
+  return result;
+}
+
+// maps of observable grid in one array, in order of map_arrays
+// 1st argument: observable grid
+inline std::vector<ham_float> map_values(const Grid_obs *gobs) {
+  std::vector<ham_float> result;
+  for (const auto &m : map_arrays(gobs)) {
+    result.insert(result.end(), m.begin(), m.end());
+  }
+  return result;
+}
+
+// private temporary directory, removed with its files
+class Scratch {
+public:
+  Scratch() {
+    const char *tmp{std::getenv("TMPDIR")};
+    std::string name{(tmp == nullptr ? "/tmp" : tmp) +
+                     std::string("/hamx_tests_XXXXXX")};
+    if (::mkdtemp(&name[0]) == nullptr) {
+      throw std::runtime_error("cannot create temporary directory");
+    }
+    dir = name;
+  }
+  Scratch(const Scratch &) = delete;
+  Scratch(Scratch &&) = delete;
+  Scratch &operator=(const Scratch &) = delete;
+  Scratch &operator=(Scratch &&) = delete;
+  ~Scratch() {
+    for (const auto &f : files()) {
+      std::remove(path(f).c_str());
+    }
+    ::rmdir(dir.c_str());
+  }
+  // path of file in directory
+  // 1st argument: file name
+  std::string path(const std::string &name) const { return dir + "/" + name; }
+  // copy of XML parameter file in directory, with map files of
+  // observables in directory, return path of copy
+  // 1st argument: XML parameter file
+  std::string xml(const std::string &filename) const {
+    tinyxml2::XMLDocument doc;
+    if (doc.LoadFile(filename.c_str()) != tinyxml2::XML_SUCCESS) {
+      throw std::runtime_error("cannot load " + filename);
+    }
+    for (tinyxml2::XMLElement *e =
+             toolkit::tracexml(&doc, {"observable"})->FirstChildElement();
+         e != nullptr; e = e->NextSiblingElement()) {
+      const char *name{e->Attribute("filename")};
+      if (name != nullptr) {
+        e->SetAttribute("filename", path(name).c_str());
+      }
+    }
+    const std::string copy{
+        path(filename.substr(filename.find_last_of('/') + 1))};
+    doc.SaveFile(copy.c_str());
+    return copy;
+  }
+  // names of files in directory, sorted
+  std::vector<std::string> files() const {
+    std::vector<std::string> result;
+    DIR *d{::opendir(dir.c_str())};
+    if (d == nullptr) {
+      return result;
+    }
+    for (dirent *e = ::readdir(d); e != nullptr; e = ::readdir(d)) {
+      const std::string name{e->d_name};
+      if (name != "." and name != "..") {
+        result.push_back(name);
+      }
+    }
+    ::closedir(d);
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+protected:
+  std::string dir;
+};
+
+#endif
@@ -0,0 +1,70 @@
+// unit tests for precision policy
+// maps simulated from regular fields on grids are compared with
+// reference maps of double precision build, with tolerance
+// set by precision of grid storage
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <hamtype.h>
+#include <param.h>
+
+#include "pipeline_test.h"
+
+// testing:
+// ham_policy
+TEST(precision, policy) {
+  EXPECT_TRUE((std::is_same<ham_policy::compute, ham_float>::value));
+  EXPECT_TRUE((std::is_same<ham_policy::storage, ham_store>::value));
+#ifdef HAMMURABI_SINGLE_GRID
+  EXPECT_EQ(sizeof(ham_store), sizeof(float));
+#else
+  EXPECT_EQ(sizeof(ham_store), sizeof(double));
+#endif
+}
+
+// testing:
+// Grid_breg and Grid_tereg in storage precision
+// LoS integration in compute precision
+TEST(precision, reference_maps) {
+  // maps are written into temporary directory
+  const Scratch scratch;
+  auto run = std::make_unique<Pipeline_test>(
+      scratch.xml("reference/precision_tests.xml"));
+  run->fields();
+  std::remove("precision_tests_breg.bin");
+  std::remove("precision_tests_tereg.bin");
+  // fields are read from grids written above
+  run->param()->grid_breg.read_permission = true;
+  run->param()->grid_tereg.read_permission = true;
+  const std::vector<std::vector<ham_float>> maps{
+      map_arrays(run->integrate())};
+  // reference maps are kept in one file, in order of maps above
+  std::ifstream input("reference/precision_maps.bin",
+                      std::ios::in | std::ios::binary);
+  ASSERT_TRUE(input.is_open());
+  const ham_float tol{sizeof(ham_store) < sizeof(ham_float) ? 1e-5 : 1e-12};
+  for (const auto &m : maps) {
+    std::vector<double> reference(m.size());
+    input.read(reinterpret_cast<char *>(reference.data()),
+               reference.size() * sizeof(double));
+    ASSERT_TRUE(input.good());
+    // relative to largest magnitude in map
+    ham_float scale{0.};
+    for (const auto &v : reference) {
+      scale = std::max(scale, std::fabs(v));
+    }
+    ASSERT_GT(scale, 0.);
+    for (ham_uint i = 0; i != m.size(); ++i) {
+      EXPECT_NEAR(m[i], reference[i], tol * scale);
+    }
+  }
+}
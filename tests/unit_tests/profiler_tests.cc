@@ -0,0 +1,122 @@
+// unit tests for profiler
+// profiler records elapsed time and counters per thread,
+// and aggregates them when reported
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <hamtype.h>
+#include <profiler.h>
+
+// testing:
+// Profiler::region
+// Profiler::counter
+// Profiler::total_time
+// Profiler::total_calls
+// Profiler::total_count
+// Profiler::reset
+TEST(profiler, records) {
+  Profiler &prof = Profiler::instance();
+  const ham_uint id{prof.region("test/records")};
+  EXPECT_EQ(prof.region("test/records"), id);
+  const ham_uint cid{prof.counter("test/records")};
+  EXPECT_EQ(prof.counter("test/records"), cid);
+  for (int i = 0; i < 2; ++i) {
+    Profile_scope scope(id);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    prof.add_count(cid, 3);
+  }
+  {
+    // later stops are ignored
+    Profile_scope scope(id);
+    scope.stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  EXPECT_EQ(prof.total_calls("test/records"), 3u);
+  EXPECT_LT(std::fabs(prof.total_time("test/records") - 200), 20);
+  EXPECT_EQ(prof.total_count("test/records"), 6u);
+  EXPECT_EQ(prof.total_calls("test/unknown"), 0u);
+  EXPECT_EQ(prof.total_count("test/unknown"), 0u);
+  prof.reset();
+  EXPECT_EQ(prof.total_calls("test/records"), 0u);
+  EXPECT_EQ(prof.total_time("test/records"), 0.);
+  EXPECT_EQ(prof.total_count("test/records"), 0u);
+}
+
+// testing:
+// Profiler::local
+// threads record separately, totals cover all threads
+TEST(profiler, threads) {
+  Profiler &prof = Profiler::instance();
+  prof.reset();
+  const ham_uint n{1000};
+  int threads{1};
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+#ifdef _OPENMP
+#pragma omp single
+    threads = omp_get_num_threads();
+#endif
+    for (ham_uint i = 0; i != n; ++i) {
+      HAM_PROFILE("test/threads");
+      HAM_COUNT("test/threads", 2);
+    }
+  }
+#ifndef NTIMING
+  EXPECT_EQ(prof.total_calls("test/threads"), threads * n);
+  EXPECT_EQ(prof.total_count("test/threads"), 2 * threads * n);
+  EXPECT_GE(prof.threads(), static_cast<ham_uint>(threads));
+#else
+  EXPECT_EQ(prof.total_calls("test/threads"), 0u);
+#endif
+}
+
+// testing:
+// HAM_PROFILE_BEGIN
+// HAM_PROFILE_END
+// HAM_PROFILE_STAGE
+// Profiler::export_json
+// Profiler::export_trace
+TEST(profiler, export) {
+  Profiler &prof = Profiler::instance();
+  prof.reset();
+  {
+    HAM_PROFILE_STAGE("test/stage");
+    HAM_PROFILE_BEGIN(step, "test/step");
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    HAM_PROFILE_END(step);
+  }
+  prof.export_json("profile_tests.json");
+  prof.export_trace("profile_tests.trace.json");
+  auto content = [](const std::string &filename) {
+    std::ifstream input(filename.c_str());
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    return buffer.str();
+  };
+  const std::string json{content("profile_tests.json")};
+  const std::string trace{content("profile_tests.trace.json")};
+  EXPECT_NE(json.find("\"regions\""), std::string::npos);
+  EXPECT_NE(trace.find("\"traceEvents\""), std::string::npos);
+#ifndef NTIMING
+  EXPECT_EQ(prof.total_calls("test/stage"), 1u);
+  EXPECT_EQ(prof.total_calls("test/step"), 1u);
+  EXPECT_NE(json.find("test/step"), std::string::npos);
+  // only stages become trace events
+  EXPECT_NE(trace.find("\"name\": \"test/stage\", \"cat\""),
+            std::string::npos);
+  EXPECT_EQ(trace.find("\"name\": \"test/step\", \"cat\""), std::string::npos);
+#endif
+}
@@ -0,0 +1,185 @@
+// unit tests for LoS field sample cache
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hamtype.h>
+#include <param.h>
+#include <raycache.h>
+#include <tinyxml2.h>
+
+#include "pipeline_test.h"
+
+// pipeline with fields assembled
+// 1st argument: XML parameter file
+std::unique_ptr<Pipeline_test> prepare(const std::string &filename) {
+  auto run = std::make_unique<Pipeline_test>(filename);
+  run->fields();
+  return run;
+}
+
+// testing:
+// Ray_cache::layout
+// Ray_cache::store
+// Ray_cache::load
+// Ray_cache::save
+// Ray_cache::read
+TEST(raycache, slices) {
+  for (const bool single : {false, true}) {
+    Ray_cache cache;
+    cache.open(42, single, "");
+    EXPECT_FALSE(cache.ready(0, 3));
+    cache.layout(0, {2, 0, 3});
+    EXPECT_TRUE(cache.ready(0, 3));
+    EXPECT_EQ(cache.samples(0, 2), 3u);
+    const std::vector<ham_float> bx{1., 2., 3.}, by{4., 5., 6.},
+        bz{7., 8., 9.}, te{0.1, 0.2, 0.3};
+    // sample number other than reserved is not cached
+    cache.store(0, 0, 3, bx.data(), by.data(), bz.data(), te.data());
+    EXPECT_FALSE(cache.filled(0, 0));
+    cache.store(0, 2, 3, bx.data(), by.data(), bz.data(), te.data());
+    cache.store(0, 1, 0, bx.data(), by.data(), bz.data(), te.data());
+    EXPECT_TRUE(cache.filled(0, 2));
+    EXPECT_TRUE(cache.modified());
+    EXPECT_EQ(cache.pixels(), 2u);
+    cache.save("raycache_tests.bin");
+    // content of other key is discarded
+    Ray_cache other;
+    other.open(43, single, "raycache_tests.bin");
+    EXPECT_EQ(other.pixels(), 0u);
+    Ray_cache copy;
+    copy.open(42, single, "raycache_tests.bin");
+    EXPECT_FALSE(copy.modified());
+    EXPECT_EQ(copy.pixels(), 2u);
+    std::vector<ham_float> x(3), y(3), z(3), t(3);
+    copy.load(0, 2, x.data(), y.data(), z.data(), t.data());
+    for (ham_uint i = 0; i != 3; ++i) {
+      EXPECT_FLOAT_EQ(x[i], bx[i]);
+      EXPECT_FLOAT_EQ(y[i], by[i]);
+      EXPECT_FLOAT_EQ(z[i], bz[i]);
+      EXPECT_FLOAT_EQ(t[i], te[i]);
+    }
+    std::remove("raycache_tests.bin");
+  }
+}
+
+// testing:
+// Param::cache_param
+// key ignores CRE and observable parameters only
+TEST(raycache, key) {
+  auto key = [](const char *elem, const char *att, const char *value) {
+    tinyxml2::XMLDocument doc;
+    doc.LoadFile("reference/cache_tests.xml");
+    tinyxml2::XMLElement *root{doc.FirstChildElement("root")};
+    if (std::string(elem) == "alpha") {
+      root->FirstChildElement("cre")
+          ->FirstChildElement("unif")
+          ->FirstChildElement("alpha")
+          ->SetAttribute(att, value);
+    } else if (std::string(elem) == "sync") {
+      root->FirstChildElement("observable")
+          ->FirstChildElement("sync")
+          ->SetAttribute(att, value);
+    } else if (std::string(elem) == "bp") {
+      root->FirstChildElement("magneticfield")
+          ->FirstChildElement("regular")
+          ->FirstChildElement("unif")
+          ->FirstChildElement("bp")
+          ->SetAttribute(att, value);
+    }
+    doc.SaveFile("raycache_tests.xml");
+    Param par("raycache_tests.xml");
+    std::remove("raycache_tests.xml");
+    EXPECT_TRUE(par.grid_obs.do_cache);
+    EXPECT_TRUE(par.grid_obs.cache_stable);
+    return par.grid_obs.cache_key;
+  };
+  const std::uint64_t base{key("", "", "")};
+  EXPECT_EQ(key("alpha", "value", "2.5"), base);
+  EXPECT_EQ(key("sync", "freq", "30"), base);
+  EXPECT_NE(key("bp", "value", "3.0"), base);
+}
+
+// testing:
+// Param::cache_param
+// key follows content of imported grid files, not only their names
+TEST(raycache, imported) {
+  const Scratch scratch;
+  const std::string filename{scratch.path("tereg.bin")};
+  // parameter file exporting or importing thermal electron grid
+  auto edit = [&scratch, &filename](const bool &read, const char *n0) {
+    tinyxml2::XMLDocument doc;
+    doc.LoadFile(scratch.xml("reference/cache_tests.xml").c_str());
+    tinyxml2::XMLElement *root{doc.FirstChildElement("root")};
+    tinyxml2::XMLElement *io{doc.NewElement("tereg")};
+    io->SetAttribute("read", read ? "1" : "0");
+    io->SetAttribute("write", read ? "0" : "1");
+    io->SetAttribute("filename", filename.c_str());
+    root->FirstChildElement("fieldio")->InsertEndChild(io);
+    tinyxml2::XMLElement *box{doc.NewElement("box_tereg")};
+    for (const char *name : {"nx", "ny", "nz"}) {
+      box->InsertEndChild(doc.NewElement(name))->ToElement()->SetAttribute(
+          "value", "8");
+    }
+    // around observer, where the field is not zero
+    for (const auto &limit : std::vector<std::pair<const char *, const char *>>{
+             {"x_min", "-12.0"},
+             {"x_max", "-4.0"},
+             {"y_min", "-4.0"},
+             {"y_max", "4.0"},
+             {"z_min", "-4.0"},
+             {"z_max", "4.0"}}) {
+      box->InsertEndChild(doc.NewElement(limit.first))
+          ->ToElement()
+          ->SetAttribute("value", limit.second);
+    }
+    root->FirstChildElement("grid")->InsertFirstChild(box);
+    root->FirstChildElement("thermalelectron")
+        ->FirstChildElement("regular")
+        ->FirstChildElement("unif")
+        ->FirstChildElement("n0")
+        ->SetAttribute("value", n0);
+    const std::string copy{scratch.path("imported.xml")};
+    doc.SaveFile(copy.c_str());
+    return copy;
+  };
+  // same parameter file importing whatever grid file holds
+  auto key = [&edit]() { return Param(edit(true, "0.01")).grid_obs.cache_key; };
+  prepare(edit(false, "0.01"));
+  const std::uint64_t base{key()};
+  EXPECT_EQ(key(), base);
+  prepare(edit(false, "0.02"));
+  EXPECT_NE(key(), base);
+}
+
+// testing:
+// Integrator::replay_ray
+// replayed samples reproduce integration with changed CRE,
+// regular field is dropped before replay to prove it is not read
+TEST(raycache, replay) {
+  const Scratch scratch;
+  const std::string xml{scratch.xml("reference/cache_tests.xml")};
+  auto reference = prepare(xml);
+  reference->param()->grid_obs.do_cache = false;
+  reference->param()->cre_unif.alpha = 2.5;
+  const std::vector<ham_float> expected{map_values(reference->integrate())};
+
+  auto run = prepare(xml);
+  run->integrate();
+  EXPECT_GT(run->cache()->pixels(), 0u);
+  run->param()->cre_unif.alpha = 2.5;
+  run->drop_breg();
+  const std::vector<ham_float> result{map_values(run->integrate())};
+  ASSERT_EQ(result.size(), expected.size());
+  for (ham_uint i = 0; i != result.size(); ++i) {
+    EXPECT_EQ(result[i], expected[i]);
+  }
+  // without cache, dropped field changes result
+  run->param()->grid_obs.do_cache = false;
+  EXPECT_NE(map_values(run->integrate()), expected);
+}
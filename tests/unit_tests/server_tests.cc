@@ -0,0 +1,186 @@
+// unit tests for resident server
+// replies are compared with maps of separate pipelines
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <bfield.h>
+#include <grid.h>
+#include <hamtype.h>
+#include <param.h>
+#include <server.h>
+#include <tinyxml2.h>
+#include <toolkit.h>
+
+#include "pipeline_test.h"
+
+typedef std::vector<std::pair<std::string, std::vector<ham_float>>> map_list;
+
+// server with access to fields
+class Server_test final : public Server {
+public:
+  Server_test(const std::string &filename) : Server(filename) {}
+  const Breg *breg_field() const { return breg.get(); }
+};
+
+// pipeline keeping exported maps in memory
+class Pipeline_export final : public Pipeline_test {
+public:
+  Pipeline_export(const std::string &filename) : Pipeline_test(filename) {}
+  // maps of single run of all stages
+  map_list exported() {
+    run();
+    return maps;
+  }
+
+protected:
+  map_list maps;
+  void export_obs(Grid_obs *grid, const Param *p) override {
+    for (const auto &m : grid->export_list(p)) {
+      maps.emplace_back(m.first, std::vector<ham_float>(m.second->npix()));
+      for (ham_uint i = 0; i != m.second->npix(); ++i) {
+        maps.back().second[i] = m.second->data(i);
+      }
+    }
+  }
+};
+
+// decode maps of successful reply
+map_list decode(const std::string &reply) {
+  map_list result;
+  std::size_t eol{reply.find('\n')};
+  EXPECT_EQ(reply.compare(0, 3, "ok "), 0);
+  const ham_uint count{std::stoul(reply.substr(3, eol - 3))};
+  std::size_t pos{eol + 1};
+  for (ham_uint k = 0; k != count; ++k) {
+    eol = reply.find('\n', pos);
+    const std::string head{reply.substr(pos, eol - pos)};
+    const std::size_t cut{head.find(' ')};
+    const ham_uint npix{std::stoul(head.substr(cut + 1))};
+    result.emplace_back(head.substr(0, cut), std::vector<ham_float>(npix));
+    std::memcpy(result.back().second.data(), reply.data() + eol + 1,
+                npix * sizeof(ham_float));
+    pos = eol + 1 + npix * sizeof(ham_float);
+  }
+  EXPECT_EQ(pos, reply.size());
+  return result;
+}
+
+// maps of separate pipeline with given overrides
+// 1st argument: temporary directory with XML parameter file
+// 2nd argument: override path
+// 3rd argument: override value
+map_list expected(const Scratch &scratch, const std::string &path,
+                  const std::string &value) {
+  auto doc = toolkit::loadxml(scratch.path("pipeline_tests.xml"));
+  if (not path.empty()) {
+    toolkit::override_xml(doc.get(), path, value);
+  }
+  const std::string copy{scratch.path("expected.xml")};
+  doc->SaveFile(copy.c_str());
+  map_list result{Pipeline_export(copy).exported()};
+  std::remove(copy.c_str());
+  return result;
+}
+
+// testing:
+// Server::respond
+// Server::export_obs
+TEST(server, respond) {
+  const Scratch scratch;
+  Server_test server(scratch.xml("reference/pipeline_tests.xml"));
+  const std::vector<std::string> files{scratch.files()};
+  std::string reply;
+  EXPECT_TRUE(server.respond("{}", reply));
+  map_list result{decode(reply)};
+  ASSERT_EQ(result.size(), 8u);
+  EXPECT_EQ(result[0].first, scratch.path("dm.bin"));
+  EXPECT_EQ(result[1].first, scratch.path("sync_23_I.bin"));
+  EXPECT_EQ(result[7].first, scratch.path("fd.bin"));
+  EXPECT_EQ(result, expected(scratch, "", ""));
+  const Breg *breg{server.breg_field()};
+  // fields are kept, overrides do not accumulate
+  EXPECT_TRUE(server.respond(R"({"cre.unif.alpha": 2.5})", reply));
+  EXPECT_EQ(server.breg_field(), breg);
+  EXPECT_EQ(decode(reply), expected(scratch, "cre.unif.alpha", "2.5"));
+  EXPECT_TRUE(server.respond(R"({"magneticfield.regular.unif.bp": 3})", reply));
+  EXPECT_EQ(decode(reply),
+            expected(scratch, "magneticfield.regular.unif.bp", "3"));
+  // failed requests leave server ready
+  for (const char *request :
+       {"", "cre.unif.alpha", R"({"cre.unif.beta": 1})"}) {
+    EXPECT_TRUE(server.respond(request, reply));
+    EXPECT_EQ(reply.compare(0, 6, "error "), 0) << request;
+    EXPECT_EQ(reply.back(), '\n');
+  }
+  EXPECT_TRUE(server.respond("{}", reply));
+  EXPECT_EQ(decode(reply), result);
+  EXPECT_FALSE(server.respond(" shutdown ", reply));
+  EXPECT_EQ(reply, "bye\n");
+  // no map files are written
+  EXPECT_EQ(scratch.files(), files);
+}
+
+// testing:
+// Server::serve
+TEST(server, socket) {
+  const Scratch scratch;
+  const std::string path{scratch.path("server_tests.sock")};
+  Server_test server(scratch.xml("reference/pipeline_tests.xml"));
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  // socket file left by a previous server is replaced
+  const int stale{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  ASSERT_EQ(::bind(stale, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)),
+            0);
+  ::close(stale);
+  std::thread host([&server, &path]() { server.serve(path); });
+  const int fd{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  ASSERT_GE(fd, 0);
+  // wait for server to listen
+  ham_uint attempt{0};
+  while (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) !=
+             0 and
+         attempt++ < 1000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_LT(attempt, 1000u);
+  // two requests in one write
+  const std::string request{"{\"cre.unif.alpha\": 2.5}\nshutdown\n"};
+  ASSERT_EQ(::write(fd, request.data(), request.size()),
+            static_cast<ssize_t>(request.size()));
+  std::string reply;
+  char chunk[4096];
+  for (ssize_t n; (n = ::read(fd, chunk, sizeof(chunk))) > 0;) {
+    reply.append(chunk, n);
+  }
+  ::close(fd);
+  host.join();
+  ASSERT_GT(reply.size(), 4u);
+  EXPECT_EQ(reply.substr(reply.size() - 4), "bye\n");
+  reply.resize(reply.size() - 4);
+  EXPECT_EQ(decode(reply), expected(scratch, "cre.unif.alpha", "2.5"));
+  // socket file is removed at shutdown
+  EXPECT_NE(::access(path.c_str(), F_OK), 0);
+  // other files at path are kept
+  std::FILE *file{std::fopen(path.c_str(), "w")};
+  ASSERT_NE(file, nullptr);
+  std::fclose(file);
+  EXPECT_THROW(server.serve(path), std::runtime_error);
+  EXPECT_EQ(::access(path.c_str(), F_OK), 0);
+}
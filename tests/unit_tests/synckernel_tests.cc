@@ -0,0 +1,65 @@
+// unit tests for tabulated synchrotron kernels
+// F(x) and G(x) are validated against GSL
+
+#include <gtest/gtest.h>
+
+#include <gsl/gsl_sf_synchrotron.h>
+
+#include <cmath>
+#include <hamtype.h>
+#include <synckernel.h>
+#include <vector>
+
+// testing:
+// Sync_kernel::F
+// Sync_kernel::G
+// covering small x series, table and asymptotic series
+TEST(synckernel, gsl_consistency) {
+  const ham_float tol{1e-8};
+  Sync_kernel kernel(tol);
+  EXPECT_LE(kernel.error(), tol);
+  for (ham_float lx = -7.; lx < 2.; lx += 0.031) {
+    const ham_float x{std::pow(10., lx)};
+    EXPECT_NEAR(kernel.F(x) / gsl_sf_synchrotron_1(x), 1., tol);
+    EXPECT_NEAR(kernel.G(x) / gsl_sf_synchrotron_2(x), 1., tol);
+  }
+  EXPECT_EQ(kernel.F(0.), 0.);
+  EXPECT_EQ(kernel.G(0.), 0.);
+}
+
+// testing:
+// Sync_kernel::Sync_kernel
+// looser accuracy target gives coarser table
+TEST(synckernel, accuracy_target) {
+  Sync_kernel coarse(1e-4);
+  Sync_kernel fine(1e-6);
+  EXPECT_LE(coarse.error(), 1e-4);
+  EXPECT_LE(fine.error(), 1e-6);
+  EXPECT_LT(coarse.nodes_per_decade(), fine.nodes_per_decade());
+  for (ham_float lx = -4.; lx < 1.5; lx += 0.053) {
+    const ham_float x{std::pow(10., lx)};
+    EXPECT_NEAR(coarse.F(x) / gsl_sf_synchrotron_1(x), 1., 1e-4);
+    EXPECT_NEAR(coarse.G(x) / gsl_sf_synchrotron_2(x), 1., 1e-4);
+    EXPECT_NEAR(fine.F(x) / gsl_sf_synchrotron_1(x), 1., 1e-6);
+    EXPECT_NEAR(fine.G(x) / gsl_sf_synchrotron_2(x), 1., 1e-6);
+  }
+  EXPECT_THROW(Sync_kernel(0.), std::runtime_error);
+}
+
+// testing:
+// Sync_kernel::F_batch
+// Sync_kernel::G_batch
+TEST(synckernel, batch) {
+  Sync_kernel kernel;
+  // table range, series on both sides and non-positive x
+  std::vector<ham_float> x{0., -1.}, F(202), G(202);
+  for (ham_uint i = 0; i != 200; ++i) {
+    x.push_back(std::pow(10., -6. + 0.04 * i));
+  }
+  kernel.F_batch(x.data(), x.size(), F.data());
+  kernel.G_batch(x.data(), x.size(), G.data());
+  for (ham_uint i = 0; i != x.size(); ++i) {
+    EXPECT_EQ(F[i], kernel.F(x[i]));
+    EXPECT_EQ(G[i], kernel.G(x[i]));
+  }
+}
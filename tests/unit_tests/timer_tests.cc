@@ -30,3 +30,21 @@ TEST(timing, precision) {
   EXPECT_LT(fabs(t.record.find("sub")->second.second - 5000), 50);
   EXPECT_LT(fabs(t.record.find("main")->second.second - 10000), 100);
 }
+
+// testing:
+// Timer::stop
+// repeated recording accumulates per name
+TEST(timing, accumulation) {
+  Timer t;
+  for (int i = 0; i < 2; ++i) {
+    t.start("a");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    t.stop("a");
+  }
+  t.start("b");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  t.stop("b");
+
+  EXPECT_LT(fabs(t.record.find("a")->second.second - 200), 20);
+  EXPECT_LT(fabs(t.record.find("b")->second.second - 100), 20);
+}
@@ -6,6 +6,8 @@
 #include <hamtype.h>
 #include <memory>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <tinyxml2.h>
 #include <toolkit.h>
 #include <vector>
@@ -112,3 +114,38 @@ TEST(toolkit, xml_parser) {
 
   EXPECT_EQ(toolkit::fetchbool(el, "dft_value", "true"), false);
 }
+
+// testing:
+// toolkit::parse_record
+TEST(toolkit, parse_record) {
+  const auto items = toolkit::parse_record(
+      R"({"grid.shell.oc_r_res": 0.2, "cre@type" : "unif", "x": true})");
+  ASSERT_EQ(items.size(), 3u);
+  EXPECT_EQ(items[0].first, "grid.shell.oc_r_res");
+  EXPECT_EQ(items[0].second, "0.2");
+  EXPECT_EQ(items[1].first, "cre@type");
+  EXPECT_EQ(items[1].second, "unif");
+  EXPECT_EQ(items[2].second, "1");
+  EXPECT_TRUE(toolkit::parse_record(" {} ").empty());
+  EXPECT_THROW(toolkit::parse_record(R"({"a": {"b": 1}})"),
+               std::runtime_error);
+  EXPECT_THROW(toolkit::parse_record(R"({"a": 1)"), std::runtime_error);
+}
+
+// testing:
+// toolkit::override_xml
+TEST(toolkit, override_xml) {
+  auto doc = toolkit::loadxml("reference/tools_tests.xml");
+  toolkit::override_xml(doc.get(), "float", "2.5");
+  toolkit::override_xml(doc.get(), "integer@other", "7");
+  EXPECT_EQ(toolkit::fetchfloat(toolkit::tracexml(doc.get(), {"float"}),
+                                "value"),
+            ham_float(2.5));
+  EXPECT_EQ(toolkit::fetchuint(toolkit::tracexml(doc.get(), {"integer"}),
+                               "other"),
+            ham_uint(7));
+  EXPECT_THROW(toolkit::override_xml(doc.get(), "float[1]", "0"),
+               std::runtime_error);
+  EXPECT_THROW(toolkit::override_xml(doc.get(), "missing.float", "0"),
+               std::runtime_error);
+}